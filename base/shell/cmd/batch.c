@@ -166,6 +166,16 @@ VOID ClearBatch(VOID)
     if (bc->mem && bc->memfree)
         cmd_free(bc->mem);
 
+    if (bc->labels)
+    {
+        UINT i;
+        for (i = 0; i < bc->labelcount; i++)
+            cmd_free(bc->labels[i].name);
+        cmd_free(bc->labels);
+        bc->labels = NULL;
+        bc->labelcount = 0;
+    }
+
     if (bc->raw_params)
         cmd_free(bc->raw_params);
 
@@ -308,6 +318,8 @@ INT Batch(LPTSTR fullname, LPTSTR firstword, LPTSTR param, PARSED_COMMAND *Cmd)
             new.memfree = FALSE;    /* don't free this, being used before this */
         }
         bc = &new;
+        bc->labels = NULL;
+        bc->labelcount = 0;
         bc->RedirList = NULL;
         bc->setlocal = setlocal;
     }
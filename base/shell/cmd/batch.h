@@ -4,6 +4,12 @@
 
 #pragma once
 
+typedef struct tagBATCHLABEL
+{
+    LPTSTR name;        /* label name, without the leading colon */
+    DWORD  pos;         /* position of the line following the label */
+} BATCH_LABEL, *LPBATCH_LABEL;
+
 typedef struct tagBATCHCONTEXT
 {
     struct tagBATCHCONTEXT *prev;
@@ -11,6 +17,8 @@ typedef struct tagBATCHCONTEXT
     DWORD   memsize;    /* size of batchfile */
     DWORD   mempos;     /* current position to read from */
     BOOL    memfree;    /* true if it need to be freed when exitbatch is called */	
+    LPBATCH_LABEL labels;   /* label index sorted by name, built on first GOTO, kept by the context owning mem */
+    UINT    labelcount;
     TCHAR BatchFilePath[MAX_PATH];
     LPTSTR params;
     LPTSTR raw_params;  /* Holds the raw params given by the input */
@@ -29,6 +29,149 @@
 #include "precomp.h"
 
 
+/*
+ * Extract the label name from a batch file line, applying the same
+ * trimming as the original line by line search: trailing spaces, control
+ * chars and colons are dropped, leading spaces skipped, and the name ends
+ * at the first space. Returns NULL if the line is not a label.
+ */
+static LPTSTR GetLabelFromLine (LPTSTR line)
+{
+    LPTSTR tmp;
+    INT_PTR size;
+    int pos;
+
+    /* Strip out any trailing spaces or control chars */
+    tmp = line + _tcslen (line) - 1;
+
+    while (tmp > line && (_istcntrl (*tmp) || _istspace (*tmp) ||  (*tmp == _T(':'))))
+        tmp--;
+    *(tmp + 1) = _T('\0');
+
+    /* Then leading spaces... */
+    tmp = line;
+    while (_istspace (*tmp))
+        tmp++;
+
+    /* All space after leading space terminate the string */
+    size = _tcslen(tmp) -1;
+    pos=0;
+    while (tmp+pos < tmp+size)
+    {
+        if (_istspace(tmp[pos]))
+            tmp[pos]=_T('\0');
+        pos++;
+    }
+
+    if (*tmp != _T(':'))
+        return NULL;
+
+    return tmp + 1;
+}
+
+static int __cdecl CompareLabels (const void *arg1, const void *arg2)
+{
+    const BATCH_LABEL *label1 = arg1;
+    const BATCH_LABEL *label2 = arg2;
+    int ret;
+
+    ret = _tcsicmp (label1->name, label2->name);
+    if (ret != 0)
+        return ret;
+
+    /* Keep duplicate labels in file order, the first one wins */
+    return (label1->pos < label2->pos) ? -1 : (label1->pos > label2->pos);
+}
+
+/*
+ * A CALL into the same batch file shares the file in memory with the
+ * calling context, so the label index is kept by the context that owns it.
+ */
+static LPBATCH_CONTEXT GetLabelIndexOwner (VOID)
+{
+    LPBATCH_CONTEXT owner = bc;
+
+    while (owner->mem && !owner->memfree && owner->prev && owner->prev->mem == owner->mem)
+        owner = owner->prev;
+
+    return owner;
+}
+
+/*
+ * Read the whole batch file once and build the label index for the
+ * context owning it, so that GOTO does not rescan the file.
+ */
+static BOOL BuildLabelIndex (LPBATCH_CONTEXT owner)
+{
+    LPBATCH_LABEL labels, tmp;
+    UINT count = 0, max = 16;
+    LPTSTR name;
+
+    labels = cmd_alloc (max * sizeof(BATCH_LABEL));
+    if (!labels)
+        return FALSE;
+
+    bc->mempos = 0;
+
+    while (BatchGetString (textline, sizeof(textline) / sizeof(textline[0])))
+    {
+        name = GetLabelFromLine (textline);
+        if (!name)
+            continue;
+
+        if (count == max)
+        {
+            tmp = cmd_realloc (labels, 2 * max * sizeof(BATCH_LABEL));
+            if (!tmp)
+                goto failure;
+            labels = tmp;
+            max *= 2;
+        }
+
+        labels[count].name = cmd_dup (name);
+        if (!labels[count].name)
+            goto failure;
+        labels[count].pos = bc->mempos;
+        count++;
+    }
+
+    qsort (labels, count, sizeof(BATCH_LABEL), CompareLabels);
+
+    owner->labels = labels;
+    owner->labelcount = count;
+    return TRUE;
+
+failure:
+    while (count)
+        cmd_free (labels[--count].name);
+    cmd_free (labels);
+    return FALSE;
+}
+
+/*
+ * Look up a label in the index, returns the position of the line
+ * following its first occurrence or -1 if it does not exist.
+ */
+static DWORD FindLabel (LPBATCH_CONTEXT owner, LPCTSTR name)
+{
+    UINT low = 0, high = owner->labelcount, mid;
+
+    /* Find the first entry not sorting before the name */
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+        if (_tcsicmp (owner->labels[mid].name, name) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low < owner->labelcount && _tcsicmp (owner->labels[low].name, name) == 0)
+        return owner->labels[low].pos;
+
+    return (DWORD)-1;
+}
+
 /*
  * Perform GOTO command.
  *
@@ -38,7 +181,9 @@
 
 INT cmd_goto (LPTSTR param)
 {
-    LPTSTR tmp, tmp2;
+    LPBATCH_CONTEXT owner;
+    LPTSTR tmp;
+    DWORD pos;
 
     TRACE ("cmd_goto (\'%s\')\n", debugstr_aw(param));
 
@@ -74,41 +219,24 @@ INT cmd_goto (LPTSTR param)
         return 0;
     }
 
-    /* jump to begin of the file */
-    bc->mempos=0;
-
-    while (BatchGetString (textline, sizeof(textline) / sizeof(textline[0])))
+    /* the label index is built once per batch file in memory */
+    owner = GetLabelIndexOwner();
+    if (!owner->labels && !BuildLabelIndex(owner))
     {
-        int pos;
-        INT_PTR size;
-
-        /* Strip out any trailing spaces or control chars */
-        tmp = textline + _tcslen (textline) - 1;
-
-        while (tmp > textline && (_istcntrl (*tmp) || _istspace (*tmp) ||  (*tmp == _T(':'))))
-            tmp--;
-        *(tmp + 1) = _T('\0');
-
-        /* Then leading spaces... */
-        tmp = textline;
-        while (_istspace (*tmp))
-            tmp++;
-
-        /* All space after leading space terminate the string */
-        size = _tcslen(tmp) -1;
-        pos=0;
-        while (tmp+pos < tmp+size)
-        {
-            if (_istspace(tmp[pos]))
-                tmp[pos]=_T('\0');
-            pos++;
-        }
-
-        tmp2 = param;
-        /* use whole label name */
-        if ((*tmp == _T(':')) && ((_tcsicmp (++tmp, param) == 0) || (_tcsicmp (tmp, ++tmp2) == 0)))
-            return 0;
+        error_out_of_memory();
+        ExitBatch();
+        return 1;
+    }
 
+    /* match the whole label name, or the name without the colon in front
+     * of it, whichever comes first in the file */
+    pos = FindLabel (owner, param);
+    if (*param == _T(':'))
+        pos = min (pos, FindLabel (owner, param + 1));
+    if (pos != (DWORD)-1)
+    {
+        bc->mempos = pos;
+        return 0;
     }
 
     ConErrResPrintf(STRING_GOTO_ERROR2, param);
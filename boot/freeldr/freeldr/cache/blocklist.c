@@ -22,14 +22,19 @@
 
 DBG_DEFAULT_CHANNEL(CACHE);
 
+static PLIST_ENTRY CacheInternalHashBucket(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
+{
+    return &CacheDrive->CacheBlockHash[BlockNumber & (CACHE_HASH_SIZE - 1)];
+}
+
 // Returns a pointer to a CACHE_BLOCK structure
 // Adds the block to the cache manager block list
 // in cache memory if it isn't already there
-PCACHE_BLOCK CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
+PCACHE_BLOCK CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNumber, ULONG BlockCount)
 {
     PCACHE_BLOCK    CacheBlock = NULL;
 
-    TRACE("CacheInternalGetBlockPointer() BlockNumber = %d\n", BlockNumber);
+    TRACE("CacheInternalGetBlockPointer() BlockNumber = %d BlockCount = %d\n", BlockNumber, BlockCount);
 
     CacheBlock = CacheInternalFindBlock(CacheDrive, BlockNumber);
 
@@ -37,106 +42,162 @@ PCACHE_BLOCK CacheInternalGetBlockPointer(PCACHE_DRIVE CacheDrive, ULONG BlockNu
     {
         TRACE("Cache hit! BlockNumber: %d CacheBlock->BlockNumber: %d\n", BlockNumber, CacheBlock->BlockNumber);
 
+        CacheHits++;
+        CacheDrive->LastBlockNumber = BlockNumber;
+
         return CacheBlock;
     }
 
     TRACE("Cache miss! BlockNumber: %d\n", BlockNumber);
 
-    CacheBlock = CacheInternalAddBlockToCache(CacheDrive, BlockNumber);
+    CacheMisses++;
+
+    // If the blocks are being read sequentially then
+    // read ahead of what the caller asked for
+    if ((BlockNumber == CacheDrive->LastBlockNumber) ||
+        (BlockNumber == CacheDrive->LastBlockNumber + 1))
+    {
+        BlockCount += CACHE_READ_AHEAD_BLOCKS;
+    }
+    CacheDrive->LastBlockNumber = BlockNumber;
+
+    CacheBlock = CacheInternalAddBlockToCache(CacheDrive, BlockNumber, BlockCount);
 
     // Optimize the block list so it has a LRU structure
-    CacheInternalOptimizeBlockList(CacheDrive, CacheBlock);
+    if (CacheBlock != NULL)
+    {
+        CacheInternalOptimizeBlockList(CacheDrive, CacheBlock);
+    }
 
     return CacheBlock;
 }
 
 PCACHE_BLOCK CacheInternalFindBlock(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
 {
-    PCACHE_BLOCK    CacheBlock = NULL;
+    PLIST_ENTRY     BucketHead;
+    PLIST_ENTRY     Entry;
+    PCACHE_BLOCK    CacheBlock;
 
     TRACE("CacheInternalFindBlock() BlockNumber = %d\n", BlockNumber);
 
     //
-    // Make sure the block list has entries before I start searching it.
+    // Search the hash bucket of this block number
     //
-    if (!IsListEmpty(&CacheDrive->CacheBlockHead))
+    BucketHead = CacheInternalHashBucket(CacheDrive, BlockNumber);
+
+    for (Entry = BucketHead->Flink; Entry != BucketHead; Entry = Entry->Flink)
     {
+        CacheBlock = CONTAINING_RECORD(Entry, CACHE_BLOCK, HashEntry);
+
         //
-        // Search the list and find the BIOS drive number
+        // We found the block, so return it
         //
-        CacheBlock = CONTAINING_RECORD(CacheDrive->CacheBlockHead.Flink, CACHE_BLOCK, ListEntry);
-
-        while (&CacheBlock->ListEntry != &CacheDrive->CacheBlockHead)
+        if (CacheBlock->BlockNumber == BlockNumber)
         {
             //
-            // We found the block, so return it
+            // Increment the blocks access count
             //
-            if (CacheBlock->BlockNumber == BlockNumber)
-            {
-                //
-                // Increment the blocks access count
-                //
-                CacheBlock->AccessCount++;
+            CacheBlock->AccessCount++;
 
-                return CacheBlock;
-            }
-
-            CacheBlock = CONTAINING_RECORD(CacheBlock->ListEntry.Flink, CACHE_BLOCK, ListEntry);
+            return CacheBlock;
         }
     }
 
     return NULL;
 }
 
-PCACHE_BLOCK CacheInternalAddBlockToCache(PCACHE_DRIVE CacheDrive, ULONG BlockNumber)
+PCACHE_BLOCK CacheInternalAddBlockToCache(PCACHE_DRIVE CacheDrive, ULONG BlockNumber, ULONG BlockCount)
 {
     PCACHE_BLOCK    CacheBlock = NULL;
+    PCACHE_BLOCK    FirstCacheBlock = NULL;
+    ULONG           BlockBytes = CacheDrive->BlockSize * CacheDrive->BytesPerSector;
+    ULONG           MaxBlockCount;
+    ULONG           Idx;
 
-    TRACE("CacheInternalAddBlockToCache() BlockNumber = %d\n", BlockNumber);
-
-    // Check the size of the cache so we don't exceed our limits
-    CacheInternalCheckCacheSizeLimits(CacheDrive);
+    TRACE("CacheInternalAddBlockToCache() BlockNumber = %d BlockCount = %d\n", BlockNumber, BlockCount);
 
-    // We will need to add the block to the
-    // drive's list of cached blocks. So allocate
-    // the block memory.
-    CacheBlock = FrLdrTempAlloc(sizeof(CACHE_BLOCK), TAG_CACHE_BLOCK);
-    if (CacheBlock == NULL)
+    // Read as many blocks as fit in the disk read buffer at once,
+    // but stop before the first block that is already cached
+    MaxBlockCount = (ULONG)(DiskReadBufferSize / BlockBytes);
+    if (BlockCount > MaxBlockCount)
     {
-        return NULL;
+        BlockCount = max(MaxBlockCount, 1);
     }
-
-    // Now initialize the structure and
-    // allocate room for the block data
-    RtlZeroMemory(CacheBlock, sizeof(CACHE_BLOCK));
-    CacheBlock->BlockNumber = BlockNumber;
-    CacheBlock->BlockData = FrLdrTempAlloc(CacheDrive->BlockSize * CacheDrive->BytesPerSector,
-                                           TAG_CACHE_DATA);
-    if (CacheBlock->BlockData ==NULL)
+    for (Idx = 1; Idx < BlockCount; Idx++)
     {
-        FrLdrTempFree(CacheBlock, TAG_CACHE_BLOCK);
-        return NULL;
+        if (CacheInternalFindBlock(CacheDrive, BlockNumber + Idx) != NULL)
+        {
+            break;
+        }
     }
+    BlockCount = Idx;
 
-    // Now try to read in the block
-    if (!MachDiskReadLogicalSectors(CacheDrive->DriveNumber, (BlockNumber * CacheDrive->BlockSize), CacheDrive->BlockSize, DiskReadBuffer))
+    // Now try to read in the blocks. The blocks after the first one may run
+    // past the end of the drive (read-ahead at the tail of a floppy, for
+    // instance), so if that fails, settle for the block that was asked for.
+    if (!MachDiskReadLogicalSectors(CacheDrive->DriveNumber, ((ULONGLONG)BlockNumber * CacheDrive->BlockSize), BlockCount * CacheDrive->BlockSize, DiskReadBuffer))
     {
-        FrLdrTempFree(CacheBlock->BlockData, TAG_CACHE_DATA);
-        FrLdrTempFree(CacheBlock, TAG_CACHE_BLOCK);
-        return NULL;
+        if (BlockCount == 1)
+        {
+            return NULL;
+        }
+
+        TRACE("Multi-block read failed, retrying block %d alone\n", BlockNumber);
+        BlockCount = 1;
+        if (!MachDiskReadLogicalSectors(CacheDrive->DriveNumber, ((ULONGLONG)BlockNumber * CacheDrive->BlockSize), CacheDrive->BlockSize, DiskReadBuffer))
+        {
+            return NULL;
+        }
     }
-    RtlCopyMemory(CacheBlock->BlockData, DiskReadBuffer, CacheDrive->BlockSize * CacheDrive->BytesPerSector);
+    CacheDiskReads++;
+    CacheBytesRead += BlockCount * BlockBytes;
 
-    // Add it to our list of blocks managed by the cache
-    InsertTailList(&CacheDrive->CacheBlockHead, &CacheBlock->ListEntry);
+    // Add them starting with the last one, so that the block
+    // that was asked for ends up at the head of the LRU list
+    for (Idx = BlockCount; Idx-- > 0; )
+    {
+        // Check the size of the cache so we don't exceed our limits
+        CacheInternalCheckCacheSizeLimits(CacheDrive);
+
+        // We will need to add the block to the
+        // drive's list of cached blocks. So allocate
+        // the block memory.
+        CacheBlock = FrLdrTempAlloc(sizeof(CACHE_BLOCK), TAG_CACHE_BLOCK);
+        if (CacheBlock == NULL)
+        {
+            return FirstCacheBlock;
+        }
 
-    // Update the cache data
-    CacheBlockCount++;
-    CacheSizeCurrent = CacheBlockCount * (CacheDrive->BlockSize * CacheDrive->BytesPerSector);
+        // Now initialize the structure and
+        // allocate room for the block data
+        RtlZeroMemory(CacheBlock, sizeof(CACHE_BLOCK));
+        CacheBlock->BlockNumber = BlockNumber + Idx;
+        CacheBlock->BlockData = FrLdrTempAlloc(BlockBytes, TAG_CACHE_DATA);
+        if (CacheBlock->BlockData ==NULL)
+        {
+            FrLdrTempFree(CacheBlock, TAG_CACHE_BLOCK);
+            return FirstCacheBlock;
+        }
+
+        RtlCopyMemory(CacheBlock->BlockData, (PUCHAR)DiskReadBuffer + Idx * BlockBytes, BlockBytes);
+
+        // Add it to our list of blocks managed by the cache
+        InsertHeadList(&CacheDrive->CacheBlockHead, &CacheBlock->ListEntry);
+        InsertHeadList(CacheInternalHashBucket(CacheDrive, CacheBlock->BlockNumber), &CacheBlock->HashEntry);
+
+        // Update the cache data
+        CacheBlockCount++;
+        CacheSizeCurrent = CacheBlockCount * BlockBytes;
+
+        if (Idx == 0)
+        {
+            FirstCacheBlock = CacheBlock;
+        }
+    }
 
     CacheInternalDumpBlockList(CacheDrive);
 
-    return CacheBlock;
+    return FirstCacheBlock;
 }
 
 BOOLEAN CacheInternalFreeBlock(PCACHE_DRIVE CacheDrive)
@@ -156,12 +217,13 @@ BOOLEAN CacheInternalFreeBlock(PCACHE_DRIVE CacheDrive)
 
     // No blocks left in cache that can be freed
     // so just return
-    if (IsListEmpty(&CacheDrive->CacheBlockHead))
+    if (&CacheBlockToFree->ListEntry == &CacheDrive->CacheBlockHead)
     {
         return FALSE;
     }
 
     RemoveEntryList(&CacheBlockToFree->ListEntry);
+    RemoveEntryList(&CacheBlockToFree->HashEntry);
 
     // Free the block memory and the block structure
     FrLdrTempFree(CacheBlockToFree->BlockData, TAG_CACHE_DATA);
@@ -201,6 +263,8 @@ VOID CacheInternalDumpBlockList(PCACHE_DRIVE CacheDrive)
     TRACE("CacheSizeLimit: %d.\n", CacheSizeLimit);
     TRACE("CacheSizeCurrent: %d.\n", CacheSizeCurrent);
     TRACE("CacheBlockCount: %d.\n", CacheBlockCount);
+    TRACE("CacheHits: %d CacheMisses: %d.\n", CacheHits, CacheMisses);
+    TRACE("CacheDiskReads: %d CacheBytesRead: %I64u.\n", CacheDiskReads, CacheBytesRead);
 
     CacheBlock = CONTAINING_RECORD(CacheDrive->CacheBlockHead.Flink, CACHE_BLOCK, ListEntry);
     while (&CacheBlock->ListEntry != &CacheDrive->CacheBlockHead)
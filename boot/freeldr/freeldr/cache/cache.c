@@ -33,11 +33,16 @@ BOOLEAN            CacheManagerDataInvalid = FALSE;
 ULONG            CacheBlockCount = 0;
 SIZE_T            CacheSizeLimit = 0;
 SIZE_T            CacheSizeCurrent = 0;
+ULONG            CacheHits = 0;
+ULONG            CacheMisses = 0;
+ULONG            CacheDiskReads = 0;
+ULONGLONG        CacheBytesRead = 0;
 
 BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
 {
     PCACHE_BLOCK    NextCacheBlock;
     GEOMETRY    DriveGeometry;
+    ULONG        Idx;
 
     // If we already have a cache for this drive then
     // by all means lets keep it, unless it is a removable
@@ -63,6 +68,8 @@ BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
         TRACE("CacheBlockCount: %d\n", CacheBlockCount);
         TRACE("CacheSizeLimit: %d\n", CacheSizeLimit);
         TRACE("CacheSizeCurrent: %d\n", CacheSizeCurrent);
+        TRACE("Cache hits: %d misses: %d disk reads: %d bytes read: %I64u\n",
+              CacheHits, CacheMisses, CacheDiskReads, CacheBytesRead);
         //
         // Loop through and free the cache blocks
         //
@@ -80,6 +87,11 @@ BOOLEAN CacheInitializeDrive(UCHAR DriveNumber)
     // Initialize the structure
     RtlZeroMemory(&CacheManagerDrive, sizeof(CACHE_DRIVE));
     InitializeListHead(&CacheManagerDrive.CacheBlockHead);
+    for (Idx = 0; Idx < CACHE_HASH_SIZE; Idx++)
+    {
+        InitializeListHead(&CacheManagerDrive.CacheBlockHash[Idx]);
+    }
+    CacheManagerDrive.LastBlockNumber = MAXULONG;
     CacheManagerDrive.DriveNumber = DriveNumber;
     if (!MachDiskGetDriveGeometry(DriveNumber, &DriveGeometry))
     {
@@ -151,7 +163,7 @@ BOOLEAN CacheReadDiskSectors(UCHAR DiskNumber, ULONGLONG StartSector, ULONG Sect
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, StartBlock);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, StartBlock, BlockCount);
         if (CacheBlock == NULL)
         {
             return FALSE;
@@ -184,7 +196,7 @@ BOOLEAN CacheReadDiskSectors(UCHAR DiskNumber, ULONGLONG StartSector, ULONG Sect
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx, BlockCount);
         if (CacheBlock == NULL)
         {
             return FALSE;
@@ -217,7 +229,7 @@ BOOLEAN CacheReadDiskSectors(UCHAR DiskNumber, ULONGLONG StartSector, ULONG Sect
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, EndBlock);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, EndBlock, 1);
         if (CacheBlock == NULL)
         {
             return FALSE;
@@ -277,7 +289,7 @@ BOOLEAN CacheForceDiskSectorsIntoCache(UCHAR DiskNumber, ULONGLONG StartSector,
         //
         // Get cache block pointer (this forces the disk sectors into the cache memory)
         //
-        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx);
+        CacheBlock = CacheInternalGetBlockPointer(&CacheManagerDrive, Idx, 1);
         if (CacheBlock == NULL)
         {
             return FALSE;
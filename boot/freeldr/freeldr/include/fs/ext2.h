@@ -103,7 +103,18 @@ struct ext2_sblock
   char volume_name[16];
   char last_mounted_on[64];
   ULONG compression_info;
-  ULONG padding[77];
+  UCHAR prealloc_blocks;
+  UCHAR prealloc_dir_blocks;
+  USHORT reserved_gdt_blocks;
+  UCHAR journal_uuid[16];
+  ULONG journal_inode;
+  ULONG journal_device;
+  ULONG last_orphan;
+  ULONG hash_seed[4];
+  UCHAR default_hash_version;
+  UCHAR journal_backup_type;
+  USHORT desc_size;
+  ULONG padding[64];
 };
 
 /* The ext2 blockgroup.  */
@@ -168,16 +179,68 @@ struct ext2_dirent
  * End of code from grub/fs/ext2.c
  */
 
+/* The ext4 extent tree, stored in the inode block array
+ * and in the tree blocks it points to.  */
+struct ext4_extent_header
+{
+  USHORT magic;
+  USHORT entries;
+  USHORT max;
+  USHORT depth;
+  ULONG generation;
+};
+
+/* Leaf entry, maps a run of file blocks to disk blocks.  */
+struct ext4_extent
+{
+  ULONG block;
+  USHORT len;
+  USHORT start_hi;
+  ULONG start_lo;
+};
+
+/* Index entry, points to the tree block covering a range of file blocks.  */
+struct ext4_extent_idx
+{
+  ULONG block;
+  ULONG leaf_lo;
+  USHORT leaf_hi;
+  USHORT unused;
+};
+
 typedef struct ext2_sblock        EXT2_SUPER_BLOCK, *PEXT2_SUPER_BLOCK;
 typedef struct ext2_inode        EXT2_INODE, *PEXT2_INODE;
 typedef struct ext2_block_group        EXT2_GROUP_DESC, *PEXT2_GROUP_DESC;
 typedef struct ext2_dirent        EXT2_DIR_ENTRY, *PEXT2_DIR_ENTRY;
+typedef struct ext4_extent_header    EXT4_EXTENT_HEADER, *PEXT4_EXTENT_HEADER;
+typedef struct ext4_extent        EXT4_EXTENT, *PEXT4_EXTENT;
+typedef struct ext4_extent_idx        EXT4_EXTENT_IDX, *PEXT4_EXTENT_IDX;
 
 /* Special inode numbers.  */
 #define EXT2_ROOT_INO        2
 
 /* Feature set definitions.  */
-#define EXT3_FEATURE_INCOMPAT_SUPP    0x0002
+#define EXT2_FEATURE_INCOMPAT_FILETYPE    0x0002
+#define EXT4_FEATURE_INCOMPAT_EXTENTS    0x0040
+#define EXT4_FEATURE_INCOMPAT_64BIT    0x0080
+#define EXT4_FEATURE_INCOMPAT_FLEX_BG    0x0200
+#define EXT3_FEATURE_INCOMPAT_SUPP    (EXT2_FEATURE_INCOMPAT_FILETYPE | \
+                                       EXT4_FEATURE_INCOMPAT_EXTENTS | \
+                                       EXT4_FEATURE_INCOMPAT_64BIT | \
+                                       EXT4_FEATURE_INCOMPAT_FLEX_BG)
+
+/* Group descriptor size without and with the 64bit feature.  */
+#define EXT2_MIN_DESC_SIZE    32
+#define EXT4_MIN_DESC_SIZE_64BIT    64
+
+/* EXT2_INODE::flags value for inodes mapped by an extent tree.  */
+#define EXT4_EXTENTS_FL    0x00080000
+
+#define EXT4_EXTENT_MAGIC    0xF30A
+/* Maximum depth of an extent tree.  */
+#define EXT4_EXTENT_MAX_DEPTH    5
+/* Extents longer than this are unwritten (preallocated) and read as zeroes.  */
+#define EXT4_EXTENT_MAX_INIT_LEN    32768
 
 /* Log2 size of ext2 block in bytes.  */
 #define LOG2_BLOCK_SIZE(sb)    (sb->log2_block_size + 10)
@@ -34,6 +34,7 @@ BOOLEAN    Ext2ReadSuperBlock(VOID);
 BOOLEAN    Ext2ReadGroupDescriptors(VOID);
 BOOLEAN    Ext2ReadDirectory(ULONG Inode, PVOID* DirectoryBuffer, PEXT2_INODE InodePointer);
 BOOLEAN    Ext2ReadBlock(ULONG BlockNumber, PVOID Buffer);
+BOOLEAN    Ext2ReadBlocks(ULONG BlockNumber, ULONG BlockCount, PVOID Buffer);
 BOOLEAN    Ext2ReadPartialBlock(ULONG BlockNumber, ULONG StartingOffset, ULONG Length, PVOID Buffer);
 ULONG        Ext2GetGroupDescBlockNumber(ULONG Group);
 ULONG        Ext2GetGroupDescOffsetInBlock(ULONG Group);
@@ -47,6 +48,7 @@ ULONGLONG        Ext2GetInodeFileSize(PEXT2_INODE Inode);
 BOOLEAN    Ext2CopyIndirectBlockPointers(ULONG* BlockList, ULONG* CurrentBlockInList, ULONG BlockCount, ULONG IndirectBlock);
 BOOLEAN    Ext2CopyDoubleIndirectBlockPointers(ULONG* BlockList, ULONG* CurrentBlockInList, ULONG BlockCount, ULONG DoubleIndirectBlock);
 BOOLEAN    Ext2CopyTripleIndirectBlockPointers(ULONG* BlockList, ULONG* CurrentBlockInList, ULONG BlockCount, ULONG TripleIndirectBlock);
+BOOLEAN    Ext2CopyExtentBlockPointers(ULONG* BlockList, ULONG BlockCount, PEXT4_EXTENT_HEADER ExtentHeader, ULONG Depth);
 
 GEOMETRY        Ext2DiskGeometry;                // Ext2 file system disk geometry
 
@@ -62,6 +64,7 @@ ULONG                    Ext2FragmentSizeInSectors = 0;    // Fragment size in s
 ULONG                    Ext2GroupCount = 0;                // Number of groups in this file system
 ULONG                    Ext2InodesPerBlock = 0;            // Number of inodes in one block
 ULONG                    Ext2GroupDescPerBlock = 0;        // Number of group descriptors in one block
+ULONG                    Ext2GroupDescSize = 0;            // Size of one group descriptor in bytes
 
 #define TAG_EXT_BLOCK_LIST 'LtxE'
 #define TAG_EXT_FILE 'FtxE'
@@ -385,6 +388,7 @@ BOOLEAN Ext2ReadFileBig(PEXT2_FILE_INFO Ext2FileInfo, ULONGLONG BytesToRead, ULO
     ULONG                OffsetInBlock;
     ULONG                LengthInBlock;
     ULONG                NumberOfBlocks;
+    ULONG                RunLength;
 
     TRACE("Ext2ReadFileBig() BytesToRead = %d Buffer = 0x%x\n", (ULONG)BytesToRead, Buffer);
 
@@ -516,21 +520,33 @@ BOOLEAN Ext2ReadFileBig(PEXT2_FILE_INFO Ext2FileInfo, ULONGLONG BytesToRead, ULO
             BlockNumberIndex = (ULONG)(Ext2FileInfo->FilePointer / Ext2BlockSizeInBytes);
             BlockNumber = Ext2FileInfo->FileBlockList[BlockNumberIndex];
 
+            //
+            // Gather the run of blocks that are contiguous on disk
+            // (or the run of sparse blocks) so it is read in one go
+            //
+            RunLength = 1;
+            while (RunLength < NumberOfBlocks &&
+                   Ext2FileInfo->FileBlockList[BlockNumberIndex + RunLength] ==
+                   (BlockNumber != 0 ? BlockNumber + RunLength : 0))
+            {
+                RunLength++;
+            }
+
             //
             // Now do the read and update BytesRead, BytesToRead, FilePointer, & Buffer
             //
-            if (!Ext2ReadBlock(BlockNumber, Buffer))
+            if (!Ext2ReadBlocks(BlockNumber, RunLength, Buffer))
             {
                 return FALSE;
             }
             if (BytesRead != NULL)
             {
-                *BytesRead += Ext2BlockSizeInBytes;
+                *BytesRead += (ULONGLONG)RunLength * Ext2BlockSizeInBytes;
             }
-            BytesToRead -= Ext2BlockSizeInBytes;
-            Ext2FileInfo->FilePointer += Ext2BlockSizeInBytes;
-            Buffer = (PVOID)((ULONG_PTR)Buffer + Ext2BlockSizeInBytes);
-            NumberOfBlocks--;
+            BytesToRead -= (ULONGLONG)RunLength * Ext2BlockSizeInBytes;
+            Ext2FileInfo->FilePointer += (ULONGLONG)RunLength * Ext2BlockSizeInBytes;
+            Buffer = (PVOID)((ULONG_PTR)Buffer + RunLength * Ext2BlockSizeInBytes);
+            NumberOfBlocks -= RunLength;
         }
     }
 
@@ -717,8 +733,23 @@ BOOLEAN Ext2ReadSuperBlock(VOID)
     Ext2InodesPerBlock = Ext2BlockSizeInBytes / EXT2_INODE_SIZE(Ext2SuperBlock);
     TRACE("Ext2InodesPerBlock: %d\n", Ext2InodesPerBlock);
 
+    // Group descriptors are bigger on file systems with the 64bit feature
+    Ext2GroupDescSize = EXT2_MIN_DESC_SIZE;
+    if (Ext2SuperBlock->feature_incompat & EXT4_FEATURE_INCOMPAT_64BIT)
+    {
+        Ext2GroupDescSize = Ext2SuperBlock->desc_size;
+        if (Ext2GroupDescSize < EXT4_MIN_DESC_SIZE_64BIT ||
+            Ext2GroupDescSize > Ext2BlockSizeInBytes ||
+            (Ext2GroupDescSize & (Ext2GroupDescSize - 1)) != 0)
+        {
+            FileSystemError("Invalid group descriptor size in super block.");
+            return FALSE;
+        }
+    }
+    TRACE("Ext2GroupDescSize: %d\n", Ext2GroupDescSize);
+
     // Calculate the number of group descriptors in one block
-    Ext2GroupDescPerBlock = EXT2_DESC_PER_BLOCK(Ext2SuperBlock);
+    Ext2GroupDescPerBlock = Ext2BlockSizeInBytes / Ext2GroupDescSize;
     TRACE("Ext2GroupDescPerBlock: %d\n", Ext2GroupDescPerBlock);
 
     return TRUE;
@@ -837,29 +868,42 @@ BOOLEAN Ext2ReadDirectory(ULONG Inode, PVOID* DirectoryBuffer, PEXT2_INODE Inode
 
 BOOLEAN Ext2ReadBlock(ULONG BlockNumber, PVOID Buffer)
 {
-    CHAR    ErrorString[80];
-
     TRACE("Ext2ReadBlock() BlockNumber = %d Buffer = 0x%x\n", BlockNumber, Buffer);
 
-    // Make sure its a valid block
-    if (BlockNumber > Ext2SuperBlock->total_blocks)
-    {
-        sprintf(ErrorString, "Error reading block %d - block out of range.", (int) BlockNumber);
-        FileSystemError(ErrorString);
-        return FALSE;
-    }
+    return Ext2ReadBlocks(BlockNumber, 1, Buffer);
+}
+
+/*
+ * Ext2ReadBlocks()
+ * Reads a run of blocks that are contiguous on disk into memory.
+ * A run starting at block zero is sparse and is zero filled.
+ */
+BOOLEAN Ext2ReadBlocks(ULONG BlockNumber, ULONG BlockCount, PVOID Buffer)
+{
+    CHAR    ErrorString[80];
+
+    TRACE("Ext2ReadBlocks() BlockNumber = %d BlockCount = %d Buffer = 0x%x\n", BlockNumber, BlockCount, Buffer);
 
     // Check to see if this is a sparse block
     if (BlockNumber == 0)
     {
         TRACE("Block is part of a sparse file. Zeroing input buffer.\n");
 
-        RtlZeroMemory(Buffer, Ext2BlockSizeInBytes);
+        RtlZeroMemory(Buffer, BlockCount * Ext2BlockSizeInBytes);
 
         return TRUE;
     }
 
-    return Ext2ReadVolumeSectors(Ext2DriveNumber, (ULONGLONG)BlockNumber * Ext2BlockSizeInSectors, Ext2BlockSizeInSectors, Buffer);
+    // Make sure its a valid block
+    if (BlockNumber > Ext2SuperBlock->total_blocks ||
+        BlockCount > Ext2SuperBlock->total_blocks - BlockNumber + 1)
+    {
+        sprintf(ErrorString, "Error reading block %d - block out of range.", (int) BlockNumber);
+        FileSystemError(ErrorString);
+        return FALSE;
+    }
+
+    return Ext2ReadVolumeSectors(Ext2DriveNumber, (ULONGLONG)BlockNumber * Ext2BlockSizeInSectors, BlockCount * Ext2BlockSizeInSectors, Buffer);
 }
 
 /*
@@ -997,7 +1041,7 @@ BOOLEAN Ext2ReadGroupDescriptor(ULONG Group, PEXT2_GROUP_DESC GroupBuffer)
 
     RtlCopyMemory(GroupBuffer, (PVOID)(FILESYSBUFFER + Ext2GetGroupDescOffsetInBlock(Group)), sizeof(EXT2_GROUP_DESC));*/
 
-    RtlCopyMemory(GroupBuffer, &Ext2GroupDescriptors[Group], sizeof(EXT2_GROUP_DESC));
+    RtlCopyMemory(GroupBuffer, (PUCHAR)Ext2GroupDescriptors + Group * Ext2GroupDescSize, sizeof(EXT2_GROUP_DESC));
 
     TRACE("Dumping group descriptor:\n");
     TRACE("block_id = %d\n", GroupBuffer->block_id);
@@ -1039,6 +1083,27 @@ ULONG* Ext2ReadBlockPointerList(PEXT2_INODE Inode)
 
     RtlZeroMemory(BlockList, BlockCount * sizeof(ULONG));
 
+    // ext4 files are mapped by an extent tree rooted in the inode
+    if (Inode->flags & EXT4_EXTENTS_FL)
+    {
+        // The root node must fit in the 60 bytes of the block pointers
+        if (((PEXT4_EXTENT_HEADER)&Inode->blocks)->max >
+            (sizeof(Inode->blocks) - sizeof(EXT4_EXTENT_HEADER)) / sizeof(EXT4_EXTENT))
+        {
+            FileSystemError("Invalid extent tree.");
+            FrLdrTempFree(BlockList, TAG_EXT_BLOCK_LIST);
+            return NULL;
+        }
+
+        if (!Ext2CopyExtentBlockPointers(BlockList, BlockCount, (PEXT4_EXTENT_HEADER)&Inode->blocks, EXT4_EXTENT_MAX_DEPTH))
+        {
+            FrLdrTempFree(BlockList, TAG_EXT_BLOCK_LIST);
+            return NULL;
+        }
+
+        return BlockList;
+    }
+
     // Copy the direct block pointers
     for (CurrentBlockInList = CurrentBlock = 0;
          CurrentBlockInList < BlockCount && CurrentBlock < INDIRECT_BLOCKS;
@@ -1080,6 +1145,112 @@ ULONG* Ext2ReadBlockPointerList(PEXT2_INODE Inode)
     return BlockList;
 }
 
+/*
+ * Ext2CopyExtentBlockPointers()
+ * Walks an extent tree node and fills in the block list entries it maps.
+ * Holes and unwritten extents are left as zero so they read as sparse.
+ * The caller checks that the node's max entries fit in its buffer.
+ */
+BOOLEAN Ext2CopyExtentBlockPointers(ULONG* BlockList, ULONG BlockCount, PEXT4_EXTENT_HEADER ExtentHeader, ULONG Depth)
+{
+    PEXT4_EXTENT        Extent;
+    PEXT4_EXTENT_IDX    ExtentIndex;
+    PVOID                BlockBuffer;
+    ULONG                CurrentEntry;
+    ULONG                CurrentBlock;
+    ULONG                ExtentLength;
+    BOOLEAN                Success;
+
+    TRACE("Ext2CopyExtentBlockPointers() BlockCount = %d\n", BlockCount);
+
+    if (ExtentHeader->magic != EXT4_EXTENT_MAGIC ||
+        ExtentHeader->depth > Depth ||
+        ExtentHeader->entries > ExtentHeader->max)
+    {
+        FileSystemError("Invalid extent tree.");
+        return FALSE;
+    }
+
+    if (ExtentHeader->depth == 0)
+    {
+        Extent = (PEXT4_EXTENT)(ExtentHeader + 1);
+        for (CurrentEntry = 0; CurrentEntry < ExtentHeader->entries; CurrentEntry++, Extent++)
+        {
+            // Unwritten extents have no data on disk yet
+            if (Extent->len > EXT4_EXTENT_MAX_INIT_LEN)
+            {
+                continue;
+            }
+
+            if (Extent->start_hi != 0)
+            {
+                FileSystemError("File data is located beyond the first 2^32 blocks.");
+                return FALSE;
+            }
+
+            ExtentLength = Extent->len;
+            for (CurrentBlock = 0;
+                 CurrentBlock < ExtentLength && Extent->block + CurrentBlock < BlockCount;
+                 CurrentBlock++)
+            {
+                BlockList[Extent->block + CurrentBlock] = Extent->start_lo + CurrentBlock;
+            }
+        }
+
+        return TRUE;
+    }
+
+    BlockBuffer = FrLdrTempAlloc(Ext2BlockSizeInBytes, TAG_EXT_BUFFER);
+    if (!BlockBuffer)
+    {
+        return FALSE;
+    }
+
+    ExtentIndex = (PEXT4_EXTENT_IDX)(ExtentHeader + 1);
+    for (CurrentEntry = 0; CurrentEntry < ExtentHeader->entries; CurrentEntry++, ExtentIndex++)
+    {
+        // The remaining entries map blocks past the end of the file
+        if (ExtentIndex->block >= BlockCount)
+        {
+            break;
+        }
+
+        if (ExtentIndex->leaf_hi != 0)
+        {
+            FileSystemError("Extent tree block is located beyond the first 2^32 blocks.");
+            FrLdrTempFree(BlockBuffer, TAG_EXT_BUFFER);
+            return FALSE;
+        }
+
+        if (!Ext2ReadBlock(ExtentIndex->leaf_lo, BlockBuffer))
+        {
+            FrLdrTempFree(BlockBuffer, TAG_EXT_BUFFER);
+            return FALSE;
+        }
+
+        // The child node must sit strictly below this one
+        if (((PEXT4_EXTENT_HEADER)BlockBuffer)->depth >= ExtentHeader->depth ||
+            ((PEXT4_EXTENT_HEADER)BlockBuffer)->max >
+            (Ext2BlockSizeInBytes - sizeof(EXT4_EXTENT_HEADER)) / sizeof(EXT4_EXTENT))
+        {
+            FileSystemError("Invalid extent tree.");
+            FrLdrTempFree(BlockBuffer, TAG_EXT_BUFFER);
+            return FALSE;
+        }
+
+        Success = Ext2CopyExtentBlockPointers(BlockList, BlockCount, BlockBuffer, ExtentHeader->depth - 1);
+        if (!Success)
+        {
+            FrLdrTempFree(BlockBuffer, TAG_EXT_BUFFER);
+            return FALSE;
+        }
+    }
+
+    FrLdrTempFree(BlockBuffer, TAG_EXT_BUFFER);
+
+    return TRUE;
+}
+
 ULONGLONG Ext2GetInodeFileSize(PEXT2_INODE Inode)
 {
     if ((Inode->mode & EXT2_S_IFMT) == EXT2_S_IFDIR)
@@ -54,8 +54,8 @@
 @ stdcall WaitForMultipleObjectsEx() kernel32.WaitForMultipleObjectsEx
 @ stdcall WaitForSingleObject() kernel32.WaitForSingleObject
 @ stdcall WaitForSingleObjectEx() kernel32.WaitForSingleObjectEx
-@ stub WaitOnAddress
+@ stdcall WaitOnAddress() kernel32_vista.WaitOnAddress
 @ stdcall WakeAllConditionVariable() kernel32_vista.WakeAllConditionVariable
-@ stub WakeByAddressAll
-@ stub WakeByAddressSingle
+@ stdcall WakeByAddressAll() kernel32_vista.WakeByAddressAll
+@ stdcall WakeByAddressSingle() kernel32_vista.WakeByAddressSingle
 @ stdcall WakeConditionVariable() kernel32_vista.WakeConditionVariable
@@ -6,12 +6,235 @@
 
 #include <wmistr.h>
 #include <evntrace.h>
+#include <wmiioctl.h>
 
 #define NDEBUG
 #include <debug.h>
 
 #define FIXME DPRINT1
 
+static
+ULONG
+EtwpSendLoggerRequest(
+    ULONG IoControlCode,
+    PWMI_LOGGER_INFORMATION LoggerInfo,
+    ULONG Length)
+{
+    UNICODE_STRING DeviceName = RTL_CONSTANT_STRING(L"\\Device\\WMIDataDevice");
+    ULONG Privilege = SE_SYSTEM_PROFILE_PRIVILEGE;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatusBlock;
+    HANDLE DeviceHandle;
+    PVOID State = NULL;
+    NTSTATUS Status;
+
+    InitializeObjectAttributes(&ObjectAttributes, &DeviceName, 0, NULL, NULL);
+    Status = NtOpenFile(&DeviceHandle,
+                        SYNCHRONIZE | GENERIC_READ,
+                        &ObjectAttributes,
+                        &IoStatusBlock,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE,
+                        FILE_SYNCHRONOUS_IO_NONALERT);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to open the WMI device: 0x%lx\n", Status);
+        return RtlNtStatusToDosError(Status);
+    }
+
+    /* Controlling a logger needs the profiling privilege, use it if we have it */
+    if (IoControlCode != IOCTL_WMI_QUERY_LOGGER)
+    {
+        if (!NT_SUCCESS(RtlAcquirePrivilege(&Privilege, 1, 0, &State)))
+            State = NULL;
+    }
+
+    Status = NtDeviceIoControlFile(DeviceHandle,
+                                   NULL,
+                                   NULL,
+                                   NULL,
+                                   &IoStatusBlock,
+                                   IoControlCode,
+                                   LoggerInfo,
+                                   Length,
+                                   LoggerInfo,
+                                   sizeof(WMI_LOGGER_INFORMATION));
+
+    if (State) RtlReleasePrivilege(State);
+    NtClose(DeviceHandle);
+
+    return RtlNtStatusToDosError(Status);
+}
+
+static
+PWMI_LOGGER_INFORMATION
+EtwpAllocateLoggerInformation(
+    TRACEHANDLE SessionHandle,
+    PCUNICODE_STRING LoggerName,
+    PCUNICODE_STRING LogFileName,
+    PEVENT_TRACE_PROPERTIES Properties,
+    PULONG Length)
+{
+    PWMI_LOGGER_INFORMATION LoggerInfo;
+    USHORT LoggerNameLength, LogFileNameLength;
+    PUCHAR Names;
+
+    LoggerNameLength = LoggerName ? LoggerName->Length : 0;
+    LogFileNameLength = LogFileName ? LogFileName->Length : 0;
+
+    *Length = sizeof(WMI_LOGGER_INFORMATION) + LoggerNameLength + LogFileNameLength;
+    LoggerInfo = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, *Length);
+    if (!LoggerInfo) return NULL;
+
+    LoggerInfo->Wnode.BufferSize = *Length;
+    LoggerInfo->Wnode.HistoricalContext = SessionHandle;
+    LoggerInfo->Wnode.Guid = Properties->Wnode.Guid;
+    LoggerInfo->Wnode.ClientContext = Properties->Wnode.ClientContext;
+    LoggerInfo->Wnode.Flags = Properties->Wnode.Flags;
+    LoggerInfo->BufferSize = Properties->BufferSize;
+    LoggerInfo->MinimumBuffers = Properties->MinimumBuffers;
+    LoggerInfo->MaximumBuffers = Properties->MaximumBuffers;
+    LoggerInfo->MaximumFileSize = Properties->MaximumFileSize;
+    LoggerInfo->LogFileMode = Properties->LogFileMode;
+    LoggerInfo->FlushTimer = Properties->FlushTimer;
+    LoggerInfo->EnableFlags = Properties->EnableFlags;
+    LoggerInfo->AgeLimit = Properties->AgeLimit;
+
+    /* The names are packed after the structure, the kernel finds them there */
+    Names = (PUCHAR)(LoggerInfo + 1);
+    if (LoggerNameLength)
+    {
+        RtlCopyMemory(Names, LoggerName->Buffer, LoggerNameLength);
+        LoggerInfo->LoggerName.Length = LoggerNameLength;
+    }
+    if (LogFileNameLength)
+    {
+        RtlCopyMemory(Names + LoggerNameLength, LogFileName->Buffer, LogFileNameLength);
+        LoggerInfo->LogFileName.Length = LogFileNameLength;
+    }
+
+    return LoggerInfo;
+}
+
+static
+VOID
+EtwpUpdateProperties(
+    PEVENT_TRACE_PROPERTIES Properties,
+    PWMI_LOGGER_INFORMATION LoggerInfo)
+{
+    Properties->Wnode.HistoricalContext = LoggerInfo->Wnode.HistoricalContext;
+    Properties->Wnode.ClientContext = LoggerInfo->Wnode.ClientContext;
+    Properties->BufferSize = LoggerInfo->BufferSize;
+    Properties->MinimumBuffers = LoggerInfo->MinimumBuffers;
+    Properties->MaximumBuffers = LoggerInfo->MaximumBuffers;
+    Properties->MaximumFileSize = LoggerInfo->MaximumFileSize;
+    Properties->LogFileMode = LoggerInfo->LogFileMode;
+    Properties->FlushTimer = LoggerInfo->FlushTimer;
+    Properties->EnableFlags = LoggerInfo->EnableFlags;
+    Properties->NumberOfBuffers = LoggerInfo->NumberOfBuffers;
+    Properties->FreeBuffers = LoggerInfo->FreeBuffers;
+    Properties->EventsLost = LoggerInfo->EventsLost;
+    Properties->BuffersWritten = LoggerInfo->BuffersWritten;
+    Properties->LogBuffersLost = LoggerInfo->LogBuffersLost;
+    Properties->RealTimeBuffersLost = LoggerInfo->RealTimeBuffersLost;
+    Properties->LoggerThreadId = LoggerInfo->LoggerThreadId;
+}
+
+static
+ULONG
+EtwpStartTrace(
+    PTRACEHANDLE SessionHandle,
+    PCUNICODE_STRING SessionName,
+    PCWSTR LogFileName,
+    PEVENT_TRACE_PROPERTIES Properties)
+{
+    PWMI_LOGGER_INFORMATION LoggerInfo;
+    UNICODE_STRING NtLogFileName;
+    ULONG Length, Error;
+
+    /* The kernel wants a native path */
+    RtlInitEmptyUnicodeString(&NtLogFileName, NULL, 0);
+    if ((LogFileName) && (*LogFileName))
+    {
+        if (!RtlDosPathNameToNtPathName_U(LogFileName, &NtLogFileName, NULL, NULL))
+            return ERROR_BAD_PATHNAME;
+    }
+
+    LoggerInfo = EtwpAllocateLoggerInformation(0,
+                                               SessionName,
+                                               &NtLogFileName,
+                                               Properties,
+                                               &Length);
+    if (!LoggerInfo)
+    {
+        RtlFreeUnicodeString(&NtLogFileName);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    Error = EtwpSendLoggerRequest(IOCTL_WMI_START_LOGGER, LoggerInfo, Length);
+    if (Error == ERROR_SUCCESS)
+    {
+        *SessionHandle = LoggerInfo->Wnode.HistoricalContext;
+        EtwpUpdateProperties(Properties, LoggerInfo);
+    }
+
+    RtlFreeHeap(RtlGetProcessHeap(), 0, LoggerInfo);
+    RtlFreeUnicodeString(&NtLogFileName);
+    return Error;
+}
+
+static
+ULONG
+EtwpControlTrace(
+    TRACEHANDLE SessionHandle,
+    PCUNICODE_STRING SessionName,
+    PEVENT_TRACE_PROPERTIES Properties,
+    ULONG ControlCode)
+{
+    PWMI_LOGGER_INFORMATION LoggerInfo;
+    ULONG IoControlCode, Length, Error;
+
+    switch (ControlCode)
+    {
+        case EVENT_TRACE_CONTROL_QUERY:
+            IoControlCode = IOCTL_WMI_QUERY_LOGGER;
+            break;
+
+        case EVENT_TRACE_CONTROL_STOP:
+            IoControlCode = IOCTL_WMI_STOP_LOGGER;
+            break;
+
+        case EVENT_TRACE_CONTROL_UPDATE:
+            IoControlCode = IOCTL_WMI_UPDATE_LOGGER;
+            break;
+
+        case EVENT_TRACE_CONTROL_FLUSH:
+            IoControlCode = IOCTL_WMI_FLUSH_LOGGER;
+            break;
+
+        default:
+            return ERROR_INVALID_PARAMETER;
+    }
+
+    if (!Properties || (!SessionHandle && !(SessionName && SessionName->Length)))
+        return ERROR_INVALID_PARAMETER;
+
+    if (Properties->Wnode.BufferSize < sizeof(EVENT_TRACE_PROPERTIES))
+        return ERROR_BAD_LENGTH;
+
+    LoggerInfo = EtwpAllocateLoggerInformation(SessionHandle,
+                                               SessionName,
+                                               NULL,
+                                               Properties,
+                                               &Length);
+    if (!LoggerInfo) return ERROR_NOT_ENOUGH_MEMORY;
+
+    Error = EtwpSendLoggerRequest(IoControlCode, LoggerInfo, Length);
+    if (Error == ERROR_SUCCESS) EtwpUpdateProperties(Properties, LoggerInfo);
+
+    RtlFreeHeap(RtlGetProcessHeap(), 0, LoggerInfo);
+    return Error;
+}
+
 /*
  * @unimplemented
  */
@@ -38,6 +261,9 @@ EtwGetTraceLoggerHandle(
 }
 
 
+/*
+ * @implemented
+ */
 ULONG
 NTAPI
 EtwTraceEvent(
@@ -45,7 +271,7 @@ EtwTraceEvent(
     PEVENT_TRACE_HEADER EventTrace
 )
 {
-    FIXME("EtwTraceEvent stub()\n");
+    NTSTATUS Status;
 
     if (!SessionHandle || !EventTrace)
     {
@@ -53,13 +279,14 @@ EtwTraceEvent(
         return ERROR_INVALID_PARAMETER;
     }
 
-    if (EventTrace->Size != sizeof(EVENT_TRACE_HEADER))
+    if (EventTrace->Size < sizeof(EVENT_TRACE_HEADER))
     {
         /* invalid parameter */
         return ERROR_INVALID_PARAMETER;
     }
 
-    return ERROR_SUCCESS;
+    Status = NtTraceEvent((ULONG)SessionHandle, 0, EventTrace->Size, EventTrace);
+    return RtlNtStatusToDosError(Status);
 }
 
 ULONG
@@ -126,18 +353,80 @@ EtwRegisterTraceGuidsW(
     return ERROR_SUCCESS;
 }
 
+/******************************************************************************
+ * EtwStartTraceW [NTDLL.@]
+ *
+ * Start an event trace session, logging to a file
+ *
+ */
 ULONG WINAPI EtwStartTraceW( PTRACEHANDLE pSessionHandle, LPCWSTR SessionName, PEVENT_TRACE_PROPERTIES Properties )
 {
-    FIXME("(%p, %s, %p) stub\n", pSessionHandle, SessionName, Properties);
-    if (pSessionHandle) *pSessionHandle = 0xcafe4242;
-    return ERROR_SUCCESS;
+    UNICODE_STRING Name;
+    PCWSTR LogFileName = NULL;
+    ULONG Error;
+
+    if (!pSessionHandle || !SessionName || !Properties) return ERROR_INVALID_PARAMETER;
+    if (Properties->Wnode.BufferSize < sizeof(EVENT_TRACE_PROPERTIES)) return ERROR_BAD_LENGTH;
+
+    if (Properties->LogFileNameOffset)
+        LogFileName = (PCWSTR)((PUCHAR)Properties + Properties->LogFileNameOffset);
+
+    RtlInitUnicodeString(&Name, SessionName);
+    Error = EtwpStartTrace(pSessionHandle, &Name, LogFileName, Properties);
+
+    /* Hand the session name back, if the caller left room for it */
+    if ((Error == ERROR_SUCCESS) && (Properties->LoggerNameOffset) &&
+        (Properties->LoggerNameOffset + Name.MaximumLength <= Properties->Wnode.BufferSize))
+    {
+        RtlCopyMemory((PUCHAR)Properties + Properties->LoggerNameOffset,
+                      SessionName,
+                      Name.MaximumLength);
+    }
+
+    return Error;
 }
 
+/******************************************************************************
+ * EtwStartTraceA [NTDLL.@]
+ *
+ * See StartTraceW.
+ *
+ */
 ULONG WINAPI EtwStartTraceA( PTRACEHANDLE pSessionHandle, LPCSTR SessionName, PEVENT_TRACE_PROPERTIES Properties )
 {
-    FIXME("(%p, %s, %p) stub\n", pSessionHandle, SessionName, Properties);
-    if (pSessionHandle) *pSessionHandle = 0xcafe4242;
-    return ERROR_SUCCESS;
+    UNICODE_STRING Name, LogFileName;
+    ULONG Error;
+
+    if (!pSessionHandle || !SessionName || !Properties) return ERROR_INVALID_PARAMETER;
+    if (Properties->Wnode.BufferSize < sizeof(EVENT_TRACE_PROPERTIES)) return ERROR_BAD_LENGTH;
+
+    RtlInitEmptyUnicodeString(&LogFileName, NULL, 0);
+    if (Properties->LogFileNameOffset &&
+        !RtlCreateUnicodeStringFromAsciiz(&LogFileName,
+                                          (PCSZ)((PUCHAR)Properties + Properties->LogFileNameOffset)))
+    {
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    if (!RtlCreateUnicodeStringFromAsciiz(&Name, (PCSZ)SessionName))
+    {
+        RtlFreeUnicodeString(&LogFileName);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    Error = EtwpStartTrace(pSessionHandle, &Name, LogFileName.Buffer, Properties);
+
+    if ((Error == ERROR_SUCCESS) && (Properties->LoggerNameOffset) &&
+        (Properties->LoggerNameOffset + strlen(SessionName) + 1 <= Properties->Wnode.BufferSize))
+    {
+        RtlCopyMemory((PUCHAR)Properties + Properties->LoggerNameOffset,
+                      SessionName,
+                      strlen(SessionName) + 1);
+    }
+
+    RtlFreeUnicodeString(&Name);
+    RtlFreeUnicodeString(&LogFileName);
+    return Error;
 }
 
 /******************************************************************************
@@ -148,8 +437,10 @@ ULONG WINAPI EtwStartTraceA( PTRACEHANDLE pSessionHandle, LPCSTR SessionName, PE
  */
 ULONG WINAPI EtwControlTraceW( TRACEHANDLE hSession, LPCWSTR SessionName, PEVENT_TRACE_PROPERTIES Properties, ULONG control )
 {
-    FIXME("(%I64x, %s, %p, %d) stub\n", hSession, SessionName, Properties, control);
-    return ERROR_SUCCESS;
+    UNICODE_STRING Name;
+
+    RtlInitUnicodeString(&Name, SessionName);
+    return EtwpControlTrace(hSession, &Name, Properties, control);
 }
 
 /******************************************************************************
@@ -160,8 +451,82 @@ ULONG WINAPI EtwControlTraceW( TRACEHANDLE hSession, LPCWSTR SessionName, PEVENT
  */
 ULONG WINAPI EtwControlTraceA( TRACEHANDLE hSession, LPCSTR SessionName, PEVENT_TRACE_PROPERTIES Properties, ULONG control )
 {
-    FIXME("(%I64x, %s, %p, %d) stub\n", hSession, SessionName, Properties, control);
-    return ERROR_SUCCESS;
+    UNICODE_STRING Name;
+    ULONG Error;
+
+    if (!SessionName) return EtwpControlTrace(hSession, NULL, Properties, control);
+
+    if (!RtlCreateUnicodeStringFromAsciiz(&Name, (PCSZ)SessionName))
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    Error = EtwpControlTrace(hSession, &Name, Properties, control);
+
+    RtlFreeUnicodeString(&Name);
+    return Error;
+}
+
+/******************************************************************************
+ * EtwStopTraceW [NTDLL.@]
+ */
+ULONG WINAPI EtwStopTraceW( TRACEHANDLE hSession, LPCWSTR SessionName, PEVENT_TRACE_PROPERTIES Properties )
+{
+    return EtwControlTraceW(hSession, SessionName, Properties, EVENT_TRACE_CONTROL_STOP);
+}
+
+/******************************************************************************
+ * EtwStopTraceA [NTDLL.@]
+ */
+ULONG WINAPI EtwStopTraceA( TRACEHANDLE hSession, LPCSTR SessionName, PEVENT_TRACE_PROPERTIES Properties )
+{
+    return EtwControlTraceA(hSession, SessionName, Properties, EVENT_TRACE_CONTROL_STOP);
+}
+
+/******************************************************************************
+ * EtwQueryTraceW [NTDLL.@]
+ */
+ULONG WINAPI EtwQueryTraceW( TRACEHANDLE hSession, LPCWSTR SessionName, PEVENT_TRACE_PROPERTIES Properties )
+{
+    return EtwControlTraceW(hSession, SessionName, Properties, EVENT_TRACE_CONTROL_QUERY);
+}
+
+/******************************************************************************
+ * EtwQueryTraceA [NTDLL.@]
+ */
+ULONG WINAPI EtwQueryTraceA( TRACEHANDLE hSession, LPCSTR SessionName, PEVENT_TRACE_PROPERTIES Properties )
+{
+    return EtwControlTraceA(hSession, SessionName, Properties, EVENT_TRACE_CONTROL_QUERY);
+}
+
+/******************************************************************************
+ * EtwUpdateTraceW [NTDLL.@]
+ */
+ULONG WINAPI EtwUpdateTraceW( TRACEHANDLE hSession, LPCWSTR SessionName, PEVENT_TRACE_PROPERTIES Properties )
+{
+    return EtwControlTraceW(hSession, SessionName, Properties, EVENT_TRACE_CONTROL_UPDATE);
+}
+
+/******************************************************************************
+ * EtwUpdateTraceA [NTDLL.@]
+ */
+ULONG WINAPI EtwUpdateTraceA( TRACEHANDLE hSession, LPCSTR SessionName, PEVENT_TRACE_PROPERTIES Properties )
+{
+    return EtwControlTraceA(hSession, SessionName, Properties, EVENT_TRACE_CONTROL_UPDATE);
+}
+
+/******************************************************************************
+ * EtwFlushTraceW [NTDLL.@]
+ */
+ULONG WINAPI EtwFlushTraceW( TRACEHANDLE hSession, LPCWSTR SessionName, PEVENT_TRACE_PROPERTIES Properties )
+{
+    return EtwControlTraceW(hSession, SessionName, Properties, EVENT_TRACE_CONTROL_FLUSH);
+}
+
+/******************************************************************************
+ * EtwFlushTraceA [NTDLL.@]
+ */
+ULONG WINAPI EtwFlushTraceA( TRACEHANDLE hSession, LPCSTR SessionName, PEVENT_TRACE_PROPERTIES Properties )
+{
+    return EtwControlTraceA(hSession, SessionName, Properties, EVENT_TRACE_CONTROL_FLUSH);
 }
 
 /******************************************************************************
@@ -1657,6 +1657,8 @@ LdrpInitializeProcess(IN PCONTEXT Context,
     NLSTABLEINFO NlsTable;
     PIMAGE_LOAD_CONFIG_DIRECTORY LoadConfig;
     PTEB Teb = NtCurrentTeb();
+    LARGE_INTEGER PhaseStart, PhaseEnd, Frequency, ImportTime, InitTime;
+    BOOLEAN TimePhases;
     PLIST_ENTRY ListHead;
     PLIST_ENTRY NextEntry;
     ULONG i;
@@ -2194,9 +2196,20 @@ LdrpInitializeProcess(IN PCONTEXT Context,
         Kernel32BaseQueryModuleData = FunctionAddress;
     }
 
+    /* Time the loader phases when snaps were requested */
+    TimePhases = ShowSnaps;
+    PhaseStart.QuadPart = Frequency.QuadPart = ImportTime.QuadPart = 0;
+    if (TimePhases) NtQueryPerformanceCounter(&PhaseStart, &Frequency);
+
     /* Walk the IAT and load all the DLLs */
     ImportStatus = LdrpWalkImportDescriptor(LdrpDefaultPath.Buffer, LdrpImageEntry);
 
+    if (TimePhases)
+    {
+        NtQueryPerformanceCounter(&PhaseEnd, NULL);
+        ImportTime.QuadPart = PhaseEnd.QuadPart - PhaseStart.QuadPart;
+    }
+
     /* Check if relocation is needed */
     if (Peb->ImageBaseAddress != (PVOID)NtHeader->OptionalHeader.ImageBase)
     {
@@ -2343,6 +2356,7 @@ LdrpInitializeProcess(IN PCONTEXT Context,
      */
 
     /* Now call the Init Routines */
+    if (TimePhases) NtQueryPerformanceCounter(&PhaseStart, NULL);
     Status = LdrpRunInitializeRoutines(Context);
     if (!NT_SUCCESS(Status))
     {
@@ -2351,6 +2365,16 @@ LdrpInitializeProcess(IN PCONTEXT Context,
         return Status;
     }
 
+    if (TimePhases && Frequency.QuadPart != 0)
+    {
+        NtQueryPerformanceCounter(&PhaseEnd, NULL);
+        InitTime.QuadPart = PhaseEnd.QuadPart - PhaseStart.QuadPart;
+        DPRINT1("LDR: %wZ: imports loaded in %I64u us, init routines run in %I64u us\n",
+                &ImagePathName,
+                ImportTime.QuadPart * 1000000 / Frequency.QuadPart,
+                InitTime.QuadPart * 1000000 / Frequency.QuadPart);
+    }
+
     /* Notify Shim Engine */
     if (g_ShimsEnabled)
     {
@@ -1572,6 +1572,42 @@ LdrpAllocateDataTableEntry(IN PVOID BaseAddress)
     return LdrEntry;
 }
 
+ULONG
+NTAPI
+LdrpHashUnicodeString(IN PUNICODE_STRING NameString)
+{
+    PPEB Peb = NtCurrentPeb();
+    ULONG HashValue = 0;
+    ULONG i;
+
+    /* The bucket layout is visible to applications through HashLinks,
+       so it follows the Windows version the process is told it runs on */
+    if (Peb->OSMajorVersion > 6 ||
+        (Peb->OSMajorVersion == 6 && Peb->OSMinorVersion >= 2))
+    {
+        /* Hash the whole name (x65599 over the upcased characters), so
+           system DLLs don't pile up in a handful of buckets */
+        for (i = 0; i < NameString->Length / sizeof(WCHAR); i++)
+        {
+            HashValue = HashValue * 65599 + RtlUpcaseUnicodeChar(NameString->Buffer[i]);
+        }
+    }
+    else if (Peb->OSMajorVersion == 6 && Peb->OSMinorVersion == 1)
+    {
+        for (i = 0; i < NameString->Length / sizeof(WCHAR); i++)
+        {
+            HashValue += 65599 * RtlUpcaseUnicodeChar(NameString->Buffer[i]);
+        }
+    }
+    else if (NameString->Length != 0)
+    {
+        /* Older loaders only use the first character */
+        HashValue = RtlUpcaseUnicodeChar(NameString->Buffer[0]);
+    }
+
+    return HashValue & (LDR_HASH_TABLE_ENTRIES - 1);
+}
+
 VOID
 NTAPI
 LdrpInsertMemoryTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry)
@@ -1580,7 +1616,7 @@ LdrpInsertMemoryTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry)
     ULONG i;
 
     /* Insert into hash table */
-    i = LDR_GET_HASH_ENTRY(LdrEntry->BaseDllName.Buffer[0]);
+    i = LdrpHashUnicodeString(&LdrEntry->BaseDllName);
     InsertTailList(&LdrpHashTable[i], &LdrEntry->HashLinks);
 
     /* Insert into other lists */
@@ -2006,7 +2042,7 @@ lookinhash:
         /* FIXME: if we get redirected dll it means that we also get a full path so we need to find its filename for the hash lookup */
 
         /* Get hash index */
-        HashIndex = LDR_GET_HASH_ENTRY(DllName->Buffer[0]);
+        HashIndex = LdrpHashUnicodeString(DllName);
 
         /* Traverse that list */
         ListHead = &LdrpHashTable[HashIndex];
@@ -19,14 +19,203 @@
 DEBUG_CHANNEL(kernel32file);
 #endif
 
+/* Vista+ flag, see winbase.h */
+#ifndef COPY_FILE_NO_BUFFERING
+#define COPY_FILE_NO_BUFFERING 0x00001000
+#endif
+
+/* Number of buffers kept in flight, and the range of their size */
+#define COPY_BUFFER_COUNT   4
+#define COPY_CHUNK_MINIMUM  0x10000
+#define COPY_CHUNK_MAXIMUM  0x100000
+
+typedef struct _COPY_BUFFER
+{
+    PUCHAR Data;
+    ULONG Length;
+    HANDLE Event;
+    IO_STATUS_BLOCK IoStatusBlock;
+    LARGE_INTEGER Offset;
+    BOOL Pending;
+} COPY_BUFFER, *PCOPY_BUFFER;
+
 /* FUNCTIONS ****************************************************************/
 
+static VOID
+CopyStartIo(
+    PCOPY_BUFFER		Buffer,
+    HANDLE			FileHandle,
+    BOOL			Write,
+    ULONG			Length
+)
+{
+    NTSTATUS errCode;
+
+    if (Write)
+    {
+        errCode = NtWriteFile(FileHandle,
+                              Buffer->Event,
+                              NULL,
+                              NULL,
+                              &Buffer->IoStatusBlock,
+                              Buffer->Data,
+                              Length,
+                              &Buffer->Offset,
+                              NULL);
+    }
+    else
+    {
+        errCode = NtReadFile(FileHandle,
+                             Buffer->Event,
+                             NULL,
+                             NULL,
+                             &Buffer->IoStatusBlock,
+                             Buffer->Data,
+                             Length,
+                             &Buffer->Offset,
+                             NULL);
+    }
+
+    /* Requests failed right away don't signal the event, keep their status */
+    Buffer->Pending = (errCode == STATUS_PENDING);
+    if (!Buffer->Pending && !NT_SUCCESS(errCode))
+    {
+        Buffer->IoStatusBlock.Status = errCode;
+        Buffer->IoStatusBlock.Information = 0;
+    }
+}
+
+static NTSTATUS
+CopyWaitIo(
+    PCOPY_BUFFER		Buffer
+)
+{
+    NTSTATUS errCode;
+
+    if (Buffer->Pending)
+    {
+        errCode = NtWaitForSingleObject(Buffer->Event, FALSE, NULL);
+        Buffer->Pending = FALSE;
+        if (!NT_SUCCESS(errCode))
+            return errCode;
+    }
+
+    return Buffer->IoStatusBlock.Status;
+}
+
+/* Waits for a read to complete and reissues it until the buffer is full,
+ * since a short read doesn't mean the end of the file was reached. */
+static NTSTATUS
+CopyWaitRead(
+    PCOPY_BUFFER		Buffer,
+    HANDLE			FileHandle,
+    ULONG			Length,
+    LARGE_INTEGER		FileSize,
+    BOOL			*EndOfFile
+)
+{
+    NTSTATUS errCode;
+    LARGE_INTEGER Offset;
+
+    Buffer->Length = 0;
+    errCode = CopyWaitIo(Buffer);
+    while (TRUE)
+    {
+        if (STATUS_END_OF_FILE == errCode)
+        {
+            *EndOfFile = TRUE;
+            return STATUS_SUCCESS;
+        }
+        if (!NT_SUCCESS(errCode))
+            return errCode;
 
+        Buffer->Length += (ULONG)Buffer->IoStatusBlock.Information;
+        if (Buffer->Length == Length)
+            return STATUS_SUCCESS;
+
+        /* Only stop early once the size seen at open time was read */
+        Offset.QuadPart = Buffer->Offset.QuadPart + Buffer->Length;
+        if (0 == Buffer->IoStatusBlock.Information || Offset.QuadPart >= FileSize.QuadPart)
+        {
+            *EndOfFile = TRUE;
+            return STATUS_SUCCESS;
+        }
+
+        TRACE("Short read of %lu bytes at %I64u, reading the rest\n",
+              Buffer->Length, Buffer->Offset.QuadPart);
+        errCode = NtReadFile(FileHandle,
+                             Buffer->Event,
+                             NULL,
+                             NULL,
+                             &Buffer->IoStatusBlock,
+                             Buffer->Data + Buffer->Length,
+                             Length - Buffer->Length,
+                             &Offset,
+                             NULL);
+        if (STATUS_PENDING == errCode)
+            errCode = NtWaitForSingleObject(Buffer->Event, FALSE, NULL);
+        if (NT_SUCCESS(errCode))
+            errCode = Buffer->IoStatusBlock.Status;
+    }
+}
+
+static NTSTATUS
+CopyReportProgress(
+    LPPROGRESS_ROUTINE	*lpProgressRoutine,
+    DWORD			CallbackReason,
+    LARGE_INTEGER		SourceFileSize,
+    LARGE_INTEGER		BytesCopied,
+    HANDLE			FileHandleSource,
+    HANDLE			FileHandleDest,
+    LPVOID			lpData,
+    BOOL			*KeepDest
+)
+{
+    DWORD ProgressResult;
+
+    if (NULL == *lpProgressRoutine)
+        return STATUS_SUCCESS;
+
+    ProgressResult = (**lpProgressRoutine)(SourceFileSize,
+                                           BytesCopied,
+                                           SourceFileSize,
+                                           BytesCopied,
+                                           0,
+                                           CallbackReason,
+                                           FileHandleSource,
+                                           FileHandleDest,
+                                           lpData);
+    switch (ProgressResult)
+    {
+    case PROGRESS_CANCEL:
+        TRACE("Progress callback requested cancel\n");
+        return STATUS_REQUEST_ABORTED;
+    case PROGRESS_STOP:
+        TRACE("Progress callback requested stop\n");
+        *KeepDest = TRUE;
+        return STATUS_REQUEST_ABORTED;
+    case PROGRESS_QUIET:
+        *lpProgressRoutine = NULL;
+        break;
+    case PROGRESS_CONTINUE:
+    default:
+        break;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+/*
+ * Copies the data in chunks, keeping several reads in flight while the
+ * previous chunk is being written. Both handles must have been opened for
+ * overlapped I/O.
+ */
 static NTSTATUS
 CopyLoop (
     HANDLE			FileHandleSource,
     HANDLE			FileHandleDest,
     LARGE_INTEGER		SourceFileSize,
+    BOOL			NoBuffering,
     LPPROGRESS_ROUTINE	lpProgressRoutine,
     LPVOID			lpData,
     BOOL			*pbCancel,
@@ -35,130 +224,215 @@ CopyLoop (
 {
     NTSTATUS errCode;
     IO_STATUS_BLOCK IoStatusBlock;
+    FILE_ALLOCATION_INFORMATION FileAllocation;
+    FILE_END_OF_FILE_INFORMATION FileEndOfFile;
+    FILE_FS_SIZE_INFORMATION FileFsSize;
+    COPY_BUFFER Buffers[COPY_BUFFER_COUNT];
+    PCOPY_BUFFER Current, Previous;
     UCHAR *lpBuffer = NULL;
-    SIZE_T RegionSize = 0x10000;
+    SIZE_T RegionSize;
     LARGE_INTEGER BytesCopied;
-    DWORD CallbackReason;
-    DWORD ProgressResult;
+    LARGE_INTEGER ReadOffset;
+    ULONG ChunkSize, BufferCount, SectorSize, WriteLength, Index, i;
     BOOL EndOfFileFound;
 
     *KeepDest = FALSE;
+
+    /* Use bigger chunks for bigger files */
+    ChunkSize = COPY_CHUNK_MINIMUM;
+    while (ChunkSize < COPY_CHUNK_MAXIMUM &&
+           SourceFileSize.QuadPart / 8 > ChunkSize)
+    {
+        ChunkSize *= 2;
+    }
+    BufferCount = (SourceFileSize.QuadPart > ChunkSize) ? COPY_BUFFER_COUNT : 2;
+
+    /* Non cached writes must cover whole sectors */
+    SectorSize = 1;
+    if (NoBuffering)
+    {
+        errCode = NtQueryVolumeInformationFile(FileHandleDest,
+                                               &IoStatusBlock,
+                                               &FileFsSize,
+                                               sizeof(FILE_FS_SIZE_INFORMATION),
+                                               FileFsSizeInformation);
+        SectorSize = NT_SUCCESS(errCode) ? FileFsSize.BytesPerSector : PAGE_SIZE;
+    }
+
+    /* Reserve the space for the whole file, so it isn't extended piecemeal */
+    if (SourceFileSize.QuadPart != 0)
+    {
+        FileAllocation.AllocationSize = SourceFileSize;
+        errCode = NtSetInformationFile(FileHandleDest,
+                                       &IoStatusBlock,
+                                       &FileAllocation,
+                                       sizeof(FILE_ALLOCATION_INFORMATION),
+                                       FileAllocationInformation);
+        if (errCode == STATUS_DISK_FULL)
+        {
+            WARN("Not enough space for %I64u bytes\n", SourceFileSize.QuadPart);
+            return errCode;
+        }
+    }
+
+    RegionSize = (SIZE_T)ChunkSize * BufferCount;
     errCode = NtAllocateVirtualMemory(NtCurrentProcess(),
                                       (PVOID *)&lpBuffer,
                                       0,
                                       &RegionSize,
                                       MEM_RESERVE | MEM_COMMIT,
                                       PAGE_READWRITE);
+    if (!NT_SUCCESS(errCode))
+    {
+        TRACE("Error 0x%08x allocating buffer of %lu bytes\n", errCode, RegionSize);
+        return errCode;
+    }
+
+    RtlZeroMemory(Buffers, sizeof(Buffers));
+    for (i = 0; i < BufferCount && NT_SUCCESS(errCode); i++)
+    {
+        Buffers[i].Data = lpBuffer + i * ChunkSize;
+        errCode = NtCreateEvent(&Buffers[i].Event,
+                                EVENT_ALL_ACCESS,
+                                NULL,
+                                SynchronizationEvent,
+                                FALSE);
+    }
+
+    BytesCopied.QuadPart = 0;
+    if (NT_SUCCESS(errCode))
+    {
+        errCode = CopyReportProgress(&lpProgressRoutine,
+                                     CALLBACK_STREAM_SWITCH,
+                                     SourceFileSize,
+                                     BytesCopied,
+                                     FileHandleSource,
+                                     FileHandleDest,
+                                     lpData,
+                                     KeepDest);
+    }
 
     if (NT_SUCCESS(errCode))
     {
-        BytesCopied.QuadPart = 0;
+        /* Fill the pipeline */
+        ReadOffset.QuadPart = 0;
+        for (i = 0; i < BufferCount; i++)
+        {
+            Buffers[i].Offset = ReadOffset;
+            CopyStartIo(&Buffers[i], FileHandleSource, FALSE, ChunkSize);
+            ReadOffset.QuadPart += ChunkSize;
+        }
+
+        /* Buffers are written in the order they were read. Each turn
+         * starts writing the next chunk, then finishes the write started on
+         * the previous turn and reuses that buffer for the next read. */
         EndOfFileFound = FALSE;
-        CallbackReason = CALLBACK_STREAM_SWITCH;
-        while (! EndOfFileFound &&
-                NT_SUCCESS(errCode) &&
-                (NULL == pbCancel || ! *pbCancel))
+        Previous = NULL;
+        Index = 0;
+        while (TRUE)
         {
-            if (NULL != lpProgressRoutine)
+            Current = &Buffers[Index];
+            Current->Length = 0;
+
+            if (!EndOfFileFound)
             {
-                ProgressResult = (*lpProgressRoutine)(SourceFileSize,
-                                                      BytesCopied,
-                                                      SourceFileSize,
-                                                      BytesCopied,
-                                                      0,
-                                                      CallbackReason,
-                                                      FileHandleSource,
-                                                      FileHandleDest,
-                                                      lpData);
-                switch (ProgressResult)
+                errCode = CopyWaitRead(Current,
+                                       FileHandleSource,
+                                       ChunkSize,
+                                       SourceFileSize,
+                                       &EndOfFileFound);
+                if (!NT_SUCCESS(errCode))
                 {
-                case PROGRESS_CANCEL:
-                    TRACE("Progress callback requested cancel\n");
-                    errCode = STATUS_REQUEST_ABORTED;
-                    break;
-                case PROGRESS_STOP:
-                    TRACE("Progress callback requested stop\n");
-                    errCode = STATUS_REQUEST_ABORTED;
-                    *KeepDest = TRUE;
-                    break;
-                case PROGRESS_QUIET:
-                    lpProgressRoutine = NULL;
-                    break;
-                case PROGRESS_CONTINUE:
-                default:
+                    WARN("Error 0x%08x reading from source\n", errCode);
                     break;
                 }
-                CallbackReason = CALLBACK_CHUNK_FINISHED;
             }
-            if (NT_SUCCESS(errCode))
+
+            if (Current->Length != 0)
+            {
+                WriteLength = ROUND_UP(Current->Length, SectorSize);
+                RtlZeroMemory(Current->Data + Current->Length,
+                              WriteLength - Current->Length);
+                CopyStartIo(Current, FileHandleDest, TRUE, WriteLength);
+            }
+
+            if (Previous != NULL)
             {
-                errCode = NtReadFile(FileHandleSource,
-                                     NULL,
-                                     NULL,
-                                     NULL,
-                                     (PIO_STATUS_BLOCK)&IoStatusBlock,
-                                     lpBuffer,
-                                     RegionSize,
-                                     NULL,
-                                     NULL);
-                /* With sync read, 0 length + status success mean EOF:
-                 * https://msdn.microsoft.com/en-us/library/windows/desktop/aa365467(v=vs.85).aspx
-                 */
-                if (NT_SUCCESS(errCode) && IoStatusBlock.Information == 0)
+                errCode = CopyWaitIo(Previous);
+                if (!NT_SUCCESS(errCode))
                 {
-                    errCode = STATUS_END_OF_FILE;
+                    WARN("Error 0x%08x writing to dest\n", errCode);
+                    break;
                 }
-                if (NT_SUCCESS(errCode) && (NULL == pbCancel || ! *pbCancel))
+
+                BytesCopied.QuadPart += Previous->Length;
+
+                if (NULL != pbCancel && *pbCancel)
                 {
-                    errCode = NtWriteFile(FileHandleDest,
-                                          NULL,
-                                          NULL,
-                                          NULL,
-                                          (PIO_STATUS_BLOCK)&IoStatusBlock,
-                                          lpBuffer,
-                                          IoStatusBlock.Information,
-                                          NULL,
-                                          NULL);
-                    if (NT_SUCCESS(errCode))
-                    {
-                        BytesCopied.QuadPart += IoStatusBlock.Information;
-                    }
-                    else
-                    {
-                        WARN("Error 0x%08x reading writing to dest\n", errCode);
-                    }
+                    TRACE("User requested cancel\n");
+                    errCode = STATUS_REQUEST_ABORTED;
+                    break;
                 }
-                else if (!NT_SUCCESS(errCode))
+
+                errCode = CopyReportProgress(&lpProgressRoutine,
+                                             CALLBACK_CHUNK_FINISHED,
+                                             SourceFileSize,
+                                             BytesCopied,
+                                             FileHandleSource,
+                                             FileHandleDest,
+                                             lpData,
+                                             KeepDest);
+                if (!NT_SUCCESS(errCode))
+                    break;
+
+                if (!EndOfFileFound)
                 {
-                    if (STATUS_END_OF_FILE == errCode)
-                    {
-                        EndOfFileFound = TRUE;
-                        errCode = STATUS_SUCCESS;
-                    }
-                    else
-                    {
-                        WARN("Error 0x%08x reading from source\n", errCode);
-                    }
+                    Previous->Offset = ReadOffset;
+                    CopyStartIo(Previous, FileHandleSource, FALSE, ChunkSize);
+                    ReadOffset.QuadPart += ChunkSize;
                 }
             }
-        }
 
-        if (! EndOfFileFound && (NULL != pbCancel && *pbCancel))
-        {
-            TRACE("User requested cancel\n");
-            errCode = STATUS_REQUEST_ABORTED;
+            /* Nothing left to write */
+            if (Current->Length == 0)
+                break;
+
+            Previous = Current;
+            Index = (Index + 1) % BufferCount;
         }
+    }
 
-        NtFreeVirtualMemory(NtCurrentProcess(),
-                            (PVOID *)&lpBuffer,
-                            &RegionSize,
-                            MEM_RELEASE);
+    /* The buffers can only go once nothing uses them anymore */
+    for (i = 0; i < BufferCount; i++)
+    {
+        if (Buffers[i].Pending)
+            CopyWaitIo(&Buffers[i]);
+        if (Buffers[i].Event != NULL)
+            NtClose(Buffers[i].Event);
     }
-    else
+
+    /* Drop the padding of the last sector. A destination kept after a
+     * stop is cut to what was reported as copied. */
+    if ((NT_SUCCESS(errCode) && NoBuffering) || *KeepDest)
     {
-        TRACE("Error 0x%08x allocating buffer of %lu bytes\n", errCode, RegionSize);
+        NTSTATUS TrimStatus;
+
+        FileEndOfFile.EndOfFile = BytesCopied;
+        TrimStatus = NtSetInformationFile(FileHandleDest,
+                                          &IoStatusBlock,
+                                          &FileEndOfFile,
+                                          sizeof(FILE_END_OF_FILE_INFORMATION),
+                                          FileEndOfFileInformation);
+        if (NT_SUCCESS(errCode))
+            errCode = TrimStatus;
     }
 
+    RegionSize = 0;
+    NtFreeVirtualMemory(NtCurrentProcess(),
+                        (PVOID *)&lpBuffer,
+                        &RegionSize,
+                        MEM_RELEASE);
+
     return errCode;
 }
 
@@ -216,14 +490,22 @@ BasepCopyFileExW(IN LPCWSTR lpExistingFileName,
     FILE_BASIC_INFORMATION FileBasic;
     BOOL RC = FALSE;
     BOOL KeepDestOnError = FALSE;
+    BOOL NoBuffering;
     DWORD SystemError;
+    DWORD FlagsAndAttributes;
+
+    /* Both ends are read and written asynchronously by CopyLoop */
+    NoBuffering = (dwCopyFlags & COPY_FILE_NO_BUFFERING) != 0;
+    FlagsAndAttributes = FILE_FLAG_OVERLAPPED;
+    if (NoBuffering)
+        FlagsAndAttributes |= FILE_FLAG_NO_BUFFERING;
 
     FileHandleSource = CreateFileW(lpExistingFileName,
                                    GENERIC_READ,
                                    FILE_SHARE_READ | FILE_SHARE_WRITE,
                                    NULL,
                                    OPEN_EXISTING,
-                                   FILE_ATTRIBUTE_NORMAL|FILE_FLAG_NO_BUFFERING,
+                                   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN | FlagsAndAttributes,
                                    NULL);
     if (INVALID_HANDLE_VALUE != FileHandleSource)
     {
@@ -254,14 +536,15 @@ BasepCopyFileExW(IN LPCWSTR lpExistingFileName,
                                              GENERIC_WRITE,
                                              FILE_SHARE_WRITE,
                                              NULL,
-                                             dwCopyFlags ? CREATE_NEW : CREATE_ALWAYS,
-                                             FileBasic.FileAttributes,
+                                             (dwCopyFlags & COPY_FILE_FAIL_IF_EXISTS) ? CREATE_NEW : CREATE_ALWAYS,
+                                             FileBasic.FileAttributes | FlagsAndAttributes,
                                              NULL);
                 if (INVALID_HANDLE_VALUE != FileHandleDest)
                 {
                     errCode = CopyLoop(FileHandleSource,
                                        FileHandleDest,
                                        FileStandard.EndOfFile,
+                                       NoBuffering,
                                        lpProgressRoutine,
                                        lpData,
                                        pbCancel,
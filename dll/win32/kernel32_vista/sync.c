@@ -48,6 +48,21 @@ VOID
 NTAPI
 RtlReleaseSRWLockExclusive(IN OUT PRTL_SRWLOCK SRWLock);
 
+NTSTATUS
+NTAPI
+RtlWaitOnAddress(IN const volatile VOID *Address,
+                 IN PVOID CompareAddress,
+                 IN SIZE_T AddressSize,
+                 IN const LARGE_INTEGER *TimeOut OPTIONAL);
+
+VOID
+NTAPI
+RtlWakeAddressAll(IN const volatile VOID *Address);
+
+VOID
+NTAPI
+RtlWakeAddressSingle(IN const volatile VOID *Address);
+
 
 VOID
 WINAPI
@@ -146,6 +161,41 @@ WakeConditionVariable(PCONDITION_VARIABLE ConditionVariable)
     RtlWakeConditionVariable((PRTL_CONDITION_VARIABLE)ConditionVariable);
 }
 
+BOOL
+WINAPI
+WaitOnAddress(volatile VOID *Address, PVOID CompareAddress, SIZE_T AddressSize, DWORD Timeout)
+{
+    NTSTATUS Status;
+    LARGE_INTEGER Time;
+
+    Status = RtlWaitOnAddress(Address, CompareAddress, AddressSize, GetNtTimeout(&Time, Timeout));
+    if (Status == STATUS_TIMEOUT)
+    {
+        SetLastError(ERROR_TIMEOUT);
+        return FALSE;
+    }
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+VOID
+WINAPI
+WakeByAddressAll(PVOID Address)
+{
+    RtlWakeAddressAll(Address);
+}
+
+VOID
+WINAPI
+WakeByAddressSingle(PVOID Address)
+{
+    RtlWakeAddressSingle(Address);
+}
+
 
 /*
 * @implemented
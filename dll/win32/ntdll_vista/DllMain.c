@@ -19,6 +19,12 @@ RtlpInitializeKeyedEvent(VOID);
 VOID
 RtlpCloseKeyedEvent(VOID);
 
+VOID
+RtlpInitializeWaitOnAddress(VOID);
+
+VOID
+RtlpCloseWaitOnAddress(VOID);
+
 BOOL
 WINAPI
 DllMain(HANDLE hDll,
@@ -29,9 +35,11 @@ DllMain(HANDLE hDll,
     {
         LdrDisableThreadCalloutsForDll(hDll);
         RtlpInitializeKeyedEvent();
+        RtlpInitializeWaitOnAddress();
     }
     else if (dwReason == DLL_PROCESS_DETACH)
     {
+        RtlpCloseWaitOnAddress();
         RtlpCloseKeyedEvent();
     }
     return TRUE;
@@ -0,0 +1,234 @@
+/*
+ * PROJECT:     ReactOS system libraries
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Wait on address routines
+ */
+
+/* NOTE: Waiters are kept in a small table of buckets hashed by address.
+   A waiter compares the value and queues itself while holding the bucket
+   lock, and wakers take the same lock, so a wake issued after the value
+   was changed can't be missed. Waiters are parked on a keyed event, with
+   their wait block as the key. */
+
+/* INCLUDES ******************************************************************/
+
+#include <rtl_vista.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* INTERNAL TYPES ************************************************************/
+
+#define ADDRESS_WAIT_BUCKETS         128
+
+typedef struct _ADDRESS_WAIT_BLOCK
+{
+    /* The wait block is the keyed event key, so its address must be even */
+    LIST_ENTRY ListEntry;
+    const volatile VOID *Address;
+    BOOLEAN Signaled;
+} ADDRESS_WAIT_BLOCK, *PADDRESS_WAIT_BLOCK;
+
+typedef struct _ADDRESS_WAIT_BUCKET
+{
+    RTL_SRWLOCK Lock;
+    LIST_ENTRY WaitListHead;
+} ADDRESS_WAIT_BUCKET, *PADDRESS_WAIT_BUCKET;
+
+/* GLOBALS *******************************************************************/
+
+static HANDLE AddressKeyedEventHandle = NULL;
+static ADDRESS_WAIT_BUCKET AddressWaitBuckets[ADDRESS_WAIT_BUCKETS];
+
+/* INTERNAL FUNCTIONS ********************************************************/
+
+VOID
+NTAPI
+RtlInitializeSRWLock(OUT PRTL_SRWLOCK SRWLock);
+VOID
+NTAPI
+RtlAcquireSRWLockExclusive(IN OUT PRTL_SRWLOCK SRWLock);
+VOID
+NTAPI
+RtlReleaseSRWLockExclusive(IN OUT PRTL_SRWLOCK SRWLock);
+
+FORCEINLINE
+PADDRESS_WAIT_BUCKET
+InternalGetWaitBucket(IN const volatile VOID *Address)
+{
+    ULONG_PTR Hash = (ULONG_PTR)Address;
+
+    /* Neighbouring variables should not share a bucket */
+    Hash = (Hash >> 3) ^ (Hash >> 10);
+    return &AddressWaitBuckets[Hash % ADDRESS_WAIT_BUCKETS];
+}
+
+FORCEINLINE
+BOOLEAN
+InternalIsAddressEqual(IN const volatile VOID *Address,
+                       IN PVOID CompareAddress,
+                       IN SIZE_T AddressSize)
+{
+    switch (AddressSize)
+    {
+        case 1:
+            return *(const volatile UCHAR *)Address == *(PUCHAR)CompareAddress;
+        case 2:
+            return *(const volatile USHORT *)Address == *(PUSHORT)CompareAddress;
+        case 4:
+            return *(const volatile ULONG *)Address == *(PULONG)CompareAddress;
+        default:
+            return *(const volatile ULONGLONG *)Address == *(PULONGLONG)CompareAddress;
+    }
+}
+
+static
+VOID
+InternalWakeAddress(IN const volatile VOID *Address,
+                    IN BOOLEAN ReleaseAll)
+{
+    PADDRESS_WAIT_BUCKET Bucket;
+    PADDRESS_WAIT_BLOCK WaitBlock;
+    PLIST_ENTRY ListEntry;
+    LIST_ENTRY WakeListHead;
+
+    ASSERT(AddressKeyedEventHandle != NULL);
+
+    Bucket = InternalGetWaitBucket(Address);
+    InitializeListHead(&WakeListHead);
+
+    RtlAcquireSRWLockExclusive(&Bucket->Lock);
+
+    ListEntry = Bucket->WaitListHead.Flink;
+    while (ListEntry != &Bucket->WaitListHead)
+    {
+        WaitBlock = CONTAINING_RECORD(ListEntry, ADDRESS_WAIT_BLOCK, ListEntry);
+        ListEntry = ListEntry->Flink;
+
+        if (WaitBlock->Address != Address)
+            continue;
+
+        /* Once signaled, a timed out waiter waits for our release */
+        RemoveEntryList(&WaitBlock->ListEntry);
+        WaitBlock->Signaled = TRUE;
+        InsertTailList(&WakeListHead, &WaitBlock->ListEntry);
+
+        if (!ReleaseAll)
+            break;
+    }
+
+    RtlReleaseSRWLockExclusive(&Bucket->Lock);
+
+    /* The wait blocks live on the waiters' stacks, so don't touch one
+       after it was released. */
+    while (!IsListEmpty(&WakeListHead))
+    {
+        ListEntry = RemoveHeadList(&WakeListHead);
+        WaitBlock = CONTAINING_RECORD(ListEntry, ADDRESS_WAIT_BLOCK, ListEntry);
+        NtReleaseKeyedEvent(AddressKeyedEventHandle, WaitBlock, FALSE, NULL);
+    }
+}
+
+VOID
+RtlpInitializeWaitOnAddress(VOID)
+{
+    ULONG i;
+
+    ASSERT(AddressKeyedEventHandle == NULL);
+    NtCreateKeyedEvent(&AddressKeyedEventHandle, EVENT_ALL_ACCESS, NULL, 0);
+
+    for (i = 0; i < ADDRESS_WAIT_BUCKETS; i++)
+    {
+        RtlInitializeSRWLock(&AddressWaitBuckets[i].Lock);
+        InitializeListHead(&AddressWaitBuckets[i].WaitListHead);
+    }
+}
+
+VOID
+RtlpCloseWaitOnAddress(VOID)
+{
+    ASSERT(AddressKeyedEventHandle != NULL);
+    NtClose(AddressKeyedEventHandle);
+    AddressKeyedEventHandle = NULL;
+}
+
+/* EXPORTED FUNCTIONS ********************************************************/
+
+NTSTATUS
+NTAPI
+RtlWaitOnAddress(IN const volatile VOID *Address,
+                 IN PVOID CompareAddress,
+                 IN SIZE_T AddressSize,
+                 IN const LARGE_INTEGER *TimeOut OPTIONAL)
+{
+    PADDRESS_WAIT_BUCKET Bucket;
+    ADDRESS_WAIT_BLOCK WaitBlock;
+    NTSTATUS Status;
+
+    if (AddressSize != 1 && AddressSize != 2 &&
+        AddressSize != 4 && AddressSize != 8)
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    ASSERT(AddressKeyedEventHandle != NULL);
+
+    Bucket = InternalGetWaitBucket(Address);
+    WaitBlock.Address = Address;
+    WaitBlock.Signaled = FALSE;
+
+    RtlAcquireSRWLockExclusive(&Bucket->Lock);
+
+    if (!InternalIsAddressEqual(Address, CompareAddress, AddressSize))
+    {
+        /* The value already changed, no need to sleep */
+        RtlReleaseSRWLockExclusive(&Bucket->Lock);
+        return STATUS_SUCCESS;
+    }
+
+    InsertTailList(&Bucket->WaitListHead, &WaitBlock.ListEntry);
+
+    RtlReleaseSRWLockExclusive(&Bucket->Lock);
+
+    Status = NtWaitForKeyedEvent(AddressKeyedEventHandle,
+                                 &WaitBlock,
+                                 FALSE,
+                                 (PLARGE_INTEGER)TimeOut);
+    if (Status != STATUS_SUCCESS)
+    {
+        RtlAcquireSRWLockExclusive(&Bucket->Lock);
+
+        if (!WaitBlock.Signaled)
+        {
+            /* Nobody woke us, leave the queue */
+            RemoveEntryList(&WaitBlock.ListEntry);
+            RtlReleaseSRWLockExclusive(&Bucket->Lock);
+            return Status;
+        }
+
+        RtlReleaseSRWLockExclusive(&Bucket->Lock);
+
+        /* A waker already dequeued us and is going to release our key.
+           Take it, or it would block forever. */
+        NtWaitForKeyedEvent(AddressKeyedEventHandle, &WaitBlock, FALSE, NULL);
+        Status = STATUS_SUCCESS;
+    }
+
+    return Status;
+}
+
+VOID
+NTAPI
+RtlWakeAddressAll(IN const volatile VOID *Address)
+{
+    InternalWakeAddress(Address, TRUE);
+}
+
+VOID
+NTAPI
+RtlWakeAddressSingle(IN const volatile VOID *Address)
+{
+    InternalWakeAddress(Address, FALSE);
+}
+
+/* EOF */
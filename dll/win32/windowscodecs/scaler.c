@@ -19,6 +19,7 @@
 #include "config.h"
 
 #include <stdarg.h>
+#include <math.h>
 
 #define COBJMACROS
 
@@ -32,6 +33,19 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(wincodecs);
 
+/* Filter weights are 1.14 fixed point; the vertical pass keeps 6 fraction bits */
+#define FILTER_SHIFT 14
+#define COLUMN_SHIFT 8
+
+/* Destination rows produced from one source request in CopyPixels */
+#define SCALER_BAND_HEIGHT 16
+
+typedef struct ScalerFilter {
+    UINT taps;
+    INT *start;     /* first source pixel for each destination pixel */
+    SHORT *weights; /* taps weights for each destination pixel */
+} ScalerFilter;
+
 typedef struct BitmapScaler {
     IWICBitmapScaler IWICBitmapScaler_iface;
     LONG ref;
@@ -43,6 +57,10 @@ typedef struct BitmapScaler {
     UINT bpp;
     void (*fn_get_required_source_rect)(struct BitmapScaler*,UINT,UINT,WICRect*);
     void (*fn_copy_scanline)(struct BitmapScaler*,UINT,UINT,UINT,BYTE**,UINT,UINT,BYTE*);
+    UINT channels;
+    ScalerFilter filter_x, filter_y;
+    INT *row_sums;
+    SHORT *column_data;
     CRITICAL_SECTION lock; /* must be held when initialized */
 } BitmapScaler;
 
@@ -107,6 +125,12 @@ static ULONG WINAPI BitmapScaler_Release(IWICBitmapScaler *iface)
         This->lock.DebugInfo->Spare[0] = 0;
         DeleteCriticalSection(&This->lock);
         if (This->source) IWICBitmapSource_Release(This->source);
+        HeapFree(GetProcessHeap(), 0, This->filter_x.start);
+        HeapFree(GetProcessHeap(), 0, This->filter_x.weights);
+        HeapFree(GetProcessHeap(), 0, This->filter_y.start);
+        HeapFree(GetProcessHeap(), 0, This->filter_y.weights);
+        HeapFree(GetProcessHeap(), 0, This->row_sums);
+        HeapFree(GetProcessHeap(), 0, This->column_data);
         HeapFree(GetProcessHeap(), 0, This);
     }
 
@@ -201,6 +225,235 @@ static void NearestNeighbor_CopyScanline(BitmapScaler *This,
     }
 }
 
+static double cubic_weight(double x)
+{
+    /* Catmull-Rom spline */
+    x = fabs(x);
+    if (x < 1.0)
+        return (1.5 * x - 2.5) * x * x + 1.0;
+    if (x < 2.0)
+        return ((-0.5 * x + 2.5) * x - 4.0) * x + 2.0;
+    return 0.0;
+}
+
+static HRESULT init_filter(ScalerFilter *filter, WICBitmapInterpolationMode mode,
+    UINT src_size, UINT dst_size)
+{
+    double scale = (double)src_size / dst_size;
+    double *weights, sum, total, pos, lo, hi;
+    BOOL box = (mode == WICBitmapInterpolationModeFant && scale > 1.0);
+    INT left, start, j, fixed, prev_fixed, nearest;
+    UINT i, k, taps;
+
+    /* Fant averages every covered source pixel when shrinking and
+     * interpolates like Linear when enlarging. */
+    if (box)
+        taps = (UINT)ceil(scale) + 1;
+    else if (mode == WICBitmapInterpolationModeCubic)
+        taps = 4;
+    else
+        taps = 2;
+
+    if (taps > src_size) taps = src_size;
+
+    filter->taps = taps;
+    filter->start = HeapAlloc(GetProcessHeap(), 0, dst_size * sizeof(INT));
+    filter->weights = HeapAlloc(GetProcessHeap(), 0, dst_size * taps * sizeof(SHORT));
+    weights = HeapAlloc(GetProcessHeap(), 0, taps * sizeof(double));
+    if (!filter->start || !filter->weights || !weights)
+    {
+        HeapFree(GetProcessHeap(), 0, weights);
+        return E_OUTOFMEMORY;
+    }
+
+    for (i = 0; i < dst_size; i++)
+    {
+        if (box)
+        {
+            lo = i * scale;
+            hi = lo + scale;
+            left = (INT)floor(lo);
+            pos = 0.0;
+        }
+        else
+        {
+            pos = (i + 0.5) * scale - 0.5;
+            /* A single tap (one pixel wide source) sits on the nearest pixel */
+            if (taps == 1)
+                left = (INT)floor(pos + 0.5);
+            else
+                left = (INT)floor(pos) - ((INT)taps / 2 - 1);
+            lo = hi = 0.0;
+        }
+
+        /* Keep the window inside the source and fold the taps that fall
+         * outside of it onto the edge pixels. */
+        start = left;
+        if (start > (INT)(src_size - taps)) start = src_size - taps;
+        if (start < 0) start = 0;
+
+        for (k = 0; k < taps; k++)
+            weights[k] = 0.0;
+
+        for (k = 0; k < taps; k++)
+        {
+            double w;
+
+            j = left + k;
+            if (box)
+                w = min(j + 1, hi) - max(j, lo);
+            else if (mode == WICBitmapInterpolationModeCubic)
+                w = cubic_weight(j - pos);
+            else
+                w = 1.0 - fabs(j - pos);
+            if (!box || w > 0.0)
+            {
+                if (j < 0) j = 0;
+                if (j > (INT)src_size - 1) j = src_size - 1;
+                weights[j - start] += w;
+            }
+        }
+
+        sum = 0.0;
+        for (k = 0; k < taps; k++)
+            sum += weights[k];
+
+        /* Nothing to interpolate from, copy the nearest pixel */
+        if (sum <= 0.0)
+        {
+            nearest = box ? (INT)floor(lo) : (INT)floor(pos + 0.5);
+            if (nearest < start) nearest = start;
+            if (nearest > start + (INT)taps - 1) nearest = start + taps - 1;
+            for (k = 0; k < taps; k++)
+                weights[k] = 0.0;
+            weights[nearest - start] = 1.0;
+            sum = 1.0;
+        }
+
+        /* Round the running total so that the weights add up to exactly one */
+        total = 0.0;
+        prev_fixed = 0;
+        for (k = 0; k < taps; k++)
+        {
+            total += weights[k];
+            fixed = (INT)floor(total / sum * (1 << FILTER_SHIFT) + 0.5);
+            filter->weights[i * taps + k] = (SHORT)(fixed - prev_fixed);
+            prev_fixed = fixed;
+        }
+
+        filter->start[i] = start;
+    }
+
+    HeapFree(GetProcessHeap(), 0, weights);
+    return S_OK;
+}
+
+static void Filter_GetRequiredSourceRect(BitmapScaler *This,
+    UINT x, UINT y, WICRect *src_rect)
+{
+    src_rect->X = This->filter_x.start[x];
+    src_rect->Y = This->filter_y.start[y];
+    src_rect->Width = This->filter_x.taps;
+    src_rect->Height = This->filter_y.taps;
+}
+
+static inline BYTE clamp_pixel(INT value)
+{
+    value = (value + (1 << (FILTER_SHIFT + FILTER_SHIFT - COLUMN_SHIFT - 1))) >>
+        (FILTER_SHIFT + FILTER_SHIFT - COLUMN_SHIFT);
+    if (value < 0) return 0;
+    if (value > 0xff) return 0xff;
+    return value;
+}
+
+static void Filter_CopyScanline(BitmapScaler *This,
+    UINT dst_x, UINT dst_y, UINT dst_width,
+    BYTE **src_data, UINT src_data_x, UINT src_data_y, BYTE *pbBuffer)
+{
+    const ScalerFilter *fx = &This->filter_x, *fy = &This->filter_y;
+    const SHORT *weights = fy->weights + dst_y * fy->taps;
+    UINT channels = This->channels;
+    UINT first = fx->start[dst_x];
+    UINT count = (fx->start[dst_x + dst_width - 1] + fx->taps - first) * channels;
+    BYTE **rows = src_data + (fy->start[dst_y] - src_data_y);
+    INT *row_sums = This->row_sums;
+    SHORT *column_data = This->column_data;
+    UINT i, k, c;
+
+    /* Vertical pass over every source column the row needs. The loops are
+     * kept simple so that the compiler can vectorise them. */
+    for (i = 0; i < count; i++)
+        row_sums[i] = 0;
+
+    for (k = 0; k < fy->taps; k++)
+    {
+        const BYTE *src = rows[k] + (first - src_data_x) * channels;
+        INT w = weights[k];
+
+        if (!w) continue;
+        for (i = 0; i < count; i++)
+            row_sums[i] += w * src[i];
+    }
+
+    for (i = 0; i < count; i++)
+        column_data[i] = (SHORT)((row_sums[i] + (1 << (COLUMN_SHIFT - 1))) >> COLUMN_SHIFT);
+
+    /* Horizontal pass */
+    if (channels == 4)
+    {
+        for (i = 0; i < dst_width; i++)
+        {
+            const SHORT *src = column_data + (fx->start[dst_x + i] - first) * 4;
+            const SHORT *w = fx->weights + (dst_x + i) * fx->taps;
+            INT b = 0, g = 0, r = 0, a = 0;
+
+            for (k = 0; k < fx->taps; k++, src += 4)
+            {
+                b += w[k] * src[0];
+                g += w[k] * src[1];
+                r += w[k] * src[2];
+                a += w[k] * src[3];
+            }
+
+            pbBuffer[i * 4 + 0] = clamp_pixel(b);
+            pbBuffer[i * 4 + 1] = clamp_pixel(g);
+            pbBuffer[i * 4 + 2] = clamp_pixel(r);
+            pbBuffer[i * 4 + 3] = clamp_pixel(a);
+        }
+    }
+    else
+    {
+        for (i = 0; i < dst_width; i++)
+        {
+            const SHORT *src = column_data + (fx->start[dst_x + i] - first) * channels;
+            const SHORT *w = fx->weights + (dst_x + i) * fx->taps;
+
+            for (c = 0; c < channels; c++)
+            {
+                INT sum = 0;
+
+                for (k = 0; k < fx->taps; k++)
+                    sum += w[k] * src[k * channels + c];
+
+                pbBuffer[i * channels + c] = clamp_pixel(sum);
+            }
+        }
+    }
+}
+
+static BOOL is_filterable_format(const WICPixelFormatGUID *format)
+{
+    /* Formats with one byte per channel and no palette */
+    return IsEqualGUID(format, &GUID_WICPixelFormat8bppGray) ||
+           IsEqualGUID(format, &GUID_WICPixelFormat24bppBGR) ||
+           IsEqualGUID(format, &GUID_WICPixelFormat24bppRGB) ||
+           IsEqualGUID(format, &GUID_WICPixelFormat32bppBGR) ||
+           IsEqualGUID(format, &GUID_WICPixelFormat32bppBGRA) ||
+           IsEqualGUID(format, &GUID_WICPixelFormat32bppPBGRA) ||
+           IsEqualGUID(format, &GUID_WICPixelFormat32bppRGBA) ||
+           IsEqualGUID(format, &GUID_WICPixelFormat32bppPRGBA);
+}
+
 static HRESULT WINAPI BitmapScaler_CopyPixels(IWICBitmapScaler *iface,
     const WICRect *prc, UINT cbStride, UINT cbBufferSize, BYTE *pbBuffer)
 {
@@ -213,6 +466,7 @@ static HRESULT WINAPI BitmapScaler_CopyPixels(IWICBitmapScaler *iface,
     ULONG bytesperrow;
     ULONG src_bytesperrow;
     ULONG buffer_size;
+    INT band_y, band_height;
     UINT y;
 
     TRACE("(%p,%p,%u,%u,%p)\n", iface, prc, cbStride, cbBufferSize, pbBuffer);
@@ -261,48 +515,56 @@ static HRESULT WINAPI BitmapScaler_CopyPixels(IWICBitmapScaler *iface,
      * once, by saving the data that will be useful for the next scanline after
      * the call returns. The GetRequiredSourceRect/CopyScanline functions are
      * designed to make it possible to do this in a generic way, but for now we
-     * just grab all the data we need in each call. */
+     * just grab the data we need in each call, a band of rows at a time so
+     * that large requests don't need the whole source in memory. */
 
-    This->fn_get_required_source_rect(This, dest_rect.X, dest_rect.Y, &src_rect_ul);
-    This->fn_get_required_source_rect(This, dest_rect.X+dest_rect.Width-1,
-        dest_rect.Y+dest_rect.Height-1, &src_rect_br);
+    hr = S_OK;
 
-    src_rect.X = src_rect_ul.X;
-    src_rect.Y = src_rect_ul.Y;
-    src_rect.Width = src_rect_br.Width + src_rect_br.X - src_rect_ul.X;
-    src_rect.Height = src_rect_br.Height + src_rect_br.Y - src_rect_ul.Y;
+    for (band_y = 0; band_y < dest_rect.Height && SUCCEEDED(hr); band_y += band_height)
+    {
+        band_height = min(dest_rect.Height - band_y, SCALER_BAND_HEIGHT);
 
-    src_bytesperrow = (src_rect.Width * This->bpp + 7)/8;
-    buffer_size = src_bytesperrow * src_rect.Height;
+        This->fn_get_required_source_rect(This, dest_rect.X, dest_rect.Y+band_y, &src_rect_ul);
+        This->fn_get_required_source_rect(This, dest_rect.X+dest_rect.Width-1,
+            dest_rect.Y+band_y+band_height-1, &src_rect_br);
 
-    src_rows = HeapAlloc(GetProcessHeap(), 0, sizeof(BYTE*) * src_rect.Height);
-    src_bits = HeapAlloc(GetProcessHeap(), 0, buffer_size);
+        src_rect.X = src_rect_ul.X;
+        src_rect.Y = src_rect_ul.Y;
+        src_rect.Width = src_rect_br.Width + src_rect_br.X - src_rect_ul.X;
+        src_rect.Height = src_rect_br.Height + src_rect_br.Y - src_rect_ul.Y;
 
-    if (!src_rows || !src_bits)
-    {
-        HeapFree(GetProcessHeap(), 0, src_rows);
-        HeapFree(GetProcessHeap(), 0, src_bits);
-        hr = E_OUTOFMEMORY;
-        goto end;
-    }
+        src_bytesperrow = (src_rect.Width * This->bpp + 7)/8;
+        buffer_size = src_bytesperrow * src_rect.Height;
 
-    for (y=0; y<src_rect.Height; y++)
-        src_rows[y] = src_bits + y * src_bytesperrow;
+        src_rows = HeapAlloc(GetProcessHeap(), 0, sizeof(BYTE*) * src_rect.Height);
+        src_bits = HeapAlloc(GetProcessHeap(), 0, buffer_size);
 
-    hr = IWICBitmapSource_CopyPixels(This->source, &src_rect, src_bytesperrow,
-        buffer_size, src_bits);
+        if (!src_rows || !src_bits)
+        {
+            HeapFree(GetProcessHeap(), 0, src_rows);
+            HeapFree(GetProcessHeap(), 0, src_bits);
+            hr = E_OUTOFMEMORY;
+            goto end;
+        }
 
-    if (SUCCEEDED(hr))
-    {
-        for (y=0; y < dest_rect.Height; y++)
+        for (y=0; y<src_rect.Height; y++)
+            src_rows[y] = src_bits + y * src_bytesperrow;
+
+        hr = IWICBitmapSource_CopyPixels(This->source, &src_rect, src_bytesperrow,
+            buffer_size, src_bits);
+
+        if (SUCCEEDED(hr))
         {
-            This->fn_copy_scanline(This, dest_rect.X, dest_rect.Y+y, dest_rect.Width,
-                src_rows, src_rect.X, src_rect.Y, pbBuffer + cbStride * y);
+            for (y=band_y; y < band_y+band_height; y++)
+            {
+                This->fn_copy_scanline(This, dest_rect.X, dest_rect.Y+y, dest_rect.Width,
+                    src_rows, src_rect.X, src_rect.Y, pbBuffer + cbStride * y);
+            }
         }
-    }
 
-    HeapFree(GetProcessHeap(), 0, src_rows);
-    HeapFree(GetProcessHeap(), 0, src_bits);
+        HeapFree(GetProcessHeap(), 0, src_rows);
+        HeapFree(GetProcessHeap(), 0, src_bits);
+    }
 
 end:
     LeaveCriticalSection(&This->lock);
@@ -346,6 +608,65 @@ static HRESULT WINAPI BitmapScaler_Initialize(IWICBitmapScaler *iface,
     {
         switch (mode)
         {
+        case WICBitmapInterpolationModeLinear:
+        case WICBitmapInterpolationModeCubic:
+        case WICBitmapInterpolationModeFant:
+            if (!uiWidth || !uiHeight || !This->src_width || !This->src_height)
+            {
+                hr = E_INVALIDARG;
+                break;
+            }
+
+            if (is_filterable_format(&src_pixelformat))
+            {
+                IWICBitmapSource_AddRef(pISource);
+                This->source = pISource;
+            }
+            else
+            {
+                hr = WICConvertBitmapSource(&GUID_WICPixelFormat32bppBGRA,
+                    pISource, &This->source);
+                This->bpp = 32;
+            }
+            This->channels = This->bpp / 8;
+
+            if (SUCCEEDED(hr))
+                hr = init_filter(&This->filter_x, mode, This->src_width, uiWidth);
+            if (SUCCEEDED(hr))
+                hr = init_filter(&This->filter_y, mode, This->src_height, uiHeight);
+            if (SUCCEEDED(hr))
+            {
+                This->row_sums = HeapAlloc(GetProcessHeap(), 0,
+                    This->src_width * This->channels * sizeof(INT));
+                This->column_data = HeapAlloc(GetProcessHeap(), 0,
+                    This->src_width * This->channels * sizeof(SHORT));
+                if (!This->row_sums || !This->column_data)
+                    hr = E_OUTOFMEMORY;
+            }
+
+            if (FAILED(hr))
+            {
+                HeapFree(GetProcessHeap(), 0, This->filter_x.start);
+                HeapFree(GetProcessHeap(), 0, This->filter_x.weights);
+                HeapFree(GetProcessHeap(), 0, This->filter_y.start);
+                HeapFree(GetProcessHeap(), 0, This->filter_y.weights);
+                HeapFree(GetProcessHeap(), 0, This->row_sums);
+                HeapFree(GetProcessHeap(), 0, This->column_data);
+                memset(&This->filter_x, 0, sizeof(This->filter_x));
+                memset(&This->filter_y, 0, sizeof(This->filter_y));
+                This->row_sums = NULL;
+                This->column_data = NULL;
+                if (This->source)
+                {
+                    IWICBitmapSource_Release(This->source);
+                    This->source = NULL;
+                }
+                break;
+            }
+
+            This->fn_get_required_source_rect = Filter_GetRequiredSourceRect;
+            This->fn_copy_scanline = Filter_CopyScanline;
+            break;
         default:
             FIXME("unsupported mode %i\n", mode);
             /* fall-through */
@@ -559,6 +880,11 @@ HRESULT BitmapScaler_Create(IWICBitmapScaler **scaler)
     This->src_height = 0;
     This->mode = 0;
     This->bpp = 0;
+    This->channels = 0;
+    memset(&This->filter_x, 0, sizeof(This->filter_x));
+    memset(&This->filter_y, 0, sizeof(This->filter_y));
+    This->row_sums = NULL;
+    This->column_data = NULL;
     InitializeCriticalSection(&This->lock);
     This->lock.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": BitmapScaler.lock");
 
@@ -1117,7 +1117,7 @@ NTSTATUS AddDevice(PDRIVER_OBJECT DriverObject, PDEVICE_OBJECT PhysicalDeviceObj
 #define funcname __func__
 #endif
 
-extern BOOL have_sse2;
+extern BOOL have_sse2, have_ssse3;
 
 extern UINT32 mount_compress;
 extern UINT32 mount_compress_force;
@@ -1481,9 +1481,13 @@ NTSTATUS zlib_decompress(UINT8* inbuf, UINT32 inlen, UINT8* outbuf, UINT32 outle
 NTSTATUS lzo_decompress(UINT8* inbuf, UINT32 inlen, UINT8* outbuf, UINT32 outlen, UINT32 inpageoff);
 NTSTATUS write_compressed_bit(fcb* fcb, UINT64 start_data, UINT64 end_data, void* data, BOOL* compressed, PIRP Irp, LIST_ENTRY* rollback);
 
+// in zstd.c
+NTSTATUS zstd_decompress(UINT8* inbuf, UINT32 inlen, UINT8* outbuf, UINT32 outlen);
+
 // in galois.c
 void galois_double(UINT8* data, UINT32 len);
 void galois_divpower(UINT8* data, UINT8 div, UINT32 readlen);
+void galois_combine(UINT8* qxy, UINT8* pxy, UINT8* p, UINT8* q, UINT8 a, UINT8 b, UINT32 len);
 UINT8 gpow2(UINT8 e);
 UINT8 gmul(UINT8 a, UINT8 b);
 UINT8 gdiv(UINT8 a, UINT8 b);
@@ -17,6 +17,13 @@
 
 #include "btrfs_drv.h"
 
+// The vector paths below need tmmintrin.h, which our SDK doesn't have, so
+// ReactOS builds only get the table-driven scalar code. There is no AVX2
+// path: the kernel would have to save the YMM state for every call.
+#ifndef __REACTOS__
+#include <tmmintrin.h>
+#endif
+
 static const UINT8 glog[] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1d, 0x3a, 0x74, 0xe8, 0xcd, 0x87, 0x13, 0x26,
                              0x4c, 0x98, 0x2d, 0x5a, 0xb4, 0x75, 0xea, 0xc9, 0x8f, 0x03, 0x06, 0x0c, 0x18, 0x30, 0x60, 0xc0,
                              0x9d, 0x27, 0x4e, 0x9c, 0x25, 0x4a, 0x94, 0x35, 0x6a, 0xd4, 0xb5, 0x77, 0xee, 0xc1, 0x9f, 0x23,
@@ -51,30 +58,149 @@ static const UINT8 gilog[] = {0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1a, 0xc6, 0x
                               0xcb, 0x59, 0x5f, 0xb0, 0x9c, 0xa9, 0xa0, 0x51, 0x0b, 0xf5, 0x16, 0xeb, 0x7a, 0x75, 0x2c, 0xd7,
                               0x4f, 0xae, 0xd5, 0xe9, 0xe6, 0xe7, 0xad, 0xe8, 0x74, 0xd6, 0xf4, 0xea, 0xa8, 0x50, 0x58, 0xaf};
 
+UINT8 gpow2(UINT8 e) {
+    return glog[e%255];
+}
+
+UINT8 gmul(UINT8 a, UINT8 b) {
+    if (a == 0 || b == 0)
+        return 0;
+    else
+        return glog[(gilog[a] + gilog[b]) % 255];
+}
+
+// Multiplication by a constant c is linear over XOR, so c * x can be split into
+// c * (x & 0xf) ^ c * (x & 0xf0), and each half looked up in a 16-entry table.
+// With SSSE3, PSHUFB does sixteen of these lookups at once.
+
+typedef struct {
+    UINT8 lo[16];
+    UINT8 hi[16];
+} galois_mul_table;
+
+static void galois_init_mul_table(galois_mul_table* t, UINT8 c) {
+    unsigned int i;
+
+    for (i = 0; i < 16; i++) {
+        t->lo[i] = gmul(c, (UINT8)i);
+        t->hi[i] = gmul(c, (UINT8)(i << 4));
+    }
+}
+
+__inline static UINT8 galois_mul_lookup(const galois_mul_table* t, UINT8 v) {
+    return t->lo[v & 0xf] ^ t->hi[v >> 4];
+}
+
+#ifndef __REACTOS__
+// Kernel-mode code on x86 has to save the FPU state before touching the XMM
+// registers. On amd64 the volatile XMM registers are preserved for us.
+__inline static BOOL galois_simd_begin(KFLOATING_SAVE* fp) {
+#ifdef _X86_
+    return NT_SUCCESS(KeSaveFloatingPointState(fp));
+#else
+    UNUSED(fp);
+    return TRUE;
+#endif
+}
+
+__inline static void galois_simd_end(KFLOATING_SAVE* fp) {
+#ifdef _X86_
+    KeRestoreFloatingPointState(fp);
+#else
+    UNUSED(fp);
+#endif
+}
+
+__inline static __m128i galois_mul_ssse3(__m128i v, __m128i lo, __m128i hi, __m128i mask) {
+    __m128i l, h;
+
+    l = _mm_shuffle_epi8(lo, _mm_and_si128(v, mask));
+    h = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(v, 4), mask));
+
+    return _mm_xor_si128(l, h);
+}
+#endif
+
 // divides the bytes in data by 2^div
 void galois_divpower(UINT8* data, UINT8 div, UINT32 len) {
-    while (len > 0) {
-        if (data[0] != 0) {
-            if (gilog[data[0]] <= div)
-                data[0] = glog[(gilog[data[0]] + (255 - div)) % 255];
-            else
-                data[0] = glog[(gilog[data[0]] - div) % 255];
+    galois_mul_table t;
+#ifndef __REACTOS__
+    KFLOATING_SAVE fp;
+#endif
+
+    galois_init_mul_table(&t, glog[(255 - div) % 255]);
+
+#ifndef __REACTOS__
+    if (have_ssse3 && galois_simd_begin(&fp)) {
+        __m128i lo = _mm_loadu_si128((__m128i*)t.lo);
+        __m128i hi = _mm_loadu_si128((__m128i*)t.hi);
+        __m128i mask = _mm_set1_epi8(0xf);
+
+        while (len >= 16) {
+            __m128i v = _mm_loadu_si128((__m128i*)data);
+
+            _mm_storeu_si128((__m128i*)data, galois_mul_ssse3(v, lo, hi, mask));
+
+            data += 16;
+            len -= 16;
         }
 
+        galois_simd_end(&fp);
+    }
+#endif
+
+    while (len > 0) {
+        data[0] = galois_mul_lookup(&t, data[0]);
+
         data++;
         len--;
     }
 }
 
-UINT8 gpow2(UINT8 e) {
-    return glog[e%255];
-}
+// sets qxy to (a * (p ^ pxy)) ^ (b * (q ^ qxy)), the RAID6 recovery step for two missing data stripes
+void galois_combine(UINT8* qxy, UINT8* pxy, UINT8* p, UINT8* q, UINT8 a, UINT8 b, UINT32 len) {
+    galois_mul_table ta, tb;
+#ifndef __REACTOS__
+    KFLOATING_SAVE fp;
+#endif
 
-UINT8 gmul(UINT8 a, UINT8 b) {
-    if (a == 0 || b == 0)
-        return 0;
-    else
-        return glog[(gilog[a] + gilog[b]) % 255];
+    galois_init_mul_table(&ta, a);
+    galois_init_mul_table(&tb, b);
+
+#ifndef __REACTOS__
+    if (have_ssse3 && galois_simd_begin(&fp)) {
+        __m128i alo = _mm_loadu_si128((__m128i*)ta.lo);
+        __m128i ahi = _mm_loadu_si128((__m128i*)ta.hi);
+        __m128i blo = _mm_loadu_si128((__m128i*)tb.lo);
+        __m128i bhi = _mm_loadu_si128((__m128i*)tb.hi);
+        __m128i mask = _mm_set1_epi8(0xf);
+
+        while (len >= 16) {
+            __m128i x = _mm_xor_si128(_mm_loadu_si128((__m128i*)p), _mm_loadu_si128((__m128i*)pxy));
+            __m128i y = _mm_xor_si128(_mm_loadu_si128((__m128i*)q), _mm_loadu_si128((__m128i*)qxy));
+
+            _mm_storeu_si128((__m128i*)qxy, _mm_xor_si128(galois_mul_ssse3(x, alo, ahi, mask), galois_mul_ssse3(y, blo, bhi, mask)));
+
+            p += 16;
+            q += 16;
+            pxy += 16;
+            qxy += 16;
+            len -= 16;
+        }
+
+        galois_simd_end(&fp);
+    }
+#endif
+
+    while (len > 0) {
+        *qxy = galois_mul_lookup(&ta, *p ^ *pxy) ^ galois_mul_lookup(&tb, *q ^ *qxy);
+
+        p++;
+        q++;
+        pxy++;
+        qxy++;
+        len--;
+    }
 }
 
 UINT8 gdiv(UINT8 a, UINT8 b) {
@@ -107,7 +233,28 @@ __inline static UINT32 galois_double_mask32(UINT32 v) {
 #endif
 
 void galois_double(UINT8* data, UINT32 len) {
-    // FIXME - SIMD?
+#ifndef __REACTOS__
+    KFLOATING_SAVE fp;
+
+    if (have_sse2 && galois_simd_begin(&fp)) {
+        __m128i poly = _mm_set1_epi8(0x1d);
+        __m128i zero = _mm_setzero_si128();
+
+        while (len >= 16) {
+            __m128i v = _mm_loadu_si128((__m128i*)data);
+            __m128i mask = _mm_cmpgt_epi8(zero, v); // bytes with the top bit set
+
+            v = _mm_add_epi8(v, v);
+            v = _mm_xor_si128(v, _mm_and_si128(mask, poly));
+            _mm_storeu_si128((__m128i*)data, v);
+
+            data += 16;
+            len -= 16;
+        }
+
+        galois_simd_end(&fp);
+    }
+#endif
 
 #ifdef _AMD64_
     while (len > sizeof(UINT64)) {
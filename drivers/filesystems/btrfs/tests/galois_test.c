@@ -0,0 +1,146 @@
+/*
+ * Host-side check that the vectorised Galois field routines in galois.c
+ * produce the same bytes as the scalar gmul / gdiv definitions.
+ *
+ * Not part of the ReactOS build (the SIMD paths are compiled out under
+ * __REACTOS__). Build and run on an x86 or amd64 host with:
+ *
+ *   cc -O2 -mssse3 -o galois_test galois_test.c && ./galois_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* Stand in for btrfs_drv.h, which pulls in the DDK headers. */
+#define BTRFS_DRV_H_DEFINED
+
+#if defined(__x86_64__) && !defined(_AMD64_)
+#define _AMD64_
+#elif defined(__i386__) && !defined(_X86_)
+#define _X86_
+#endif
+
+typedef uint8_t UINT8;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef int BOOL;
+typedef long NTSTATUS;
+typedef struct { int dummy; } KFLOATING_SAVE;
+
+#define TRUE 1
+#define FALSE 0
+#define UNUSED(x) (void)(x)
+#define NT_SUCCESS(Status) ((NTSTATUS)(Status) >= 0)
+#define __inline inline
+
+#ifdef _X86_
+static NTSTATUS KeSaveFloatingPointState(KFLOATING_SAVE* fp) { UNUSED(fp); return 0; }
+static NTSTATUS KeRestoreFloatingPointState(KFLOATING_SAVE* fp) { UNUSED(fp); return 0; }
+#endif
+
+BOOL have_sse2, have_ssse3;
+
+#include "../galois.c"
+
+#define MAX_LEN 4133
+
+static unsigned int failures;
+
+static void fill_random(UINT8* buf, UINT32 len) {
+    UINT32 i;
+
+    for (i = 0; i < len; i++)
+        buf[i] = (UINT8)rand();
+}
+
+static void check(const char* func, const UINT8* got, const UINT8* expected, UINT32 len, UINT32 arg) {
+    UINT32 i;
+
+    for (i = 0; i < len; i++) {
+        if (got[i] != expected[i]) {
+            printf("%s(%u): byte %u of %u is %02x, expected %02x (sse2 %d, ssse3 %d)\n",
+                   func, arg, i, len, got[i], expected[i], have_sse2, have_ssse3);
+            failures++;
+            return;
+        }
+    }
+}
+
+static void test_double(UINT32 off, UINT32 len) {
+    static UINT8 buf[MAX_LEN + 16], expected[MAX_LEN];
+    UINT32 i;
+
+    fill_random(buf + off, len);
+
+    for (i = 0; i < len; i++)
+        expected[i] = gmul(buf[off + i], 2);
+
+    galois_double(buf + off, len);
+    check("galois_double", buf + off, expected, len, len);
+}
+
+static void test_divpower(UINT32 off, UINT32 len, UINT8 div) {
+    static UINT8 buf[MAX_LEN + 16], expected[MAX_LEN];
+    UINT32 i;
+
+    fill_random(buf + off, len);
+
+    for (i = 0; i < len; i++)
+        expected[i] = gdiv(buf[off + i], gpow2(div));
+
+    galois_divpower(buf + off, div, len);
+    check("galois_divpower", buf + off, expected, len, div);
+}
+
+static void test_combine(UINT32 off, UINT32 len, UINT8 a, UINT8 b) {
+    static UINT8 p[MAX_LEN + 16], q[MAX_LEN + 16], pxy[MAX_LEN + 16], qxy[MAX_LEN + 16], expected[MAX_LEN];
+    UINT32 i;
+
+    fill_random(p + off, len);
+    fill_random(q + off, len);
+    fill_random(pxy + off, len);
+    fill_random(qxy + off, len);
+
+    for (i = 0; i < len; i++)
+        expected[i] = gmul(a, p[off + i] ^ pxy[off + i]) ^ gmul(b, q[off + i] ^ qxy[off + i]);
+
+    galois_combine(qxy + off, pxy + off, p + off, q + off, a, b, len);
+    check("galois_combine", qxy + off, expected, len, ((UINT32)a << 8) | b);
+}
+
+static void run_tests(void) {
+    static const UINT32 lens[] = { 0, 1, 7, 15, 16, 17, 31, 32, 33, 64, 255, 4096, MAX_LEN };
+    unsigned int i, j;
+
+    for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        for (j = 0; j < 16; j += 3) {
+            test_double(j, lens[i]);
+            test_divpower(j, lens[i], (UINT8)rand());
+            test_combine(j, lens[i], (UINT8)rand(), (UINT8)rand());
+        }
+    }
+
+    /* every divisor and a sweep of coefficients, including 0 and 1 */
+    for (i = 0; i < 256; i++) {
+        test_divpower(1, 100, (UINT8)i);
+        test_combine(3, 100, (UINT8)i, (UINT8)(255 - i));
+        test_combine(5, 100, 0, (UINT8)i);
+    }
+}
+
+int main(void) {
+    srand(0x1d);
+
+    have_sse2 = have_ssse3 = FALSE;
+    run_tests();
+
+    have_sse2 = __builtin_cpu_supports("sse2") != 0;
+    have_ssse3 = __builtin_cpu_supports("ssse3") != 0;
+    run_tests();
+
+    printf("galois: %u failures (sse2 %d, ssse3 %d)\n", failures, have_sse2, have_ssse3);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,487 @@
+/*
+ * Host-side check of the Zstandard decoder in zstd.c.
+ *
+ * Not part of the ReactOS build. Build on a little-endian host with:
+ *
+ *   cc -O2 -o zstd_test zstd_test.c
+ *
+ * Run without arguments to round-trip generated data through the zstd
+ * command line tool, which must be in the PATH.
+ *
+ * Run with a btrfs image and the directory its files were copied from to
+ * decompress every zstd extent in the image's FS tree and compare it with
+ * the original file. Only single-device images are supported. To make one:
+ *
+ *   truncate -s 256M zstd.img && mkfs.btrfs zstd.img
+ *   mount -o compress-force=zstd zstd.img /mnt && cp -a ref/. /mnt && umount /mnt
+ *   ./zstd_test zstd.img ref
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <unistd.h>
+
+/* Stand in for btrfs_drv.h, which pulls in the DDK headers. */
+#define BTRFS_DRV_H_DEFINED
+
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef int16_t INT16;
+typedef int32_t INT32;
+typedef int BOOL;
+typedef int32_t NTSTATUS;
+
+#define TRUE 1
+#define FALSE 0
+#define NT_SUCCESS(Status) ((NTSTATUS)(Status) >= 0)
+#define STATUS_SUCCESS                ((NTSTATUS)0x00000000)
+#define STATUS_NOT_SUPPORTED          ((NTSTATUS)0xc00000bb)
+#define STATUS_INTERNAL_ERROR         ((NTSTATUS)0xc00000e5)
+#define STATUS_INSUFFICIENT_RESOURCES ((NTSTATUS)0xc000009a)
+#define __inline inline
+
+#define PagedPool 1
+#define ALLOC_TAG 0x7442534d
+#define ExAllocatePoolWithTag(type, size, tag) malloc(size)
+#define ExFreePool(p) free(p)
+#define RtlCopyMemory(dst, src, len) memcpy(dst, src, len)
+#define RtlZeroMemory(dst, len) memset(dst, 0, len)
+#define RtlFillMemory(dst, len, fill) memset(dst, fill, len)
+#define ERR(s, ...) do { if (verbose) printf("%s: " s, __func__, ##__VA_ARGS__); } while (0)
+
+static int verbose;
+
+#include "../zstd.c"
+#include "../btrfs.h"
+
+static unsigned int failures, checked;
+
+static void fail(const char* fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+
+    failures++;
+}
+
+/* round trips through the zstd tool */
+
+static UINT8* zstd_tool(const UINT8* data, size_t len, const char* options, size_t* outlen) {
+    char name[] = "/tmp/zstd_testXXXXXX", cmd[256];
+    UINT8* out = NULL;
+    size_t size = 0, alloc = 0, n;
+    FILE* f;
+    int fd;
+
+    fd = mkstemp(name);
+    if (fd == -1)
+        return NULL;
+
+    if (write(fd, data, len) != (ssize_t)len) {
+        close(fd);
+        unlink(name);
+        return NULL;
+    }
+
+    close(fd);
+
+    snprintf(cmd, sizeof(cmd), "zstd -q -c %s %s", options, name);
+
+    f = popen(cmd, "r");
+    if (f) {
+        do {
+            if (size == alloc) {
+                alloc = alloc ? alloc * 2 : 0x10000;
+                out = realloc(out, alloc);
+            }
+
+            n = fread(out + size, 1, alloc - size, f);
+            size += n;
+        } while (n > 0);
+
+        if (pclose(f) != 0) {
+            free(out);
+            out = NULL;
+        }
+    }
+
+    unlink(name);
+
+    *outlen = size;
+    return out;
+}
+
+static void make_data(UINT8* buf, UINT32 len, int pattern) {
+    static const char* words[] = { "btrfs ", "extent ", "zstd ", "frame ", "block ", "literal ", "sequence ",
+                                   "offset ", "match ", "huffman ", "\n", "ReactOS ", "0123456789 " };
+    UINT32 i, j;
+
+    switch (pattern) {
+        case 0: /* all zero, giving RLE blocks */
+            memset(buf, 0, len);
+            break;
+
+        case 1: /* incompressible, giving raw blocks */
+            for (i = 0; i < len; i++)
+                buf[i] = (UINT8)rand();
+            break;
+
+        case 2: /* text, giving Huffman literals and FSE sequences */
+            for (i = 0; i < len; ) {
+                const char* w = words[rand() % (sizeof(words) / sizeof(words[0]))];
+
+                for (j = 0; w[j] && i < len; j++)
+                    buf[i++] = (UINT8)w[j];
+            }
+            break;
+
+        case 3: /* short repeats with small alphabets, giving repeat offsets */
+            for (i = 0; i < len; i++)
+                buf[i] = (i >= 8 && rand() % 4) ? buf[i - 1 - rand() % 8] : (UINT8)('a' + rand() % 4);
+            break;
+    }
+}
+
+static void check_roundtrip(const UINT8* data, UINT32 len, int pattern, const char* options) {
+    UINT8* frame;
+    UINT8* out;
+    size_t framelen;
+    UINT32 i, outlens[3];
+    NTSTATUS Status;
+
+    frame = zstd_tool(data, len, options, &framelen);
+    if (!frame) {
+        fail("zstd %s: failed to compress %u bytes of pattern %d\n", options, len, pattern);
+        return;
+    }
+
+    outlens[0] = len;       /* whole extent */
+    outlens[1] = len / 3;   /* partial read */
+    outlens[2] = len + 100; /* tail is zeroed */
+
+    out = malloc(len + 101);
+
+    for (i = 0; i < 3; i++) {
+        memset(out, 0xcc, len + 101);
+
+        Status = zstd_decompress(frame, (UINT32)framelen, out, outlens[i]);
+        checked++;
+
+        if (!NT_SUCCESS(Status)) {
+            fail("zstd %s: zstd_decompress returned %08x for %u bytes of pattern %d\n", options, (UINT32)Status, len, pattern);
+        } else if (memcmp(out, data, outlens[i] < len ? outlens[i] : len)) {
+            fail("zstd %s: output mismatch reading %u of %u bytes of pattern %d\n", options, outlens[i], len, pattern);
+        } else if (outlens[i] > len && (out[len] != 0 || memcmp(out + len, out + len + 1, outlens[i] - len - 1))) {
+            fail("zstd %s: tail not zeroed after %u bytes of pattern %d\n", options, len, pattern);
+        } else if (out[outlens[i]] != 0xcc) {
+            fail("zstd %s: wrote past %u of %u bytes of pattern %d\n", options, outlens[i], len, pattern);
+        }
+    }
+
+    free(out);
+    free(frame);
+}
+
+static void test_tool(void) {
+    static const UINT32 lens[] = { 1, 100, 4096, 65536, 131072 };
+    static const char* options[] = { "-1", "-3 --no-check", "-9", "-19 --no-check", "--fast=5" };
+    UINT8* data;
+    unsigned int i, j;
+    int pattern;
+
+    data = malloc(131072);
+
+    for (pattern = 0; pattern < 4; pattern++) {
+        for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+            make_data(data, lens[i], pattern);
+
+            for (j = 0; j < sizeof(options) / sizeof(options[0]); j++) {
+                check_roundtrip(data, lens[i], pattern, options[j]);
+            }
+        }
+    }
+
+    free(data);
+}
+
+/* extents in a btrfs image */
+
+typedef struct {
+    UINT64 address;
+    UINT64 size;
+    UINT64 physical;
+} chunk_map;
+
+typedef struct {
+    UINT64 inode;
+    UINT64 parent;
+    char* name;
+} inode_name;
+
+static FILE* image;
+static superblock sb;
+static chunk_map* chunks;
+static unsigned int num_chunks;
+static inode_name* names;
+static unsigned int num_names;
+static const char* refdir;
+
+static void add_chunk(const KEY* key, const CHUNK_ITEM* ci) {
+    const CHUNK_ITEM_STRIPE* cis = (const CHUNK_ITEM_STRIPE*)&ci[1];
+
+    chunks = realloc(chunks, (num_chunks + 1) * sizeof(chunk_map));
+    chunks[num_chunks].address = key->offset;
+    chunks[num_chunks].size = ci->size;
+    chunks[num_chunks].physical = cis[0].offset;
+    num_chunks++;
+}
+
+static BOOL read_logical(UINT64 address, void* buf, UINT32 len) {
+    unsigned int i;
+
+    for (i = 0; i < num_chunks; i++) {
+        if (address >= chunks[i].address && address + len <= chunks[i].address + chunks[i].size) {
+            if (fseeko(image, (off_t)(chunks[i].physical + address - chunks[i].address), SEEK_SET))
+                return FALSE;
+
+            return fread(buf, 1, len, image) == len;
+        }
+    }
+
+    printf("no chunk for address %llx\n", (unsigned long long)address);
+    return FALSE;
+}
+
+typedef void (*item_callback)(const KEY* key, const UINT8* data, UINT32 size);
+
+static BOOL walk_tree(UINT64 address, item_callback cb) {
+    UINT8* node = malloc(sb.node_size);
+    const tree_header* th = (const tree_header*)node;
+    UINT32 i;
+    BOOL ret = TRUE;
+
+    if (!read_logical(address, node, sb.node_size)) {
+        free(node);
+        return FALSE;
+    }
+
+    if (th->level > 0) {
+        const internal_node* in = (const internal_node*)&th[1];
+
+        for (i = 0; i < th->num_items && ret; i++) {
+            ret = walk_tree(in[i].address, cb);
+        }
+    } else {
+        const leaf_node* ln = (const leaf_node*)&th[1];
+
+        for (i = 0; i < th->num_items; i++) {
+            cb(&ln[i].key, node + sizeof(tree_header) + ln[i].offset, ln[i].size);
+        }
+    }
+
+    free(node);
+
+    return ret;
+}
+
+static void chunk_item_callback(const KEY* key, const UINT8* data, UINT32 size) {
+    if (key->obj_type == TYPE_CHUNK_ITEM && size >= sizeof(CHUNK_ITEM))
+        add_chunk(key, (const CHUNK_ITEM*)data);
+}
+
+static UINT64 fstree_address;
+
+static void root_item_callback(const KEY* key, const UINT8* data, UINT32 size) {
+    if (key->obj_id == BTRFS_ROOT_FSTREE && key->obj_type == TYPE_ROOT_ITEM && size >= offsetof(ROOT_ITEM, flags))
+        fstree_address = ((const ROOT_ITEM*)data)->block_number;
+}
+
+static void inode_ref_callback(const KEY* key, const UINT8* data, UINT32 size) {
+    const INODE_REF* ir = (const INODE_REF*)data;
+
+    if (key->obj_type != TYPE_INODE_REF || key->obj_id == SUBVOL_ROOT_INODE || size < offsetof(INODE_REF, name) + ir->n)
+        return;
+
+    names = realloc(names, (num_names + 1) * sizeof(inode_name));
+    names[num_names].inode = key->obj_id;
+    names[num_names].parent = key->offset;
+    names[num_names].name = strndup(ir->name, ir->n);
+    num_names++;
+}
+
+static BOOL get_path(UINT64 inode, char* path, size_t len) {
+    unsigned int i;
+
+    if (inode == SUBVOL_ROOT_INODE) {
+        snprintf(path, len, "%s", refdir);
+        return TRUE;
+    }
+
+    for (i = 0; i < num_names; i++) {
+        if (names[i].inode == inode) {
+            size_t pos;
+
+            if (!get_path(names[i].parent, path, len))
+                return FALSE;
+
+            pos = strlen(path);
+            snprintf(path + pos, len - pos, "/%s", names[i].name);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void compare_with_file(const KEY* key, const UINT8* data, UINT64 len) {
+    char path[4096];
+    UINT8* ref;
+    FILE* f;
+
+    if (!get_path(key->obj_id, path, sizeof(path))) {
+        fail("inode %llx: no path\n", (unsigned long long)key->obj_id);
+        return;
+    }
+
+    ref = calloc(1, len);
+
+    f = fopen(path, "rb");
+    if (!f) {
+        fail("%s: cannot open\n", path);
+        free(ref);
+        return;
+    }
+
+    if (fseeko(f, (off_t)key->offset, SEEK_SET) == 0)
+        fread(ref, 1, len, f); /* anything past EOF stays zero */
+
+    fclose(f);
+
+    if (memcmp(ref, data, len))
+        fail("%s: extent at %llx differs (%llx bytes)\n", path, (unsigned long long)key->offset, (unsigned long long)len);
+
+    free(ref);
+}
+
+static void extent_data_callback(const KEY* key, const UINT8* data, UINT32 size) {
+    const EXTENT_DATA* ed = (const EXTENT_DATA*)data;
+    UINT8* out;
+    NTSTATUS Status;
+
+    if (key->obj_type != TYPE_EXTENT_DATA || size < offsetof(EXTENT_DATA, data) || ed->compression != BTRFS_COMPRESSION_ZSTD)
+        return;
+
+    out = malloc(ed->decoded_size);
+
+    if (ed->type == EXTENT_TYPE_INLINE) {
+        Status = zstd_decompress((UINT8*)ed->data, size - (UINT32)offsetof(EXTENT_DATA, data), out, (UINT32)ed->decoded_size);
+        checked++;
+
+        if (!NT_SUCCESS(Status))
+            fail("inline extent of inode %llx: zstd_decompress returned %08x\n", (unsigned long long)key->obj_id, (UINT32)Status);
+        else
+            compare_with_file(key, out, ed->decoded_size);
+    } else if (size >= offsetof(EXTENT_DATA, data) + sizeof(EXTENT_DATA2)) {
+        const EXTENT_DATA2* ed2 = (const EXTENT_DATA2*)ed->data;
+        UINT8* comp;
+
+        if (ed2->address == 0) {
+            free(out);
+            return;
+        }
+
+        comp = malloc(ed2->size);
+
+        if (!read_logical(ed2->address, comp, (UINT32)ed2->size)) {
+            fail("extent %llx of inode %llx: read failed\n", (unsigned long long)ed2->address, (unsigned long long)key->obj_id);
+        } else {
+            Status = zstd_decompress(comp, (UINT32)ed2->size, out, (UINT32)ed->decoded_size);
+            checked++;
+
+            if (!NT_SUCCESS(Status)) {
+                fail("extent %llx: zstd_decompress returned %08x\n", (unsigned long long)ed2->address, (UINT32)Status);
+            } else if (ed2->offset + ed2->num_bytes > ed->decoded_size) {
+                fail("extent %llx: bad num_bytes %llx\n", (unsigned long long)ed2->address, (unsigned long long)ed2->num_bytes);
+            } else {
+                compare_with_file(key, out + ed2->offset, ed2->num_bytes);
+            }
+        }
+
+        free(comp);
+    }
+
+    free(out);
+}
+
+static int test_image(const char* filename) {
+    UINT32 pos;
+
+    image = fopen(filename, "rb");
+    if (!image) {
+        printf("cannot open %s\n", filename);
+        return 1;
+    }
+
+    if (fseeko(image, (off_t)superblock_addrs[0], SEEK_SET) || fread(&sb, sizeof(sb), 1, image) != 1 || sb.magic != BTRFS_MAGIC) {
+        printf("%s is not a btrfs image\n", filename);
+        fclose(image);
+        return 1;
+    }
+
+    pos = 0;
+    while (pos + sizeof(KEY) + sizeof(CHUNK_ITEM) <= sb.n) {
+        const KEY* key = (const KEY*)&sb.sys_chunk_array[pos];
+        const CHUNK_ITEM* ci = (const CHUNK_ITEM*)&key[1];
+
+        add_chunk(key, ci);
+        pos += sizeof(KEY) + sizeof(CHUNK_ITEM) + (ci->num_stripes * sizeof(CHUNK_ITEM_STRIPE));
+    }
+
+    if (!walk_tree(sb.chunk_tree_addr, chunk_item_callback) || !walk_tree(sb.root_tree_addr, root_item_callback) || !fstree_address) {
+        printf("could not find the FS tree in %s\n", filename);
+        fclose(image);
+        return 1;
+    }
+
+    walk_tree(fstree_address, inode_ref_callback);
+    walk_tree(fstree_address, extent_data_callback);
+
+    fclose(image);
+
+    if (checked == 0) {
+        printf("%s has no zstd extents\n", filename);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    int ret;
+
+    verbose = getenv("ZSTD_TEST_VERBOSE") != NULL;
+
+    if (argc == 3) {
+        refdir = argv[2];
+        ret = test_image(argv[1]);
+    } else if (argc == 1) {
+        srand(0x28b52ffd);
+        test_tool();
+        ret = 0;
+    } else {
+        printf("usage: %s [image refdir]\n", argv[0]);
+        return 1;
+    }
+
+    printf("zstd: %u decompressions, %u failures\n", checked, failures);
+
+    return (ret || failures) ? 1 : 0;
+}
@@ -0,0 +1,946 @@
+/* Copyright (c) Mark Harmstone 2016-17
+ *
+ * This file is part of WinBtrfs.
+ *
+ * WinBtrfs is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public Licence as published by
+ * the Free Software Foundation, either version 3 of the Licence, or
+ * (at your option) any later version.
+ *
+ * WinBtrfs is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public Licence for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public Licence
+ * along with WinBtrfs.  If not, see <http://www.gnu.org/licenses/>. */
+
+// This Zstandard decoder was written from the format description in RFC 8878.
+// Only decompression is supported, which is all that's needed to read extents
+// written by Linux.
+
+#include "btrfs_drv.h"
+
+#define ZSTD_MAGIC              0xfd2fb528
+
+#define ZSTD_BLOCK_RAW          0
+#define ZSTD_BLOCK_RLE          1
+#define ZSTD_BLOCK_COMPRESSED   2
+
+#define ZSTD_LIT_RAW            0
+#define ZSTD_LIT_RLE            1
+#define ZSTD_LIT_COMPRESSED     2
+#define ZSTD_LIT_TREELESS       3
+
+#define ZSTD_SEQ_PREDEFINED     0
+#define ZSTD_SEQ_RLE            1
+#define ZSTD_SEQ_FSE            2
+#define ZSTD_SEQ_REPEAT         3
+
+#define ZSTD_BLOCK_SIZE_MAX     0x20000
+
+#define ZSTD_LL_LOG_MAX         9
+#define ZSTD_ML_LOG_MAX         9
+#define ZSTD_OF_LOG_MAX         8
+#define ZSTD_HUF_LOG_MAX        11
+#define ZSTD_HUF_WEIGHT_LOG_MAX 6
+
+#define ZSTD_LL_MAX             35
+#define ZSTD_ML_MAX             52
+#define ZSTD_OF_MAX             31
+
+typedef struct {
+    const UINT8* data;
+    INT32 bitpos;
+} zstd_bitstream;
+
+typedef struct {
+    UINT16 base;
+    UINT8 symbol;
+    UINT8 nbbits;
+} zstd_fse_entry;
+
+typedef struct {
+    UINT8 symbol;
+    UINT8 nbbits;
+} zstd_huf_entry;
+
+typedef struct {
+    UINT8* out;
+    UINT32 outlen;
+    UINT32 outpos;
+
+    zstd_fse_entry ll_table[1 << ZSTD_LL_LOG_MAX];
+    zstd_fse_entry ml_table[1 << ZSTD_ML_LOG_MAX];
+    zstd_fse_entry of_table[1 << ZSTD_OF_LOG_MAX];
+    UINT32 ll_log, ml_log, of_log;
+    BOOL seq_tables_valid;
+
+    zstd_huf_entry huf_table[1 << ZSTD_HUF_LOG_MAX];
+    UINT32 huf_log;
+    BOOL huf_valid;
+
+    UINT32 rep[3];
+
+    UINT8 literals[ZSTD_BLOCK_SIZE_MAX];
+} zstd_context;
+
+static const INT16 zstd_ll_default[ZSTD_LL_MAX + 1] = {
+    4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+    -1, -1, -1, -1
+};
+
+static const INT16 zstd_ml_default[ZSTD_ML_MAX + 1] = {
+    1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1,
+    -1, -1, -1, -1, -1
+};
+
+static const INT16 zstd_of_default[29] = {
+    1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1
+};
+
+static const UINT32 zstd_ll_base[ZSTD_LL_MAX + 1] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024, 2048, 4096,
+    8192, 16384, 32768, 65536
+};
+
+static const UINT8 zstd_ll_bits[ZSTD_LL_MAX + 1] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12,
+    13, 14, 15, 16
+};
+
+static const UINT32 zstd_ml_base[ZSTD_ML_MAX + 1] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+    19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+    35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027, 2051,
+    4099, 8195, 16387, 32771, 65539
+};
+
+static const UINT8 zstd_ml_bits[ZSTD_ML_MAX + 1] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11,
+    12, 13, 14, 15, 16
+};
+
+static __inline UINT32 zstd_highbit(UINT32 v) {
+    UINT32 n = 0;
+
+    while (v >>= 1) {
+        n++;
+    }
+
+    return n;
+}
+
+// Zstandard's entropy-coded streams are read backwards, starting from the highest set bit of
+// the last byte. Bits "before" the start of the stream read as zero.
+
+static BOOL zstd_init_bitstream(zstd_bitstream* bs, const UINT8* data, UINT32 len) {
+    if (len == 0 || data[len - 1] == 0)
+        return FALSE;
+
+    bs->data = data;
+    bs->bitpos = ((len - 1) * 8) + zstd_highbit(data[len - 1]);
+
+    return TRUE;
+}
+
+static __inline UINT32 zstd_peek_bits(const zstd_bitstream* bs, UINT32 n) {
+    INT32 start = bs->bitpos - (INT32)n, lo, i;
+    UINT64 v = 0;
+
+    if (n == 0 || bs->bitpos <= 0)
+        return 0;
+
+    lo = start < 0 ? 0 : start;
+
+    for (i = (bs->bitpos - 1) >> 3; i >= (lo >> 3); i--) {
+        v = (v << 8) | bs->data[i];
+    }
+
+    v >>= lo & 7;
+    v &= ((UINT64)1 << (bs->bitpos - lo)) - 1;
+
+    return (UINT32)(v << (lo - start));
+}
+
+static __inline UINT32 zstd_read_bits(zstd_bitstream* bs, UINT32 n) {
+    UINT32 v = zstd_peek_bits(bs, n);
+
+    bs->bitpos -= n;
+
+    return v;
+}
+
+static NTSTATUS zstd_read_ncount(const UINT8* in, UINT32 inlen, INT16* norm, UINT32 maxsym, UINT32 maxlog, UINT32* log, UINT32* size) {
+    UINT32 bitpos = 0, symbol = 0, threshold, nbbits;
+    INT32 remaining;
+    BOOL previous0 = FALSE;
+
+    RtlZeroMemory(norm, (maxsym + 1) * sizeof(INT16));
+
+    if (inlen == 0)
+        return STATUS_INTERNAL_ERROR;
+
+    *log = (in[0] & 0xf) + 5;
+    if (*log > maxlog)
+        return STATUS_INTERNAL_ERROR;
+
+    bitpos = 4;
+    remaining = (1 << *log) + 1;
+    threshold = 1 << *log;
+    nbbits = *log + 1;
+
+    while (remaining > 1) {
+        UINT32 bits = 0, i, max;
+        INT32 count;
+
+        if (previous0) {
+            UINT32 repeat;
+
+            do {
+                if ((bitpos + 2) > inlen * 8)
+                    return STATUS_INTERNAL_ERROR;
+
+                repeat = in[bitpos >> 3] >> (bitpos & 7);
+
+                if ((bitpos & 7) == 7 && (bitpos >> 3) + 1 < inlen)
+                    repeat |= in[(bitpos >> 3) + 1] << 1;
+
+                repeat &= 3;
+                bitpos += 2;
+                symbol += repeat;
+            } while (repeat == 3);
+
+            if (symbol > maxsym)
+                return STATUS_INTERNAL_ERROR;
+        }
+
+        for (i = 0; i < 4; i++) {
+            if ((bitpos >> 3) + i < inlen)
+                bits |= (UINT32)in[(bitpos >> 3) + i] << (i * 8);
+        }
+
+        bits >>= bitpos & 7;
+
+        max = (2 * threshold) - 1 - remaining;
+
+        if ((bits & (threshold - 1)) < max) {
+            count = bits & (threshold - 1);
+            bitpos += nbbits - 1;
+        } else {
+            count = bits & ((2 * threshold) - 1);
+            if ((UINT32)count >= threshold)
+                count -= max;
+            bitpos += nbbits;
+        }
+
+        count--;
+        remaining -= count < 0 ? -count : count;
+
+        if (symbol > maxsym || remaining < 1)
+            return STATUS_INTERNAL_ERROR;
+
+        norm[symbol++] = (INT16)count;
+        previous0 = count == 0;
+
+        while ((UINT32)remaining < threshold) {
+            nbbits--;
+            threshold >>= 1;
+        }
+    }
+
+    *size = (bitpos + 7) >> 3;
+
+    if (remaining != 1 || *size > inlen)
+        return STATUS_INTERNAL_ERROR;
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS zstd_build_fse_table(zstd_fse_entry* table, const INT16* norm, UINT32 maxsym, UINT32 log) {
+    UINT32 size = 1 << log, high = size - 1, step, mask = size - 1, pos = 0, s, i;
+    UINT16 next[ZSTD_ML_MAX + 1];
+
+    for (s = 0; s <= maxsym; s++) {
+        if (norm[s] == -1) {
+            table[high--].symbol = (UINT8)s;
+            next[s] = 1;
+        } else
+            next[s] = (UINT16)norm[s];
+    }
+
+    step = (size >> 1) + (size >> 3) + 3;
+
+    for (s = 0; s <= maxsym; s++) {
+        INT32 j;
+
+        for (j = 0; j < norm[s]; j++) {
+            table[pos].symbol = (UINT8)s;
+
+            do {
+                pos = (pos + step) & mask;
+            } while (pos > high);
+        }
+    }
+
+    if (pos != 0)
+        return STATUS_INTERNAL_ERROR;
+
+    for (i = 0; i < size; i++) {
+        UINT32 n = next[table[i].symbol]++;
+
+        table[i].nbbits = (UINT8)(log - zstd_highbit(n));
+        table[i].base = (UINT16)((n << table[i].nbbits) - size);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static __inline UINT8 zstd_fse_decode(const zstd_fse_entry* table, UINT32* state, zstd_bitstream* bs) {
+    const zstd_fse_entry* e = &table[*state];
+
+    *state = e->base + zstd_read_bits(bs, e->nbbits);
+
+    return e->symbol;
+}
+
+static NTSTATUS zstd_read_huf_table(zstd_context* ctx, const UINT8* in, UINT32 inlen, UINT32* size) {
+    UINT8 weights[256];
+    UINT32 num, i, sum, maxbits, left, rank[ZSTD_HUF_LOG_MAX + 2];
+    NTSTATUS Status;
+
+    if (inlen == 0)
+        return STATUS_INTERNAL_ERROR;
+
+    if (in[0] >= 128) { // weights stored directly as 4-bit values
+        num = in[0] - 127;
+        *size = 1 + ((num + 1) / 2);
+
+        if (*size > inlen)
+            return STATUS_INTERNAL_ERROR;
+
+        for (i = 0; i < num; i++) {
+            weights[i] = (i & 1) ? (in[1 + (i / 2)] & 0xf) : (in[1 + (i / 2)] >> 4);
+        }
+    } else { // weights FSE-compressed, with two interleaved states
+        zstd_fse_entry table[1 << ZSTD_HUF_WEIGHT_LOG_MAX];
+        INT16 norm[16];
+        UINT32 log, hdrsize, state1, state2;
+        zstd_bitstream bs;
+
+        *size = 1 + in[0];
+
+        if (*size > inlen)
+            return STATUS_INTERNAL_ERROR;
+
+        Status = zstd_read_ncount(&in[1], in[0], norm, 15, ZSTD_HUF_WEIGHT_LOG_MAX, &log, &hdrsize);
+        if (!NT_SUCCESS(Status))
+            return Status;
+
+        Status = zstd_build_fse_table(table, norm, 15, log);
+        if (!NT_SUCCESS(Status))
+            return Status;
+
+        if (!zstd_init_bitstream(&bs, &in[1 + hdrsize], in[0] - hdrsize))
+            return STATUS_INTERNAL_ERROR;
+
+        state1 = zstd_read_bits(&bs, log);
+        state2 = zstd_read_bits(&bs, log);
+        num = 0;
+
+        while (TRUE) {
+            if (num > 253)
+                return STATUS_INTERNAL_ERROR;
+
+            weights[num++] = zstd_fse_decode(table, &state1, &bs);
+
+            if (bs.bitpos < 0) {
+                weights[num++] = table[state2].symbol;
+                break;
+            }
+
+            weights[num++] = zstd_fse_decode(table, &state2, &bs);
+
+            if (bs.bitpos < 0) {
+                weights[num++] = table[state1].symbol;
+                break;
+            }
+        }
+    }
+
+    sum = 0;
+    for (i = 0; i < num; i++) {
+        if (weights[i] > ZSTD_HUF_LOG_MAX)
+            return STATUS_INTERNAL_ERROR;
+
+        if (weights[i] > 0)
+            sum += 1 << (weights[i] - 1);
+    }
+
+    if (sum == 0)
+        return STATUS_INTERNAL_ERROR;
+
+    // the weight of the last symbol is implied, by rounding the total up to a power of two
+
+    maxbits = zstd_highbit(sum) + 1;
+    left = (1 << maxbits) - sum;
+
+    if (maxbits > ZSTD_HUF_LOG_MAX || (left & (left - 1)))
+        return STATUS_INTERNAL_ERROR;
+
+    weights[num++] = (UINT8)(zstd_highbit(left) + 1);
+
+    RtlZeroMemory(rank, sizeof(rank));
+
+    for (i = 0; i < num; i++) {
+        rank[weights[i]]++;
+    }
+
+    sum = 0;
+    for (i = 1; i <= maxbits; i++) {
+        UINT32 start = sum;
+
+        sum += rank[i] << (i - 1);
+        rank[i] = start;
+    }
+
+    for (i = 0; i < num; i++) {
+        UINT32 len, j;
+
+        if (weights[i] == 0)
+            continue;
+
+        len = 1 << (weights[i] - 1);
+
+        for (j = rank[weights[i]]; j < rank[weights[i]] + len; j++) {
+            ctx->huf_table[j].symbol = (UINT8)i;
+            ctx->huf_table[j].nbbits = (UINT8)(maxbits + 1 - weights[i]);
+        }
+
+        rank[weights[i]] += len;
+    }
+
+    ctx->huf_log = maxbits;
+    ctx->huf_valid = TRUE;
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS zstd_huf_decode_stream(zstd_context* ctx, const UINT8* in, UINT32 inlen, UINT8* out, UINT32 outlen) {
+    zstd_bitstream bs;
+    UINT32 i;
+
+    if (!zstd_init_bitstream(&bs, in, inlen))
+        return STATUS_INTERNAL_ERROR;
+
+    for (i = 0; i < outlen; i++) {
+        const zstd_huf_entry* e = &ctx->huf_table[zstd_peek_bits(&bs, ctx->huf_log)];
+
+        out[i] = e->symbol;
+        bs.bitpos -= e->nbbits;
+    }
+
+    if (bs.bitpos != 0)
+        return STATUS_INTERNAL_ERROR;
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS zstd_decode_literals(zstd_context* ctx, const UINT8* in, UINT32 inlen, UINT32* litlen, UINT32* size) {
+    UINT8 type, sizeformat;
+    UINT32 regen, comp, hdrsize;
+    NTSTATUS Status;
+
+    if (inlen == 0)
+        return STATUS_INTERNAL_ERROR;
+
+    type = in[0] & 3;
+    sizeformat = (in[0] >> 2) & 3;
+
+    if (type == ZSTD_LIT_RAW || type == ZSTD_LIT_RLE) {
+        if (sizeformat == 0 || sizeformat == 2) {
+            hdrsize = 1;
+            regen = in[0] >> 3;
+        } else if (sizeformat == 1) {
+            hdrsize = 2;
+            if (inlen < hdrsize)
+                return STATUS_INTERNAL_ERROR;
+
+            regen = (in[0] >> 4) | (in[1] << 4);
+        } else {
+            hdrsize = 3;
+            if (inlen < hdrsize)
+                return STATUS_INTERNAL_ERROR;
+
+            regen = (in[0] >> 4) | (in[1] << 4) | (in[2] << 12);
+        }
+
+        if (regen > ZSTD_BLOCK_SIZE_MAX)
+            return STATUS_INTERNAL_ERROR;
+
+        if (type == ZSTD_LIT_RAW) {
+            if (hdrsize + regen > inlen)
+                return STATUS_INTERNAL_ERROR;
+
+            RtlCopyMemory(ctx->literals, &in[hdrsize], regen);
+            *size = hdrsize + regen;
+        } else {
+            if (hdrsize + 1 > inlen)
+                return STATUS_INTERNAL_ERROR;
+
+            RtlFillMemory(ctx->literals, regen, in[hdrsize]);
+            *size = hdrsize + 1;
+        }
+
+        *litlen = regen;
+
+        return STATUS_SUCCESS;
+    }
+
+    hdrsize = sizeformat < 2 ? 3 : sizeformat + 2;
+    if (inlen < hdrsize)
+        return STATUS_INTERNAL_ERROR;
+
+    if (sizeformat < 2) {
+        UINT32 h = in[0] | (in[1] << 8) | (in[2] << 16);
+
+        regen = (h >> 4) & 0x3ff;
+        comp = h >> 14;
+    } else if (sizeformat == 2) {
+        UINT32 h = in[0] | (in[1] << 8) | (in[2] << 16) | ((UINT32)in[3] << 24);
+
+        regen = (h >> 4) & 0x3fff;
+        comp = h >> 18;
+    } else {
+        UINT32 h = in[0] | (in[1] << 8) | (in[2] << 16) | ((UINT32)in[3] << 24);
+
+        regen = (h >> 4) & 0x3ffff;
+        comp = (h >> 22) | (in[4] << 10);
+    }
+
+    if (regen > ZSTD_BLOCK_SIZE_MAX || hdrsize + comp > inlen)
+        return STATUS_INTERNAL_ERROR;
+
+    in += hdrsize;
+    *size = hdrsize + comp;
+    *litlen = regen;
+
+    if (type == ZSTD_LIT_COMPRESSED) {
+        UINT32 tablesize;
+
+        Status = zstd_read_huf_table(ctx, in, comp, &tablesize);
+        if (!NT_SUCCESS(Status))
+            return Status;
+
+        in += tablesize;
+        comp -= tablesize;
+    } else if (!ctx->huf_valid)
+        return STATUS_INTERNAL_ERROR;
+
+    if (sizeformat == 0) // single stream
+        return zstd_huf_decode_stream(ctx, in, comp, ctx->literals, regen);
+    else { // four streams, preceded by a jump table
+        UINT32 len[4], outsize = (regen + 3) / 4, i;
+
+        if (comp < 6)
+            return STATUS_INTERNAL_ERROR;
+
+        len[0] = in[0] | (in[1] << 8);
+        len[1] = in[2] | (in[3] << 8);
+        len[2] = in[4] | (in[5] << 8);
+
+        if (len[0] + len[1] + len[2] + 6 > comp || outsize * 3 > regen)
+            return STATUS_INTERNAL_ERROR;
+
+        len[3] = comp - 6 - len[0] - len[1] - len[2];
+        in += 6;
+
+        for (i = 0; i < 4; i++) {
+            Status = zstd_huf_decode_stream(ctx, in, len[i], &ctx->literals[i * outsize], i == 3 ? (regen - (3 * outsize)) : outsize);
+            if (!NT_SUCCESS(Status))
+                return Status;
+
+            in += len[i];
+        }
+
+        return STATUS_SUCCESS;
+    }
+}
+
+static NTSTATUS zstd_load_seq_table(zstd_fse_entry* table, UINT32* log, UINT8 mode, const INT16* def, UINT32 deflog, UINT32 maxsym,
+                                    UINT32 maxlog, const UINT8* in, UINT32 inlen, UINT32* size) {
+    INT16 norm[ZSTD_ML_MAX + 1];
+    NTSTATUS Status;
+
+    switch (mode) {
+        case ZSTD_SEQ_PREDEFINED:
+            *size = 0;
+            *log = deflog;
+            return zstd_build_fse_table(table, def, maxsym, deflog);
+
+        case ZSTD_SEQ_RLE:
+            if (inlen < 1 || in[0] > maxsym)
+                return STATUS_INTERNAL_ERROR;
+
+            table[0].symbol = in[0];
+            table[0].nbbits = 0;
+            table[0].base = 0;
+            *size = 1;
+            *log = 0;
+            return STATUS_SUCCESS;
+
+        case ZSTD_SEQ_FSE:
+            Status = zstd_read_ncount(in, inlen, norm, maxsym, maxlog, log, size);
+            if (!NT_SUCCESS(Status))
+                return Status;
+
+            return zstd_build_fse_table(table, norm, maxsym, *log);
+
+        default:
+            *size = 0;
+            return STATUS_SUCCESS;
+    }
+}
+
+static BOOL zstd_copy_literals(zstd_context* ctx, const UINT8* lit, UINT32 len) {
+    if (ctx->outpos + len >= ctx->outlen) {
+        RtlCopyMemory(&ctx->out[ctx->outpos], lit, ctx->outlen - ctx->outpos);
+        ctx->outpos = ctx->outlen;
+        return TRUE;
+    }
+
+    RtlCopyMemory(&ctx->out[ctx->outpos], lit, len);
+    ctx->outpos += len;
+
+    return FALSE;
+}
+
+static NTSTATUS zstd_decompress_block(zstd_context* ctx, const UINT8* in, UINT32 inlen, BOOL* done) {
+    NTSTATUS Status;
+    UINT32 litlen, litpos, size, nbseq, i, ll_state, ml_state, of_state;
+    UINT8 modes;
+    zstd_bitstream bs;
+
+    Status = zstd_decode_literals(ctx, in, inlen, &litlen, &size);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    in += size;
+    inlen -= size;
+
+    if (inlen < 1)
+        return STATUS_INTERNAL_ERROR;
+
+    if (in[0] < 128) {
+        nbseq = in[0];
+        size = 1;
+    } else if (in[0] < 255) {
+        if (inlen < 2)
+            return STATUS_INTERNAL_ERROR;
+
+        nbseq = ((in[0] - 128) << 8) | in[1];
+        size = 2;
+    } else {
+        if (inlen < 3)
+            return STATUS_INTERNAL_ERROR;
+
+        nbseq = in[1] + (in[2] << 8) + 0x7f00;
+        size = 3;
+    }
+
+    in += size;
+    inlen -= size;
+
+    if (nbseq == 0) {
+        *done = zstd_copy_literals(ctx, ctx->literals, litlen);
+        return STATUS_SUCCESS;
+    }
+
+    if (inlen < 1)
+        return STATUS_INTERNAL_ERROR;
+
+    modes = in[0];
+    in++;
+    inlen--;
+
+    if (modes & 3)
+        return STATUS_INTERNAL_ERROR;
+
+    if (!ctx->seq_tables_valid && ((modes >> 6) == ZSTD_SEQ_REPEAT || ((modes >> 4) & 3) == ZSTD_SEQ_REPEAT || ((modes >> 2) & 3) == ZSTD_SEQ_REPEAT))
+        return STATUS_INTERNAL_ERROR;
+
+    Status = zstd_load_seq_table(ctx->ll_table, &ctx->ll_log, modes >> 6, zstd_ll_default, 6, ZSTD_LL_MAX, ZSTD_LL_LOG_MAX, in, inlen, &size);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    in += size;
+    inlen -= size;
+
+    Status = zstd_load_seq_table(ctx->of_table, &ctx->of_log, (modes >> 4) & 3, zstd_of_default, 5,
+                                 (modes >> 4) & 3 ? ZSTD_OF_MAX : 28, ZSTD_OF_LOG_MAX, in, inlen, &size);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    in += size;
+    inlen -= size;
+
+    Status = zstd_load_seq_table(ctx->ml_table, &ctx->ml_log, (modes >> 2) & 3, zstd_ml_default, 6, ZSTD_ML_MAX, ZSTD_ML_LOG_MAX, in, inlen, &size);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    in += size;
+    inlen -= size;
+
+    ctx->seq_tables_valid = TRUE;
+
+    if (!zstd_init_bitstream(&bs, in, inlen))
+        return STATUS_INTERNAL_ERROR;
+
+    ll_state = zstd_read_bits(&bs, ctx->ll_log);
+    of_state = zstd_read_bits(&bs, ctx->of_log);
+    ml_state = zstd_read_bits(&bs, ctx->ml_log);
+
+    litpos = 0;
+
+    for (i = 0; i < nbseq; i++) {
+        UINT8 llcode = ctx->ll_table[ll_state].symbol;
+        UINT8 mlcode = ctx->ml_table[ml_state].symbol;
+        UINT8 ofcode = ctx->of_table[of_state].symbol;
+        UINT32 ll, ml, offset;
+
+        if (ofcode > ZSTD_OF_MAX)
+            return STATUS_INTERNAL_ERROR;
+
+        offset = (1u << ofcode) + zstd_read_bits(&bs, ofcode);
+        ml = zstd_ml_base[mlcode] + zstd_read_bits(&bs, zstd_ml_bits[mlcode]);
+        ll = zstd_ll_base[llcode] + zstd_read_bits(&bs, zstd_ll_bits[llcode]);
+
+        if (offset > 3) {
+            ctx->rep[2] = ctx->rep[1];
+            ctx->rep[1] = ctx->rep[0];
+            ctx->rep[0] = offset - 3;
+        } else {
+            UINT32 idx = offset - (ll == 0 ? 0 : 1);
+
+            if (idx == 3) {
+                offset = ctx->rep[0] - 1;
+
+                if (offset == 0)
+                    return STATUS_INTERNAL_ERROR;
+
+                ctx->rep[2] = ctx->rep[1];
+                ctx->rep[1] = ctx->rep[0];
+                ctx->rep[0] = offset;
+            } else if (idx > 0) {
+                offset = ctx->rep[idx];
+
+                if (idx == 2)
+                    ctx->rep[2] = ctx->rep[1];
+
+                ctx->rep[1] = ctx->rep[0];
+                ctx->rep[0] = offset;
+            }
+        }
+
+        offset = ctx->rep[0];
+
+        if (i + 1 < nbseq) {
+            zstd_fse_decode(ctx->ll_table, &ll_state, &bs);
+            zstd_fse_decode(ctx->ml_table, &ml_state, &bs);
+            zstd_fse_decode(ctx->of_table, &of_state, &bs);
+        }
+
+        if (bs.bitpos < 0 || ll > litlen - litpos)
+            return STATUS_INTERNAL_ERROR;
+
+        if (zstd_copy_literals(ctx, &ctx->literals[litpos], ll)) {
+            *done = TRUE;
+            return STATUS_SUCCESS;
+        }
+
+        litpos += ll;
+
+        if (offset > ctx->outpos) {
+            ERR("offset %x goes back before start of frame\n", offset);
+            return STATUS_INTERNAL_ERROR;
+        }
+
+        if (ml >= ctx->outlen - ctx->outpos) {
+            ml = ctx->outlen - ctx->outpos;
+            *done = TRUE;
+        }
+
+        if (offset >= ml)
+            RtlCopyMemory(&ctx->out[ctx->outpos], &ctx->out[ctx->outpos - offset], ml);
+        else {
+            UINT8* dest = &ctx->out[ctx->outpos];
+            UINT8* src = dest - offset;
+            UINT32 j;
+
+            for (j = 0; j < ml; j++) {
+                dest[j] = src[j];
+            }
+        }
+
+        ctx->outpos += ml;
+
+        if (*done)
+            return STATUS_SUCCESS;
+    }
+
+    if (bs.bitpos != 0)
+        return STATUS_INTERNAL_ERROR;
+
+    *done = zstd_copy_literals(ctx, &ctx->literals[litpos], litlen - litpos);
+
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS zstd_decompress_frame(zstd_context* ctx, const UINT8* in, UINT32 inlen) {
+    NTSTATUS Status;
+    UINT8 fhd, fcsflag, dictflag;
+    UINT32 off;
+    BOOL done = FALSE;
+    static const UINT8 dict_sizes[] = { 0, 1, 2, 4 };
+    static const UINT8 fcs_sizes[] = { 0, 2, 4, 8 };
+
+    if (inlen < 5 || *(UINT32*)in != ZSTD_MAGIC) {
+        ERR("zstd frame magic not found\n");
+        return STATUS_INTERNAL_ERROR;
+    }
+
+    fhd = in[4];
+    fcsflag = fhd >> 6;
+    dictflag = fhd & 3;
+
+    if (fhd & 0x8) {
+        ERR("reserved bit set in zstd frame header\n");
+        return STATUS_INTERNAL_ERROR;
+    }
+
+    off = 5;
+
+    if (!(fhd & 0x20)) // not single segment, so window descriptor present
+        off++;
+
+    if (off + dict_sizes[dictflag] > inlen)
+        return STATUS_INTERNAL_ERROR;
+
+    if (dictflag != 0) {
+        UINT32 dictid = 0, i;
+
+        for (i = 0; i < dict_sizes[dictflag]; i++) {
+            dictid |= (UINT32)in[off + i] << (i * 8);
+        }
+
+        if (dictid != 0) {
+            ERR("zstd dictionaries not supported\n");
+            return STATUS_NOT_SUPPORTED;
+        }
+
+        off += dict_sizes[dictflag];
+    }
+
+    if (fcsflag == 0 && fhd & 0x20)
+        off++;
+    else
+        off += fcs_sizes[fcsflag];
+
+    ctx->rep[0] = 1;
+    ctx->rep[1] = 4;
+    ctx->rep[2] = 8;
+    ctx->huf_valid = FALSE;
+    ctx->seq_tables_valid = FALSE;
+
+    while (!done) {
+        UINT32 hdr, size;
+        UINT8 type;
+        BOOL last;
+
+        if (off + 3 > inlen) {
+            ERR("zstd frame truncated\n");
+            return STATUS_INTERNAL_ERROR;
+        }
+
+        hdr = in[off] | (in[off + 1] << 8) | (in[off + 2] << 16);
+        off += 3;
+
+        last = hdr & 1;
+        type = (hdr >> 1) & 3;
+        size = hdr >> 3;
+
+        if (size > ZSTD_BLOCK_SIZE_MAX || off + (type == ZSTD_BLOCK_RLE ? 1 : size) > inlen) {
+            ERR("invalid zstd block size %x\n", size);
+            return STATUS_INTERNAL_ERROR;
+        }
+
+        switch (type) {
+            case ZSTD_BLOCK_RAW:
+                done = zstd_copy_literals(ctx, &in[off], size);
+                off += size;
+                break;
+
+            case ZSTD_BLOCK_RLE:
+                if (ctx->outpos + size >= ctx->outlen) {
+                    size = ctx->outlen - ctx->outpos;
+                    done = TRUE;
+                }
+
+                RtlFillMemory(&ctx->out[ctx->outpos], size, in[off]);
+                ctx->outpos += size;
+                off++;
+                break;
+
+            case ZSTD_BLOCK_COMPRESSED:
+                Status = zstd_decompress_block(ctx, &in[off], size, &done);
+                if (!NT_SUCCESS(Status)) {
+                    ERR("zstd_decompress_block returned %08x\n", Status);
+                    return Status;
+                }
+
+                off += size;
+                break;
+
+            default:
+                ERR("reserved zstd block type\n");
+                return STATUS_INTERNAL_ERROR;
+        }
+
+        if (last)
+            break;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS zstd_decompress(UINT8* inbuf, UINT32 inlen, UINT8* outbuf, UINT32 outlen) {
+    NTSTATUS Status;
+    zstd_context* ctx;
+
+    ctx = ExAllocatePoolWithTag(PagedPool, sizeof(zstd_context), ALLOC_TAG);
+    if (!ctx) {
+        ERR("out of memory\n");
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    ctx->out = outbuf;
+    ctx->outlen = outlen;
+    ctx->outpos = 0;
+
+    Status = zstd_decompress_frame(ctx, inbuf, inlen);
+
+    if (NT_SUCCESS(Status) && ctx->outpos < outlen)
+        RtlZeroMemory(&outbuf[ctx->outpos], outlen - ctx->outpos);
+
+    ExFreePool(ctx);
+
+    return Status;
+}
@@ -632,10 +632,14 @@ AddRun(PNTFS_VCB Vcb,
     _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER) 
     {
         DPRINT1("Failed to add LargeMcb Entry!\n");
+        NtfsInvalidateRunCache(AttrContext);
         _SEH2_YIELD(return _SEH2_GetExceptionCode());
     }
     _SEH2_END;
 
+    // Only now, so that runs decoded from the old mcb in the meantime are dropped too
+    NtfsInvalidateRunCache(AttrContext);
+
     RunBuffer = ExAllocatePoolWithTag(NonPagedPool, Vcb->NtfsInfo.BytesPerFileRecord, TAG_NTFS);
     if (!RunBuffer)
     {
@@ -1142,6 +1146,7 @@ FreeClusters(PNTFS_VCB Vcb,
             RtlClearBits(&Bitmap, LargeLbn, 1);
         }
         FsRtlTruncateLargeMcb(&AttrContext->DataRunsMCB, AttrContext->pRecord->NonResident.HighestVCN);
+        NtfsInvalidateRunCache(AttrContext);
 
         // decrement HighestVCN, but don't let it go below 0
         AttrContext->pRecord->NonResident.HighestVCN = min(AttrContext->pRecord->NonResident.HighestVCN, AttrContext->pRecord->NonResident.HighestVCN - 1);
@@ -356,6 +356,11 @@ NtfsCreateFile(PDEVICE_OBJECT DeviceObject,
     }
 
     /* Deny create if the volume is locked */
+    if (DeviceExt->Flags & VCB_DISMOUNT_PENDING)
+    {
+        return STATUS_VOLUME_DISMOUNTED;
+    }
+
     if (DeviceExt->Flags & VCB_VOLUME_LOCKED)
     {
         return STATUS_ACCESS_DENIED;
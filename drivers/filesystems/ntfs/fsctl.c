@@ -461,6 +461,8 @@ NtfsMountVolume(PDEVICE_OBJECT DeviceObject,
     Vcb->Identifier.Type = NTFS_TYPE_VCB;
     Vcb->Identifier.Size = sizeof(NTFS_TYPE_VCB);
 
+    ExInitializeFastMutex(&Vcb->FileRecCacheLock);
+
     Status = NtfsGetVolumeData(DeviceToMount,
                                Vcb);
     if (!NT_SUCCESS(Status))
@@ -564,6 +566,9 @@ ByeBye:
         if (Ccb)
             ExFreePool(Ccb);
 
+        if (Vcb)
+            NtfsPurgeFileRecordCache(Vcb);
+
         if (NewDeviceObject)
             IoDeleteDevice(NewDeviceObject);
 
@@ -895,6 +900,45 @@ LockOrUnlockVolume(PDEVICE_EXTENSION DeviceExt,
 }
 
 
+static
+NTSTATUS
+NtfsDismountVolume(PDEVICE_EXTENSION DeviceExt,
+                   PIRP Irp)
+{
+    PIO_STACK_LOCATION Stack;
+
+    DPRINT("NtfsDismountVolume(%p, %p)\n", DeviceExt, Irp);
+
+    Stack = IoGetCurrentIrpStackLocation(Irp);
+
+    /* Like fastfat, only dismount a locked volume */
+    if (!(DeviceExt->Flags & VCB_VOLUME_LOCKED))
+    {
+        return STATUS_ACCESS_DENIED;
+    }
+
+    if (DeviceExt->Flags & VCB_DISMOUNT_PENDING)
+    {
+        return STATUS_VOLUME_DISMOUNTED;
+    }
+
+    FsRtlNotifyVolumeEvent(Stack->FileObject, FSRTL_VOLUME_DISMOUNT);
+
+    ExAcquireResourceExclusiveLite(&DeviceExt->DirResource, TRUE);
+
+    /* The next open mounts the volume again, with a fresh VCB */
+    DeviceExt->Flags |= VCB_DISMOUNT_PENDING;
+    DeviceExt->StorageDevice->Vpb->Flags &= ~VPB_MOUNTED;
+
+    /* The disk may change once dismounted, don't keep anything read from it */
+    NtfsPurgeFileRecordCache(DeviceExt);
+
+    ExReleaseResourceLite(&DeviceExt->DirResource);
+
+    return STATUS_SUCCESS;
+}
+
+
 static
 NTSTATUS
 NtfsUserFsRequest(PDEVICE_OBJECT DeviceObject,
@@ -937,6 +981,10 @@ NtfsUserFsRequest(PDEVICE_OBJECT DeviceObject,
             Status = LockOrUnlockVolume(DeviceExt, Irp, FALSE);
             break;
 
+        case FSCTL_DISMOUNT_VOLUME:
+            Status = NtfsDismountVolume(DeviceExt, Irp);
+            break;
+
         case FSCTL_GET_NTFS_VOLUME_DATA:
             Status = GetNfsVolumeData(DeviceExt, Irp);
             break;
@@ -49,6 +49,11 @@ PrepareAttributeContext(PNTFS_ATTR_RECORD AttrRecord)
         return NULL;
     }
 
+    KeInitializeSpinLock(&Context->RunCacheLock);
+    Context->RunCache = NULL;
+    Context->RunCacheGeneration = 0;
+    Context->RunHint = 0;
+
     // Allocate memory for a copy of the attribute
     Context->pRecord = ExAllocatePoolWithTag(NonPagedPool, AttrRecord->Length, TAG_NTFS);
     if(!Context->pRecord)
@@ -113,10 +118,153 @@ ReleaseAttributeContext(PNTFS_ATTR_CONTEXT Context)
         ExFreePoolWithTag(Context->pRecord, TAG_NTFS);
     }
 
+    NtfsInvalidateRunCache(Context);
+
     ExFreeToNPagedLookasideList(&NtfsGlobalData->AttrCtxtLookasideList, Context);
 }
 
 
+static
+VOID
+NtfsDereferenceRunCache(PNTFS_RUN_CACHE RunCache)
+{
+    if (InterlockedDecrement(&RunCache->RefCount) == 0)
+        ExFreePoolWithTag(RunCache, TAG_NTFS);
+}
+
+
+/**
+* @name NtfsInvalidateRunCache
+* @implemented
+*
+* Discards the decoded copy of a context's data runs. Must be called whenever
+* DataRunsMCB is modified; the next ReadAttribute() will rebuild it.
+*/
+VOID
+NtfsInvalidateRunCache(PNTFS_ATTR_CONTEXT Context)
+{
+    PNTFS_RUN_CACHE RunCache;
+    KIRQL OldIrql;
+
+    /* Readers may still use the old runs, the last one frees them */
+    KeAcquireSpinLock(&Context->RunCacheLock, &OldIrql);
+    RunCache = Context->RunCache;
+    Context->RunCache = NULL;
+    Context->RunCacheGeneration++;
+    Context->RunHint = 0;
+    KeReleaseSpinLock(&Context->RunCacheLock, OldIrql);
+
+    if (RunCache)
+        NtfsDereferenceRunCache(RunCache);
+}
+
+
+/*
+ * Returns a referenced copy of the data runs of a non-resident attribute,
+ * including holes, sorted by VCN. Walking the MCB is linear for every
+ * entry, so the runs are decoded once and shared until the MCB changes.
+ * Contexts such as the MFT's are used by concurrent readers while the
+ * MCB grows, hence the lock and the references.
+ */
+static
+PNTFS_RUN_CACHE
+NtfsReferenceRunCache(PNTFS_ATTR_CONTEXT Context)
+{
+    PNTFS_RUN_CACHE RunCache, Existing;
+    LONGLONG Vbn, Lbn, Count;
+    ULONG RunCount, Generation, i;
+    KIRQL OldIrql;
+
+    KeAcquireSpinLock(&Context->RunCacheLock, &OldIrql);
+    RunCache = Context->RunCache;
+    if (RunCache)
+        InterlockedIncrement(&RunCache->RefCount);
+    Generation = Context->RunCacheGeneration;
+    KeReleaseSpinLock(&Context->RunCacheLock, OldIrql);
+
+    if (RunCache)
+        return RunCache;
+
+    /* Decode the runs outside of the lock, the MCB has its own */
+    RunCount = FsRtlNumberOfRunsInLargeMcb(&Context->DataRunsMCB);
+    RunCache = ExAllocatePoolWithTag(NonPagedPool,
+                                     FIELD_OFFSET(NTFS_RUN_CACHE, Runs) + RunCount * sizeof(NTFS_RUN),
+                                     TAG_NTFS);
+    if (RunCache == NULL)
+        return NULL;
+
+    for (i = 0; i < RunCount && FsRtlGetNextLargeMcbEntry(&Context->DataRunsMCB, i, &Vbn, &Lbn, &Count); i++)
+    {
+        RunCache->Runs[i].Vcn = Vbn;
+        RunCache->Runs[i].Lcn = Lbn;
+        RunCache->Runs[i].Length = Count;
+    }
+    RunCache->RunCount = i;
+    RunCache->RefCount = 1;
+
+    /* Publish it, unless somebody beat us to it or the MCB changed meanwhile */
+    KeAcquireSpinLock(&Context->RunCacheLock, &OldIrql);
+    Existing = Context->RunCache;
+    if (Existing)
+    {
+        InterlockedIncrement(&Existing->RefCount);
+    }
+    else if (Context->RunCacheGeneration == Generation)
+    {
+        RunCache->RefCount++;
+        Context->RunCache = RunCache;
+    }
+    KeReleaseSpinLock(&Context->RunCacheLock, OldIrql);
+
+    if (Existing)
+    {
+        NtfsDereferenceRunCache(RunCache);
+        return Existing;
+    }
+
+    return RunCache;
+}
+
+
+/*
+ * Returns the index of the run containing Vcn, or RunCount if the VCN is not mapped.
+ */
+static
+ULONG
+NtfsFindRun(PNTFS_RUN_CACHE RunCache,
+            ULONG Hint,
+            ULONGLONG Vcn)
+{
+    PNTFS_RUN Run;
+    ULONG Low, High, Middle;
+
+    /* Sequential reads usually continue in the run the previous one stopped in */
+    if (Hint < RunCache->RunCount)
+    {
+        Run = &RunCache->Runs[Hint];
+        if (Vcn >= Run->Vcn && Vcn < Run->Vcn + Run->Length)
+            return Hint;
+    }
+
+    Low = 0;
+    High = RunCache->RunCount;
+    while (Low < High)
+    {
+        Middle = Low + (High - Low) / 2;
+        Run = &RunCache->Runs[Middle];
+
+        if (Vcn < Run->Vcn)
+            High = Middle;
+        else if (Vcn >= Run->Vcn + Run->Length)
+            Low = Middle + 1;
+        else
+            return Middle;
+    }
+
+    return RunCache->RunCount;
+}
+
+
 /**
 * @name FindAttribute
 * @implemented
@@ -1012,18 +1160,14 @@ ReadAttribute(PDEVICE_EXTENSION Vcb,
               PCHAR Buffer,
               ULONG Length)
 {
-    ULONGLONG LastLCN;
-    PUCHAR DataRun;
-    LONGLONG DataRunOffset;
-    ULONGLONG DataRunLength;
-    LONGLONG DataRunStartLCN;
-    ULONGLONG CurrentOffset;
+    PNTFS_RUN_CACHE RunCache;
+    PNTFS_RUN Run;
+    ULONG RunIndex;
+    ULONGLONG RunOffset;
+    ULONGLONG RunBytes;
     ULONG ReadLength;
     ULONG AlreadyRead;
     NTSTATUS Status;
-    
-    //TEMPTEMP
-    PUCHAR TempBuffer;
 
     if (!Context->pRecord->IsNonResident)
     {
@@ -1045,172 +1189,182 @@ ReadAttribute(PDEVICE_EXTENSION Vcb,
      * Non-resident attribute
      */
 
+    RunCache = NtfsReferenceRunCache(Context);
+    if (RunCache == NULL)
+    {
+        DPRINT1("Unable to decode data runs\n");
+        return 0;
+    }
+
     /*
      * I. Find the corresponding start data run.
      */
 
     AlreadyRead = 0;
+    RunIndex = NtfsFindRun(RunCache, Context->RunHint, Offset / Vcb->NtfsInfo.BytesPerCluster);
 
-    // FIXME: Cache seems to be non-working. Disable it for now
-    //if(Context->CacheRunOffset <= Offset && Offset < Context->CacheRunOffset + Context->CacheRunLength * Volume->ClusterSize)
-    if (0)
-    {
-        DataRun = Context->CacheRun;
-        LastLCN = Context->CacheRunLastLCN;
-        DataRunStartLCN = Context->CacheRunStartLCN;
-        DataRunLength = Context->CacheRunLength;
-        CurrentOffset = Context->CacheRunCurrentOffset;
-    }
-    else
+    /*
+     * II. Go through the run list and read the data
+     */
+
+    while (Length > 0 && RunIndex < RunCache->RunCount)
     {
-        //TEMPTEMP
-        ULONG UsedBufferSize;
-        TempBuffer = ExAllocatePoolWithTag(NonPagedPool, Vcb->NtfsInfo.BytesPerFileRecord, TAG_NTFS);
-        if (TempBuffer == NULL)
+        Run = &RunCache->Runs[RunIndex];
+        RunOffset = Offset - Run->Vcn * Vcb->NtfsInfo.BytesPerCluster;
+        RunBytes = Run->Length * Vcb->NtfsInfo.BytesPerCluster - RunOffset;
+
+        ReadLength = (ULONG)min(RunBytes, Length);
+        if (Run->Lcn == -1)
         {
-            return STATUS_INSUFFICIENT_RESOURCES;
+            /* Sparse data run. */
+            RtlZeroMemory(Buffer, ReadLength);
+        }
+        else
+        {
+            Status = NtfsReadDisk(Vcb->StorageDevice,
+                                  Run->Lcn * Vcb->NtfsInfo.BytesPerCluster + RunOffset,
+                                  ReadLength,
+                                  Vcb->NtfsInfo.BytesPerSector,
+                                  (PVOID)Buffer,
+                                  FALSE);
+            if (!NT_SUCCESS(Status))
+                break;
         }
 
-        LastLCN = 0;
-        CurrentOffset = 0;
+        Length -= ReadLength;
+        Buffer += ReadLength;
+        Offset += ReadLength;
+        AlreadyRead += ReadLength;
 
-        // This will be rewritten in the next iteration to just use the DataRuns MCB directly
-        ConvertLargeMCBToDataRuns(&Context->DataRunsMCB,
-                                  TempBuffer,
-                                  Vcb->NtfsInfo.BytesPerFileRecord,
-                                  &UsedBufferSize);
+        /* Go to next run in the list, unless there's still data left in this one. */
+        if (ReadLength == RunBytes)
+            RunIndex++;
+    }
 
-        DataRun = TempBuffer;
+    /* Only a hint, it is checked against the runs before use */
+    Context->RunHint = RunIndex;
+    NtfsDereferenceRunCache(RunCache);
 
-        while (1)
-        {
-            DataRun = DecodeRun(DataRun, &DataRunOffset, &DataRunLength);
-            if (DataRunOffset != -1)
-            {
-                /* Normal data run. */
-                DataRunStartLCN = LastLCN + DataRunOffset;
-                LastLCN = DataRunStartLCN;
-            }
-            else
-            {
-                /* Sparse data run. */
-                DataRunStartLCN = -1;
-            }
+    return AlreadyRead;
+}
 
-            if (Offset >= CurrentOffset &&
-                Offset < CurrentOffset + (DataRunLength * Vcb->NtfsInfo.BytesPerCluster))
-            {
-                break;
-            }
 
-            if (*DataRun == 0)
-            {
-                ExFreePoolWithTag(TempBuffer, TAG_NTFS);
-                return AlreadyRead;
-            }
+/*
+ * The file record cache is direct-mapped on the MFT index. Each slot keeps
+ * its buffer once allocated; a slot is empty when its index is (ULONGLONG)-1
+ * or it has no buffer yet. FileRecCacheGeneration changes on every
+ * invalidation, so a record read from disk while the MFT was being written
+ * isn't put back into the cache.
+ */
+static
+BOOLEAN
+NtfsReadCachedFileRecord(PDEVICE_EXTENSION Vcb,
+                         ULONGLONG Index,
+                         PFILE_RECORD_HEADER FileRecord,
+                         PULONG Generation)
+{
+    ULONG Slot = (ULONG)(Index % NTFS_FILE_RECORD_CACHE_SIZE);
+    BOOLEAN Found = FALSE;
 
-            CurrentOffset += DataRunLength * Vcb->NtfsInfo.BytesPerCluster;
-        }
+    ExAcquireFastMutex(&Vcb->FileRecCacheLock);
+
+    if (Vcb->FileRecCache[Slot] != NULL && Vcb->FileRecCacheIndex[Slot] == Index)
+    {
+        RtlCopyMemory(FileRecord, Vcb->FileRecCache[Slot], Vcb->NtfsInfo.BytesPerFileRecord);
+        Found = TRUE;
     }
 
-    /*
-     * II. Go through the run list and read the data
-     */
+    *Generation = Vcb->FileRecCacheGeneration;
+
+    ExReleaseFastMutex(&Vcb->FileRecCacheLock);
 
-    ReadLength = (ULONG)min(DataRunLength * Vcb->NtfsInfo.BytesPerCluster - (Offset - CurrentOffset), Length);
-    if (DataRunStartLCN == -1)
+    return Found;
+}
+
+static
+VOID
+NtfsCacheFileRecord(PDEVICE_EXTENSION Vcb,
+                    ULONGLONG Index,
+                    PFILE_RECORD_HEADER FileRecord,
+                    ULONG Generation)
+{
+    ULONG Slot = (ULONG)(Index % NTFS_FILE_RECORD_CACHE_SIZE);
+    PFILE_RECORD_HEADER Buffer = NULL;
+
+    ExAcquireFastMutex(&Vcb->FileRecCacheLock);
+
+    /* Nothing is cached anymore once the volume is being dismounted */
+    if (Vcb->FileRecCacheGeneration != Generation ||
+        (Vcb->Flags & VCB_DISMOUNT_PENDING))
     {
-        RtlZeroMemory(Buffer, ReadLength);
-        Status = STATUS_SUCCESS;
+        ExReleaseFastMutex(&Vcb->FileRecCacheLock);
+        return;
     }
-    else
+
+    if (Vcb->FileRecCache[Slot] == NULL)
     {
-        Status = NtfsReadDisk(Vcb->StorageDevice,
-                              DataRunStartLCN * Vcb->NtfsInfo.BytesPerCluster + Offset - CurrentOffset,
-                              ReadLength,
-                              Vcb->NtfsInfo.BytesPerSector,
-                              (PVOID)Buffer,
-                              FALSE);
+        Vcb->FileRecCache[Slot] = ExAllocatePoolWithTag(NonPagedPool, Vcb->NtfsInfo.BytesPerFileRecord, TAG_FILE_REC);
     }
-    if (NT_SUCCESS(Status))
+
+    Buffer = Vcb->FileRecCache[Slot];
+    if (Buffer != NULL)
     {
-        Length -= ReadLength;
-        Buffer += ReadLength;
-        AlreadyRead += ReadLength;
+        RtlCopyMemory(Buffer, FileRecord, Vcb->NtfsInfo.BytesPerFileRecord);
+        Vcb->FileRecCacheIndex[Slot] = Index;
+    }
 
-        if (ReadLength == DataRunLength * Vcb->NtfsInfo.BytesPerCluster - (Offset - CurrentOffset))
-        {
-            CurrentOffset += DataRunLength * Vcb->NtfsInfo.BytesPerCluster;
-            DataRun = DecodeRun(DataRun, &DataRunOffset, &DataRunLength);
-            if (DataRunOffset != (ULONGLONG)-1)
-            {
-                DataRunStartLCN = LastLCN + DataRunOffset;
-                LastLCN = DataRunStartLCN;
-            }
-            else
-                DataRunStartLCN = -1;
-        }
+    ExReleaseFastMutex(&Vcb->FileRecCacheLock);
+}
 
-        while (Length > 0)
-        {
-            ReadLength = (ULONG)min(DataRunLength * Vcb->NtfsInfo.BytesPerCluster, Length);
-            if (DataRunStartLCN == -1)
-                RtlZeroMemory(Buffer, ReadLength);
-            else
-            {
-                Status = NtfsReadDisk(Vcb->StorageDevice,
-                                      DataRunStartLCN * Vcb->NtfsInfo.BytesPerCluster,
-                                      ReadLength,
-                                      Vcb->NtfsInfo.BytesPerSector,
-                                      (PVOID)Buffer,
-                                      FALSE);
-                if (!NT_SUCCESS(Status))
-                    break;
-            }
+/*
+ * Drops cached file records overlapping the given byte range of the MFT's $DATA.
+ */
+static
+VOID
+NtfsInvalidateFileRecords(PDEVICE_EXTENSION Vcb,
+                          ULONGLONG Offset,
+                          ULONG Length)
+{
+    ULONGLONG First, Last;
+    ULONG Slot;
 
-            Length -= ReadLength;
-            Buffer += ReadLength;
-            AlreadyRead += ReadLength;
+    First = Offset / Vcb->NtfsInfo.BytesPerFileRecord;
+    Last = (Offset + max(Length, 1) - 1) / Vcb->NtfsInfo.BytesPerFileRecord;
 
-            /* We finished this request, but there still data in this data run. */
-            if (Length == 0 && ReadLength != DataRunLength * Vcb->NtfsInfo.BytesPerCluster)
-                break;
+    ExAcquireFastMutex(&Vcb->FileRecCacheLock);
 
-            /*
-             * Go to next run in the list.
-             */
+    Vcb->FileRecCacheGeneration++;
 
-            if (*DataRun == 0)
-                break;
-            CurrentOffset += DataRunLength * Vcb->NtfsInfo.BytesPerCluster;
-            DataRun = DecodeRun(DataRun, &DataRunOffset, &DataRunLength);
-            if (DataRunOffset != -1)
-            {
-                /* Normal data run. */
-                DataRunStartLCN = LastLCN + DataRunOffset;
-                LastLCN = DataRunStartLCN;
-            }
-            else
-            {
-                /* Sparse data run. */
-                DataRunStartLCN = -1;
-            }
-        } /* while */
+    for (Slot = 0; Slot < NTFS_FILE_RECORD_CACHE_SIZE; Slot++)
+    {
+        if (Vcb->FileRecCacheIndex[Slot] >= First && Vcb->FileRecCacheIndex[Slot] <= Last)
+            Vcb->FileRecCacheIndex[Slot] = (ULONGLONG)-1;
+    }
+
+    ExReleaseFastMutex(&Vcb->FileRecCacheLock);
+}
 
-    } /* if Disk */
+VOID
+NtfsPurgeFileRecordCache(PDEVICE_EXTENSION Vcb)
+{
+    ULONG Slot;
 
-    // TEMPTEMP
-    if (Context->pRecord->IsNonResident)
-        ExFreePoolWithTag(TempBuffer, TAG_NTFS);
+    ExAcquireFastMutex(&Vcb->FileRecCacheLock);
 
-    Context->CacheRun = DataRun;
-    Context->CacheRunOffset = Offset + AlreadyRead;
-    Context->CacheRunStartLCN = DataRunStartLCN;
-    Context->CacheRunLength = DataRunLength;
-    Context->CacheRunLastLCN = LastLCN;
-    Context->CacheRunCurrentOffset = CurrentOffset;
+    Vcb->FileRecCacheGeneration++;
 
-    return AlreadyRead;
+    for (Slot = 0; Slot < NTFS_FILE_RECORD_CACHE_SIZE; Slot++)
+    {
+        if (Vcb->FileRecCache[Slot] != NULL)
+        {
+            ExFreePoolWithTag(Vcb->FileRecCache[Slot], TAG_FILE_REC);
+            Vcb->FileRecCache[Slot] = NULL;
+        }
+
+        Vcb->FileRecCacheIndex[Slot] = (ULONGLONG)-1;
+    }
+
+    ExReleaseFastMutex(&Vcb->FileRecCacheLock);
 }
 
 
@@ -1568,6 +1722,13 @@ Cleanup:
     if (Context->pRecord->IsNonResident)
         ExFreePoolWithTag(TempBuffer, TAG_NTFS);
 
+    // Forget any cached copies of the file records we've just overwritten
+    if (Context == Vcb->MFTContext ||
+        (Context->FileMFTIndex == NTFS_FILE_MFT && Context->pRecord->Type == AttributeData))
+    {
+        NtfsInvalidateFileRecords(Vcb, Offset, *RealLengthWritten + Length);
+    }
+
     return Status;
 }
 
@@ -1577,9 +1738,14 @@ ReadFileRecord(PDEVICE_EXTENSION Vcb,
                PFILE_RECORD_HEADER file)
 {
     ULONGLONG BytesRead;
+    ULONG Generation;
+    NTSTATUS Status;
 
     DPRINT("ReadFileRecord(%p, %I64x, %p)\n", Vcb, index, file);
 
+    if (NtfsReadCachedFileRecord(Vcb, index, file, &Generation))
+        return STATUS_SUCCESS;
+
     BytesRead = ReadAttribute(Vcb, Vcb->MFTContext, index * Vcb->NtfsInfo.BytesPerFileRecord, (PCHAR)file, Vcb->NtfsInfo.BytesPerFileRecord);
     if (BytesRead != Vcb->NtfsInfo.BytesPerFileRecord)
     {
@@ -1589,7 +1755,11 @@ ReadFileRecord(PDEVICE_EXTENSION Vcb,
 
     /* Apply update sequence array fixups. */
     DPRINT("Sequence number: %u\n", file->SequenceNumber);
-    return FixupUpdateSequenceArray(Vcb, &file->Ntfs);
+    Status = FixupUpdateSequenceArray(Vcb, &file->Ntfs);
+    if (NT_SUCCESS(Status))
+        NtfsCacheFileRecord(Vcb, index, file, Generation);
+
+    return Status;
 }
 
 
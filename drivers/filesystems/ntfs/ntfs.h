@@ -101,6 +101,8 @@ typedef struct
     ULONG Size;
 } NTFSIDENTIFIER, *PNTFSIDENTIFIER;
 
+#define NTFS_FILE_RECORD_CACHE_SIZE 64
+
 typedef struct
 {
     NTFSIDENTIFIER Identifier;
@@ -123,6 +125,12 @@ typedef struct
 
     NPAGED_LOOKASIDE_LIST FileRecLookasideList;
 
+    /* Fixed-up copies of recently read file records, indexed by MFT index */
+    FAST_MUTEX FileRecCacheLock;
+    ULONG FileRecCacheGeneration;
+    ULONGLONG FileRecCacheIndex[NTFS_FILE_RECORD_CACHE_SIZE];
+    struct _FILE_RECORD_HEADER* FileRecCache[NTFS_FILE_RECORD_CACHE_SIZE];
+
     ULONG MftDataOffset;
     ULONG Flags;
     ULONG OpenHandleCount;
@@ -130,6 +138,7 @@ typedef struct
 } DEVICE_EXTENSION, *PDEVICE_EXTENSION, NTFS_VCB, *PNTFS_VCB;
 
 #define VCB_VOLUME_LOCKED       0x0001
+#define VCB_DISMOUNT_PENDING    0x0002
 
 typedef struct
 {
@@ -481,6 +490,21 @@ typedef struct
     CCHAR PriorityBoost;
 } NTFS_IRP_CONTEXT, *PNTFS_IRP_CONTEXT;
 
+typedef struct _NTFS_RUN
+{
+    ULONGLONG Vcn;
+    LONGLONG Lcn;       /* -1 for sparse runs */
+    ULONGLONG Length;
+} NTFS_RUN, *PNTFS_RUN;
+
+/* Decoded runs of an attribute, shared by its readers and freed by the last one */
+typedef struct _NTFS_RUN_CACHE
+{
+    LONG RefCount;
+    ULONG RunCount;
+    NTFS_RUN Runs[1];
+} NTFS_RUN_CACHE, *PNTFS_RUN_CACHE;
+
 typedef struct _NTFS_ATTR_CONTEXT
 {
     PUCHAR            CacheRun;
@@ -490,6 +514,10 @@ typedef struct _NTFS_ATTR_CONTEXT
     LONGLONG            CacheRunLastLCN;
     ULONGLONG            CacheRunCurrentOffset;
     LARGE_MCB           DataRunsMCB;
+    KSPIN_LOCK          RunCacheLock;
+    PNTFS_RUN_CACHE     RunCache;
+    ULONG               RunCacheGeneration;
+    ULONG               RunHint;
     ULONGLONG           FileMFTIndex;
     PNTFS_ATTR_RECORD    pRecord;
 } NTFS_ATTR_CONTEXT, *PNTFS_ATTR_CONTEXT;
@@ -1019,6 +1047,12 @@ PrepareAttributeContext(PNTFS_ATTR_RECORD AttrRecord);
 VOID
 ReleaseAttributeContext(PNTFS_ATTR_CONTEXT Context);
 
+VOID
+NtfsInvalidateRunCache(PNTFS_ATTR_CONTEXT Context);
+
+VOID
+NtfsPurgeFileRecordCache(PDEVICE_EXTENSION Vcb);
+
 ULONG
 ReadAttribute(PDEVICE_EXTENSION Vcb,
               PNTFS_ATTR_CONTEXT Context,
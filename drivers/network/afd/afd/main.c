@@ -361,6 +361,7 @@ AfdCreateSocket(PDEVICE_OBJECT DeviceObject, PIRP Irp,
 
     InitializeListHead( &FCB->DatagramList );
     InitializeListHead( &FCB->PendingConnections );
+    InitializeListHead( &FCB->PollList );
 
     AFD_DbgPrint(MID_TRACE,("%p: Checking command channel\n", FCB));
 
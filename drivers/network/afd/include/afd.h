@@ -113,6 +113,12 @@ typedef struct _AFD_DEVICE_EXTENSION {
     KSPIN_LOCK Lock;
 } AFD_DEVICE_EXTENSION, *PAFD_DEVICE_EXTENSION;
 
+/* Links an active poll into the poll list of one of the sockets it waits on */
+typedef struct _AFD_POLL_LINK {
+    LIST_ENTRY ListEntry;
+    struct _AFD_ACTIVE_POLL *Poll;
+} AFD_POLL_LINK, *PAFD_POLL_LINK;
+
 typedef struct _AFD_ACTIVE_POLL {
     LIST_ENTRY ListEntry;
     PIRP Irp;
@@ -121,6 +127,8 @@ typedef struct _AFD_ACTIVE_POLL {
     KTIMER Timer;
     PKEVENT EventObject;
     BOOLEAN Exclusive;
+    UINT LinkCount;
+    AFD_POLL_LINK Links[ANYSIZE_ARRAY];
 } AFD_ACTIVE_POLL, *PAFD_ACTIVE_POLL;
 
 typedef struct _IRP_LIST {
@@ -201,6 +209,7 @@ typedef struct _AFD_FCB {
     LIST_ENTRY PendingIrpList[MAX_FUNCTIONS];
     LIST_ENTRY DatagramList;
     LIST_ENTRY PendingConnections;
+    LIST_ENTRY PollList; /* AFD_POLL_LINKs, protected by DeviceExt->Lock */
 } AFD_FCB, *PAFD_FCB;
 
 /* bind.c */
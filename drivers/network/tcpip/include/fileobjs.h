@@ -7,7 +7,11 @@
 
 #pragma once
 
+/* Number of (protocol, port) buckets for address file lookups, power of 2 */
+#define ADDRESS_FILE_HASH_SIZE 256
+
 extern LIST_ENTRY AddressFileListHead;
+extern LIST_ENTRY AddressFileHashTable[ADDRESS_FILE_HASH_SIZE];
 extern KSPIN_LOCK AddressFileListLock;
 extern LIST_ENTRY ConnectionEndpointListHead;
 extern KSPIN_LOCK ConnectionEndpointListLock;
@@ -22,6 +26,10 @@ NTSTATUS FileOpenAddress(
 NTSTATUS FileCloseAddress(
   PTDI_REQUEST Request);
 
+VOID AddrFileSetPort(
+  PADDRESS_FILE AddrFile,
+  USHORT Port);
+
 NTSTATUS FileOpenConnection(
   PTDI_REQUEST Request,
   PVOID ClientContext);
@@ -17,6 +17,19 @@
 LIST_ENTRY AddressFileListHead;
 KSPIN_LOCK AddressFileListLock;
 
+/* Address file objects hashed by protocol and port, protected by AddressFileListLock.
+ * TCP address files with an unspecified port are not hashed until a port is assigned */
+LIST_ENTRY AddressFileHashTable[ADDRESS_FILE_HASH_SIZE];
+
+static __inline PLIST_ENTRY AddrFileHashBucket(
+    USHORT Port,
+    USHORT Protocol)
+{
+    ULONG Hash = Port ^ (Port >> 8) ^ (Protocol * 0x9D);
+
+    return &AddressFileHashTable[Hash & (ADDRESS_FILE_HASH_SIZE - 1)];
+}
+
 /* List of all connection endpoint file objects managed by this driver */
 LIST_ENTRY ConnectionEndpointListHead;
 KSPIN_LOCK ConnectionEndpointListLock;
@@ -43,12 +56,14 @@ PADDRESS_FILE AddrSearchFirst(
     SearchContext->Port     = Port;
     SearchContext->Protocol = Protocol;
 
+    SearchContext->Head     = AddrFileHashBucket(Port, Protocol);
+
     TcpipAcquireSpinLock(&AddressFileListLock, &OldIrql);
 
-    SearchContext->Next = AddressFileListHead.Flink;
+    SearchContext->Next = SearchContext->Head->Flink;
 
-    if (!IsListEmpty(&AddressFileListHead))
-        ReferenceObject(CONTAINING_RECORD(SearchContext->Next, ADDRESS_FILE, ListEntry));
+    if (!IsListEmpty(SearchContext->Head))
+        ReferenceObject(CONTAINING_RECORD(SearchContext->Next, ADDRESS_FILE, HashEntry));
 
     TcpipReleaseSpinLock(&AddressFileListLock, OldIrql);
 
@@ -188,15 +203,18 @@ PADDRESS_FILE AddrFindShared(
     USHORT Port,
     USHORT Protocol)
 {
+    PLIST_ENTRY Head;
     PLIST_ENTRY CurrentEntry;
     KIRQL OldIrql;
     PADDRESS_FILE Current = NULL;
 
+    Head = AddrFileHashBucket(Port, Protocol);
+
     TcpipAcquireSpinLock(&AddressFileListLock, &OldIrql);
 
-    CurrentEntry = AddressFileListHead.Flink;
-    while (CurrentEntry != &AddressFileListHead) {
-        Current = CONTAINING_RECORD(CurrentEntry, ADDRESS_FILE, ListEntry);
+    CurrentEntry = Head->Flink;
+    while (CurrentEntry != Head) {
+        Current = CONTAINING_RECORD(CurrentEntry, ADDRESS_FILE, HashEntry);
 
         /* See if this address matches the search criteria */
         if ((Current->Port == Port) &&
@@ -236,19 +254,19 @@ PADDRESS_FILE AddrSearchNext(
     
     TcpipAcquireSpinLock(&AddressFileListLock, &OldIrql);
 
-    if (SearchContext->Next == &AddressFileListHead)
+    if (SearchContext->Next == SearchContext->Head)
     {
         TcpipReleaseSpinLock(&AddressFileListLock, OldIrql);
         return NULL;
     }
 
     /* Save this pointer so we can dereference it later */
-    StartingAddrFile = CONTAINING_RECORD(SearchContext->Next, ADDRESS_FILE, ListEntry);
+    StartingAddrFile = CONTAINING_RECORD(SearchContext->Next, ADDRESS_FILE, HashEntry);
 
     CurrentEntry = SearchContext->Next;
 
-    while (CurrentEntry != &AddressFileListHead) {
-        Current = CONTAINING_RECORD(CurrentEntry, ADDRESS_FILE, ListEntry);
+    while (CurrentEntry != SearchContext->Head) {
+        Current = CONTAINING_RECORD(CurrentEntry, ADDRESS_FILE, HashEntry);
 
         IPAddress = &Current->Address;
 
@@ -275,10 +293,10 @@ PADDRESS_FILE AddrSearchNext(
     {
         SearchContext->Next = CurrentEntry->Flink;
 
-        if (SearchContext->Next != &AddressFileListHead)
+        if (SearchContext->Next != SearchContext->Head)
         {
             /* Reference the next address file to prevent the link from disappearing behind our back */
-            ReferenceObject(CONTAINING_RECORD(SearchContext->Next, ADDRESS_FILE, ListEntry));
+            ReferenceObject(CONTAINING_RECORD(SearchContext->Next, ADDRESS_FILE, HashEntry));
         }
 
         /* Reference the returned address file before dereferencing the starting
@@ -314,9 +332,10 @@ VOID AddrFileFree(
   /* We should not be associated with a connection here */
   ASSERT(!AddrFile->Connection);
 
-  /* Remove address file from the global list */
+  /* Remove address file from the global list and its hash bucket */
   TcpipAcquireSpinLock(&AddressFileListLock, &OldIrql);
   RemoveEntryList(&AddrFile->ListEntry);
+  RemoveEntryList(&AddrFile->HashEntry);
   TcpipReleaseSpinLock(&AddressFileListLock, OldIrql);
 
   /* FIXME: Kill TCP connections on this address file object */
@@ -392,6 +411,7 @@ NTSTATUS FileOpenAddress(
   PVOID Options)
 {
   PADDRESS_FILE AddrFile;
+  KIRQL OldIrql;
 
   TI_DbgPrint(MID_TRACE, ("Called (Proto %d).\n", Protocol));
 
@@ -541,11 +561,18 @@ NTSTATUS FileOpenAddress(
   /* Return address file object */
   Request->Handle.AddressHandle = AddrFile;
 
-  /* Add address file to global list */
-  ExInterlockedInsertTailList(
-    &AddressFileListHead,
-    &AddrFile->ListEntry,
-    &AddressFileListLock);
+  /* Add address file to global list and, unless its port is still
+   * to be chosen by the TCP stack, to the hash bucket for its port */
+  InitializeListHead(&AddrFile->HashEntry);
+
+  TcpipAcquireSpinLock(&AddressFileListLock, &OldIrql);
+  InsertTailList(&AddressFileListHead, &AddrFile->ListEntry);
+  if ((AddrFile->Protocol != IPPROTO_TCP) || (AddrFile->Port != 0))
+  {
+    InsertTailList(AddrFileHashBucket(AddrFile->Port, AddrFile->Protocol),
+                   &AddrFile->HashEntry);
+  }
+  TcpipReleaseSpinLock(&AddressFileListLock, OldIrql);
 
   TI_DbgPrint(MAX_TRACE, ("Leaving.\n"));
 
@@ -553,6 +580,33 @@ NTSTATUS FileOpenAddress(
 }
 
 
+/*
+ * FUNCTION: Assigns the port of a TCP address file opened with an
+ *           unspecified port and makes it visible to port lookups
+ * ARGUMENTS:
+ *     AddrFile = Pointer to address file object
+ *     Port     = Network port (network byte order)
+ */
+VOID AddrFileSetPort(
+  PADDRESS_FILE AddrFile,
+  USHORT Port)
+{
+  KIRQL OldIrql;
+
+  TcpipAcquireSpinLock(&AddressFileListLock, &OldIrql);
+
+  /* Only unhashed address files may be moved, so that a concurrent
+   * bucket walk never follows an entry into another bucket */
+  ASSERT(IsListEmpty(&AddrFile->HashEntry));
+
+  AddrFile->Port = Port;
+  InsertTailList(AddrFileHashBucket(Port, AddrFile->Protocol),
+                 &AddrFile->HashEntry);
+
+  TcpipReleaseSpinLock(&AddressFileListLock, OldIrql);
+}
+
+
 /*
  * FUNCTION: Closes an address file object
  * ARGUMENTS:
@@ -631,6 +631,7 @@ DriverEntry(
     UNICODE_STRING strNdisDeviceName = RTL_CONSTANT_STRING(TCPIP_PROTOCOL_NAME);
     NDIS_STATUS NdisStatus;
     LARGE_INTEGER DueTime;
+    ULONG i;
 
     TI_DbgPrint(MAX_TRACE, ("[TCPIP, DriverEntry] Called\n"));
 
@@ -711,6 +712,8 @@ DriverEntry(
 
     /* Initialize address file list and protecting spin lock */
     InitializeListHead(&AddressFileListHead);
+    for (i = 0; i < ADDRESS_FILE_HASH_SIZE; i++)
+        InitializeListHead(&AddressFileHashTable[i]);
     KeInitializeSpinLock(&AddressFileListLock);
 
     /* Initialize connection endpoint list and protecting spin lock */
@@ -139,6 +139,9 @@ PortFdoStartMiniport(
         return Status;
     }
 
+    /* The miniport has reported its capabilities, set up the request queue */
+    PortConfigureRequestQueue(DeviceExtension);
+
     /* Connect the configured interrupt */
     Status = PortFdoConnectInterrupt(DeviceExtension);
     if (!NT_SUCCESS(Status))
@@ -245,7 +248,8 @@ PortFdoStartDevice(
 
 static NTSTATUS
 SpiSendInquiry(IN PDEVICE_OBJECT DeviceObject,
-               ULONG Bus, ULONG Target, ULONG Lun)
+               ULONG Bus, ULONG Target, ULONG Lun,
+               OUT PINQUIRYDATA InquiryData)
 {
 //    IO_STATUS_BLOCK IoStatusBlock;
 //    PIO_STACK_LOCATION IrpStack;
@@ -257,12 +261,14 @@ SpiSendInquiry(IN PDEVICE_OBJECT DeviceObject,
     PUCHAR /*PSENSE_DATA*/ SenseBuffer;
 //    BOOLEAN KeepTrying = TRUE;
 //    ULONG RetryCount = 0;
-    SCSI_REQUEST_BLOCK Srb;
+    PSCSI_REQUEST_BLOCK Srb;
     PCDB Cdb;
 //    PSCSI_PORT_LUN_EXTENSION LunExtension;
 //    PSCSI_PORT_DEVICE_EXTENSION DeviceExtension;
 
 PFDO_DEVICE_EXTENSION DeviceExtension;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    LARGE_INTEGER Timeout;
     PVOID SrbExtension = NULL;
     BOOLEAN ret;
 
@@ -281,11 +287,21 @@ PFDO_DEVICE_EXTENSION DeviceExtension;
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
+    /* The SRB is not on the stack, the miniport may still own it after a timeout */
+    Srb = ExAllocatePoolWithTag(NonPagedPool, sizeof(SCSI_REQUEST_BLOCK), TAG_SENSE_DATA);
+    if (Srb == NULL)
+    {
+        ExFreePoolWithTag(SenseBuffer, TAG_SENSE_DATA);
+        ExFreePoolWithTag(InquiryBuffer, TAG_INQUIRY_DATA);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
     if (DeviceExtension->Miniport.PortConfig.SrbExtensionSize != 0)
     {
         SrbExtension = ExAllocatePoolWithTag(NonPagedPool, DeviceExtension->Miniport.PortConfig.SrbExtensionSize, TAG_SENSE_DATA);
         if (SrbExtension == NULL)
         {
+            ExFreePoolWithTag(Srb, TAG_SENSE_DATA);
             ExFreePoolWithTag(SenseBuffer, TAG_SENSE_DATA);
             ExFreePoolWithTag(InquiryBuffer, TAG_INQUIRY_DATA);
             return STATUS_INSUFFICIENT_RESOURCES;
@@ -320,32 +336,32 @@ PFDO_DEVICE_EXTENSION DeviceExtension;
 //        }
 
         /* Prepare SRB */
-        RtlZeroMemory(&Srb, sizeof(SCSI_REQUEST_BLOCK));
+        RtlZeroMemory(Srb, sizeof(SCSI_REQUEST_BLOCK));
 
-        Srb.Length = sizeof(SCSI_REQUEST_BLOCK);
+        Srb->Length = sizeof(SCSI_REQUEST_BLOCK);
 //        Srb.OriginalRequest = Irp;
-        Srb.PathId = Bus;
-        Srb.TargetId = Target;
-        Srb.Lun = Lun;
-        Srb.Function = SRB_FUNCTION_EXECUTE_SCSI;
-        Srb.SrbFlags = SRB_FLAGS_DATA_IN | SRB_FLAGS_DISABLE_SYNCH_TRANSFER;
-        Srb.TimeOutValue = 4;
-        Srb.CdbLength = 6;
+        Srb->PathId = Bus;
+        Srb->TargetId = Target;
+        Srb->Lun = Lun;
+        Srb->Function = SRB_FUNCTION_EXECUTE_SCSI;
+        Srb->SrbFlags = SRB_FLAGS_DATA_IN | SRB_FLAGS_DISABLE_SYNCH_TRANSFER;
+        Srb->TimeOutValue = 4;
+        Srb->CdbLength = 6;
 
-        Srb.SenseInfoBuffer = SenseBuffer;
-        Srb.SenseInfoBufferLength = SENSE_BUFFER_SIZE;
+        Srb->SenseInfoBuffer = SenseBuffer;
+        Srb->SenseInfoBufferLength = SENSE_BUFFER_SIZE;
 
-        Srb.DataBuffer = InquiryBuffer;
-        Srb.DataTransferLength = INQUIRYDATABUFFERSIZE;
+        Srb->DataBuffer = InquiryBuffer;
+        Srb->DataTransferLength = INQUIRYDATABUFFERSIZE;
 
-        Srb.SrbExtension = SrbExtension;
+        Srb->SrbExtension = SrbExtension;
 
         /* Attach Srb to the Irp */
 //        IrpStack = IoGetNextIrpStackLocation(Irp);
 //        IrpStack->Parameters.Scsi.Srb = &Srb;
 
         /* Fill in CDB */
-        Cdb = (PCDB)Srb.Cdb;
+        Cdb = (PCDB)Srb->Cdb;
         Cdb->CDB6INQUIRY.OperationCode = SCSIOP_INQUIRY;
         Cdb->CDB6INQUIRY.LogicalUnitNumber = Lun;
         Cdb->CDB6INQUIRY.AllocationLength = INQUIRYDATABUFFERSIZE;
@@ -353,10 +369,32 @@ PFDO_DEVICE_EXTENSION DeviceExtension;
         /* Call the driver */
 
 
+        /* The request has no IRP, so the completion DPC signals the internal SRB event */
+        DeviceExtension->InternalSrbCompleted = FALSE;
+        KeClearEvent(&DeviceExtension->InternalSrbEvent);
+        DeviceExtension->InternalSrb = Srb;
+
+        /* HwStartIo always runs under the StartIo lock, as it does for queued requests */
+        KeAcquireInStackQueuedSpinLock(&DeviceExtension->StartIoLock,
+                                       &LockHandle);
         ret = MiniportStartIo(&DeviceExtension->Miniport,
-                              &Srb);
+                              Srb);
+        KeReleaseInStackQueuedSpinLock(&LockHandle);
 DPRINT1("MiniportStartIo returned %u\n", ret);
 
+        /* The miniport may complete the request later, from its interrupt routine */
+        if (ret)
+        {
+            Timeout.QuadPart = Int32x32To64(Srb->TimeOutValue, -10 * 1000 * 1000);
+            KeWaitForSingleObject(&DeviceExtension->InternalSrbEvent,
+                                  Executive,
+                                  KernelMode,
+                                  FALSE,
+                                  &Timeout);
+        }
+
+        DeviceExtension->InternalSrb = NULL;
+
 //        Status = IoCallDriver(DeviceObject, Irp);
 
         /* Wait for it to complete */
@@ -373,20 +411,29 @@ DPRINT1("MiniportStartIo returned %u\n", ret);
 
 //        DPRINT1("SpiSendInquiry(): Request processed by driver, status = 0x%08X\n", Status);
 
-        if (SRB_STATUS(Srb.SrbStatus) == SRB_STATUS_SUCCESS)
+        if (SRB_STATUS(Srb->SrbStatus) == SRB_STATUS_SUCCESS)
         {
             /* All fine, copy data over */
-//            RtlCopyMemory(LunInfo->InquiryData,
-//                          InquiryBuffer,
-//                          INQUIRYDATABUFFERSIZE);
+            RtlCopyMemory(InquiryData,
+                          InquiryBuffer,
+                          INQUIRYDATABUFFERSIZE);
 
             /* Quit the loop */
             Status = STATUS_SUCCESS;
 //            KeepTrying = FALSE;
 //            continue;
         }
-
-        DPRINT("Inquiry SRB failed with SrbStatus 0x%08X\n", Srb.SrbStatus);
+        else if (ret && Srb->SrbStatus == SRB_STATUS_PENDING)
+        {
+            /* The miniport still owns the SRB and its buffers, they can't be freed */
+            DPRINT1("Inquiry SRB timed out at %lu:%lu:%lu\n", Bus, Target, Lun);
+            return STATUS_IO_TIMEOUT;
+        }
+        else
+        {
+            DPRINT("Inquiry SRB failed with SrbStatus 0x%08X\n", Srb->SrbStatus);
+            Status = STATUS_IO_DEVICE_ERROR;
+        }
 #if 0
         /* Check if the queue is frozen */
         if (Srb.SrbStatus & SRB_STATUS_QUEUE_FROZEN)
@@ -474,6 +521,7 @@ DPRINT1("MiniportStartIo returned %u\n", ret);
     if (SrbExtension != NULL)
         ExFreePoolWithTag(SrbExtension, TAG_SENSE_DATA);
 
+    ExFreePoolWithTag(Srb, TAG_SENSE_DATA);
     ExFreePoolWithTag(SenseBuffer, TAG_SENSE_DATA);
     ExFreePoolWithTag(InquiryBuffer, TAG_INQUIRY_DATA);
 
@@ -483,11 +531,58 @@ DPRINT1("MiniportStartIo returned %u\n", ret);
 }
 
 
+/* The PDO list is only used while handling PnP IRPs, which the PnP manager serializes */
+static
+PPDO_DEVICE_EXTENSION
+PortFdoFindPdo(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ UCHAR Bus,
+    _In_ UCHAR Target,
+    _In_ UCHAR Lun)
+{
+    PPDO_DEVICE_EXTENSION PdoDeviceExtension;
+    PLIST_ENTRY ListEntry;
+
+    for (ListEntry = DeviceExtension->PdoListHead.Flink;
+         ListEntry != &DeviceExtension->PdoListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        PdoDeviceExtension = CONTAINING_RECORD(ListEntry, PDO_DEVICE_EXTENSION, PdoListEntry);
+
+        if ((PdoDeviceExtension->Bus == Bus) &&
+            (PdoDeviceExtension->Target == Target) &&
+            (PdoDeviceExtension->Lun == Lun))
+            return PdoDeviceExtension;
+    }
+
+    return NULL;
+}
+
+
+static
+VOID
+PortFdoDeletePdos(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension)
+{
+    PPDO_DEVICE_EXTENSION PdoDeviceExtension;
+    PLIST_ENTRY ListEntry;
+
+    while (!IsListEmpty(&DeviceExtension->PdoListHead))
+    {
+        ListEntry = RemoveHeadList(&DeviceExtension->PdoListHead);
+        PdoDeviceExtension = CONTAINING_RECORD(ListEntry, PDO_DEVICE_EXTENSION, PdoListEntry);
+
+        PortDeletePdo(PdoDeviceExtension);
+    }
+}
+
+
 static
 NTSTATUS
 PortFdoScanBus(
     _In_ PFDO_DEVICE_EXTENSION DeviceExtension)
 {
+    PINQUIRYDATA InquiryData;
     ULONG Bus, Target, Lun;
     NTSTATUS Status;
 
@@ -499,6 +594,10 @@ PortFdoScanBus(
     DPRINT1("MaximumNumberOfTargets: %lu\n", DeviceExtension->Miniport.PortConfig.MaximumNumberOfTargets);
     DPRINT1("MaximumNumberOfLogicalUnits: %lu\n", DeviceExtension->Miniport.PortConfig.MaximumNumberOfLogicalUnits);
 
+    InquiryData = ExAllocatePoolWithTag(NonPagedPool, INQUIRYDATABUFFERSIZE, TAG_INQUIRY_DATA);
+    if (InquiryData == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
     /* Scan all buses */
     for (Bus = 0; Bus < DeviceExtension->Miniport.PortConfig.NumberOfBuses; Bus++)
     {
@@ -514,12 +613,27 @@ PortFdoScanBus(
             {
                 DPRINT1("    Scanning logical unit %ld:%ld:%ld\n", Bus, Target, Lun);
 
-                Status = SpiSendInquiry(DeviceExtension->Device, Bus, Target, Lun);
+                Status = SpiSendInquiry(DeviceExtension->Device, Bus, Target, Lun, InquiryData);
                 DPRINT1("SpiSendInquiry returned 0x%08lx\n", Status);
+                if (!NT_SUCCESS(Status))
+                    continue;
+
+                if (InquiryData->DeviceTypeQualifier != DEVICE_CONNECTED)
+                    continue;
+
+                /* Logical units found by an earlier scan keep their PDO */
+                if (PortFdoFindPdo(DeviceExtension, (UCHAR)Bus, (UCHAR)Target, (UCHAR)Lun) != NULL)
+                    continue;
+
+                Status = PortCreatePdo(DeviceExtension, (UCHAR)Bus, (UCHAR)Target, (UCHAR)Lun, InquiryData);
+                if (!NT_SUCCESS(Status))
+                    DPRINT1("PortCreatePdo() failed (Status 0x%08lx)\n", Status);
             }
         }
     }
 
+    ExFreePoolWithTag(InquiryData, TAG_INQUIRY_DATA);
+
     DPRINT1("Done!\n");
 
     return STATUS_SUCCESS;
@@ -532,16 +646,47 @@ PortFdoQueryBusRelations(
     _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
     _Out_ PULONG_PTR Information)
 {
+    PPDO_DEVICE_EXTENSION PdoDeviceExtension;
+    PDEVICE_RELATIONS DeviceRelations;
+    PLIST_ENTRY ListEntry;
+    ULONG Count = 0;
     NTSTATUS Status = STATUS_SUCCESS;;
 
     DPRINT1("PortFdoQueryBusRelations(%p %p)\n",
             DeviceExtension, Information);
 
     Status = PortFdoScanBus(DeviceExtension);
+    if (!NT_SUCCESS(Status))
+        return Status;
 
-    *Information = 0;
+    for (ListEntry = DeviceExtension->PdoListHead.Flink;
+         ListEntry != &DeviceExtension->PdoListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        Count++;
+    }
 
-    return Status;
+    DeviceRelations = ExAllocatePoolWithTag(PagedPool,
+                                            FIELD_OFFSET(DEVICE_RELATIONS, Objects) + Count * sizeof(PDEVICE_OBJECT),
+                                            TAG_RELATIONS);
+    if (DeviceRelations == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    DeviceRelations->Count = 0;
+
+    for (ListEntry = DeviceExtension->PdoListHead.Flink;
+         ListEntry != &DeviceExtension->PdoListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        PdoDeviceExtension = CONTAINING_RECORD(ListEntry, PDO_DEVICE_EXTENSION, PdoListEntry);
+
+        ObReferenceObject(PdoDeviceExtension->Device);
+        DeviceRelations->Objects[DeviceRelations->Count++] = PdoDeviceExtension->Device;
+    }
+
+    *Information = (ULONG_PTR)DeviceRelations;
+
+    return STATUS_SUCCESS;
 }
 
 
@@ -629,6 +774,8 @@ PortFdoPnp(
 
         case IRP_MN_REMOVE_DEVICE: /* 0x02 */
             DPRINT1("IRP_MJ_PNP / IRP_MN_REMOVE_DEVICE\n");
+            PortFdoDeletePdos(DeviceExtension);
+            PortDeleteRequestQueue(DeviceExtension);
             break;
 
         case IRP_MN_CANCEL_REMOVE_DEVICE: /* 0x03 */
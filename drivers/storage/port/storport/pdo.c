@@ -15,18 +15,491 @@
 
 /* FUNCTIONS ******************************************************************/
 
+typedef struct _PORT_DEVICE_TYPE
+{
+    PCSTR DeviceType;
+    PCSTR GenericType;
+} PORT_DEVICE_TYPE;
+
+/* Indexed by the peripheral device type of the inquiry data */
+static const PORT_DEVICE_TYPE PortDeviceTypes[] =
+{
+    {"Disk",       "GenDisk"},
+    {"Sequential", "GenSequential"},
+    {"Printer",    "GenPrinter"},
+    {"Processor",  "GenProcessor"},
+    {"Worm",       "GenWorm"},
+    {"CdRom",      "GenCdRom"},
+    {"Scanner",    "GenScanner"},
+    {"Optical",    "GenOptical"},
+    {"Changer",    "ScsiChanger"},
+    {"Net",        "ScsiNet"}
+};
+
+static const PORT_DEVICE_TYPE PortOtherDeviceType = {"Other", "ScsiOther"};
+
+
+static
+const PORT_DEVICE_TYPE *
+PortGetDeviceType(
+    _In_ PINQUIRYDATA InquiryData)
+{
+    if (InquiryData->DeviceType < RTL_NUMBER_OF(PortDeviceTypes))
+        return &PortDeviceTypes[InquiryData->DeviceType];
+
+    return &PortOtherDeviceType;
+}
+
+
+/* Copies an inquiry string field, replacing characters that are not allowed in device IDs */
+static
+VOID
+PortCopyInquiryField(
+    _Out_writes_z_(Length + 1) PCHAR Destination,
+    _In_reads_(Length) PUCHAR Source,
+    _In_ ULONG Length,
+    _In_ BOOLEAN Trim)
+{
+    ULONG i;
+
+    if (Trim)
+    {
+        while ((Length > 0) && (Source[Length - 1] == ' '))
+            Length--;
+    }
+
+    for (i = 0; i < Length; i++)
+    {
+        if ((Source[i] <= ' ') || (Source[i] >= 0x7f) || (Source[i] == ','))
+            Destination[i] = '_';
+        else
+            Destination[i] = (CHAR)Source[i];
+    }
+
+    Destination[Length] = ANSI_NULL;
+}
+
+
+static
+NTSTATUS
+PortPdoQueryId(
+    _In_ PPDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PIRP Irp,
+    _Out_ PULONG_PTR Information)
+{
+    const PORT_DEVICE_TYPE *DeviceType;
+    PINQUIRYDATA InquiryData;
+    CHAR Vendor[9], Product[17], Revision[5];
+    WCHAR Buffer[512];
+    ULONG Index = 0;
+    PWSTR Id;
+
+    InquiryData = DeviceExtension->InquiryData;
+    DeviceType = PortGetDeviceType(InquiryData);
+
+    switch (IoGetCurrentIrpStackLocation(Irp)->Parameters.QueryId.IdType)
+    {
+        case BusQueryDeviceID:
+            DPRINT("IRP_MJ_PNP / IRP_MN_QUERY_ID / BusQueryDeviceID\n");
+            PortCopyInquiryField(Vendor, InquiryData->VendorId, 8, TRUE);
+            PortCopyInquiryField(Product, InquiryData->ProductId, 16, TRUE);
+            PortCopyInquiryField(Revision, InquiryData->ProductRevisionLevel, 4, TRUE);
+
+            Index += swprintf(&Buffer[Index], L"SCSI\\%hs&Ven_%hs&Prod_%hs&Rev_%hs",
+                              DeviceType->DeviceType, Vendor, Product, Revision) + 1;
+            break;
+
+        case BusQueryHardwareIDs:
+            DPRINT("IRP_MJ_PNP / IRP_MN_QUERY_ID / BusQueryHardwareIDs\n");
+            PortCopyInquiryField(Vendor, InquiryData->VendorId, 8, FALSE);
+            PortCopyInquiryField(Product, InquiryData->ProductId, 16, FALSE);
+            PortCopyInquiryField(Revision, InquiryData->ProductRevisionLevel, 4, FALSE);
+
+            Index += swprintf(&Buffer[Index], L"SCSI\\%hs%hs%hs%hs",
+                              DeviceType->DeviceType, Vendor, Product, Revision) + 1;
+            Index += swprintf(&Buffer[Index], L"SCSI\\%hs%hs%hs",
+                              DeviceType->DeviceType, Vendor, Product) + 1;
+            Index += swprintf(&Buffer[Index], L"SCSI\\%hs%hs",
+                              DeviceType->DeviceType, Vendor) + 1;
+            Index += swprintf(&Buffer[Index], L"SCSI\\%hs%hs%.1hs",
+                              Vendor, Product, Revision) + 1;
+            Index += swprintf(&Buffer[Index], L"%hs%hs%.1hs",
+                              Vendor, Product, Revision) + 1;
+            Index += swprintf(&Buffer[Index], L"%hs",
+                              DeviceType->GenericType) + 1;
+            Buffer[Index++] = UNICODE_NULL;
+            break;
+
+        case BusQueryCompatibleIDs:
+            DPRINT("IRP_MJ_PNP / IRP_MN_QUERY_ID / BusQueryCompatibleIDs\n");
+            Index += swprintf(&Buffer[Index], L"SCSI\\%hs",
+                              DeviceType->DeviceType) + 1;
+            Index += swprintf(&Buffer[Index], L"SCSI\\RAW") + 1;
+            Buffer[Index++] = UNICODE_NULL;
+            break;
+
+        case BusQueryInstanceID:
+            DPRINT("IRP_MJ_PNP / IRP_MN_QUERY_ID / BusQueryInstanceID\n");
+            Index += swprintf(&Buffer[Index], L"%02x%02x%02x",
+                              DeviceExtension->Bus, DeviceExtension->Target, DeviceExtension->Lun) + 1;
+            break;
+
+        default:
+            DPRINT1("IRP_MJ_PNP / IRP_MN_QUERY_ID / Unknown type 0x%lx\n",
+                    IoGetCurrentIrpStackLocation(Irp)->Parameters.QueryId.IdType);
+            *Information = Irp->IoStatus.Information;
+            return Irp->IoStatus.Status;
+    }
+
+    Id = ExAllocatePoolWithTag(PagedPool, Index * sizeof(WCHAR), TAG_PNP_ID);
+    if (Id == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    RtlCopyMemory(Id, Buffer, Index * sizeof(WCHAR));
+
+    *Information = (ULONG_PTR)Id;
+
+    return STATUS_SUCCESS;
+}
+
+
+static
+NTSTATUS
+PortPdoQueryCapabilities(
+    _In_ PPDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PIRP Irp)
+{
+    PDEVICE_CAPABILITIES Capabilities;
+
+    Capabilities = IoGetCurrentIrpStackLocation(Irp)->Parameters.DeviceCapabilities.Capabilities;
+
+    if ((Capabilities->Version != 1) ||
+        (Capabilities->Size < sizeof(DEVICE_CAPABILITIES)))
+        return STATUS_UNSUCCESSFUL;
+
+    Capabilities->UniqueID = FALSE;
+    Capabilities->SilentInstall = TRUE;
+    Capabilities->Address = ((ULONG)DeviceExtension->Bus << 16) |
+                            ((ULONG)DeviceExtension->Target << 8) |
+                            DeviceExtension->Lun;
+
+    return STATUS_SUCCESS;
+}
+
+
+static
+NTSTATUS
+PortPdoQueryTargetRelation(
+    _In_ PPDO_DEVICE_EXTENSION DeviceExtension,
+    _Out_ PULONG_PTR Information)
+{
+    PDEVICE_RELATIONS DeviceRelations;
+
+    DeviceRelations = ExAllocatePoolWithTag(PagedPool,
+                                            sizeof(DEVICE_RELATIONS),
+                                            TAG_RELATIONS);
+    if (DeviceRelations == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    ObReferenceObject(DeviceExtension->Device);
+    DeviceRelations->Count = 1;
+    DeviceRelations->Objects[0] = DeviceExtension->Device;
+
+    *Information = (ULONG_PTR)DeviceRelations;
+
+    return STATUS_SUCCESS;
+}
+
+
+static
+NTSTATUS
+PortPdoQueryProperty(
+    _In_ PPDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PIRP Irp,
+    _Out_ PULONG_PTR Information)
+{
+    PFDO_DEVICE_EXTENSION FdoDeviceExtension;
+    PSTORAGE_PROPERTY_QUERY PropertyQuery;
+    PSTORAGE_DEVICE_DESCRIPTOR DeviceDescriptor;
+    STORAGE_ADAPTER_DESCRIPTOR AdapterDescriptor;
+    PINQUIRYDATA InquiryData;
+    PIO_STACK_LOCATION Stack;
+    ULONG OutputLength;
+    ULONG Size;
+    PUCHAR Ptr;
+
+    Stack = IoGetCurrentIrpStackLocation(Irp);
+    OutputLength = Stack->Parameters.DeviceIoControl.OutputBufferLength;
+
+    if (Stack->Parameters.DeviceIoControl.InputBufferLength < FIELD_OFFSET(STORAGE_PROPERTY_QUERY, AdditionalParameters))
+        return STATUS_INVALID_PARAMETER;
+
+    PropertyQuery = (PSTORAGE_PROPERTY_QUERY)Irp->AssociatedIrp.SystemBuffer;
+
+    if ((PropertyQuery->PropertyId != StorageDeviceProperty) &&
+        (PropertyQuery->PropertyId != StorageAdapterProperty))
+        return STATUS_NOT_SUPPORTED;
+
+    if (PropertyQuery->QueryType == PropertyExistsQuery)
+        return STATUS_SUCCESS;
+
+    if (PropertyQuery->QueryType != PropertyStandardQuery)
+        return STATUS_INVALID_PARAMETER;
+
+    FdoDeviceExtension = (PFDO_DEVICE_EXTENSION)DeviceExtension->AttachedFdo->DeviceExtension;
+
+    if (PropertyQuery->PropertyId == StorageAdapterProperty)
+    {
+        RtlZeroMemory(&AdapterDescriptor, sizeof(STORAGE_ADAPTER_DESCRIPTOR));
+        AdapterDescriptor.Version = sizeof(STORAGE_ADAPTER_DESCRIPTOR);
+        AdapterDescriptor.Size = sizeof(STORAGE_ADAPTER_DESCRIPTOR);
+        AdapterDescriptor.MaximumTransferLength = FdoDeviceExtension->Miniport.PortConfig.MaximumTransferLength;
+        AdapterDescriptor.MaximumPhysicalPages = FdoDeviceExtension->Miniport.PortConfig.NumberOfPhysicalBreaks;
+        AdapterDescriptor.AlignmentMask = FdoDeviceExtension->Miniport.PortConfig.AlignmentMask;
+        AdapterDescriptor.AdapterUsesPio = FALSE;
+        AdapterDescriptor.AdapterScansDown = FdoDeviceExtension->Miniport.PortConfig.AdapterScansDown;
+        AdapterDescriptor.CommandQueueing = (FdoDeviceExtension->DefaultQueueDepth > 1);
+        AdapterDescriptor.AcceleratedTransfer = TRUE;
+        AdapterDescriptor.BusType = BusTypeScsi;
+        AdapterDescriptor.BusMajorVersion = 2;
+        AdapterDescriptor.BusMinorVersion = 0;
+
+        Size = min(OutputLength, sizeof(STORAGE_ADAPTER_DESCRIPTOR));
+        RtlCopyMemory(Irp->AssociatedIrp.SystemBuffer, &AdapterDescriptor, Size);
+
+        *Information = Size;
+        return STATUS_SUCCESS;
+    }
+
+    /* The device descriptor is followed by the raw inquiry data and the vendor, product and revision strings */
+    InquiryData = DeviceExtension->InquiryData;
+    Size = FIELD_OFFSET(STORAGE_DEVICE_DESCRIPTOR, RawDeviceProperties) + INQUIRYDATABUFFERSIZE + 9 + 17 + 5;
+
+    DeviceDescriptor = ExAllocatePoolWithTag(PagedPool, Size, TAG_DESCRIPTOR);
+    if (DeviceDescriptor == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    RtlZeroMemory(DeviceDescriptor, Size);
+    DeviceDescriptor->Version = sizeof(STORAGE_DEVICE_DESCRIPTOR);
+    DeviceDescriptor->Size = Size;
+    DeviceDescriptor->DeviceType = InquiryData->DeviceType;
+    DeviceDescriptor->DeviceTypeModifier = InquiryData->DeviceTypeModifier;
+    DeviceDescriptor->RemovableMedia = InquiryData->RemovableMedia;
+    DeviceDescriptor->CommandQueueing = (FdoDeviceExtension->DefaultQueueDepth > 1);
+    DeviceDescriptor->BusType = BusTypeScsi;
+    DeviceDescriptor->RawPropertiesLength = INQUIRYDATABUFFERSIZE;
+
+    Ptr = DeviceDescriptor->RawDeviceProperties;
+    RtlCopyMemory(Ptr, InquiryData, INQUIRYDATABUFFERSIZE);
+    Ptr += INQUIRYDATABUFFERSIZE;
+
+    DeviceDescriptor->VendorIdOffset = (ULONG)(Ptr - (PUCHAR)DeviceDescriptor);
+    RtlCopyMemory(Ptr, InquiryData->VendorId, 8);
+    Ptr += 9;
+
+    DeviceDescriptor->ProductIdOffset = (ULONG)(Ptr - (PUCHAR)DeviceDescriptor);
+    RtlCopyMemory(Ptr, InquiryData->ProductId, 16);
+    Ptr += 17;
+
+    DeviceDescriptor->ProductRevisionOffset = (ULONG)(Ptr - (PUCHAR)DeviceDescriptor);
+    RtlCopyMemory(Ptr, InquiryData->ProductRevisionLevel, 4);
+
+    /* No serial number */
+    DeviceDescriptor->SerialNumberOffset = 0;
+
+    Size = min(OutputLength, Size);
+    RtlCopyMemory(Irp->AssociatedIrp.SystemBuffer, DeviceDescriptor, Size);
+
+    ExFreePoolWithTag(DeviceDescriptor, TAG_DESCRIPTOR);
+
+    *Information = Size;
+    return STATUS_SUCCESS;
+}
+
+
+static
+NTSTATUS
+PortPdoGetAddress(
+    _In_ PPDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PIRP Irp,
+    _Out_ PULONG_PTR Information)
+{
+    PSCSI_ADDRESS Address;
+
+    if (IoGetCurrentIrpStackLocation(Irp)->Parameters.DeviceIoControl.OutputBufferLength < sizeof(SCSI_ADDRESS))
+        return STATUS_BUFFER_TOO_SMALL;
+
+    Address = (PSCSI_ADDRESS)Irp->AssociatedIrp.SystemBuffer;
+    Address->Length = sizeof(SCSI_ADDRESS);
+    Address->PortNumber = 0;
+    Address->PathId = DeviceExtension->Bus;
+    Address->TargetId = DeviceExtension->Target;
+    Address->Lun = DeviceExtension->Lun;
+
+    *Information = sizeof(SCSI_ADDRESS);
+    return STATUS_SUCCESS;
+}
+
+
+NTSTATUS
+PortCreatePdo(
+    _In_ PFDO_DEVICE_EXTENSION FdoDeviceExtension,
+    _In_ UCHAR Bus,
+    _In_ UCHAR Target,
+    _In_ UCHAR Lun,
+    _In_ PINQUIRYDATA InquiryData)
+{
+    PPDO_DEVICE_EXTENSION DeviceExtension;
+    PDEVICE_OBJECT Pdo;
+    NTSTATUS Status;
+
+    DPRINT("PortCreatePdo(%p %u %u %u %p)\n",
+           FdoDeviceExtension, Bus, Target, Lun, InquiryData);
+
+    Status = IoCreateDevice(FdoDeviceExtension->Device->DriverObject,
+                            sizeof(PDO_DEVICE_EXTENSION),
+                            NULL,
+                            FILE_DEVICE_MASS_STORAGE,
+                            FILE_AUTOGENERATED_DEVICE_NAME | FILE_DEVICE_SECURE_OPEN,
+                            FALSE,
+                            &Pdo);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("IoCreateDevice() failed (Status 0x%08lx)\n", Status);
+        return Status;
+    }
+
+    DeviceExtension = (PPDO_DEVICE_EXTENSION)Pdo->DeviceExtension;
+    RtlZeroMemory(DeviceExtension, sizeof(PDO_DEVICE_EXTENSION));
+
+    DeviceExtension->InquiryData = ExAllocatePoolWithTag(NonPagedPool,
+                                                         INQUIRYDATABUFFERSIZE,
+                                                         TAG_INQUIRY_DATA);
+    if (DeviceExtension->InquiryData == NULL)
+    {
+        IoDeleteDevice(Pdo);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    RtlCopyMemory(DeviceExtension->InquiryData,
+                  InquiryData,
+                  INQUIRYDATABUFFERSIZE);
+
+    DeviceExtension->ExtensionType = PdoExtension;
+    DeviceExtension->Device = Pdo;
+    DeviceExtension->AttachedFdo = FdoDeviceExtension->Device;
+    DeviceExtension->PnpState = dsStopped;
+    DeviceExtension->Bus = Bus;
+    DeviceExtension->Target = Target;
+    DeviceExtension->Lun = Lun;
+
+    Pdo->Flags |= DO_DIRECT_IO;
+    Pdo->Flags |= DO_POWER_PAGABLE;
+    Pdo->AlignmentRequirement = FdoDeviceExtension->Device->AlignmentRequirement;
+
+    InsertTailList(&FdoDeviceExtension->PdoListHead,
+                   &DeviceExtension->PdoListEntry);
+
+    Pdo->Flags &= ~DO_DEVICE_INITIALIZING;
+
+    return STATUS_SUCCESS;
+}
+
+
+/* The caller has already removed the PDO from the adapter's list */
+VOID
+PortDeletePdo(
+    _In_ PPDO_DEVICE_EXTENSION DeviceExtension)
+{
+    DPRINT("PortDeletePdo(%p)\n", DeviceExtension);
+
+    ExFreePoolWithTag(DeviceExtension->InquiryData, TAG_INQUIRY_DATA);
+    IoDeleteDevice(DeviceExtension->Device);
+}
+
+
 NTSTATUS
 NTAPI
 PortPdoScsi(
     _In_ PDEVICE_OBJECT DeviceObject,
     _In_ PIRP Irp)
 {
-    DPRINT1("PortPdoScsi()\n");
+    PPDO_DEVICE_EXTENSION DeviceExtension;
+    PSCSI_REQUEST_BLOCK Srb;
+
+    DPRINT("PortPdoScsi(%p %p)\n",
+           DeviceObject, Irp);
+
+    DeviceExtension = (PPDO_DEVICE_EXTENSION)DeviceObject->DeviceExtension;
+    ASSERT(DeviceExtension);
+    ASSERT(DeviceExtension->ExtensionType == PdoExtension);
+
+    if (DeviceExtension->AttachedFdo == NULL)
+    {
+        Irp->IoStatus.Information = 0;
+        Irp->IoStatus.Status = STATUS_NO_SUCH_DEVICE;
+        IoCompleteRequest(Irp, IO_NO_INCREMENT);
+        return STATUS_NO_SUCH_DEVICE;
+    }
+
+    /* Requests always go to the logical unit this PDO was created for */
+    Srb = IoGetCurrentIrpStackLocation(Irp)->Parameters.Scsi.Srb;
+    if (Srb != NULL)
+    {
+        Srb->PathId = DeviceExtension->Bus;
+        Srb->TargetId = DeviceExtension->Target;
+        Srb->Lun = DeviceExtension->Lun;
+    }
+
+    /* Queue the request on the adapter */
+    return PortQueueRequest((PFDO_DEVICE_EXTENSION)DeviceExtension->AttachedFdo->DeviceExtension,
+                            Irp);
+}
+
+
+NTSTATUS
+NTAPI
+PortPdoDeviceControl(
+    _In_ PDEVICE_OBJECT DeviceObject,
+    _In_ PIRP Irp)
+{
+    PPDO_DEVICE_EXTENSION DeviceExtension;
+    PIO_STACK_LOCATION Stack;
+    ULONG_PTR Information = 0;
+    NTSTATUS Status;
+
+    DPRINT("PortPdoDeviceControl(%p %p)\n",
+           DeviceObject, Irp);
+
+    DeviceExtension = (PPDO_DEVICE_EXTENSION)DeviceObject->DeviceExtension;
+    ASSERT(DeviceExtension);
+    ASSERT(DeviceExtension->ExtensionType == PdoExtension);
+
+    Stack = IoGetCurrentIrpStackLocation(Irp);
+
+    switch (Stack->Parameters.DeviceIoControl.IoControlCode)
+    {
+        case IOCTL_STORAGE_QUERY_PROPERTY:
+            DPRINT("IOCTL_STORAGE_QUERY_PROPERTY\n");
+            Status = PortPdoQueryProperty(DeviceExtension, Irp, &Information);
+            break;
 
-    Irp->IoStatus.Information = 0;
-    Irp->IoStatus.Status = STATUS_SUCCESS;
+        case IOCTL_SCSI_GET_ADDRESS:
+            DPRINT("IOCTL_SCSI_GET_ADDRESS\n");
+            Status = PortPdoGetAddress(DeviceExtension, Irp, &Information);
+            break;
+
+        default:
+            DPRINT1("Unsupported IOCTL 0x%lx\n", Stack->Parameters.DeviceIoControl.IoControlCode);
+            Status = STATUS_INVALID_DEVICE_REQUEST;
+            break;
+    }
+
+    Irp->IoStatus.Information = Information;
+    Irp->IoStatus.Status = Status;
     IoCompleteRequest(Irp, IO_NO_INCREMENT);
-    return STATUS_SUCCESS;
+
+    return Status;
 }
 
 
@@ -36,12 +509,89 @@ PortPdoPnp(
     _In_ PDEVICE_OBJECT DeviceObject,
     _In_ PIRP Irp)
 {
-    DPRINT1("PortPdoPnp()\n");
+    PPDO_DEVICE_EXTENSION DeviceExtension;
+    PIO_STACK_LOCATION Stack;
+    ULONG_PTR Information = 0;
+    NTSTATUS Status;
+
+    DPRINT1("PortPdoPnp(%p %p)\n",
+            DeviceObject, Irp);
+
+    DeviceExtension = (PPDO_DEVICE_EXTENSION)DeviceObject->DeviceExtension;
+    ASSERT(DeviceExtension);
+    ASSERT(DeviceExtension->ExtensionType == PdoExtension);
+
+    Stack = IoGetCurrentIrpStackLocation(Irp);
+
+    switch (Stack->MinorFunction)
+    {
+        case IRP_MN_START_DEVICE: /* 0x00 */
+            DPRINT1("IRP_MJ_PNP / IRP_MN_START_DEVICE\n");
+            DeviceExtension->PnpState = dsStarted;
+            Status = STATUS_SUCCESS;
+            break;
+
+        case IRP_MN_QUERY_REMOVE_DEVICE: /* 0x01 */
+        case IRP_MN_CANCEL_REMOVE_DEVICE: /* 0x03 */
+        case IRP_MN_QUERY_STOP_DEVICE: /* 0x05 */
+        case IRP_MN_CANCEL_STOP_DEVICE: /* 0x06 */
+            Status = STATUS_SUCCESS;
+            break;
 
-    Irp->IoStatus.Information = 0;
-    Irp->IoStatus.Status = STATUS_SUCCESS;
+        case IRP_MN_REMOVE_DEVICE: /* 0x02 */
+            DPRINT1("IRP_MJ_PNP / IRP_MN_REMOVE_DEVICE\n");
+            /* The device object itself goes away with the adapter */
+            DeviceExtension->PnpState = dsRemoved;
+            Status = STATUS_SUCCESS;
+            break;
+
+        case IRP_MN_STOP_DEVICE: /* 0x04 */
+            DPRINT1("IRP_MJ_PNP / IRP_MN_STOP_DEVICE\n");
+            DeviceExtension->PnpState = dsStopped;
+            Status = STATUS_SUCCESS;
+            break;
+
+        case IRP_MN_QUERY_DEVICE_RELATIONS: /* 0x07 */
+            DPRINT1("IRP_MJ_PNP / IRP_MN_QUERY_DEVICE_RELATIONS\n");
+            if (Stack->Parameters.QueryDeviceRelations.Type == TargetDeviceRelation)
+            {
+                Status = PortPdoQueryTargetRelation(DeviceExtension, &Information);
+            }
+            else
+            {
+                Information = Irp->IoStatus.Information;
+                Status = Irp->IoStatus.Status;
+            }
+            break;
+
+        case IRP_MN_QUERY_CAPABILITIES: /* 0x09 */
+            DPRINT1("IRP_MJ_PNP / IRP_MN_QUERY_CAPABILITIES\n");
+            Status = PortPdoQueryCapabilities(DeviceExtension, Irp);
+            break;
+
+        case IRP_MN_QUERY_ID: /* 0x13 */
+            DPRINT1("IRP_MJ_PNP / IRP_MN_QUERY_ID\n");
+            Status = PortPdoQueryId(DeviceExtension, Irp, &Information);
+            break;
+
+        case IRP_MN_SURPRISE_REMOVAL: /* 0x17 */
+            DPRINT1("IRP_MJ_PNP / IRP_MN_SURPRISE_REMOVAL\n");
+            DeviceExtension->PnpState = dsSurpriseRemoved;
+            Status = STATUS_SUCCESS;
+            break;
+
+        default:
+            DPRINT1("IRP_MJ_PNP / Unknown IOCTL 0x%lx\n", Stack->MinorFunction);
+            Information = Irp->IoStatus.Information;
+            Status = Irp->IoStatus.Status;
+            break;
+    }
+
+    Irp->IoStatus.Information = Information;
+    Irp->IoStatus.Status = Status;
     IoCompleteRequest(Irp, IO_NO_INCREMENT);
-    return STATUS_SUCCESS;
+
+    return Status;
 }
 
 /* EOF */
@@ -31,6 +31,18 @@
 #define TAG_ADDRESS_MAPPING 'MAtS'
 #define TAG_INQUIRY_DATA    'QItS'
 #define TAG_SENSE_DATA      'NStS'
+#define TAG_LUN_QUEUE       'QLtS'
+#define TAG_SRB_EXTENSION   'EStS'
+#define TAG_RELATIONS       'RDtS'
+#define TAG_PNP_ID          'IPtS'
+#define TAG_DESCRIPTOR      'DStS'
+
+/* Requests per logical unit for miniports that support tagged queuing */
+#define PORT_DEFAULT_QUEUE_DEPTH    20
+#define PORT_MAXIMUM_QUEUE_DEPTH    254
+
+/* Busy, ready and queue depth changes the miniport can report between two completion DPCs */
+#define PORT_MAXIMUM_LUN_NOTIFICATIONS  32
 
 typedef enum
 {
@@ -67,6 +79,37 @@ typedef struct _DRIVER_OBJECT_EXTENSION
     LIST_ENTRY InitDataListHead;
 } DRIVER_OBJECT_EXTENSION, *PDRIVER_OBJECT_EXTENSION;
 
+typedef struct _PORT_LUN_QUEUE
+{
+    LIST_ENTRY Entry;
+    UCHAR PathId;
+    UCHAR TargetId;
+    UCHAR Lun;
+    BOOLEAN Busy;
+    ULONG BusyRequests;
+    ULONG QueueDepth;
+    ULONG OutstandingCount;
+    LIST_ENTRY PendingListHead;
+} PORT_LUN_QUEUE, *PPORT_LUN_QUEUE;
+
+typedef enum
+{
+    LunNotifyBusy,
+    LunNotifyReady,
+    LunNotifyQueueDepth
+} PORT_LUN_NOTIFICATION_TYPE;
+
+typedef struct _PORT_LUN_NOTIFICATION
+{
+    LIST_ENTRY Entry;
+    SINGLE_LIST_ENTRY FreeEntry;
+    PORT_LUN_NOTIFICATION_TYPE Type;
+    UCHAR PathId;
+    UCHAR TargetId;
+    UCHAR Lun;
+    ULONG Value;
+} PORT_LUN_NOTIFICATION, *PPORT_LUN_NOTIFICATION;
+
 typedef struct _MINIPORT_DEVICE_EXTENSION
 {
     struct _MINIPORT *Miniport;
@@ -105,6 +148,23 @@ typedef struct _FDO_DEVICE_EXTENSION
     PHW_PASSIVE_INITIALIZE_ROUTINE HwPassiveInitRoutine;
     PKINTERRUPT Interrupt;
     ULONG InterruptIrql;
+    KSPIN_LOCK StartIoLock;
+    KSPIN_LOCK QueueLock;
+    LIST_ENTRY LunQueueListHead;
+    ULONG DefaultQueueDepth;
+    KSPIN_LOCK CompletionLock;
+    LIST_ENTRY CompletionListHead;
+    KDPC CompletionDpc;
+    KSPIN_LOCK NotificationLock;
+    LIST_ENTRY NotificationListHead;
+    SINGLE_LIST_ENTRY NotificationFreeList;
+    PORT_LUN_NOTIFICATION Notifications[PORT_MAXIMUM_LUN_NOTIFICATIONS];
+    PSCSI_REQUEST_BLOCK InternalSrb;
+    LONG InternalSrbCompleted;
+    KEVENT InternalSrbEvent;
+    BOOLEAN SrbExtensionLookasideInitialized;
+    NPAGED_LOOKASIDE_LIST SrbExtensionLookaside;
+    LIST_ENTRY PdoListHead;
 } FDO_DEVICE_EXTENSION, *PFDO_DEVICE_EXTENSION;
 
 
@@ -112,10 +172,16 @@ typedef struct _PDO_DEVICE_EXTENSION
 {
     EXTENSION_TYPE ExtensionType;
 
+    PDEVICE_OBJECT Device;
     PDEVICE_OBJECT AttachedFdo;
+    LIST_ENTRY PdoListEntry;
 
     DEVICE_STATE PnpState;
 
+    UCHAR Bus;
+    UCHAR Target;
+    UCHAR Lun;
+    PINQUIRYDATA InquiryData;
 } PDO_DEVICE_EXTENSION, *PPDO_DEVICE_EXTENSION;
 
 
@@ -154,6 +220,11 @@ BOOLEAN
 MiniportHwInterrupt(
     _In_ PMINIPORT Miniport);
 
+BOOLEAN
+MiniportBuildIo(
+    _In_ PMINIPORT Miniport,
+    _In_ PSCSI_REQUEST_BLOCK Srb);
+
 BOOLEAN
 MiniportStartIo(
     _In_ PMINIPORT Miniport,
@@ -219,12 +290,30 @@ AllocateAddressMapping(
 
 /* pdo.c */
 
+NTSTATUS
+PortCreatePdo(
+    _In_ PFDO_DEVICE_EXTENSION FdoDeviceExtension,
+    _In_ UCHAR Bus,
+    _In_ UCHAR Target,
+    _In_ UCHAR Lun,
+    _In_ PINQUIRYDATA InquiryData);
+
+VOID
+PortDeletePdo(
+    _In_ PPDO_DEVICE_EXTENSION DeviceExtension);
+
 NTSTATUS
 NTAPI
 PortPdoScsi(
     _In_ PDEVICE_OBJECT DeviceObject,
     _In_ PIRP Irp);
 
+NTSTATUS
+NTAPI
+PortPdoDeviceControl(
+    _In_ PDEVICE_OBJECT DeviceObject,
+    _In_ PIRP Irp);
+
 NTSTATUS
 NTAPI
 PortPdoPnp(
@@ -232,6 +321,48 @@ PortPdoPnp(
     _In_ PIRP Irp);
 
 
+/* queue.c */
+
+VOID
+PortInitializeRequestQueue(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension);
+
+VOID
+PortConfigureRequestQueue(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension);
+
+VOID
+PortDeleteRequestQueue(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension);
+
+NTSTATUS
+PortQueueRequest(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PIRP Irp);
+
+VOID
+PortRequestComplete(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb);
+
+BOOLEAN
+PortSetLunQueueDepth(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ UCHAR PathId,
+    _In_ UCHAR TargetId,
+    _In_ UCHAR Lun,
+    _In_ ULONG Depth);
+
+BOOLEAN
+PortSetLunBusy(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ UCHAR PathId,
+    _In_ UCHAR TargetId,
+    _In_ UCHAR Lun,
+    _In_ BOOLEAN Busy,
+    _In_ ULONG RequestsToComplete);
+
+
 /* storport.c */
 
 PHW_INITIALIZATION_DATA
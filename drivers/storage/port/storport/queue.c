@@ -0,0 +1,667 @@
+/*
+ * PROJECT:     ReactOS Storport Driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Storport request queue
+ */
+
+/* INCLUDES *******************************************************************/
+
+#include "precomp.h"
+
+#define NDEBUG
+#include <debug.h>
+
+
+/* FUNCTIONS ******************************************************************/
+
+/*
+ * Requests are kept in one queue per logical unit. A logical unit may have
+ * up to QueueDepth requests outstanding in the miniport; the rest wait in
+ * the pending list. The miniport reports completed requests through
+ * StorPortNotification(RequestComplete), possibly from its interrupt routine,
+ * so these are only moved to the completion list there. The completion DPC
+ * completes the IRPs and starts the next requests without holding the
+ * StartIo lock.
+ *
+ * Busy, ready and queue depth changes can also be reported at DIRQL, where
+ * the queued spinlocks can't be taken. They are recorded in one of the
+ * preallocated notifications and applied by the completion DPC.
+ *
+ * Lock order: StartIoLock -> QueueLock. The CompletionLock and the
+ * NotificationLock are only used by the ExInterlocked list routines and
+ * never held while taking another lock.
+ */
+
+static
+NTSTATUS
+PortSrbStatusToNtStatus(
+    _In_ UCHAR SrbStatus)
+{
+    switch (SRB_STATUS(SrbStatus))
+    {
+        case SRB_STATUS_SUCCESS:
+        case SRB_STATUS_DATA_OVERRUN:
+            return STATUS_SUCCESS;
+
+        case SRB_STATUS_BUSY:
+            return STATUS_DEVICE_BUSY;
+
+        case SRB_STATUS_TIMEOUT:
+        case SRB_STATUS_COMMAND_TIMEOUT:
+            return STATUS_IO_TIMEOUT;
+
+        case SRB_STATUS_BAD_SRB_BLOCK_LENGTH:
+        case SRB_STATUS_BAD_FUNCTION:
+        case SRB_STATUS_INVALID_REQUEST:
+            return STATUS_INVALID_DEVICE_REQUEST;
+
+        case SRB_STATUS_NO_DEVICE:
+        case SRB_STATUS_SELECTION_TIMEOUT:
+        case SRB_STATUS_INVALID_PATH_ID:
+        case SRB_STATUS_INVALID_TARGET_ID:
+        case SRB_STATUS_INVALID_LUN:
+            return STATUS_DEVICE_DOES_NOT_EXIST;
+
+        default:
+            return STATUS_IO_DEVICE_ERROR;
+    }
+}
+
+
+/* The caller must hold the QueueLock */
+static
+PPORT_LUN_QUEUE
+PortGetLunQueue(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ UCHAR PathId,
+    _In_ UCHAR TargetId,
+    _In_ UCHAR Lun,
+    _In_ BOOLEAN Create)
+{
+    PPORT_LUN_QUEUE LunQueue;
+    PLIST_ENTRY ListEntry;
+
+    ListEntry = DeviceExtension->LunQueueListHead.Flink;
+    while (ListEntry != &DeviceExtension->LunQueueListHead)
+    {
+        LunQueue = CONTAINING_RECORD(ListEntry,
+                                     PORT_LUN_QUEUE,
+                                     Entry);
+        if ((LunQueue->PathId == PathId) &&
+            (LunQueue->TargetId == TargetId) &&
+            (LunQueue->Lun == Lun))
+            return LunQueue;
+
+        ListEntry = ListEntry->Flink;
+    }
+
+    if (!Create)
+        return NULL;
+
+    LunQueue = ExAllocatePoolWithTag(NonPagedPool,
+                                     sizeof(PORT_LUN_QUEUE),
+                                     TAG_LUN_QUEUE);
+    if (LunQueue == NULL)
+        return NULL;
+
+    RtlZeroMemory(LunQueue, sizeof(PORT_LUN_QUEUE));
+
+    LunQueue->PathId = PathId;
+    LunQueue->TargetId = TargetId;
+    LunQueue->Lun = Lun;
+    LunQueue->QueueDepth = DeviceExtension->DefaultQueueDepth;
+    InitializeListHead(&LunQueue->PendingListHead);
+
+    InsertTailList(&DeviceExtension->LunQueueListHead,
+                   &LunQueue->Entry);
+
+    return LunQueue;
+}
+
+
+/* The caller must hold the QueueLock */
+static
+BOOLEAN
+PortCanStartRequest(
+    _In_ PPORT_LUN_QUEUE LunQueue)
+{
+    return !LunQueue->Busy &&
+           (LunQueue->OutstandingCount < LunQueue->QueueDepth) &&
+           !IsListEmpty(&LunQueue->PendingListHead);
+}
+
+
+/* Must be called at DISPATCH_LEVEL */
+static
+VOID
+PortStartNextRequests(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PPORT_LUN_QUEUE LunQueue)
+{
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PLIST_ENTRY ListEntry;
+    PSCSI_REQUEST_BLOCK Srb;
+    PIRP Irp;
+
+    for (;;)
+    {
+        KeAcquireInStackQueuedSpinLockAtDpcLevel(&DeviceExtension->QueueLock,
+                                                 &LockHandle);
+
+        if (!PortCanStartRequest(LunQueue))
+        {
+            KeReleaseInStackQueuedSpinLockFromDpcLevel(&LockHandle);
+            break;
+        }
+
+        ListEntry = RemoveHeadList(&LunQueue->PendingListHead);
+        LunQueue->OutstandingCount++;
+
+        KeReleaseInStackQueuedSpinLockFromDpcLevel(&LockHandle);
+
+        Irp = CONTAINING_RECORD(ListEntry, IRP, Tail.Overlay.ListEntry);
+        Srb = IoGetCurrentIrpStackLocation(Irp)->Parameters.Scsi.Srb;
+
+        /* HwBuildIo runs without any lock, so several processors can prepare requests at the same time */
+        if (!MiniportBuildIo(&DeviceExtension->Miniport, Srb))
+        {
+            /* The miniport has already completed the request */
+            continue;
+        }
+
+        KeAcquireInStackQueuedSpinLockAtDpcLevel(&DeviceExtension->StartIoLock,
+                                                 &LockHandle);
+        MiniportStartIo(&DeviceExtension->Miniport, Srb);
+        KeReleaseInStackQueuedSpinLockFromDpcLevel(&LockHandle);
+    }
+}
+
+
+/* Must be called at DISPATCH_LEVEL */
+static
+VOID
+PortStartReadyQueues(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension)
+{
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PPORT_LUN_QUEUE LunQueue;
+    PLIST_ENTRY ListEntry;
+
+    for (;;)
+    {
+        LunQueue = NULL;
+
+        KeAcquireInStackQueuedSpinLockAtDpcLevel(&DeviceExtension->QueueLock,
+                                                 &LockHandle);
+
+        ListEntry = DeviceExtension->LunQueueListHead.Flink;
+        while (ListEntry != &DeviceExtension->LunQueueListHead)
+        {
+            if (PortCanStartRequest(CONTAINING_RECORD(ListEntry, PORT_LUN_QUEUE, Entry)))
+            {
+                LunQueue = CONTAINING_RECORD(ListEntry, PORT_LUN_QUEUE, Entry);
+                break;
+            }
+
+            ListEntry = ListEntry->Flink;
+        }
+
+        KeReleaseInStackQueuedSpinLockFromDpcLevel(&LockHandle);
+
+        if (LunQueue == NULL)
+            break;
+
+        PortStartNextRequests(DeviceExtension, LunQueue);
+    }
+}
+
+
+/* Runs in the completion DPC */
+static
+VOID
+PortApplyLunNotifications(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension)
+{
+    PPORT_LUN_NOTIFICATION Notification;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PPORT_LUN_QUEUE LunQueue;
+    PLIST_ENTRY ListEntry;
+
+    while ((ListEntry = ExInterlockedRemoveHeadList(&DeviceExtension->NotificationListHead,
+                                                    &DeviceExtension->NotificationLock)) != NULL)
+    {
+        Notification = CONTAINING_RECORD(ListEntry, PORT_LUN_NOTIFICATION, Entry);
+
+        KeAcquireInStackQueuedSpinLockAtDpcLevel(&DeviceExtension->QueueLock,
+                                                 &LockHandle);
+
+        LunQueue = PortGetLunQueue(DeviceExtension,
+                                   Notification->PathId,
+                                   Notification->TargetId,
+                                   Notification->Lun,
+                                   (Notification->Type == LunNotifyQueueDepth));
+        if (LunQueue != NULL)
+        {
+            switch (Notification->Type)
+            {
+                case LunNotifyBusy:
+                    LunQueue->Busy = TRUE;
+                    LunQueue->BusyRequests = Notification->Value;
+                    break;
+
+                case LunNotifyReady:
+                    LunQueue->Busy = FALSE;
+                    LunQueue->BusyRequests = 0;
+                    break;
+
+                case LunNotifyQueueDepth:
+                    LunQueue->QueueDepth = Notification->Value;
+                    DPRINT("Queue depth of %u:%u:%u set to %lu\n",
+                           Notification->PathId, Notification->TargetId,
+                           Notification->Lun, Notification->Value);
+                    break;
+            }
+        }
+
+        KeReleaseInStackQueuedSpinLockFromDpcLevel(&LockHandle);
+
+        ExInterlockedPushEntryList(&DeviceExtension->NotificationFreeList,
+                                   &Notification->FreeEntry,
+                                   &DeviceExtension->NotificationLock);
+    }
+}
+
+
+static
+VOID
+NTAPI
+PortCompletionDpc(
+    _In_ PKDPC Dpc,
+    _In_opt_ PVOID DeferredContext,
+    _In_opt_ PVOID SystemArgument1,
+    _In_opt_ PVOID SystemArgument2)
+{
+    PFDO_DEVICE_EXTENSION DeviceExtension;
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PPORT_LUN_QUEUE LunQueue;
+    PSCSI_REQUEST_BLOCK Srb;
+    PLIST_ENTRY ListEntry;
+    PIRP Irp;
+
+    DeviceExtension = (PFDO_DEVICE_EXTENSION)DeferredContext;
+
+    PortApplyLunNotifications(DeviceExtension);
+
+    if (InterlockedExchange(&DeviceExtension->InternalSrbCompleted, FALSE))
+        KeSetEvent(&DeviceExtension->InternalSrbEvent, IO_NO_INCREMENT, FALSE);
+
+    while ((ListEntry = ExInterlockedRemoveHeadList(&DeviceExtension->CompletionListHead,
+                                                    &DeviceExtension->CompletionLock)) != NULL)
+    {
+        Irp = CONTAINING_RECORD(ListEntry, IRP, Tail.Overlay.ListEntry);
+        Srb = IoGetCurrentIrpStackLocation(Irp)->Parameters.Scsi.Srb;
+        LunQueue = (PPORT_LUN_QUEUE)Irp->Tail.Overlay.DriverContext[0];
+
+        DPRINT("Completing Irp %p Srb %p SrbStatus 0x%02x\n",
+               Irp, Srb, Srb->SrbStatus);
+
+        if (Srb->SrbExtension != NULL)
+        {
+            ExFreeToNPagedLookasideList(&DeviceExtension->SrbExtensionLookaside,
+                                        Srb->SrbExtension);
+            Srb->SrbExtension = NULL;
+        }
+
+        Srb->OriginalRequest = NULL;
+
+        KeAcquireInStackQueuedSpinLockAtDpcLevel(&DeviceExtension->QueueLock,
+                                                 &LockHandle);
+
+        ASSERT(LunQueue->OutstandingCount > 0);
+        LunQueue->OutstandingCount--;
+
+        if (LunQueue->Busy && LunQueue->BusyRequests != 0)
+        {
+            if (--LunQueue->BusyRequests == 0)
+                LunQueue->Busy = FALSE;
+        }
+
+        KeReleaseInStackQueuedSpinLockFromDpcLevel(&LockHandle);
+
+        Irp->IoStatus.Status = PortSrbStatusToNtStatus(Srb->SrbStatus);
+        Irp->IoStatus.Information = NT_SUCCESS(Irp->IoStatus.Status) ? Srb->DataTransferLength : 0;
+        IoCompleteRequest(Irp, IO_DISK_INCREMENT);
+    }
+
+    PortStartReadyQueues(DeviceExtension);
+}
+
+
+VOID
+PortInitializeRequestQueue(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension)
+{
+    ULONG i;
+
+    KeInitializeSpinLock(&DeviceExtension->StartIoLock);
+    KeInitializeSpinLock(&DeviceExtension->QueueLock);
+    InitializeListHead(&DeviceExtension->LunQueueListHead);
+    DeviceExtension->DefaultQueueDepth = 1;
+
+    KeInitializeSpinLock(&DeviceExtension->CompletionLock);
+    InitializeListHead(&DeviceExtension->CompletionListHead);
+    KeInitializeDpc(&DeviceExtension->CompletionDpc,
+                    PortCompletionDpc,
+                    DeviceExtension);
+
+    KeInitializeSpinLock(&DeviceExtension->NotificationLock);
+    InitializeListHead(&DeviceExtension->NotificationListHead);
+    DeviceExtension->NotificationFreeList.Next = NULL;
+    for (i = 0; i < PORT_MAXIMUM_LUN_NOTIFICATIONS; i++)
+    {
+        PushEntryList(&DeviceExtension->NotificationFreeList,
+                      &DeviceExtension->Notifications[i].FreeEntry);
+    }
+
+    KeInitializeEvent(&DeviceExtension->InternalSrbEvent,
+                      NotificationEvent,
+                      FALSE);
+}
+
+
+VOID
+PortConfigureRequestQueue(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension)
+{
+    PPORT_CONFIGURATION_INFORMATION PortConfig;
+
+    PortConfig = &DeviceExtension->Miniport.PortConfig;
+
+    /* Only miniports that handle tagged commands get more than one request per logical unit */
+    if (PortConfig->TaggedQueuing && PortConfig->MultipleRequestPerLu)
+        DeviceExtension->DefaultQueueDepth = PORT_DEFAULT_QUEUE_DEPTH;
+    else
+        DeviceExtension->DefaultQueueDepth = 1;
+
+    DPRINT("DefaultQueueDepth: %lu\n", DeviceExtension->DefaultQueueDepth);
+
+    if ((PortConfig->SrbExtensionSize != 0) &&
+        (DeviceExtension->SrbExtensionLookasideInitialized == FALSE))
+    {
+        ExInitializeNPagedLookasideList(&DeviceExtension->SrbExtensionLookaside,
+                                        NULL,
+                                        NULL,
+                                        0,
+                                        PortConfig->SrbExtensionSize,
+                                        TAG_SRB_EXTENSION,
+                                        0);
+        DeviceExtension->SrbExtensionLookasideInitialized = TRUE;
+    }
+}
+
+
+VOID
+PortDeleteRequestQueue(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension)
+{
+    PPORT_LUN_QUEUE LunQueue;
+    PLIST_ENTRY ListEntry;
+
+    /* Let a completion DPC that is still running finish with the queues */
+    KeFlushQueuedDpcs();
+
+    while (!IsListEmpty(&DeviceExtension->LunQueueListHead))
+    {
+        ListEntry = RemoveHeadList(&DeviceExtension->LunQueueListHead);
+        LunQueue = CONTAINING_RECORD(ListEntry,
+                                     PORT_LUN_QUEUE,
+                                     Entry);
+
+        ASSERT(IsListEmpty(&LunQueue->PendingListHead));
+        ASSERT(LunQueue->OutstandingCount == 0);
+
+        ExFreePoolWithTag(LunQueue, TAG_LUN_QUEUE);
+    }
+
+    if (DeviceExtension->SrbExtensionLookasideInitialized)
+    {
+        ExDeleteNPagedLookasideList(&DeviceExtension->SrbExtensionLookaside);
+        DeviceExtension->SrbExtensionLookasideInitialized = FALSE;
+    }
+}
+
+
+NTSTATUS
+PortQueueRequest(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PIRP Irp)
+{
+    KLOCK_QUEUE_HANDLE LockHandle;
+    PPORT_LUN_QUEUE LunQueue;
+    PSCSI_REQUEST_BLOCK Srb;
+    PVOID SrbExtension = NULL;
+    NTSTATUS Status;
+    KIRQL OldIrql;
+
+    Srb = IoGetCurrentIrpStackLocation(Irp)->Parameters.Scsi.Srb;
+
+    DPRINT("PortQueueRequest(%p %p) Srb %p\n",
+           DeviceExtension, Irp, Srb);
+
+    if (Srb == NULL)
+    {
+        Status = STATUS_INVALID_PARAMETER;
+        goto done;
+    }
+
+    if (DeviceExtension->PnpState != dsStarted)
+    {
+        Srb->SrbStatus = SRB_STATUS_NO_HBA;
+        Status = STATUS_DEVICE_NOT_READY;
+        goto done;
+    }
+
+    switch (Srb->Function)
+    {
+        case SRB_FUNCTION_CLAIM_DEVICE:
+        case SRB_FUNCTION_RELEASE_DEVICE:
+            Srb->SrbStatus = SRB_STATUS_SUCCESS;
+            Status = STATUS_SUCCESS;
+            goto done;
+
+        default:
+            break;
+    }
+
+    if (DeviceExtension->SrbExtensionLookasideInitialized)
+    {
+        SrbExtension = ExAllocateFromNPagedLookasideList(&DeviceExtension->SrbExtensionLookaside);
+        if (SrbExtension == NULL)
+        {
+            Srb->SrbStatus = SRB_STATUS_INTERNAL_ERROR;
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto done;
+        }
+
+        RtlZeroMemory(SrbExtension,
+                      DeviceExtension->Miniport.PortConfig.SrbExtensionSize);
+    }
+
+    Srb->SrbExtension = SrbExtension;
+    Srb->OriginalRequest = Irp;
+    Srb->SrbStatus = SRB_STATUS_PENDING;
+
+    IoMarkIrpPending(Irp);
+
+    KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
+
+    KeAcquireInStackQueuedSpinLockAtDpcLevel(&DeviceExtension->QueueLock,
+                                             &LockHandle);
+
+    LunQueue = PortGetLunQueue(DeviceExtension,
+                               Srb->PathId,
+                               Srb->TargetId,
+                               Srb->Lun,
+                               TRUE);
+    if (LunQueue != NULL)
+    {
+        Irp->Tail.Overlay.DriverContext[0] = LunQueue;
+        InsertTailList(&LunQueue->PendingListHead,
+                       &Irp->Tail.Overlay.ListEntry);
+    }
+
+    KeReleaseInStackQueuedSpinLockFromDpcLevel(&LockHandle);
+
+    if (LunQueue != NULL)
+    {
+        PortStartNextRequests(DeviceExtension, LunQueue);
+    }
+    else
+    {
+        if (SrbExtension != NULL)
+            ExFreeToNPagedLookasideList(&DeviceExtension->SrbExtensionLookaside,
+                                        SrbExtension);
+
+        Srb->SrbExtension = NULL;
+        Srb->OriginalRequest = NULL;
+        Srb->SrbStatus = SRB_STATUS_INTERNAL_ERROR;
+
+        Irp->IoStatus.Information = 0;
+        Irp->IoStatus.Status = STATUS_INSUFFICIENT_RESOURCES;
+        IoCompleteRequest(Irp, IO_NO_INCREMENT);
+    }
+
+    KeLowerIrql(OldIrql);
+
+    return STATUS_PENDING;
+
+done:
+    Irp->IoStatus.Information = 0;
+    Irp->IoStatus.Status = Status;
+    IoCompleteRequest(Irp, IO_NO_INCREMENT);
+
+    return Status;
+}
+
+
+/* Called by the miniport, possibly at DIRQL */
+VOID
+PortRequestComplete(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PSCSI_REQUEST_BLOCK Srb)
+{
+    PIRP Irp;
+
+    /* Requests built by the port driver itself have no IRP; the DPC wakes up their sender */
+    Irp = (PIRP)Srb->OriginalRequest;
+    if (Irp == NULL)
+    {
+        if (Srb == DeviceExtension->InternalSrb)
+        {
+            InterlockedExchange(&DeviceExtension->InternalSrbCompleted, TRUE);
+            KeInsertQueueDpc(&DeviceExtension->CompletionDpc,
+                             NULL,
+                             NULL);
+        }
+        return;
+    }
+
+    ExInterlockedInsertTailList(&DeviceExtension->CompletionListHead,
+                                &Irp->Tail.Overlay.ListEntry,
+                                &DeviceExtension->CompletionLock);
+
+    KeInsertQueueDpc(&DeviceExtension->CompletionDpc,
+                     NULL,
+                     NULL);
+}
+
+
+/* Called by the miniport, possibly at DIRQL */
+static
+BOOLEAN
+PortQueueLunNotification(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ PORT_LUN_NOTIFICATION_TYPE Type,
+    _In_ UCHAR PathId,
+    _In_ UCHAR TargetId,
+    _In_ UCHAR Lun,
+    _In_ ULONG Value)
+{
+    PPORT_LUN_NOTIFICATION Notification;
+    PSINGLE_LIST_ENTRY FreeEntry;
+
+    FreeEntry = ExInterlockedPopEntryList(&DeviceExtension->NotificationFreeList,
+                                          &DeviceExtension->NotificationLock);
+    if (FreeEntry == NULL)
+    {
+        DPRINT1("No free notification for %u:%u:%u\n", PathId, TargetId, Lun);
+        return FALSE;
+    }
+
+    Notification = CONTAINING_RECORD(FreeEntry, PORT_LUN_NOTIFICATION, FreeEntry);
+    Notification->Type = Type;
+    Notification->PathId = PathId;
+    Notification->TargetId = TargetId;
+    Notification->Lun = Lun;
+    Notification->Value = Value;
+
+    ExInterlockedInsertTailList(&DeviceExtension->NotificationListHead,
+                                &Notification->Entry,
+                                &DeviceExtension->NotificationLock);
+
+    /* The DPC applies the change and restarts the queue outside of any miniport lock */
+    KeInsertQueueDpc(&DeviceExtension->CompletionDpc,
+                     NULL,
+                     NULL);
+
+    return TRUE;
+}
+
+
+/* Called by the miniport, possibly at DIRQL */
+BOOLEAN
+PortSetLunQueueDepth(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ UCHAR PathId,
+    _In_ UCHAR TargetId,
+    _In_ UCHAR Lun,
+    _In_ ULONG Depth)
+{
+    if (Depth == 0)
+        return FALSE;
+
+    if (Depth > PORT_MAXIMUM_QUEUE_DEPTH)
+        Depth = PORT_MAXIMUM_QUEUE_DEPTH;
+
+    /* Without tagged queuing the miniport cannot take more than one request per logical unit */
+    if (DeviceExtension->DefaultQueueDepth == 1)
+        Depth = 1;
+
+    return PortQueueLunNotification(DeviceExtension,
+                                    LunNotifyQueueDepth,
+                                    PathId,
+                                    TargetId,
+                                    Lun,
+                                    Depth);
+}
+
+
+/* Called by the miniport, possibly at DIRQL */
+BOOLEAN
+PortSetLunBusy(
+    _In_ PFDO_DEVICE_EXTENSION DeviceExtension,
+    _In_ UCHAR PathId,
+    _In_ UCHAR TargetId,
+    _In_ UCHAR Lun,
+    _In_ BOOLEAN Busy,
+    _In_ ULONG RequestsToComplete)
+{
+    return PortQueueLunNotification(DeviceExtension,
+                                    Busy ? LunNotifyBusy : LunNotifyReady,
+                                    PathId,
+                                    TargetId,
+                                    Lun,
+                                    RequestsToComplete);
+}
+
+/* EOF */
@@ -18,6 +18,27 @@ typedef struct
 
 }SUM_NODE_CONTEXT, *PSUM_NODE_CONTEXT;
 
+typedef struct
+{
+    /* Input and output formats. Must be first, as FsContext2 is also used as the format array */
+    KSDATAFORMAT_WAVEFORMATEX Formats[2];
+
+    /* Serializes the writes of the pin, which share the resampler and the buffers below */
+    KMUTEX Mutex;
+
+    /* Resampler kept across packets, so that no state is lost between them */
+    struct SRC_STATE_tag * State;
+    ULONG StateOldRate;
+    ULONG StateNewRate;
+    ULONG StateChannels;
+
+    /* Conversion buffers, grown on demand and reused for every packet */
+    PFLOAT FloatIn;
+    ULONG FloatInCount;
+    PFLOAT FloatOut;
+    ULONG FloatOutCount;
+}PIN_CONTEXT, *PPIN_CONTEXT;
+
 
 NTSTATUS
 NTAPI
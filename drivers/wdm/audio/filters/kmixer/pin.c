@@ -15,8 +15,49 @@
 
 const GUID KSPROPSETID_Connection              = {0x1D58C920L, 0xAC9B, 0x11CF, {0xA5, 0xD6, 0x28, 0xDB, 0x04, 0xC1, 0x00, 0x00}};
 
+static
+BOOLEAN
+EnsureFloatBuffer(
+    PFLOAT * Buffer,
+    PULONG Count,
+    ULONG NewCount)
+{
+    PFLOAT NewBuffer;
+
+    if (*Count >= NewCount)
+        return TRUE;
+
+    /* grow with some slack, packet sizes vary slightly */
+    NewCount += NewCount / 4;
+
+    NewBuffer = ExAllocatePool(NonPagedPool, NewCount * sizeof(FLOAT));
+    if (!NewBuffer)
+        return FALSE;
+
+    if (*Buffer)
+        ExFreePool(*Buffer);
+
+    *Buffer = NewBuffer;
+    *Count = NewCount;
+    return TRUE;
+}
+
+VOID
+FreePinContext(
+    PPIN_CONTEXT Context)
+{
+    if (Context->State)
+        src_delete(Context->State);
+    if (Context->FloatIn)
+        ExFreePool(Context->FloatIn);
+    if (Context->FloatOut)
+        ExFreePool(Context->FloatOut);
+    ExFreePool(Context);
+}
+
 NTSTATUS
 PerformSampleRateConversion(
+    PPIN_CONTEXT Context,
     PUCHAR Buffer,
     ULONG BufferLength,
     ULONG OldRate,
@@ -29,7 +70,6 @@ PerformSampleRateConversion(
     KFLOATING_SAVE FloatSave;
     NTSTATUS Status;
     ULONG Index;
-    SRC_STATE * State;
     SRC_DATA Data;
     PUCHAR ResultOut;
     int error;
@@ -52,41 +92,47 @@ PerformSampleRateConversion(
 
     NumSamples = BufferLength / (BytesPerSample * NumChannels);
 
-    FloatIn = ExAllocatePool(NonPagedPool, NumSamples * NumChannels * sizeof(FLOAT));
-    if (!FloatIn)
-    {
-        KeRestoreFloatingPointState(&FloatSave);
-        return STATUS_INSUFFICIENT_RESOURCES;
-    }
-
-    NewSamples = ((((ULONG64)NumSamples * NewRate) + (OldRate / 2)) / OldRate) + 2;
+    /* the resampler may hand out frames it buffered from the previous packet, leave room for them */
+    NewSamples = ((((ULONG64)NumSamples * NewRate) + (OldRate / 2)) / OldRate) + 2 + 64;
 
-    FloatOut = ExAllocatePool(NonPagedPool, NewSamples * NumChannels * sizeof(FLOAT));
-    if (!FloatOut)
+    if (!EnsureFloatBuffer(&Context->FloatIn, &Context->FloatInCount, NumSamples * NumChannels) ||
+        !EnsureFloatBuffer(&Context->FloatOut, &Context->FloatOutCount, NewSamples * NumChannels))
     {
-        ExFreePool(FloatIn);
         KeRestoreFloatingPointState(&FloatSave);
         return STATUS_INSUFFICIENT_RESOURCES;
     }
+    FloatIn = Context->FloatIn;
+    FloatOut = Context->FloatOut;
 
     ResultOut = ExAllocatePool(NonPagedPool, NewSamples * NumChannels * BytesPerSample);
     if (!ResultOut)
     {
-        ExFreePool(FloatIn);
-        ExFreePool(FloatOut);
         KeRestoreFloatingPointState(&FloatSave);
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
-    State = src_new(SRC_SINC_FASTEST, NumChannels, &error);
-    if (!State)
+    /* the resampler is only recreated when the conversion changes */
+    if (Context->State &&
+        (Context->StateOldRate != OldRate || Context->StateNewRate != NewRate ||
+         Context->StateChannels != NumChannels))
     {
-        DPRINT1("src_new failed with %x\n", error);
-        KeRestoreFloatingPointState(&FloatSave);
-        ExFreePool(FloatIn);
-        ExFreePool(FloatOut);
-        ExFreePool(ResultOut);
-        return STATUS_UNSUCCESSFUL;
+        src_delete(Context->State);
+        Context->State = NULL;
+    }
+
+    if (!Context->State)
+    {
+        Context->State = src_new(SRC_SINC_FASTEST, NumChannels, &error);
+        if (!Context->State)
+        {
+            DPRINT1("src_new failed with %x\n", error);
+            KeRestoreFloatingPointState(&FloatSave);
+            ExFreePool(ResultOut);
+            return STATUS_UNSUCCESSFUL;
+        }
+        Context->StateOldRate = OldRate;
+        Context->StateNewRate = NewRate;
+        Context->StateChannels = NumChannels;
     }
 
     /* fixme use asm */
@@ -109,15 +155,17 @@ PerformSampleRateConversion(
     Data.input_frames = NumSamples;
     Data.output_frames = NewSamples;
     Data.src_ratio = (double)NewRate / (double)OldRate;
+    Data.end_of_input = 0;
 
-    error = src_process(State, &Data);
+    error = src_process(Context->State, &Data);
     if (error)
     {
         DPRINT1("src_process failed with %x\n", error);
         KeRestoreFloatingPointState(&FloatSave);
-        ExFreePool(FloatIn);
-        ExFreePool(FloatOut);
         ExFreePool(ResultOut);
+        /* start over with a fresh resampler on the next packet */
+        src_delete(Context->State);
+        Context->State = NULL;
         return STATUS_UNSUCCESSFUL;
     }
 
@@ -144,13 +192,57 @@ PerformSampleRateConversion(
 
     *Result = ResultOut;
     *ResultLength = Data.output_frames_gen * BytesPerSample * NumChannels;
-    ExFreePool(FloatIn);
-    ExFreePool(FloatOut);
-    src_delete(State);
     KeRestoreFloatingPointState(&FloatSave);
     return STATUS_SUCCESS;
 }
 
+static
+LONG
+ReadSample(
+    PUCHAR Sample,
+    ULONG BitsPerSample)
+{
+    switch(BitsPerSample)
+    {
+        case 8:
+            /* 8 bit samples are unsigned */
+            return (LONG)Sample[0] - 0x80;
+        case 16:
+            return *(PSHORT)Sample;
+        case 24:
+            /* Assemble the bytes unsigned, a signed shift into the sign bit is undefined */
+            return (LONG)(((ULONG)Sample[0] << 8) | ((ULONG)Sample[1] << 16) | ((ULONG)Sample[2] << 24)) >> 8;
+        default:
+            return *(PLONG)Sample;
+    }
+}
+
+static
+VOID
+WriteSample(
+    PUCHAR Sample,
+    ULONG BitsPerSample,
+    LONG Value)
+{
+    switch(BitsPerSample)
+    {
+        case 8:
+            Sample[0] = (UCHAR)(Value + 0x80);
+            break;
+        case 16:
+            *(PSHORT)Sample = (SHORT)Value;
+            break;
+        case 24:
+            Sample[0] = (UCHAR)Value;
+            Sample[1] = (UCHAR)(Value >> 8);
+            Sample[2] = (UCHAR)(Value >> 16);
+            break;
+        default:
+            *(PLONG)Sample = Value;
+            break;
+    }
+}
+
 NTSTATUS
 PerformChannelConversion(
     PUCHAR Buffer,
@@ -161,113 +253,55 @@ PerformChannelConversion(
     PVOID * Result,
     PULONG ResultLength)
 {
-    ULONG Samples;
-    ULONG NewIndex, OldIndex;
+    ULONG Samples, Index, Channel, SubChannel, Count;
+    ULONG BytesPerSample = BitsPerSample / 8;
+    PUCHAR BufferOut, In, Out;
+    LONGLONG Sum;
 
-    Samples = BufferLength / (BitsPerSample / 8) / OldChannels;
+    ASSERT(BytesPerSample >= 1 && BytesPerSample <= 4);
 
-    if (NewChannels > OldChannels)
-    {
-        if (BitsPerSample == 8)
-        {
-            PUCHAR BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels);
-            if (!BufferOut)
-                return STATUS_INSUFFICIENT_RESOURCES;
+    Samples = BufferLength / BytesPerSample / OldChannels;
 
-            for(NewIndex = 0, OldIndex = 0; OldIndex < Samples * OldChannels; NewIndex += NewChannels, OldIndex += OldChannels)
-            {
-                ULONG SubIndex = 0;
+    BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels * BytesPerSample);
+    if (!BufferOut)
+        return STATUS_INSUFFICIENT_RESOURCES;
 
-                RtlMoveMemory(&BufferOut[NewIndex], &Buffer[OldIndex], OldChannels * sizeof(UCHAR));
+    for(Index = 0; Index < Samples; Index++)
+    {
+        In = Buffer + Index * OldChannels * BytesPerSample;
+        Out = BufferOut + Index * NewChannels * BytesPerSample;
 
-                do
-                {
-                    /* 2 channel stretched to 4 looks like LRLR */
-                     BufferOut[NewIndex+OldChannels + SubIndex] = Buffer[OldIndex + (SubIndex % OldChannels)];
-                }while(SubIndex++ < NewChannels - OldChannels);
-            }
-            *Result = BufferOut;
-            *ResultLength = Samples * NewChannels;
-        }
-        else if (BitsPerSample == 16)
+        if (NewChannels > OldChannels)
         {
-            PUSHORT BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels);
-            if (!BufferOut)
-                return STATUS_INSUFFICIENT_RESOURCES;
+            /* keep the existing channels, 2 channel stretched to 4 looks like LRLR */
+            RtlMoveMemory(Out, In, OldChannels * BytesPerSample);
 
-            for(NewIndex = 0, OldIndex = 0; OldIndex < Samples * OldChannels; NewIndex += NewChannels, OldIndex += OldChannels)
+            for(Channel = OldChannels; Channel < NewChannels; Channel++)
             {
-                ULONG SubIndex = 0;
-
-                RtlMoveMemory(&BufferOut[NewIndex], &Buffer[OldIndex], OldChannels * sizeof(USHORT));
-
-                do
-                {
-                     BufferOut[NewIndex+OldChannels + SubIndex] = Buffer[OldIndex + (SubIndex % OldChannels)];
-                }while(SubIndex++ < NewChannels - OldChannels);
+                RtlMoveMemory(Out + Channel * BytesPerSample,
+                              In + (Channel % OldChannels) * BytesPerSample,
+                              BytesPerSample);
             }
-            *Result = BufferOut;
-            *ResultLength = Samples * NewChannels;
         }
-        else if (BitsPerSample == 24)
+        else
         {
-            PUCHAR BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels);
-            if (!BufferOut)
-                return STATUS_INSUFFICIENT_RESOURCES;
-
-            for(NewIndex = 0, OldIndex = 0; OldIndex < Samples * OldChannels; NewIndex += NewChannels, OldIndex += OldChannels)
+            /* each output channel receives the average of the input channels folded onto it */
+            for(Channel = 0; Channel < NewChannels; Channel++)
             {
-                ULONG SubIndex = 0;
-
-                RtlMoveMemory(&BufferOut[NewIndex], &Buffer[OldIndex], OldChannels * 3);
-
-                do
+                Sum = 0;
+                Count = 0;
+                for(SubChannel = Channel; SubChannel < OldChannels; SubChannel += NewChannels)
                 {
-                     RtlMoveMemory(&BufferOut[(NewIndex+OldChannels + SubIndex) * 3], &Buffer[(OldIndex + (SubIndex % OldChannels)) * 3], 3);
-                }while(SubIndex++ < NewChannels - OldChannels);
+                    Sum += ReadSample(In + SubChannel * BytesPerSample, BitsPerSample);
+                    Count++;
+                }
+                WriteSample(Out + Channel * BytesPerSample, BitsPerSample, (LONG)(Sum / Count));
             }
-            *Result = BufferOut;
-            *ResultLength = Samples * NewChannels;
         }
-        else if (BitsPerSample == 32)
-        {
-            PULONG BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels);
-            if (!BufferOut)
-                return STATUS_INSUFFICIENT_RESOURCES;
-
-            for(NewIndex = 0, OldIndex = 0; OldIndex < Samples * OldChannels; NewIndex += NewChannels, OldIndex += OldChannels)
-            {
-                ULONG SubIndex = 0;
-
-                RtlMoveMemory(&BufferOut[NewIndex], &Buffer[OldIndex], OldChannels * sizeof(ULONG));
-
-                do
-                {
-                     BufferOut[NewIndex+OldChannels + SubIndex] = Buffer[OldIndex + (SubIndex % OldChannels)];
-                }while(SubIndex++ < NewChannels - OldChannels);
-            }
-            *Result = BufferOut;
-            *ResultLength = Samples * NewChannels;
-        }
-
     }
-    else
-    {
-        PUSHORT BufferOut = ExAllocatePool(NonPagedPool, Samples * NewChannels);
-        if (!BufferOut)
-            return STATUS_INSUFFICIENT_RESOURCES;
-
-        for(NewIndex = 0, OldIndex = 0; OldIndex < Samples * OldChannels; NewIndex += NewChannels, OldIndex += OldChannels)
-        {
-            /* TODO
-             * mix stream instead of just dumping part of it ;)
-             */
-            RtlMoveMemory(&BufferOut[NewIndex], &Buffer[OldIndex], NewChannels * (BitsPerSample/8));
-        }
 
-        *Result = BufferOut;
-        *ResultLength = Samples * NewChannels;
-    }
+    *Result = BufferOut;
+    *ResultLength = Samples * NewChannels * BytesPerSample;
     return STATUS_SUCCESS;
 }
 
@@ -514,7 +548,16 @@ Pin_fnClose(
     PDEVICE_OBJECT DeviceObject,
     PIRP Irp)
 {
-    UNIMPLEMENTED;
+    PIO_STACK_LOCATION IoStack;
+
+    IoStack = IoGetCurrentIrpStackLocation(Irp);
+
+    /* free the pin formats and the conversion state */
+    if (IoStack->FileObject->FsContext2)
+    {
+        FreePinContext((PPIN_CONTEXT)IoStack->FileObject->FsContext2);
+        IoStack->FileObject->FsContext2 = NULL;
+    }
 
     Irp->IoStatus.Status = STATUS_SUCCESS;
     Irp->IoStatus.Information = 0;
@@ -657,7 +700,9 @@ Pin_fnFastWrite(
 
     if (InputFormat->WaveFormatEx.nSamplesPerSec != OutputFormat->WaveFormatEx.nSamplesPerSec)
     {
-        Status = PerformSampleRateConversion(StreamHeader->Data,
+        KeWaitForSingleObject(&((PPIN_CONTEXT)Formats)->Mutex, Executive, KernelMode, FALSE, NULL);
+        Status = PerformSampleRateConversion((PPIN_CONTEXT)Formats,
+                                             StreamHeader->Data,
                                              StreamHeader->DataUsed,
                                              InputFormat->WaveFormatEx.nSamplesPerSec,
                                              OutputFormat->WaveFormatEx.nSamplesPerSec,
@@ -665,6 +710,7 @@ Pin_fnFastWrite(
                                              OutputFormat->WaveFormatEx.nChannels,
                                              &BufferOut,
                                              &BufferLength);
+        KeReleaseMutex(&((PPIN_CONTEXT)Formats)->Mutex, FALSE);
         if (NT_SUCCESS(Status))
         {
             ExFreePool(StreamHeader->Data);
@@ -701,18 +747,19 @@ CreatePin(
 {
     NTSTATUS Status;
     KSOBJECT_HEADER ObjectHeader;
-    PKSDATAFORMAT DataFormat;
+    PPIN_CONTEXT Context;
     PIO_STACK_LOCATION IoStack;
 
 
-    DataFormat = ExAllocatePool(NonPagedPool, sizeof(KSDATAFORMAT_WAVEFORMATEX) * 2);
-    if (!DataFormat)
+    Context = ExAllocatePool(NonPagedPool, sizeof(PIN_CONTEXT));
+    if (!Context)
         return STATUS_INSUFFICIENT_RESOURCES;
 
-    RtlZeroMemory(DataFormat, sizeof(KSDATAFORMAT_WAVEFORMATEX) * 2);
+    RtlZeroMemory(Context, sizeof(PIN_CONTEXT));
+    KeInitializeMutex(&Context->Mutex, 0);
 
     IoStack = IoGetCurrentIrpStackLocation(Irp);
-    IoStack->FileObject->FsContext2 = (PVOID)DataFormat;
+    IoStack->FileObject->FsContext2 = (PVOID)Context;
 
     /* allocate object header */
     Status = KsAllocateObjectHeader(&ObjectHeader, 0, NULL, Irp, &PinTable);
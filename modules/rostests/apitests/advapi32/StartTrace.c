@@ -0,0 +1,205 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Tests for StartTrace, TraceEvent and ControlTrace
+ */
+
+#include "precomp.h"
+
+#include <wmistr.h>
+#include <evntrace.h>
+#include <wmiioctl.h>
+
+#define SESSION_NAME    L"ReactOS StartTrace apitest"
+#define TEST_EVENTS     100
+
+/* {5B4A3F3E-6D1C-4C53-9E43-1E2A7A8B9C01} */
+static const GUID TestEventGuid =
+    { 0x5b4a3f3e, 0x6d1c, 0x4c53, { 0x9e, 0x43, 0x1e, 0x2a, 0x7a, 0x8b, 0x9c, 0x01 } };
+
+typedef struct _TEST_EVENT
+{
+    EVENT_TRACE_HEADER Header;
+    ULONG Sequence;
+    ULONG Magic;
+} TEST_EVENT, *PTEST_EVENT;
+
+typedef struct _TEST_PROPERTIES
+{
+    EVENT_TRACE_PROPERTIES Properties;
+    WCHAR LogFileName[MAX_PATH];
+    WCHAR LoggerName[64];
+} TEST_PROPERTIES, *PTEST_PROPERTIES;
+
+static VOID InitProperties(PTEST_PROPERTIES Props, PCWSTR LogFileName)
+{
+    ZeroMemory(Props, sizeof(*Props));
+    Props->Properties.Wnode.BufferSize = sizeof(*Props);
+    Props->Properties.Wnode.Flags = WNODE_FLAG_TRACED_GUID;
+    Props->Properties.Wnode.ClientContext = 1;
+    Props->Properties.BufferSize = 4;
+    Props->Properties.LogFileMode = EVENT_TRACE_FILE_MODE_SEQUENTIAL;
+    Props->Properties.LogFileNameOffset = FIELD_OFFSET(TEST_PROPERTIES, LogFileName);
+    Props->Properties.LoggerNameOffset = FIELD_OFFSET(TEST_PROPERTIES, LoggerName);
+    if (LogFileName)
+        StringCbCopyW(Props->LogFileName, sizeof(Props->LogFileName), LogFileName);
+}
+
+static BOOL IsReactOS(VOID)
+{
+    HKEY hKey;
+
+    if (RegOpenKeyExW(HKEY_LOCAL_MACHINE, L"SOFTWARE\\ReactOS", 0, KEY_READ, &hKey) != ERROR_SUCCESS)
+        return FALSE;
+    RegCloseKey(hKey);
+    return TRUE;
+}
+
+/*
+ * Walk the buffers of the log file and check each of our events made it.
+ * Buffers are written as they fill up on each processor, so the events are
+ * only ordered within a buffer.
+ */
+static VOID CheckLogFile(PCWSTR LogFileName, ULONG BufferSize)
+{
+    PWMI_BUFFER_HEADER Buffer;
+    PEVENT_TRACE_HEADER Event;
+    PTEST_EVENT TestEvent;
+    BOOLEAN Seen[TEST_EVENTS] = { 0 };
+    ULONG Offset, Found = 0;
+    HANDLE File;
+    DWORD Read;
+
+    File = CreateFileW(LogFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                       NULL, OPEN_EXISTING, 0, NULL);
+    ok(File != INVALID_HANDLE_VALUE, "Failed to open the log file (%lu)\n", GetLastError());
+    if (File == INVALID_HANDLE_VALUE)
+        return;
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, BufferSize);
+    while (ReadFile(File, Buffer, BufferSize, &Read, NULL) && Read == BufferSize)
+    {
+        ok_long(Buffer->BufferSize, BufferSize);
+        ok(Buffer->SavedOffset >= sizeof(*Buffer) && Buffer->SavedOffset <= BufferSize,
+           "Bad buffer offset %lu\n", Buffer->SavedOffset);
+        if (Buffer->SavedOffset > BufferSize)
+            break;
+
+        for (Offset = sizeof(*Buffer); Offset < Buffer->SavedOffset; )
+        {
+            Event = (PEVENT_TRACE_HEADER)((PUCHAR)Buffer + Offset);
+            if (Event->Size < sizeof(*Event))
+            {
+                ok(0, "Bad event size %u at offset %lu\n", Event->Size, Offset);
+                break;
+            }
+
+            if (IsEqualGUID(&Event->Guid, &TestEventGuid))
+            {
+                TestEvent = (PTEST_EVENT)Event;
+                ok_int(Event->Size, sizeof(TEST_EVENT));
+                ok_long(TestEvent->Magic, 0xC0FFEE);
+                ok_long(Event->ThreadId, GetCurrentThreadId());
+                ok_long(Event->ProcessId, GetCurrentProcessId());
+                ok(TestEvent->Sequence < TEST_EVENTS && !Seen[TestEvent->Sequence],
+                   "Unexpected event %lu\n", TestEvent->Sequence);
+                if (TestEvent->Sequence < TEST_EVENTS && !Seen[TestEvent->Sequence])
+                {
+                    Seen[TestEvent->Sequence] = TRUE;
+                    Found++;
+                }
+            }
+
+            Offset += (Event->Size + 7) & ~7;
+        }
+    }
+    ok_long(Found, TEST_EVENTS);
+
+    HeapFree(GetProcessHeap(), 0, Buffer);
+    CloseHandle(File);
+}
+
+START_TEST(StartTrace)
+{
+    WCHAR TempPath[MAX_PATH], LogFileName[MAX_PATH];
+    TEST_PROPERTIES Props;
+    TRACEHANDLE Session = 0, Session2;
+    TEST_EVENT Event;
+    ULONG Error, i;
+
+    GetTempPathW(_countof(TempPath), TempPath);
+    GetTempFileNameW(TempPath, L"etl", 0, LogFileName);
+
+    /* Parameter checks */
+    InitProperties(&Props, LogFileName);
+    ok_long(StartTraceW(NULL, SESSION_NAME, &Props.Properties), ERROR_INVALID_PARAMETER);
+    ok_long(StartTraceW(&Session, NULL, &Props.Properties), ERROR_INVALID_PARAMETER);
+    Props.Properties.Wnode.BufferSize = sizeof(EVENT_TRACE_PROPERTIES) - 1;
+    ok_long(StartTraceW(&Session, SESSION_NAME, &Props.Properties), ERROR_BAD_LENGTH);
+
+    /* Make sure a previous run doesn't get in the way */
+    InitProperties(&Props, NULL);
+    ControlTraceW(0, SESSION_NAME, &Props.Properties, EVENT_TRACE_CONTROL_STOP);
+
+    InitProperties(&Props, LogFileName);
+    Error = StartTraceW(&Session, SESSION_NAME, &Props.Properties);
+    if (Error == ERROR_ACCESS_DENIED)
+    {
+        skip("Not allowed to start a trace session\n");
+        DeleteFileW(LogFileName);
+        return;
+    }
+    ok_long(Error, ERROR_SUCCESS);
+    if (Error != ERROR_SUCCESS)
+    {
+        DeleteFileW(LogFileName);
+        return;
+    }
+    ok(Session != 0, "No session handle\n");
+    ok(!wcscmp(Props.LoggerName, SESSION_NAME), "Got session name %S\n", Props.LoggerName);
+
+    /* A second session with the same name is refused */
+    InitProperties(&Props, LogFileName);
+    ok_long(StartTraceW(&Session2, SESSION_NAME, &Props.Properties), ERROR_ALREADY_EXISTS);
+
+    for (i = 0; i < TEST_EVENTS; i++)
+    {
+        ZeroMemory(&Event, sizeof(Event));
+        Event.Header.Size = sizeof(Event);
+        Event.Header.Flags = WNODE_FLAG_TRACED_GUID;
+        Event.Header.Guid = TestEventGuid;
+        Event.Header.Class.Type = EVENT_TRACE_TYPE_INFO;
+        Event.Sequence = i;
+        Event.Magic = 0xC0FFEE;
+        ok_long(TraceEvent(Session, &Event.Header), ERROR_SUCCESS);
+    }
+
+    Event.Header.Size = sizeof(EVENT_TRACE_HEADER) - 1;
+    ok_long(TraceEvent(Session, &Event.Header), ERROR_INVALID_PARAMETER);
+
+    /* Query by name and by handle */
+    InitProperties(&Props, NULL);
+    ok_long(ControlTraceW(0, SESSION_NAME, &Props.Properties, EVENT_TRACE_CONTROL_QUERY), ERROR_SUCCESS);
+    ok(Props.Properties.NumberOfBuffers != 0, "No buffers\n");
+    ok_long(Props.Properties.EventsLost, 0);
+
+    InitProperties(&Props, NULL);
+    ok_long(ControlTraceW(Session, NULL, &Props.Properties, EVENT_TRACE_CONTROL_FLUSH), ERROR_SUCCESS);
+
+    InitProperties(&Props, NULL);
+    ok_long(ControlTraceW(Session, NULL, &Props.Properties, EVENT_TRACE_CONTROL_STOP), ERROR_SUCCESS);
+    ok(Props.Properties.BuffersWritten != 0, "No buffers written\n");
+
+    /* The session is gone now */
+    InitProperties(&Props, NULL);
+    ok_long(ControlTraceW(Session, NULL, &Props.Properties, EVENT_TRACE_CONTROL_QUERY), ERROR_WMI_INSTANCE_NOT_FOUND);
+    Event.Header.Size = sizeof(Event);
+    ok_long(TraceEvent(Session, &Event.Header), ERROR_INVALID_HANDLE);
+
+    /* The log file format is our own */
+    if (IsReactOS())
+        CheckLogFile(LogFileName, 4 * 1024);
+    else
+        skip("Not checking the log file format on Windows\n");
+    DeleteFileW(LogFileName);
+}
@@ -63,9 +63,41 @@ Test_strlen(PFN_STRLEN pstrlen)
 #endif
 }
 
+/* strlen reads whole words, make sure it never touches the page
+   following a string that ends right before it */
+void
+Test_strlen_PageEnd(void)
+{
+    PCHAR Buffer;
+    PCHAR String;
+    size_t Length;
+    DWORD OldProtect;
+
+    Buffer = VirtualAlloc(NULL, 2 * 4096, MEM_COMMIT, PAGE_READWRITE);
+    ok(Buffer != NULL, "VirtualAlloc failed\n");
+    if (Buffer == NULL)
+        return;
+    ok(VirtualProtect(Buffer + 4096, 4096, PAGE_NOACCESS, &OldProtect),
+       "VirtualProtect failed\n");
+
+    for (Length = 0; Length < 64; Length++)
+    {
+        String = Buffer + 4096 - Length - 1;
+        memset(String, 'a', Length);
+        String[Length] = 0;
+
+        StartSeh()
+            ok_int((int)strlen(String), (int)Length);
+        EndSeh(STATUS_SUCCESS);
+    }
+
+    VirtualFree(Buffer, 0, MEM_RELEASE);
+}
+
 START_TEST(strlen)
 {
     Test_strlen(strlen);
+    Test_strlen_PageEnd();
 #ifdef __GNUC__
     Test_strlen(GCC_builtin_strlen);
 #endif // __GNUC__
@@ -0,0 +1,210 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Tests for console output that scrolls the screen buffer
+ */
+
+#include "precomp.h"
+#include <wingdi.h>
+#include <winuser.h>
+
+#define BUFFER_WIDTH    80
+#define BUFFER_HEIGHT   25
+#define LINE_COUNT      1000
+
+/* Copies the client area of the console window, as currently shown */
+static PDWORD CaptureWindow(HWND hWnd, LONG Width, LONG Height)
+{
+    BITMAPINFO bmi;
+    HBITMAP hBitmap, hOldBitmap;
+    HDC hdc, hMemDC;
+    PVOID Bits;
+    PDWORD Copy = NULL;
+
+    hdc = GetDC(hWnd);
+    if (!hdc)
+        return NULL;
+
+    ZeroMemory(&bmi, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = Width;
+    bmi.bmiHeader.biHeight = -Height;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    hMemDC = CreateCompatibleDC(hdc);
+    hBitmap = CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, &Bits, NULL, 0);
+    if (hMemDC && hBitmap)
+    {
+        hOldBitmap = SelectObject(hMemDC, hBitmap);
+        if (BitBlt(hMemDC, 0, 0, Width, Height, hdc, 0, 0, SRCCOPY))
+        {
+            GdiFlush();
+            Copy = HeapAlloc(GetProcessHeap(), 0, Width * Height * sizeof(DWORD));
+            if (Copy)
+                CopyMemory(Copy, Bits, Width * Height * sizeof(DWORD));
+        }
+        SelectObject(hMemDC, hOldBitmap);
+    }
+
+    if (hBitmap) DeleteObject(hBitmap);
+    if (hMemDC) DeleteDC(hMemDC);
+    ReleaseDC(hWnd, hdc);
+    return Copy;
+}
+
+static VOID Test_ScrolledContents(HANDLE hConOut)
+{
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    CHAR Expected[32], Line[BUFFER_WIDTH];
+    DWORD Read;
+    COORD Coord;
+    SHORT Row;
+
+    ok(GetConsoleScreenBufferInfo(hConOut, &csbi), "GetConsoleScreenBufferInfo failed\n");
+    ok(csbi.dwCursorPosition.X == 0 && csbi.dwCursorPosition.Y == BUFFER_HEIGHT - 1,
+       "Cursor at (%d,%d)\n", csbi.dwCursorPosition.X, csbi.dwCursorPosition.Y);
+
+    /* The last lines written fill the buffer, the last row is empty */
+    for (Row = 0; Row < BUFFER_HEIGHT - 1; Row++)
+    {
+        Coord.X = 0;
+        Coord.Y = Row;
+        ok(ReadConsoleOutputCharacterA(hConOut, Line, sizeof(Line), Coord, &Read),
+           "ReadConsoleOutputCharacterA failed\n");
+        StringCbPrintfA(Expected, sizeof(Expected), "Line %04d",
+                        LINE_COUNT - (BUFFER_HEIGHT - 1) + Row);
+        ok(Read == sizeof(Line) && !memcmp(Line, Expected, strlen(Expected)),
+           "Row %d is '%.*s', expected '%s'\n", Row, (int)strlen(Expected), Line, Expected);
+    }
+}
+
+/* What is shown once the output has been painted must not change when the
+ * whole window is painted again from the buffer. */
+static VOID Test_ScrolledDisplay(HANDLE hConOut)
+{
+    CONSOLE_CURSOR_INFO CursorInfo;
+    PDWORD Before, After;
+    HWND hWnd;
+    RECT Rect;
+    LONG Width, Height, Count, i;
+
+    hWnd = GetConsoleWindow();
+    if (!hWnd || !IsWindowVisible(hWnd) || !GetClientRect(hWnd, &Rect))
+    {
+        skip("No visible console window\n");
+        return;
+    }
+    Width = Rect.right;
+    Height = Rect.bottom;
+
+    /* The blinking cursor would make the two pictures differ */
+    GetConsoleCursorInfo(hConOut, &CursorInfo);
+    CursorInfo.bVisible = FALSE;
+    SetConsoleCursorInfo(hConOut, &CursorInfo);
+
+    /* Let the console paint what it has pending */
+    Sleep(500);
+    Before = CaptureWindow(hWnd, Width, Height);
+
+    RedrawWindow(hWnd, NULL, NULL, RDW_INVALIDATE | RDW_UPDATENOW);
+    Sleep(500);
+    After = CaptureWindow(hWnd, Width, Height);
+
+    if (!Before || !After)
+    {
+        skip("Cannot capture the console window\n");
+    }
+    else
+    {
+        Count = 0;
+        for (i = 0; i < Width * Height; i++)
+        {
+            if (Before[i] != After[i])
+                Count++;
+        }
+        ok(Count == 0, "%ld of %ld pixels changed when the window was repainted\n",
+           Count, Width * Height);
+    }
+
+    if (Before) HeapFree(GetProcessHeap(), 0, Before);
+    if (After) HeapFree(GetProcessHeap(), 0, After);
+
+    CursorInfo.bVisible = TRUE;
+    SetConsoleCursorInfo(hConOut, &CursorInfo);
+}
+
+static VOID Test_Throughput(HANDLE hConOut)
+{
+    CHAR Text[BUFFER_WIDTH * 8];
+    LARGE_INTEGER Frequency, Start, End;
+    DWORD Written, Total = 0, i;
+    double Seconds;
+
+    /* Full lines of text, written the way a build log is */
+    for (i = 0; i < sizeof(Text); i++)
+        Text[i] = ((i + 1) % BUFFER_WIDTH) ? (CHAR)('a' + i % 26) : '\n';
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < 1024; i++)
+    {
+        if (!WriteConsoleA(hConOut, Text, sizeof(Text), &Written, NULL))
+            break;
+        Total += Written;
+    }
+    QueryPerformanceCounter(&End);
+
+    ok(Total == 1024 * sizeof(Text), "Wrote %lu bytes\n", Total);
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+    if (Seconds > 0)
+        trace("Console output: %lu bytes in %.3f s, %.2f MB/s\n",
+              Total, Seconds, Total / Seconds / (1024 * 1024));
+}
+
+START_TEST(ConsoleScroll)
+{
+    HANDLE hConOut, hOldOut;
+    CHAR Text[32];
+    DWORD Written;
+    SMALL_RECT Window;
+    COORD Size;
+    ULONG i;
+
+    hOldOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    hConOut = CreateConsoleScreenBuffer(GENERIC_READ | GENERIC_WRITE,
+                                        FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                        NULL,
+                                        CONSOLE_TEXTMODE_BUFFER,
+                                        NULL);
+    if (hConOut == INVALID_HANDLE_VALUE)
+    {
+        skip("No console available\n");
+        return;
+    }
+
+    /* A buffer no taller than the window, so every new line scrolls it */
+    Window.Left = Window.Top = 0;
+    Window.Right = BUFFER_WIDTH - 1;
+    Window.Bottom = BUFFER_HEIGHT - 1;
+    Size.X = BUFFER_WIDTH;
+    Size.Y = BUFFER_HEIGHT;
+    SetConsoleWindowInfo(hConOut, TRUE, &Window);
+    ok(SetConsoleScreenBufferSize(hConOut, Size), "SetConsoleScreenBufferSize failed, error %lu\n", GetLastError());
+    ok(SetConsoleActiveScreenBuffer(hConOut), "SetConsoleActiveScreenBuffer failed\n");
+
+    for (i = 0; i < LINE_COUNT; i++)
+    {
+        StringCbPrintfA(Text, sizeof(Text), "Line %04lu\n", i);
+        ok(WriteConsoleA(hConOut, Text, (DWORD)strlen(Text), &Written, NULL), "WriteConsoleA failed\n");
+    }
+
+    Test_ScrolledContents(hConOut);
+    Test_ScrolledDisplay(hConOut);
+    Test_Throughput(hConOut);
+
+    if (hOldOut != INVALID_HANDLE_VALUE)
+        SetConsoleActiveScreenBuffer(hOldOut);
+    CloseHandle(hConOut);
+}
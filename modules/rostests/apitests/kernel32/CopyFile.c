@@ -0,0 +1,270 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Tests for CopyFileEx data transfer and progress callbacks
+ */
+
+#include "precomp.h"
+
+#ifndef COPY_FILE_NO_BUFFERING
+#define COPY_FILE_NO_BUFFERING 0x00001000
+#endif
+
+typedef struct _PROGRESS_DATA
+{
+    ULONG Calls;
+    ULONG StreamSwitches;
+    LONGLONG LastTransferred;
+    LONGLONG StopAfter;
+    LONGLONG ShrinkTo;
+    LPCWSTR Source;
+} PROGRESS_DATA, *PPROGRESS_DATA;
+
+static WCHAR SourceName[MAX_PATH];
+static WCHAR DestName[MAX_PATH];
+
+static UCHAR PatternByte(LONGLONG Offset)
+{
+    return (UCHAR)((Offset * 7) ^ (Offset >> 9));
+}
+
+static BOOL CreateSource(LONGLONG Size)
+{
+    UCHAR Buffer[4096];
+    LONGLONG Offset = 0;
+    DWORD Length, Written, i;
+    HANDLE hFile;
+
+    hFile = CreateFileW(SourceName, GENERIC_WRITE, 0, NULL,
+                        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    while (Offset < Size)
+    {
+        Length = (DWORD)min(Size - Offset, (LONGLONG)sizeof(Buffer));
+        for (i = 0; i < Length; i++)
+            Buffer[i] = PatternByte(Offset + i);
+        if (!WriteFile(hFile, Buffer, Length, &Written, NULL) || Written != Length)
+        {
+            CloseHandle(hFile);
+            return FALSE;
+        }
+        Offset += Length;
+    }
+
+    CloseHandle(hFile);
+    return TRUE;
+}
+
+/* Checks that the destination holds exactly the first Size bytes of the pattern */
+static VOID CheckDest(LONGLONG Size, LPCSTR Description)
+{
+    UCHAR Buffer[4096];
+    LONGLONG Offset = 0;
+    LARGE_INTEGER FileSize;
+    DWORD Read, i;
+    HANDLE hFile;
+
+    hFile = CreateFileW(DestName, GENERIC_READ, FILE_SHARE_READ, NULL,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    ok(hFile != INVALID_HANDLE_VALUE, "%s: cannot open the copy, error %lu\n", Description, GetLastError());
+    if (hFile == INVALID_HANDLE_VALUE)
+        return;
+
+    ok(GetFileSizeEx(hFile, &FileSize), "%s: GetFileSizeEx failed\n", Description);
+    ok(FileSize.QuadPart == Size, "%s: copy is %I64d bytes, expected %I64d\n",
+       Description, FileSize.QuadPart, Size);
+
+    while (ReadFile(hFile, Buffer, sizeof(Buffer), &Read, NULL) && Read != 0)
+    {
+        for (i = 0; i < Read; i++)
+        {
+            if (Buffer[i] != PatternByte(Offset + i))
+                break;
+        }
+        ok(i == Read, "%s: copy differs at offset %I64d\n", Description, Offset + i);
+        if (i != Read)
+            break;
+        Offset += Read;
+    }
+
+    CloseHandle(hFile);
+}
+
+static DWORD CALLBACK ProgressRoutine(
+    LARGE_INTEGER TotalFileSize,
+    LARGE_INTEGER TotalBytesTransferred,
+    LARGE_INTEGER StreamSize,
+    LARGE_INTEGER StreamBytesTransferred,
+    DWORD dwStreamNumber,
+    DWORD dwCallbackReason,
+    HANDLE hSourceFile,
+    HANDLE hDestinationFile,
+    LPVOID lpData)
+{
+    PPROGRESS_DATA Data = lpData;
+    LARGE_INTEGER NewSize;
+    HANDLE hFile;
+
+    if (Data->Calls++ == 0)
+    {
+        /* The stream is announced before any data is transferred */
+        ok(dwCallbackReason == CALLBACK_STREAM_SWITCH, "First callback is %lu\n", dwCallbackReason);
+        ok(TotalBytesTransferred.QuadPart == 0, "First callback reports %I64d bytes\n",
+           TotalBytesTransferred.QuadPart);
+
+        /* Make the source shorter than what the copy saw when opening it */
+        if (Data->ShrinkTo >= 0)
+        {
+            hFile = CreateFileW(Data->Source, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            ok(hFile != INVALID_HANDLE_VALUE, "Cannot open the source, error %lu\n", GetLastError());
+            if (hFile != INVALID_HANDLE_VALUE)
+            {
+                NewSize.QuadPart = Data->ShrinkTo;
+                ok(SetFilePointerEx(hFile, NewSize, NULL, FILE_BEGIN), "SetFilePointerEx failed\n");
+                ok(SetEndOfFile(hFile), "SetEndOfFile failed, error %lu\n", GetLastError());
+                CloseHandle(hFile);
+            }
+        }
+    }
+
+    if (dwCallbackReason == CALLBACK_STREAM_SWITCH)
+    {
+        Data->StreamSwitches++;
+    }
+    else
+    {
+        ok(dwCallbackReason == CALLBACK_CHUNK_FINISHED, "Callback reason %lu\n", dwCallbackReason);
+        ok(TotalBytesTransferred.QuadPart > Data->LastTransferred || TotalFileSize.QuadPart == 0,
+           "Transferred went from %I64d to %I64d\n",
+           Data->LastTransferred, TotalBytesTransferred.QuadPart);
+    }
+
+    ok(TotalBytesTransferred.QuadPart <= TotalFileSize.QuadPart,
+       "Transferred %I64d of %I64d bytes\n",
+       TotalBytesTransferred.QuadPart, TotalFileSize.QuadPart);
+    Data->LastTransferred = TotalBytesTransferred.QuadPart;
+
+    if (Data->StopAfter >= 0 && TotalBytesTransferred.QuadPart > Data->StopAfter)
+        return PROGRESS_STOP;
+
+    return PROGRESS_CONTINUE;
+}
+
+static VOID TestCopy(LONGLONG Size, DWORD Flags)
+{
+    PROGRESS_DATA Data;
+    CHAR Description[64];
+    BOOL Ret;
+
+    StringCbPrintfA(Description, sizeof(Description), "size %I64d, flags 0x%lx", Size, Flags);
+    if (!CreateSource(Size))
+    {
+        skip("%s: cannot create the source\n", Description);
+        return;
+    }
+
+    ZeroMemory(&Data, sizeof(Data));
+    Data.StopAfter = -1;
+    Data.ShrinkTo = -1;
+    Ret = CopyFileExW(SourceName, DestName, ProgressRoutine, &Data, NULL, Flags);
+    ok(Ret, "%s: CopyFileExW failed, error %lu\n", Description, GetLastError());
+    ok(Data.StreamSwitches == 1, "%s: %lu stream switches\n", Description, Data.StreamSwitches);
+    ok(Data.LastTransferred == Size, "%s: last callback reports %I64d bytes\n",
+       Description, Data.LastTransferred);
+    if (Ret)
+        CheckDest(Size, Description);
+
+    DeleteFileW(DestName);
+}
+
+static VOID TestShrinkingSource(DWORD Flags)
+{
+    PROGRESS_DATA Data;
+    BOOL Ret;
+
+    if (!CreateSource(0x180000))
+    {
+        skip("Cannot create the source\n");
+        return;
+    }
+
+    /* Reads past the new end come back short or empty */
+    ZeroMemory(&Data, sizeof(Data));
+    Data.StopAfter = -1;
+    Data.ShrinkTo = 0x12345;
+    Data.Source = SourceName;
+    Ret = CopyFileExW(SourceName, DestName, ProgressRoutine, &Data, NULL, Flags);
+    ok(Ret || GetLastError() == ERROR_HANDLE_EOF,
+       "Flags 0x%lx: CopyFileExW failed, error %lu\n", Flags, GetLastError());
+    if (Ret)
+        CheckDest(Data.ShrinkTo, "shrunk source");
+
+    DeleteFileW(DestName);
+}
+
+static VOID TestStop(DWORD Flags)
+{
+    PROGRESS_DATA Data;
+    WIN32_FILE_ATTRIBUTE_DATA Attributes;
+    LONGLONG Size;
+    BOOL Ret;
+
+    /* Not a multiple of the sector size, and several chunks long */
+    if (!CreateSource(0x300123))
+    {
+        skip("Cannot create the source\n");
+        return;
+    }
+
+    ZeroMemory(&Data, sizeof(Data));
+    Data.StopAfter = 0;
+    Data.ShrinkTo = -1;
+    SetLastError(0xdeadbeef);
+    Ret = CopyFileExW(SourceName, DestName, ProgressRoutine, &Data, NULL, Flags);
+    ok(!Ret, "Flags 0x%lx: CopyFileExW succeeded\n", Flags);
+    ok(GetLastError() == ERROR_REQUEST_ABORTED, "Flags 0x%lx: error %lu\n", Flags, GetLastError());
+    ok(Data.LastTransferred > 0 && Data.LastTransferred < 0x300123,
+       "Flags 0x%lx: stopped after %I64d bytes\n", Flags, Data.LastTransferred);
+
+    /* A destination kept after a stop must not carry the sector padding */
+    if (GetFileAttributesExW(DestName, GetFileExInfoStandard, &Attributes))
+    {
+        Size = ((LONGLONG)Attributes.nFileSizeHigh << 32) | Attributes.nFileSizeLow;
+        ok(Size <= Data.LastTransferred, "Flags 0x%lx: kept %I64d bytes, reported %I64d\n",
+           Flags, Size, Data.LastTransferred);
+        CheckDest(Size, "stopped copy");
+        SetFileAttributesW(DestName, FILE_ATTRIBUTE_NORMAL);
+        DeleteFileW(DestName);
+    }
+}
+
+START_TEST(CopyFile)
+{
+    static const LONGLONG Sizes[] = { 0, 1, 511, 4097, 0x10000, 0x10007, 0x300123 };
+    static const DWORD Flags[] = { 0, COPY_FILE_NO_BUFFERING };
+    WCHAR TempPath[MAX_PATH];
+    ULONG i, j;
+
+    if (!GetTempPathW(_countof(TempPath), TempPath) ||
+        !GetTempFileNameW(TempPath, L"cfs", 0, SourceName) ||
+        !GetTempFileNameW(TempPath, L"cfd", 0, DestName))
+    {
+        skip("No temporary directory\n");
+        return;
+    }
+
+    for (j = 0; j < _countof(Flags); j++)
+    {
+        for (i = 0; i < _countof(Sizes); i++)
+            TestCopy(Sizes[i], Flags[j]);
+
+        TestShrinkingSource(Flags[j]);
+        TestStop(Flags[j]);
+    }
+
+    DeleteFileW(DestName);
+    DeleteFileW(SourceName);
+}
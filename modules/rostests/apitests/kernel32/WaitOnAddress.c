@@ -0,0 +1,200 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Tests for WaitOnAddress and WakeByAddress*
+ */
+
+#include "precomp.h"
+
+static BOOL (WINAPI *pWaitOnAddress)(volatile VOID *, PVOID, SIZE_T, DWORD);
+static VOID (WINAPI *pWakeByAddressAll)(PVOID);
+static VOID (WINAPI *pWakeByAddressSingle)(PVOID);
+
+#define LOCK_THREADS     4
+#define LOCK_ITERATIONS  20000
+
+static volatile LONG g_Value;
+static volatile LONG g_Woken;
+static volatile LONG g_Lock;
+static LONG g_Counter;
+
+static DWORD WINAPI WaitThread(LPVOID Parameter)
+{
+    LONG Zero = 0;
+
+    ok(pWaitOnAddress(&g_Value, &Zero, sizeof(Zero), INFINITE), "WaitOnAddress failed\n");
+    InterlockedIncrement(&g_Woken);
+    return 0;
+}
+
+/* Minimal lock: 0 free, 1 owned, 2 owned with waiters */
+static VOID AcquireLock(VOID)
+{
+    LONG Contended = 2;
+    LONG Old;
+
+    Old = InterlockedCompareExchange(&g_Lock, 1, 0);
+    if (Old == 0)
+        return;
+
+    if (Old != 2)
+        Old = InterlockedExchange(&g_Lock, 2);
+    while (Old != 0)
+    {
+        pWaitOnAddress(&g_Lock, &Contended, sizeof(Contended), INFINITE);
+        Old = InterlockedExchange(&g_Lock, 2);
+    }
+}
+
+static VOID ReleaseLock(VOID)
+{
+    if (InterlockedExchange(&g_Lock, 0) == 2)
+        pWakeByAddressSingle((PVOID)&g_Lock);
+}
+
+static DWORD WINAPI LockThread(LPVOID Parameter)
+{
+    ULONG i;
+
+    for (i = 0; i < LOCK_ITERATIONS; i++)
+    {
+        AcquireLock();
+        g_Counter++;
+        ReleaseLock();
+    }
+    return 0;
+}
+
+static void Test_Compare(void)
+{
+    LONGLONG Value64 = 0x123456789ull, Compare64;
+    SHORT Value16 = 5, Compare16;
+    UCHAR Value8 = 1, Compare8;
+    LONG Value = 1, Compare;
+    DWORD Start;
+    BOOL Ret;
+
+    /* A different value returns right away */
+    Compare8 = 2;
+    ok(pWaitOnAddress(&Value8, &Compare8, sizeof(Value8), INFINITE), "1 byte compare failed\n");
+    Compare16 = 6;
+    ok(pWaitOnAddress(&Value16, &Compare16, sizeof(Value16), INFINITE), "2 byte compare failed\n");
+    Compare = 2;
+    ok(pWaitOnAddress(&Value, &Compare, sizeof(Value), INFINITE), "4 byte compare failed\n");
+    Compare64 = 0x23456789ull;
+    ok(pWaitOnAddress(&Value64, &Compare64, sizeof(Value64), INFINITE), "8 byte compare failed\n");
+
+    /* The same value times out */
+    Compare = 1;
+    SetLastError(0xdeadbeef);
+    Start = GetTickCount();
+    Ret = pWaitOnAddress(&Value, &Compare, sizeof(Value), 50);
+    ok(!Ret, "WaitOnAddress returned TRUE\n");
+    ok_err(ERROR_TIMEOUT);
+    ok(GetTickCount() - Start >= 40, "Returned after %lu ms\n", GetTickCount() - Start);
+
+    SetLastError(0xdeadbeef);
+    ok(!pWaitOnAddress(&Value, &Compare, sizeof(Value), 0), "WaitOnAddress returned TRUE\n");
+    ok_err(ERROR_TIMEOUT);
+
+    SetLastError(0xdeadbeef);
+    ok(!pWaitOnAddress(&Value, &Compare, 3, 0), "WaitOnAddress returned TRUE\n");
+    ok_err(ERROR_INVALID_PARAMETER);
+
+    /* Waking an address nobody waits on is harmless */
+    pWakeByAddressSingle(&Value);
+    pWakeByAddressAll(&Value);
+}
+
+static void Test_Wake(void)
+{
+    HANDLE Threads[LOCK_THREADS];
+    ULONG i;
+
+    /* Wake one waiter at a time */
+    g_Value = 0;
+    g_Woken = 0;
+    Threads[0] = CreateThread(NULL, 0, WaitThread, NULL, 0, NULL);
+    Threads[1] = CreateThread(NULL, 0, WaitThread, NULL, 0, NULL);
+    Sleep(100);
+    ok_long(g_Woken, 0);
+
+    pWakeByAddressSingle((PVOID)&g_Value);
+    Sleep(100);
+    ok_long(g_Woken, 1);
+
+    pWakeByAddressSingle((PVOID)&g_Value);
+    ok(WaitForMultipleObjects(2, Threads, TRUE, 5000) == WAIT_OBJECT_0, "Threads didn't wake\n");
+    ok_long(g_Woken, 2);
+    CloseHandle(Threads[0]);
+    CloseHandle(Threads[1]);
+
+    /* Wake all of them at once */
+    g_Woken = 0;
+    for (i = 0; i < LOCK_THREADS; i++)
+        Threads[i] = CreateThread(NULL, 0, WaitThread, NULL, 0, NULL);
+    Sleep(100);
+    ok_long(g_Woken, 0);
+
+    g_Value = 1;
+    pWakeByAddressAll((PVOID)&g_Value);
+    ok(WaitForMultipleObjects(LOCK_THREADS, Threads, TRUE, 5000) == WAIT_OBJECT_0, "Threads didn't wake\n");
+    ok_long(g_Woken, LOCK_THREADS);
+    for (i = 0; i < LOCK_THREADS; i++)
+        CloseHandle(Threads[i]);
+}
+
+static void Test_ContendedLock(void)
+{
+    HANDLE Threads[LOCK_THREADS];
+    DWORD Start;
+    ULONG i;
+
+    g_Lock = 0;
+    g_Counter = 0;
+    Start = GetTickCount();
+    for (i = 0; i < LOCK_THREADS; i++)
+        Threads[i] = CreateThread(NULL, 0, LockThread, NULL, 0, NULL);
+    ok(WaitForMultipleObjects(LOCK_THREADS, Threads, TRUE, 60000) == WAIT_OBJECT_0, "Threads didn't finish\n");
+    trace("%u threads took %lu ms for %u lock round trips each\n",
+          LOCK_THREADS, GetTickCount() - Start, LOCK_ITERATIONS);
+    ok_long(g_Counter, LOCK_THREADS * LOCK_ITERATIONS);
+    for (i = 0; i < LOCK_THREADS; i++)
+        CloseHandle(Threads[i]);
+}
+
+START_TEST(WaitOnAddress)
+{
+    /* Windows exports it from the synch API set and kernelbase,
+     * ReactOS from kernel32_vista */
+    static const PCWSTR Modules[] =
+    {
+        L"kernel32.dll",
+        L"api-ms-win-core-synch-l1-2-0.dll",
+        L"kernelbase.dll",
+        L"kernel32_vista.dll",
+    };
+    HMODULE hDll = NULL;
+    ULONG i;
+
+    for (i = 0; i < _countof(Modules) && !pWaitOnAddress; i++)
+    {
+        hDll = LoadLibraryW(Modules[i]);
+        if (hDll)
+            pWaitOnAddress = (void *)GetProcAddress(hDll, "WaitOnAddress");
+    }
+    if (!pWaitOnAddress)
+    {
+        skip("WaitOnAddress is not available\n");
+        return;
+    }
+    pWakeByAddressAll = (void *)GetProcAddress(hDll, "WakeByAddressAll");
+    pWakeByAddressSingle = (void *)GetProcAddress(hDll, "WakeByAddressSingle");
+    ok(pWakeByAddressAll && pWakeByAddressSingle, "WakeByAddress* missing next to WaitOnAddress\n");
+    if (!pWakeByAddressAll || !pWakeByAddressSingle)
+        return;
+
+    Test_Compare();
+    Test_Wake();
+    Test_ContendedLock();
+}
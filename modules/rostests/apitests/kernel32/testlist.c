@@ -4,6 +4,8 @@
 #include <apitest.h>
 
 extern void func_Console(void);
+extern void func_ConsoleScroll(void);
+extern void func_CopyFile(void);
 extern void func_CreateProcess(void);
 extern void func_DefaultActCtx(void);
 extern void func_DeviceIoControl(void);
@@ -31,11 +33,14 @@ extern void func_SetUnhandledExceptionFilter(void);
 extern void func_SystemFirmware(void);
 extern void func_TerminateProcess(void);
 extern void func_TunnelCache(void);
+extern void func_WaitOnAddress(void);
 extern void func_WideCharToMultiByte(void);
 
 const struct test winetest_testlist[] =
 {
     { "ConsoleCP",                   func_Console },
+    { "ConsoleScroll",               func_ConsoleScroll },
+    { "CopyFile",                    func_CopyFile },
     { "CreateProcess",               func_CreateProcess },
     { "DefaultActCtx",               func_DefaultActCtx },
     { "DeviceIoControl",             func_DeviceIoControl },
@@ -63,6 +68,7 @@ const struct test winetest_testlist[] =
     { "SystemFirmware",              func_SystemFirmware },
     { "TerminateProcess",            func_TerminateProcess },
     { "TunnelCache",                 func_TunnelCache },
+    { "WaitOnAddress",               func_WaitOnAddress },
     { "WideCharToMultiByte",         func_WideCharToMultiByte },
     { 0, 0 }
 };
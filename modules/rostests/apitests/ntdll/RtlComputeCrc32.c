@@ -0,0 +1,58 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for RtlComputeCrc32
+ */
+
+#include "precomp.h"
+
+static
+ULONG
+ReferenceCrc32(
+    _In_ ULONG Initial,
+    _In_ const UCHAR *Data,
+    _In_ ULONG Length)
+{
+    ULONG Crc = ~Initial;
+    ULONG Bit;
+
+    while (Length--)
+    {
+        Crc ^= *Data++;
+        for (Bit = 0; Bit < 8; Bit++)
+            Crc = (Crc >> 1) ^ ((Crc & 1) ? 0xedb88320 : 0);
+    }
+
+    return ~Crc;
+}
+
+START_TEST(RtlComputeCrc32)
+{
+    static UCHAR Buffer[4096 + 16];
+    ULONG Offset, Length, Initial, i;
+    ULONG Crc, Expected;
+
+    for (i = 0; i < sizeof(Buffer); i++)
+        Buffer[i] = (UCHAR)(i * 7 + (i >> 8));
+
+    ok_hex(RtlComputeCrc32(0, (PUCHAR)"123456789", 9), 0xcbf43926);
+    ok_hex(RtlComputeCrc32(0x12345678, Buffer, 0), 0x12345678);
+
+    /* Cover every alignment and tail length around the 8 byte fast path */
+    for (Offset = 0; Offset < 16; Offset++)
+    {
+        for (Length = 0; Length < 64; Length++)
+        {
+            Initial = Offset * 0x01000193 + Length;
+            Crc = RtlComputeCrc32(Initial, Buffer + Offset, Length);
+            Expected = ReferenceCrc32(Initial, Buffer + Offset, Length);
+            ok(Crc == Expected, "Offset %lu, Length %lu: got 0x%lx, expected 0x%lx\n",
+               Offset, Length, Crc, Expected);
+        }
+    }
+
+    /* Chaining must give the same result as a single call */
+    Crc = RtlComputeCrc32(0, Buffer + 3, 1001);
+    Crc = RtlComputeCrc32(Crc, Buffer + 1004, 4096 - 1001);
+    ok_hex(Crc, ReferenceCrc32(0, Buffer + 3, 4096));
+}
@@ -0,0 +1,149 @@
+/*
+ * PROJECT:         ReactOS kernel-mode tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Kernel-Mode Test Suite Runtime library for range lists
+ */
+
+#include <kmt_test.h>
+
+#define NDEBUG
+#include <debug.h>
+
+static
+ULONG
+CheckRangeOrder(
+    _In_ PRTL_RANGE_LIST RangeList)
+{
+    RTL_RANGE_LIST_ITERATOR Iterator;
+    PRTL_RANGE Range;
+    ULONGLONG Previous = 0;
+    ULONG Count = 0;
+    NTSTATUS Status;
+
+    Status = RtlGetFirstRange(RangeList, &Iterator, &Range);
+    while (NT_SUCCESS(Status))
+    {
+        ok(Range->Start >= Previous, "Range %I64x after %I64x\n", Range->Start, Previous);
+        Previous = Range->Start;
+        Count++;
+        Status = RtlGetNextRange(&Iterator, &Range, TRUE);
+    }
+    ok_eq_hex(Status, STATUS_NO_MORE_ENTRIES);
+
+    return Count;
+}
+
+START_TEST(RtlRangeList)
+{
+    RTL_RANGE_LIST RangeList, CopyList, MergedList;
+    RTL_RANGE_LIST_ITERATOR Iterator;
+    PRTL_RANGE Range;
+    ULONGLONG Start;
+    BOOLEAN Available;
+    NTSTATUS Status;
+    ULONG i, Seed;
+
+    RtlInitializeRangeList(&RangeList);
+
+    /* Added out of order, iterated in order */
+    Status = RtlAddRange(&RangeList, 0x3000, 0x3fff, 0, 0, NULL, NULL);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    Status = RtlAddRange(&RangeList, 0x1000, 0x1fff, 0, 0, NULL, NULL);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    Status = RtlAddRange(&RangeList, 0x5000, 0x5fff, 0, RTL_RANGE_LIST_ADD_SHARED, NULL, NULL);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    Status = RtlAddRange(&RangeList, 0x10, 0x1, 0, 0, NULL, NULL);
+    ok_eq_hex(Status, STATUS_INVALID_PARAMETER);
+    Status = RtlAddRange(&RangeList, 0x3800, 0x47ff, 0, 0, NULL, NULL);
+    ok_eq_hex(Status, STATUS_RANGE_LIST_CONFLICT);
+    Status = RtlAddRange(&RangeList, 0x5800, 0x5900, 0, RTL_RANGE_LIST_ADD_SHARED, NULL, NULL);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    Status = RtlDeleteRange(&RangeList, 0x5800, 0x5900, NULL);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok_eq_ulong(RangeList.Count, 3UL);
+    ok_eq_ulong(CheckRangeOrder(&RangeList), 3UL);
+
+    Status = RtlGetFirstRange(&RangeList, &Iterator, &Range);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok_eq_ulonglong(Range->Start, 0x1000ULL);
+    Status = RtlGetNextRange(&Iterator, &Range, TRUE);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok_eq_ulonglong(Range->Start, 0x3000ULL);
+    Status = RtlGetNextRange(&Iterator, &Range, FALSE);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok_eq_ulonglong(Range->Start, 0x1000ULL);
+
+    /* Availability */
+    RtlIsRangeAvailable(&RangeList, 0x2000, 0x2fff, 0, 0, NULL, NULL, &Available);
+    ok_eq_bool(Available, TRUE);
+    RtlIsRangeAvailable(&RangeList, 0x2000, 0x3000, 0, 0, NULL, NULL, &Available);
+    ok_eq_bool(Available, FALSE);
+    RtlIsRangeAvailable(&RangeList, 0x1fff, 0x2000, 0, 0, NULL, NULL, &Available);
+    ok_eq_bool(Available, FALSE);
+    RtlIsRangeAvailable(&RangeList, 0x5800, 0x5900, 0, 0, NULL, NULL, &Available);
+    ok_eq_bool(Available, FALSE);
+    RtlIsRangeAvailable(&RangeList, 0x5800, 0x5900, RTL_RANGE_SHARED, 0, NULL, NULL, &Available);
+    ok_eq_bool(Available, TRUE);
+
+    /* The highest free aligned range is returned */
+    Status = RtlFindRange(&RangeList, 0, 0x5fff, 0x800, 0x800, 0, 0, NULL, NULL, &Start);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok_eq_ulonglong(Start, 0x4800ULL);
+    Status = RtlFindRange(&RangeList, 0, 0x3fff, 0x1000, 0x1000, 0, 0, NULL, NULL, &Start);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok_eq_ulonglong(Start, 0x2000ULL);
+    Status = RtlFindRange(&RangeList, 0x1000, 0x3fff, 0x1001, 1, 0, 0, NULL, NULL, &Start);
+    ok_eq_hex(Status, STATUS_RANGE_NOT_FOUND);
+
+    /* Copy and merge keep the order */
+    RtlInitializeRangeList(&CopyList);
+    Status = RtlCopyRangeList(&CopyList, &RangeList);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok_eq_ulong(CheckRangeOrder(&CopyList), 3UL);
+
+    Status = RtlDeleteRange(&CopyList, 0x3000, 0x3fff, NULL);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    Status = RtlDeleteRange(&CopyList, 0x3000, 0x3fff, NULL);
+    ok_eq_hex(Status, STATUS_RANGE_NOT_FOUND);
+    Status = RtlAddRange(&CopyList, 0x8000, 0x8fff, 0, 0, NULL, NULL);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+
+    RtlInitializeRangeList(&MergedList);
+    Status = RtlMergeRangeLists(&MergedList, &RangeList, &CopyList, 0);
+    ok_eq_hex(Status, STATUS_RANGE_LIST_CONFLICT);
+    ok_eq_ulong(MergedList.Count, 0UL);
+    Status = RtlMergeRangeLists(&MergedList, &RangeList, &CopyList, RTL_RANGE_LIST_MERGE_IF_CONFLICT);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok_eq_ulong(MergedList.Count, 6UL);
+    ok_eq_ulong(CheckRangeOrder(&MergedList), 6UL);
+
+    RtlFreeRangeList(&MergedList);
+    RtlFreeRangeList(&CopyList);
+    RtlFreeRangeList(&RangeList);
+
+    /* Many ranges, added and removed in random order; some of them overlap */
+    Seed = 0x12345678;
+    for (i = 0; i < 2000; i++)
+    {
+        Start = (ULONGLONG)(RtlRandom(&Seed) % 0x10000) * 0x10;
+        Status = RtlAddRange(&RangeList, Start, Start + 0xf, 0, RTL_RANGE_LIST_ADD_IF_CONFLICT, NULL, (PVOID)(ULONG_PTR)(i % 4 + 1));
+        ok_eq_hex(Status, STATUS_SUCCESS);
+    }
+    ok_eq_ulong(CheckRangeOrder(&RangeList), 2000UL);
+
+    Status = RtlDeleteOwnersRanges(&RangeList, (PVOID)2);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok_eq_ulong(RangeList.Count, 1500UL);
+    ok_eq_ulong(CheckRangeOrder(&RangeList), 1500UL);
+
+    Status = RtlGetFirstRange(&RangeList, &Iterator, &Range);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    if (NT_SUCCESS(Status))
+    {
+        RtlIsRangeAvailable(&RangeList, Range->Start + 4, Range->Start + 4, 0, 0, NULL, NULL, &Available);
+        ok_eq_bool(Available, FALSE);
+    }
+
+    RtlFreeRangeList(&RangeList);
+    ok_eq_ulong(RangeList.Count, 0UL);
+}
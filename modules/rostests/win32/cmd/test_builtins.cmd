@@ -26,5 +26,21 @@ for %%i in (M,
 N,
 O
 ) do echo %%j
+echo ------------ Testing goto ------------
+echo --- GOTO forward, backward and CALL :label
+set /a n=0
+:goto_loop
+set /a n+=1
+if %n% lss 3 goto GOTO_LOOP
+echo n=%n%
+call :goto_sub X
+goto goto_skip
+echo not reached
+:goto_sub
+echo sub %1
+goto :eof
+:goto_skip
+echo after skip
+set n=
 echo ------------ End of Testing ------------
 echo --- Testing ends here
@@ -1030,6 +1030,142 @@ static void test_WICCreateBitmapFromSectionEx(void)
     CloseHandle(hsection);
 }
 
+static void test_scaler(void)
+{
+    static const WICBitmapInterpolationMode modes[] =
+    {
+        WICBitmapInterpolationModeLinear,
+        WICBitmapInterpolationModeCubic,
+        WICBitmapInterpolationModeFant
+    };
+    IWICBitmapScaler *scaler;
+    IWICBitmap *bitmap;
+    WICPixelFormatGUID format;
+    BYTE src[4 * 4 * 4], dst[7 * 5 * 4];
+    UINT width, height, i, x, y;
+    HRESULT hr;
+
+    /* Left half is (0,40,80,255), right half is (200,120,40,255) */
+    for (y = 0; y < 4; y++)
+    {
+        for (x = 0; x < 4; x++)
+        {
+            BYTE *pixel = src + (y * 4 + x) * 4;
+            pixel[0] = x < 2 ? 0 : 200;
+            pixel[1] = x < 2 ? 40 : 120;
+            pixel[2] = x < 2 ? 80 : 40;
+            pixel[3] = 0xff;
+        }
+    }
+
+    hr = IWICImagingFactory_CreateBitmapFromMemory(factory, 4, 4, &GUID_WICPixelFormat32bppBGRA,
+        16, sizeof(src), src, &bitmap);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+
+    for (i = 0; i < sizeof(modes)/sizeof(modes[0]); i++)
+    {
+        hr = IWICImagingFactory_CreateBitmapScaler(factory, &scaler);
+        ok(hr == S_OK, "got 0x%08x\n", hr);
+
+        hr = IWICBitmapScaler_Initialize(scaler, (IWICBitmapSource*)bitmap, 2, 2, modes[i]);
+        ok(hr == S_OK, "mode %u: got 0x%08x\n", modes[i], hr);
+
+        width = height = 0;
+        hr = IWICBitmapScaler_GetSize(scaler, &width, &height);
+        ok(hr == S_OK, "got 0x%08x\n", hr);
+        ok(width == 2 && height == 2, "mode %u: got %ux%u\n", modes[i], width, height);
+
+        hr = IWICBitmapScaler_GetPixelFormat(scaler, &format);
+        ok(hr == S_OK, "got 0x%08x\n", hr);
+        ok(IsEqualGUID(&format, &GUID_WICPixelFormat32bppBGRA), "mode %u: got %s\n",
+            modes[i], wine_dbgstr_guid(&format));
+
+        /* Halving keeps the two halves apart, except for the cubic overshoot */
+        memset(dst, 0xcc, sizeof(dst));
+        hr = IWICBitmapScaler_CopyPixels(scaler, NULL, 8, 16, dst);
+        ok(hr == S_OK, "mode %u: got 0x%08x\n", modes[i], hr);
+        for (y = 0; y < 2 && modes[i] != WICBitmapInterpolationModeCubic; y++)
+        {
+            ok(dst[y * 8 + 0] == 0 && dst[y * 8 + 1] == 40 && dst[y * 8 + 2] == 80 && dst[y * 8 + 3] == 0xff,
+               "mode %u: got left pixel %02x%02x%02x%02x\n", modes[i],
+               dst[y * 8 + 3], dst[y * 8 + 2], dst[y * 8 + 1], dst[y * 8 + 0]);
+            ok(dst[y * 8 + 4] == 200 && dst[y * 8 + 5] == 120 && dst[y * 8 + 6] == 40 && dst[y * 8 + 7] == 0xff,
+               "mode %u: got right pixel %02x%02x%02x%02x\n", modes[i],
+               dst[y * 8 + 7], dst[y * 8 + 6], dst[y * 8 + 5], dst[y * 8 + 4]);
+        }
+
+        IWICBitmapScaler_Release(scaler);
+
+        /* Enlarging keeps the edges and puts blended pixels in between */
+        hr = IWICImagingFactory_CreateBitmapScaler(factory, &scaler);
+        ok(hr == S_OK, "got 0x%08x\n", hr);
+
+        hr = IWICBitmapScaler_Initialize(scaler, (IWICBitmapSource*)bitmap, 7, 5, modes[i]);
+        ok(hr == S_OK, "mode %u: got 0x%08x\n", modes[i], hr);
+
+        hr = IWICBitmapScaler_CopyPixels(scaler, NULL, 28, sizeof(dst), dst);
+        ok(hr == S_OK, "mode %u: got 0x%08x\n", modes[i], hr);
+        for (y = 0; y < 5; y++)
+        {
+            BYTE *row = dst + y * 28;
+            ok(row[0] == 0 && row[1] == 40 && row[2] == 80,
+               "mode %u: row %u: got %u,%u,%u\n", modes[i], y, row[0], row[1], row[2]);
+            ok(row[24] == 200 && row[25] == 120 && row[26] == 40,
+               "mode %u: row %u: got %u,%u,%u\n", modes[i], y, row[24], row[25], row[26]);
+            ok(row[12] > 0 && row[12] < 200, "mode %u: row %u: got %u\n", modes[i], y, row[12]);
+            for (x = 0; x < 7; x++)
+                ok(row[x * 4 + 3] == 0xff, "mode %u: got alpha %u\n", modes[i], row[x * 4 + 3]);
+        }
+
+        IWICBitmapScaler_Release(scaler);
+    }
+
+    IWICBitmap_Release(bitmap);
+
+    /* One pixel wide sources have a single tap, each output pixel must be that pixel */
+    for (y = 0; y < 3; y++)
+    {
+        src[y * 4 + 0] = 10;
+        src[y * 4 + 1] = 20;
+        src[y * 4 + 2] = 30;
+        src[y * 4 + 3] = 0xff;
+    }
+
+    hr = IWICImagingFactory_CreateBitmapFromMemory(factory, 1, 3, &GUID_WICPixelFormat32bppBGRA,
+        4, 12, src, &bitmap);
+    ok(hr == S_OK, "got 0x%08x\n", hr);
+
+    for (i = 0; i < sizeof(modes)/sizeof(modes[0]); i++)
+    {
+        static const UINT sizes[][2] = { { 1, 3 }, { 1, 5 }, { 3, 2 }, { 7, 1 } };
+        UINT j;
+
+        for (j = 0; j < sizeof(sizes)/sizeof(sizes[0]); j++)
+        {
+            hr = IWICImagingFactory_CreateBitmapScaler(factory, &scaler);
+            ok(hr == S_OK, "got 0x%08x\n", hr);
+
+            hr = IWICBitmapScaler_Initialize(scaler, (IWICBitmapSource*)bitmap,
+                sizes[j][0], sizes[j][1], modes[i]);
+            ok(hr == S_OK, "mode %u: got 0x%08x\n", modes[i], hr);
+
+            memset(dst, 0xcc, sizeof(dst));
+            hr = IWICBitmapScaler_CopyPixels(scaler, NULL, sizes[j][0] * 4, sizeof(dst), dst);
+            ok(hr == S_OK, "mode %u: got 0x%08x\n", modes[i], hr);
+            for (x = 0; x < sizes[j][0] * sizes[j][1]; x++)
+            {
+                ok(dst[x * 4] == 10 && dst[x * 4 + 1] == 20 && dst[x * 4 + 2] == 30 && dst[x * 4 + 3] == 0xff,
+                   "mode %u, %ux%u: pixel %u: got %u,%u,%u,%u\n", modes[i], sizes[j][0], sizes[j][1], x,
+                   dst[x * 4], dst[x * 4 + 1], dst[x * 4 + 2], dst[x * 4 + 3]);
+            }
+
+            IWICBitmapScaler_Release(scaler);
+        }
+    }
+
+    IWICBitmap_Release(bitmap);
+}
+
 START_TEST(bitmap)
 {
     HRESULT hr;
@@ -1046,6 +1182,7 @@ START_TEST(bitmap)
     test_CreateBitmapFromHICON();
     test_CreateBitmapFromHBITMAP();
     test_clipper();
+    test_scaler();
 
     IWICImagingFactory_Release(factory);
 
@@ -716,12 +716,12 @@ QSI_DEF(SystemPerformanceInformation)
     Spi->TransitionCount = 0; /* FIXME */
     Spi->CacheTransitionCount = 0; /* FIXME */
     Spi->DemandZeroCount = 0; /* FIXME */
-    Spi->PageReadCount = 0; /* FIXME */
-    Spi->PageReadIoCount = 0; /* FIXME */
+    Spi->PageReadCount = MiPageFileReadCount; /* FIXME: paging file only */
+    Spi->PageReadIoCount = MiPageFileReadIoCount; /* FIXME: paging file only */
     Spi->CacheReadCount = 0; /* FIXME */
     Spi->CacheIoCount = 0; /* FIXME */
-    Spi->DirtyPagesWriteCount = 0; /* FIXME */
-    Spi->DirtyWriteIoCount = 0; /* FIXME */
+    Spi->DirtyPagesWriteCount = MiPageFileWriteCount;
+    Spi->DirtyWriteIoCount = MiPageFileWriteIoCount;
     Spi->MappedPagesWriteCount = 0; /* FIXME */
     Spi->MappedWriteIoCount = 0; /* FIXME */
 
@@ -693,6 +693,11 @@ NTSTATUS
 IopInitializePnpServices(
     IN PDEVICE_NODE DeviceNode);
 
+VOID
+IopInitializeParallelDeviceStart(
+    VOID
+);
+
 NTSTATUS
 NTAPI
 IopOpenRegistryKeyEx(
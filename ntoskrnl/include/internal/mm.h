@@ -9,6 +9,10 @@ struct _EPROCESS;
 extern PMMSUPPORT MmKernelAddressSpace;
 extern PFN_COUNT MiFreeSwapPages;
 extern PFN_COUNT MiUsedSwapPages;
+extern LONG MiPageFileReadCount;
+extern LONG MiPageFileReadIoCount;
+extern LONG MiPageFileWriteCount;
+extern LONG MiPageFileWriteIoCount;
 extern PFN_COUNT MmNumberOfPhysicalPages;
 extern UCHAR MmDisablePagingExecutive;
 extern PFN_NUMBER MmLowestPhysicalPage;
@@ -434,6 +438,7 @@ typedef struct _MMPAGING_FILE
     PFILE_OBJECT FileObject;
     UNICODE_STRING PageFileName;
     PRTL_BITMAP Bitmap;
+    ULONG AllocationHint;
     HANDLE FileHandle;
 }
 MMPAGING_FILE, *PMMPAGING_FILE;
@@ -186,5 +186,10 @@
 /* Se Process Audit */
 #define TAG_SEPA          'aPeS'
 
+/* WMI Tags */
+#define TAG_WMI_LOGGER    'LimW'
+#define TAG_WMI_BUFFER    'BimW'
+#define TAG_WMI_EVENT     'EimW'
+
 #define TAG_WAIT            'tiaW'
 #define TAG_SEC_QUERY       'qSbO'
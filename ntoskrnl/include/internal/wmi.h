@@ -0,0 +1,108 @@
+/*
+* PROJECT:         ReactOS Kernel
+* LICENSE:         GPL - See COPYING in the top level directory
+* FILE:            ntoskrnl/include/internal/wmi.h
+* PURPOSE:         Internal header for the kernel event trace logger
+*/
+
+//
+// Events the kernel logger can trace, these match EVENT_TRACE_FLAG_*
+//
+#define WMI_TRACE_FLAG_PROCESS                          0x00000001
+#define WMI_TRACE_FLAG_THREAD                           0x00000002
+#define WMI_TRACE_FLAG_CSWITCH                          0x00000010
+#define WMI_TRACE_FLAG_DISK_IO                          0x00000100
+#define WMI_TRACE_FLAG_MEMORY_PAGE_FAULTS               0x00001000
+
+#define WMI_TRACE_FLAG_SUPPORTED                        \
+    (WMI_TRACE_FLAG_PROCESS | WMI_TRACE_FLAG_THREAD |   \
+     WMI_TRACE_FLAG_CSWITCH | WMI_TRACE_FLAG_DISK_IO |  \
+     WMI_TRACE_FLAG_MEMORY_PAGE_FAULTS)
+
+//
+// Enable flags of the running kernel logger, zero while it is stopped
+//
+extern volatile ULONG WmipKernelLoggerEnableFlags;
+
+VOID
+NTAPI
+WmipTraceProcess(
+    IN PEPROCESS Process,
+    IN BOOLEAN Create
+);
+
+VOID
+NTAPI
+WmipTraceThread(
+    IN PETHREAD Thread,
+    IN BOOLEAN Create
+);
+
+VOID
+FASTCALL
+WmipTraceContextSwitch(
+    IN PKTHREAD OldThread,
+    IN PKTHREAD NewThread
+);
+
+VOID
+FASTCALL
+WmipTraceDiskIo(
+    IN PIRP Irp
+);
+
+VOID
+FASTCALL
+WmipTracePageFault(
+    IN ULONG FaultCode,
+    IN PVOID Address,
+    IN KPROCESSOR_MODE Mode
+);
+
+//
+// Kernel logger hooks. With the logger stopped, each costs a single test
+//
+FORCEINLINE
+VOID
+WmiTraceProcess(IN PEPROCESS Process,
+                IN BOOLEAN Create)
+{
+    if (WmipKernelLoggerEnableFlags & WMI_TRACE_FLAG_PROCESS)
+        WmipTraceProcess(Process, Create);
+}
+
+FORCEINLINE
+VOID
+WmiTraceThread(IN PETHREAD Thread,
+               IN BOOLEAN Create)
+{
+    if (WmipKernelLoggerEnableFlags & WMI_TRACE_FLAG_THREAD)
+        WmipTraceThread(Thread, Create);
+}
+
+FORCEINLINE
+VOID
+WmiTraceContextSwitch(IN PKTHREAD OldThread,
+                      IN PKTHREAD NewThread)
+{
+    if (WmipKernelLoggerEnableFlags & WMI_TRACE_FLAG_CSWITCH)
+        WmipTraceContextSwitch(OldThread, NewThread);
+}
+
+FORCEINLINE
+VOID
+WmiTraceDiskIo(IN PIRP Irp)
+{
+    if (WmipKernelLoggerEnableFlags & WMI_TRACE_FLAG_DISK_IO)
+        WmipTraceDiskIo(Irp);
+}
+
+FORCEINLINE
+VOID
+WmiTracePageFault(IN ULONG FaultCode,
+                  IN PVOID Address,
+                  IN KPROCESSOR_MODE Mode)
+{
+    if (WmipKernelLoggerEnableFlags & WMI_TRACE_FLAG_MEMORY_PAGE_FAULTS)
+        WmipTracePageFault(FaultCode, Address, Mode);
+}
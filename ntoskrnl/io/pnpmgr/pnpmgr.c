@@ -45,6 +45,45 @@ typedef struct _DEVICE_ACTION_DATA
     DEVICE_RELATION_TYPE Type;
 } DEVICE_ACTION_DATA, *PDEVICE_ACTION_DATA;
 
+/*
+ * Parallel device start. While the children of a device node are added,
+ * devices that do not need to be started in order are queued on a start
+ * batch instead of being started right away. Once every child is added,
+ * their IRP_MN_START_DEVICE requests are sent from several threads at once.
+ * Resource assignment, enumeration and all device node updates still run
+ * on the enumerating thread, in the order the devices were added.
+ *
+ * This is off by default. It is turned on by setting the ParallelDeviceStart
+ * DWORD under CurrentControlSet\Control\Pnp to 1. Its effect on boot time
+ * has not been measured yet; each batch reports how long its starts took.
+ * The start entries are walked under the batch spinlock, so they come from
+ * nonpaged pool.
+ */
+#define PNP_MAX_START_THREADS 4
+
+typedef struct _PNP_START_ENTRY
+{
+    LIST_ENTRY ListEntry;
+    PDEVICE_NODE DeviceNode;
+    NTSTATUS Status;
+} PNP_START_ENTRY, *PPNP_START_ENTRY;
+
+typedef struct _PNP_START_BATCH
+{
+    LIST_ENTRY BatchListEntry;
+    PDEVICE_NODE ParentNode;
+    PKTHREAD OwnerThread;
+    BOOLEAN Active;
+    ULONG Count;
+    LIST_ENTRY EntryListHead;
+    KSPIN_LOCK Lock;
+    PLIST_ENTRY NextEntry;
+} PNP_START_BATCH, *PPNP_START_BATCH;
+
+BOOLEAN PnpParallelDeviceStart = FALSE;
+LIST_ENTRY PnpStartBatchListHead;
+KSPIN_LOCK PnpStartBatchLock;
+
 /* FUNCTIONS *****************************************************************/
 NTSTATUS
 NTAPI
@@ -646,18 +685,12 @@ IopSendStopDevice(IN PDEVICE_OBJECT DeviceObject)
     IopSynchronousCall(DeviceObject, &Stack, &Dummy);
 }
 
-VOID
-NTAPI
-IopStartDevice2(IN PDEVICE_OBJECT DeviceObject)
+static
+NTSTATUS
+IopSendStartDevice(IN PDEVICE_NODE DeviceNode)
 {
     IO_STACK_LOCATION Stack;
-    PDEVICE_NODE DeviceNode;
-    NTSTATUS Status;
     PVOID Dummy;
-    DEVICE_CAPABILITIES DeviceCapabilities;
-
-    /* Get the device node */
-    DeviceNode = IopGetDeviceNode(DeviceObject);
 
     ASSERT(!(DeviceNode->Flags & DNF_DISABLED));
 
@@ -672,7 +705,16 @@ IopStartDevice2(IN PDEVICE_OBJECT DeviceObject)
          DeviceNode->ResourceListTranslated;
 
     /* Do the call */
-    Status = IopSynchronousCall(DeviceObject, &Stack, &Dummy);
+    return IopSynchronousCall(DeviceNode->PhysicalDeviceObject, &Stack, &Dummy);
+}
+
+static
+VOID
+IopFinishStartDevice(IN PDEVICE_NODE DeviceNode,
+                     IN NTSTATUS Status)
+{
+    DEVICE_CAPABILITIES DeviceCapabilities;
+
     if (!NT_SUCCESS(Status))
     {
         /* Send an IRP_MN_REMOVE_DEVICE request */
@@ -695,7 +737,7 @@ IopStartDevice2(IN PDEVICE_OBJECT DeviceObject)
     }
 
     /* Invalidate device state so IRP_MN_QUERY_PNP_DEVICE_STATE is sent */
-    IoInvalidateDeviceState(DeviceObject);
+    IoInvalidateDeviceState(DeviceNode->PhysicalDeviceObject);
 
     /* Otherwise, mark us as started */
     DeviceNode->Flags |= DNF_STARTED;
@@ -705,6 +747,18 @@ IopStartDevice2(IN PDEVICE_OBJECT DeviceObject)
     DeviceNode->Flags |= DNF_NEED_ENUMERATION_ONLY;
 }
 
+VOID
+NTAPI
+IopStartDevice2(IN PDEVICE_OBJECT DeviceObject)
+{
+    PDEVICE_NODE DeviceNode;
+
+    /* Get the device node */
+    DeviceNode = IopGetDeviceNode(DeviceObject);
+
+    IopFinishStartDevice(DeviceNode, IopSendStartDevice(DeviceNode));
+}
+
 NTSTATUS
 NTAPI
 IopStartAndEnumerateDevice(IN PDEVICE_NODE DeviceNode)
@@ -779,8 +833,9 @@ IopStopDevice(
     return Status;
 }
 
+static
 NTSTATUS
-IopStartDevice(
+IopSetActiveService(
    PDEVICE_NODE DeviceNode)
 {
     NTSTATUS Status;
@@ -788,16 +843,6 @@ IopStartDevice(
     UNICODE_STRING KeyName, ValueString;
     OBJECT_ATTRIBUTES ObjectAttributes;
 
-    if (DeviceNode->Flags & DNF_DISABLED)
-        return STATUS_SUCCESS;
-
-    Status = IopAssignDeviceResources(DeviceNode);
-    if (!NT_SUCCESS(Status))
-        goto ByeBye;
-
-    /* New PnP ABI */
-    IopStartAndEnumerateDevice(DeviceNode);
-
     /* FIX: Should be done in new device instance code */
     Status = IopCreateDeviceKeyPath(&DeviceNode->InstancePath, REG_OPTION_NON_VOLATILE, &InstanceHandle);
     if (!NT_SUCCESS(Status))
@@ -838,6 +883,327 @@ ByeBye:
     return Status;
 }
 
+static
+BOOLEAN
+IopIsBootStartDevice(
+   PDEVICE_NODE DeviceNode)
+{
+    UNICODE_STRING ServicesKeyName = RTL_CONSTANT_STRING(L"\\Registry\\Machine\\System\\CurrentControlSet\\Services");
+    PKEY_VALUE_FULL_INFORMATION KeyValueInformation;
+    HANDLE ServicesHandle, ServiceHandle;
+    ULONG Start = SERVICE_BOOT_START;
+    NTSTATUS Status;
+
+    /* Raw devices are started by their bus driver */
+    if (!DeviceNode->ServiceName.Buffer)
+        return FALSE;
+
+    /* Assume the worst if the service can't be looked up */
+    Status = IopOpenRegistryKeyEx(&ServicesHandle, NULL, &ServicesKeyName, KEY_READ);
+    if (!NT_SUCCESS(Status))
+        return TRUE;
+
+    Status = IopOpenRegistryKeyEx(&ServiceHandle, ServicesHandle, &DeviceNode->ServiceName, KEY_READ);
+    ZwClose(ServicesHandle);
+    if (!NT_SUCCESS(Status))
+        return TRUE;
+
+    Status = IopGetRegistryValue(ServiceHandle, L"Start", &KeyValueInformation);
+    ZwClose(ServiceHandle);
+    if (!NT_SUCCESS(Status))
+        return TRUE;
+
+    if ((KeyValueInformation->Type == REG_DWORD) &&
+        (KeyValueInformation->DataLength == sizeof(ULONG)))
+    {
+        Start = *(PULONG)((ULONG_PTR)KeyValueInformation + KeyValueInformation->DataOffset);
+    }
+
+    ExFreePool(KeyValueInformation);
+
+    return (Start == SERVICE_BOOT_START);
+}
+
+static
+PPNP_START_BATCH
+IopGetStartBatch(VOID)
+{
+    PPNP_START_BATCH Batch, Found = NULL;
+    PLIST_ENTRY ListEntry;
+    PKTHREAD Thread = KeGetCurrentThread();
+    KIRQL OldIrql;
+
+    /* The most recent batch of this thread is the one being filled */
+    KeAcquireSpinLock(&PnpStartBatchLock, &OldIrql);
+    for (ListEntry = PnpStartBatchListHead.Flink;
+         ListEntry != &PnpStartBatchListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        Batch = CONTAINING_RECORD(ListEntry, PNP_START_BATCH, BatchListEntry);
+        if (Batch->OwnerThread == Thread)
+        {
+            Found = Batch;
+            break;
+        }
+    }
+    KeReleaseSpinLock(&PnpStartBatchLock, OldIrql);
+
+    return Found;
+}
+
+static
+BOOLEAN
+IopQueueStartDevice(
+   PDEVICE_NODE DeviceNode)
+{
+    PPNP_START_BATCH Batch;
+    PPNP_START_ENTRY Entry;
+
+    if (!PnpParallelDeviceStart)
+        return FALSE;
+
+    /* Only siblings enumerated by this thread are batched */
+    Batch = IopGetStartBatch();
+    if (!Batch || DeviceNode->Parent != Batch->ParentNode)
+        return FALSE;
+
+    if (DeviceNode->Flags & DNF_STARTED)
+        return FALSE;
+
+    /* Boot drivers may be needed by the devices that follow them */
+    if (IopIsBootStartDevice(DeviceNode))
+        return FALSE;
+
+    Entry = ExAllocatePoolWithTag(NonPagedPool, sizeof(PNP_START_ENTRY), TAG_IO);
+    if (!Entry)
+        return FALSE;
+
+    ObReferenceObject(DeviceNode->PhysicalDeviceObject);
+    Entry->DeviceNode = DeviceNode;
+    Entry->Status = STATUS_PENDING;
+    InsertTailList(&Batch->EntryListHead, &Entry->ListEntry);
+    Batch->Count++;
+
+    DeviceNode->Flags |= DNF_START_REQUEST_PENDING;
+
+    DPRINT("Queued start of %wZ\n", &DeviceNode->InstancePath);
+    return TRUE;
+}
+
+static
+VOID
+IopSendQueuedStarts(
+   PPNP_START_BATCH Batch)
+{
+    PPNP_START_ENTRY Entry;
+    PLIST_ENTRY ListEntry;
+    KIRQL OldIrql;
+
+    for (;;)
+    {
+        KeAcquireSpinLock(&Batch->Lock, &OldIrql);
+        ListEntry = Batch->NextEntry;
+        if (ListEntry != &Batch->EntryListHead)
+            Batch->NextEntry = ListEntry->Flink;
+        KeReleaseSpinLock(&Batch->Lock, OldIrql);
+
+        if (ListEntry == &Batch->EntryListHead)
+            break;
+
+        Entry = CONTAINING_RECORD(ListEntry, PNP_START_ENTRY, ListEntry);
+        Entry->Status = IopSendStartDevice(Entry->DeviceNode);
+    }
+}
+
+static
+VOID
+NTAPI
+IopStartDeviceThread(
+   PVOID Context)
+{
+    IopSendQueuedStarts(Context);
+    PsTerminateSystemThread(STATUS_SUCCESS);
+}
+
+static
+VOID
+IopBeginStartBatch(
+   PPNP_START_BATCH Batch,
+   PDEVICE_NODE ParentNode)
+{
+    KIRQL OldIrql;
+
+    RtlZeroMemory(Batch, sizeof(PNP_START_BATCH));
+    InitializeListHead(&Batch->EntryListHead);
+    KeInitializeSpinLock(&Batch->Lock);
+
+    if (!PnpParallelDeviceStart)
+        return;
+
+    Batch->ParentNode = ParentNode;
+    Batch->OwnerThread = KeGetCurrentThread();
+    Batch->Active = TRUE;
+
+    KeAcquireSpinLock(&PnpStartBatchLock, &OldIrql);
+    InsertHeadList(&PnpStartBatchListHead, &Batch->BatchListEntry);
+    KeReleaseSpinLock(&PnpStartBatchLock, OldIrql);
+}
+
+static
+VOID
+IopEndStartBatch(
+   PPNP_START_BATCH Batch)
+{
+    PVOID ThreadObjects[PNP_MAX_START_THREADS - 1];
+    ULONG ThreadCount = 0, i;
+    PPNP_START_ENTRY Entry;
+    PLIST_ENTRY ListEntry;
+    PDEVICE_NODE DeviceNode;
+    HANDLE ThreadHandle, WaitHandle = NULL;
+    ULONGLONG StartTime;
+    KIRQL OldIrql;
+    NTSTATUS Status;
+
+    if (!Batch->Active)
+        return;
+
+    /* Devices started below get batches of their own */
+    KeAcquireSpinLock(&PnpStartBatchLock, &OldIrql);
+    RemoveEntryList(&Batch->BatchListEntry);
+    KeReleaseSpinLock(&PnpStartBatchLock, OldIrql);
+    Batch->Active = FALSE;
+
+    if (Batch->Count == 0)
+        return;
+
+    DPRINT("Starting %lu devices of %wZ\n", Batch->Count, &Batch->ParentNode->InstancePath);
+    StartTime = KeQueryInterruptTime();
+
+    /* Send the start requests, with this thread doing its share */
+    Batch->NextEntry = Batch->EntryListHead.Flink;
+    while (ThreadCount < min(Batch->Count - 1, PNP_MAX_START_THREADS - 1))
+    {
+        Status = PsCreateSystemThread(&ThreadHandle,
+                                      THREAD_ALL_ACCESS,
+                                      NULL,
+                                      NULL,
+                                      NULL,
+                                      IopStartDeviceThread,
+                                      Batch);
+        if (!NT_SUCCESS(Status))
+            break;
+
+        Status = ObReferenceObjectByHandle(ThreadHandle,
+                                           SYNCHRONIZE,
+                                           PsThreadType,
+                                           KernelMode,
+                                           &ThreadObjects[ThreadCount],
+                                           NULL);
+        if (!NT_SUCCESS(Status))
+        {
+            /* The thread is already running, keep its handle to wait on it */
+            DPRINT1("ObReferenceObjectByHandle() failed (Status 0x%08lx)\n", Status);
+            WaitHandle = ThreadHandle;
+            break;
+        }
+
+        ZwClose(ThreadHandle);
+        ThreadCount++;
+    }
+
+    IopSendQueuedStarts(Batch);
+
+    if (WaitHandle)
+    {
+        ZwWaitForSingleObject(WaitHandle, FALSE, NULL);
+        ZwClose(WaitHandle);
+    }
+
+    for (i = 0; i < ThreadCount; i++)
+    {
+        KeWaitForSingleObject(ThreadObjects[i], Executive, KernelMode, FALSE, NULL);
+        ObDereferenceObject(ThreadObjects[i]);
+    }
+
+    DPRINT("Started %lu devices of %wZ in %I64u ms with %lu threads\n",
+           Batch->Count, &Batch->ParentNode->InstancePath,
+           (KeQueryInterruptTime() - StartTime) / 10000, ThreadCount + 1);
+
+    /* Complete the starts in the order the devices were added */
+    while (!IsListEmpty(&Batch->EntryListHead))
+    {
+        ListEntry = RemoveHeadList(&Batch->EntryListHead);
+        Entry = CONTAINING_RECORD(ListEntry, PNP_START_ENTRY, ListEntry);
+        DeviceNode = Entry->DeviceNode;
+
+        DeviceNode->Flags &= ~DNF_START_REQUEST_PENDING;
+        IopFinishStartDevice(DeviceNode, Entry->Status);
+
+        if (DeviceNode->Flags & DNF_STARTED)
+            IopStartAndEnumerateDevice(DeviceNode);
+
+        IopSetActiveService(DeviceNode);
+
+        ObDereferenceObject(DeviceNode->PhysicalDeviceObject);
+        ExFreePoolWithTag(Entry, TAG_IO);
+    }
+}
+
+VOID
+INIT_FUNCTION
+IopInitializeParallelDeviceStart(VOID)
+{
+    UNICODE_STRING KeyName = RTL_CONSTANT_STRING(L"\\Registry\\Machine\\SYSTEM\\CurrentControlSet\\Control\\Pnp");
+    PKEY_VALUE_FULL_INFORMATION KeyValueInformation;
+    HANDLE KeyHandle;
+    NTSTATUS Status;
+
+    InitializeListHead(&PnpStartBatchListHead);
+    KeInitializeSpinLock(&PnpStartBatchLock);
+
+    Status = IopOpenRegistryKeyEx(&KeyHandle, NULL, &KeyName, KEY_QUERY_VALUE);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    Status = IopGetRegistryValue(KeyHandle, L"ParallelDeviceStart", &KeyValueInformation);
+    ZwClose(KeyHandle);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    if ((KeyValueInformation->Type == REG_DWORD) &&
+        (KeyValueInformation->DataLength == sizeof(ULONG)))
+    {
+        PnpParallelDeviceStart = (*(PULONG)((ULONG_PTR)KeyValueInformation + KeyValueInformation->DataOffset) != 0);
+    }
+
+    ExFreePool(KeyValueInformation);
+
+    DPRINT("Parallel device start %s\n", PnpParallelDeviceStart ? "enabled" : "disabled");
+}
+
+NTSTATUS
+IopStartDevice(
+   PDEVICE_NODE DeviceNode)
+{
+    NTSTATUS Status;
+
+    if (DeviceNode->Flags & DNF_DISABLED)
+        return STATUS_SUCCESS;
+
+    Status = IopAssignDeviceResources(DeviceNode);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    /* The start request is sent once all siblings are added */
+    if (IopQueueStartDevice(DeviceNode))
+        return STATUS_SUCCESS;
+
+    /* New PnP ABI */
+    IopStartAndEnumerateDevice(DeviceNode);
+
+    return IopSetActiveService(DeviceNode);
+}
+
 NTSTATUS
 NTAPI
 IopQueryDeviceCapabilities(PDEVICE_NODE DeviceNode,
@@ -2940,6 +3306,8 @@ NTSTATUS
 IopInitializePnpServices(IN PDEVICE_NODE DeviceNode)
 {
    DEVICETREE_TRAVERSE_CONTEXT Context;
+   PNP_START_BATCH Batch;
+   NTSTATUS Status;
 
    DPRINT("IopInitializePnpServices(%p)\n", DeviceNode);
 
@@ -2949,7 +3317,11 @@ IopInitializePnpServices(IN PDEVICE_NODE DeviceNode)
       IopActionInitChildServices,
       DeviceNode);
 
-   return IopTraverseDeviceTree(&Context);
+   IopBeginStartBatch(&Batch, DeviceNode);
+   Status = IopTraverseDeviceTree(&Context);
+   IopEndStartBatch(&Batch);
+
+   return Status;
 }
 
 static NTSTATUS INIT_FUNCTION
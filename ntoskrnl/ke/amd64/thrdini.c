@@ -172,6 +172,9 @@ KiSwapContextResume(
     Pcr->ContextSwitches++;
     NewThread->ContextSwitches++;
 
+    /* Notify WMI */
+    WmiTraceContextSwitch(OldThread, NewThread);
+
     /* DPCs shouldn't be active */
     if (Pcr->Prcb.DpcRoutineActive)
     {
@@ -230,6 +230,9 @@ KiSwapContextExit(IN PKTHREAD OldThread,
     /* Increase thread context switches */
     NewThread->ContextSwitches++;
 
+    /* Notify WMI */
+    WmiTraceContextSwitch(OldThread, NewThread);
+
     /* DPCs shouldn't be active */
     if (Pcr->Prcb.DpcRoutineActive)
     {
@@ -380,6 +380,9 @@ KiSwapContextExit(IN PKTHREAD OldThread,
     /* Load data from switch frame */
     Pcr->NtTib.ExceptionList = SwitchFrame->ExceptionList;
 
+    /* Notify WMI */
+    WmiTraceContextSwitch(OldThread, NewThread);
+
     /* DPCs shouldn't be active */
     if (Pcr->PrcbData.DpcRoutineActive)
     {
@@ -208,6 +208,9 @@ MmAccessFault(IN ULONG FaultCode,
 {
     PMEMORY_AREA MemoryArea = NULL;
 
+    /* Notify WMI */
+    WmiTracePageFault(FaultCode, Address, Mode);
+
     /* Cute little hack for ROS */
     if ((ULONG_PTR)Address >= (ULONG_PTR)MmSystemRangeStart)
     {
@@ -55,6 +55,13 @@ PFN_COUNT MiFreeSwapPages;
 /* Number of pages that have been allocated for swapping */
 PFN_COUNT MiUsedSwapPages;
 
+/* Paging file I/O statistics: pages transferred and number of I/Os.
+ * Every paging file I/O is currently a single page. */
+LONG MiPageFileReadCount;
+LONG MiPageFileReadIoCount;
+LONG MiPageFileWriteCount;
+LONG MiPageFileWriteIoCount;
+
 BOOLEAN MmZeroPageFile;
 
 /*
@@ -181,6 +188,12 @@ MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
         Status = Iosb.Status;
     }
 
+    if (NT_SUCCESS(Status))
+    {
+        InterlockedIncrement(&MiPageFileWriteCount);
+        InterlockedIncrement(&MiPageFileWriteIoCount);
+    }
+
     if (Mdl->MdlFlags & MDL_MAPPED_TO_SYSTEM_VA)
     {
         MmUnmapLockedPages (Mdl->MappedSystemVa, Mdl);
@@ -246,6 +259,11 @@ MiReadPageFile(
         KeWaitForSingleObject(&Event, Executive, KernelMode, FALSE, NULL);
         Status = Iosb.Status;
     }
+    if (NT_SUCCESS(Status))
+    {
+        InterlockedIncrement(&MiPageFileReadCount);
+        InterlockedIncrement(&MiPageFileReadIoCount);
+    }
     if (Mdl->MdlFlags & MDL_MAPPED_TO_SYSTEM_VA)
     {
         MmUnmapLockedPages (Mdl->MappedSystemVa, Mdl);
@@ -292,7 +310,7 @@ MmFreeSwapPage(SWAPENTRY Entry)
         KeBugCheck(MEMORY_MANAGEMENT);
     }
 
-    RtlClearBit(PagingFile->Bitmap, off >> 5);
+    RtlClearBit(PagingFile->Bitmap, (ULONG)off);
 
     PagingFile->FreeSpace++;
     PagingFile->CurrentUsage--;
@@ -324,13 +342,24 @@ MmAllocSwapPage(VOID)
         if (MmPagingFile[i] != NULL &&
                 MmPagingFile[i]->FreeSpace >= 1)
         {
-            off = RtlFindClearBitsAndSet(MmPagingFile[i]->Bitmap, 1, 0);
+            /*
+             * Allocate next-fit from where the previous allocation ended
+             * rather than first-fit from bit 0: pages evicted one after the
+             * other then get consecutive slots, so the paging file is written
+             * (and later read back) sequentially instead of scattered over
+             * holes left at its beginning. The search wraps around.
+             */
+            off = RtlFindClearBitsAndSet(MmPagingFile[i]->Bitmap, 1,
+                                         MmPagingFile[i]->AllocationHint);
             if (off == 0xFFFFFFFF)
             {
                 KeBugCheck(MEMORY_MANAGEMENT);
                 KeReleaseGuardedMutex(&MmPageFileCreationLock);
                 return(STATUS_UNSUCCESSFUL);
             }
+            MmPagingFile[i]->AllocationHint = off + 1;
+            MmPagingFile[i]->FreeSpace--;
+            MmPagingFile[i]->CurrentUsage++;
             MiUsedSwapPages++;
             MiFreeSwapPages--;
             KeReleaseGuardedMutex(&MmPageFileCreationLock);
@@ -794,6 +823,17 @@ NtCreatePagingFile(IN PUNICODE_STRING FileName,
                         (ULONG)(PagingFile->MaximumSize));
     RtlClearAllBits(PagingFile->Bitmap);
 
+    /* Reserve the header page and everything past the current file size,
+     * so that the allocator never hands out a slot outside of the file */
+    RtlSetBit(PagingFile->Bitmap, 0);
+    if (PagingFile->MaximumSize > PagingFile->Size)
+    {
+        RtlSetBits(PagingFile->Bitmap,
+                   (ULONG)PagingFile->Size,
+                   (ULONG)(PagingFile->MaximumSize - PagingFile->Size));
+    }
+    PagingFile->AllocationHint = 1;
+
     /* FIXME: should be calling unsafe instead,
      * we should already be in a guarded region
      */
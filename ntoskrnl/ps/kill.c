@@ -511,7 +511,7 @@ PspExitThread(IN NTSTATUS ExitStatus)
     PopCleanupPowerState((PPOWER_STATE)&Thread->Tcb.PowerState);
 
     /* Call the WMI Callback for Threads */
-    //WmiTraceThread(Thread, NULL, FALSE);
+    WmiTraceThread(Thread, FALSE);
 
     /* Run Thread Notify Routines before we desintegrate the thread */
     PspRunCreateThreadNotifyRoutines(Thread, FALSE);
@@ -1087,7 +1087,7 @@ PspExitProcess(IN BOOLEAN LastThread,
     if (LastThread)
     {
         /* Notify the WMI Process Callback */
-        //WmiTraceProcess(Process, FALSE);
+        WmiTraceProcess(Process, FALSE);
 
         /* Run the Notification Routines */
         PspRunCreateProcessNotifyRoutines(Process, FALSE);
@@ -406,8 +406,7 @@ PspCreateThread(OUT PHANDLE ThreadHandle,
     ExReleaseRundownProtection(&Process->RundownProtect);
 
     /* Notify WMI */
-    //WmiTraceProcess(Process, TRUE);
-    //WmiTraceThread(Thread, InitialTeb, TRUE);
+    WmiTraceThread(Thread, TRUE);
 
     /* Notify Thread Creation */
     PspRunCreateThreadNotifyRoutines(Thread, TRUE);
@@ -0,0 +1,1530 @@
+/*
+ * PROJECT:         ReactOS Kernel
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * FILE:            ntoskrnl/wmi/trace.c
+ * PURPOSE:         Event Trace Loggers
+ */
+
+/*
+ * Every logger owns a fixed set of nonpaged buffers. Each processor writes
+ * its events to its own buffer at DISPATCH_LEVEL, so writers never take a
+ * lock: a full buffer is pushed to the flush list and replaced by one popped
+ * from the free list, both being interlocked SLISTs. When no free buffer is
+ * left, the event is counted as lost. The logger thread writes the flushed
+ * buffers to the log file every second and puts them back on the free list.
+ *
+ * Writers count themselves in a per-processor reference count of the logger
+ * slot before reading it. Stopping a logger clears its slot and waits for
+ * these counts to drop, after which nobody can touch it. Every FlushTimer
+ * seconds, partially filled buffers are swapped out by a DPC targeted to
+ * every processor.
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <ntoskrnl.h>
+#define INITGUID
+#include <wmiguid.h>
+#include <wmistr.h>
+#include <evntrace.h>
+#include <wmiioctl.h>
+
+#include "wmip.h"
+
+#define NDEBUG
+#include <debug.h>
+
+/* The hooks test our own flags, make sure they are the public ones */
+C_ASSERT(WMI_TRACE_FLAG_PROCESS == EVENT_TRACE_FLAG_PROCESS);
+C_ASSERT(WMI_TRACE_FLAG_THREAD == EVENT_TRACE_FLAG_THREAD);
+C_ASSERT(WMI_TRACE_FLAG_CSWITCH == EVENT_TRACE_FLAG_CSWITCH);
+C_ASSERT(WMI_TRACE_FLAG_DISK_IO == EVENT_TRACE_FLAG_DISK_IO);
+C_ASSERT(WMI_TRACE_FLAG_MEMORY_PAGE_FAULTS == EVENT_TRACE_FLAG_MEMORY_PAGE_FAULTS);
+
+#define WMIP_MAX_LOGGERS            8
+#define WMIP_KERNEL_LOGGER_ID       0
+
+/* Buffer sizes are in KB, as in EVENT_TRACE_PROPERTIES */
+#define WMIP_DEFAULT_BUFFER_SIZE    64
+#define WMIP_MAX_BUFFER_SIZE        1024
+#define WMIP_EXTRA_BUFFERS          8
+#define WMIP_MAX_BUFFERS            256
+#define WMIP_MAX_LOGGER_MEMORY      (32 * 1024 * 1024)
+
+#define WMIP_EVENT_ALIGNMENT        8
+#define WMIP_SMALL_EVENT_SIZE       256
+
+/* Context switches are logged as type 36 of the thread class */
+#define WMIP_TYPE_CSWITCH           36
+
+typedef struct _WMIP_BUFFER
+{
+    SLIST_ENTRY ListEntry;
+    ULONG CurrentOffset;
+    PWMI_BUFFER_HEADER Header;
+} WMIP_BUFFER, *PWMIP_BUFFER;
+
+typedef struct _WMIP_LOGGER_CONTEXT
+{
+    /* Kept first, the list heads need their natural alignment */
+    SLIST_HEADER FreeList;
+    SLIST_HEADER FlushList;
+    PWMIP_BUFFER ProcessorBuffers[MAXIMUM_PROCESSORS];
+    KDPC SwapDpc[MAXIMUM_PROCESSORS];
+    volatile LONG SwapDpcCount;
+    KEVENT SwapDoneEvent;
+    ULONG LoggerId;
+    ULONG ClientContext;
+    WMI_CLOCK_TYPE ClockType;
+    ULONG BufferSize;
+    ULONG NumberOfBuffers;
+    ULONG MaximumFileSize;
+    ULONG LogFileMode;
+    ULONG FlushTimer;
+    ULONG EnableFlags;
+    volatile LONG EventsLost;
+    ULONG BuffersWritten;
+    ULONG LogBuffersLost;
+    ULONG SequenceNumber;
+    HANDLE FileHandle;
+    LARGE_INTEGER FileOffset;
+    FAST_MUTEX FileMutex;
+    KEVENT StopEvent;
+    PETHREAD LoggerThread;
+    HANDLE LoggerThreadId;
+    UNICODE_STRING LoggerName;
+} WMIP_LOGGER_CONTEXT, *PWMIP_LOGGER_CONTEXT;
+
+/* First event of every log, to make sense of the timestamps */
+typedef struct _WMIP_SESSION_INFO_EVENT
+{
+    ULONG BufferSize;
+    ULONG NumberOfProcessors;
+    ULONG ClientContext;
+    ULONG LogFileMode;
+    ULONG EnableFlags;
+    ULONG Reserved;
+    LARGE_INTEGER PerfFreq;
+    LARGE_INTEGER StartTime;
+} WMIP_SESSION_INFO_EVENT, *PWMIP_SESSION_INFO_EVENT;
+
+typedef struct _WMIP_PROCESS_EVENT
+{
+    ULONG_PTR UniqueProcessKey;
+    ULONG ProcessId;
+    ULONG ParentId;
+    NTSTATUS ExitStatus;
+    CHAR ImageFileName[16];
+} WMIP_PROCESS_EVENT, *PWMIP_PROCESS_EVENT;
+
+typedef struct _WMIP_THREAD_EVENT
+{
+    ULONG ProcessId;
+    ULONG ThreadId;
+    PVOID StackBase;
+    PVOID StackLimit;
+    PVOID StartAddress;
+    PVOID Win32StartAddress;
+    PVOID TebBase;
+} WMIP_THREAD_EVENT, *PWMIP_THREAD_EVENT;
+
+typedef struct _WMIP_CSWITCH_EVENT
+{
+    ULONG NewThreadId;
+    ULONG OldThreadId;
+    CHAR NewThreadPriority;
+    CHAR OldThreadPriority;
+    UCHAR OldThreadState;
+    UCHAR OldThreadWaitReason;
+    UCHAR OldThreadWaitMode;
+    UCHAR Reserved[3];
+} WMIP_CSWITCH_EVENT, *PWMIP_CSWITCH_EVENT;
+
+typedef struct _WMIP_DISK_IO_EVENT
+{
+    PVOID DeviceObject;
+    PVOID FileObject;
+    PVOID Irp;
+    ULONGLONG ByteOffset;
+    ULONG TransferSize;
+    ULONG IrpFlags;
+    NTSTATUS Status;
+    ULONG IssuingThreadId;
+} WMIP_DISK_IO_EVENT, *PWMIP_DISK_IO_EVENT;
+
+typedef struct _WMIP_PAGE_FAULT_EVENT
+{
+    PVOID VirtualAddress;
+    ULONG FaultCode;
+    ULONG Mode;
+} WMIP_PAGE_FAULT_EVENT, *PWMIP_PAGE_FAULT_EVENT;
+
+/* GLOBALS ******************************************************************/
+
+volatile ULONG WmipKernelLoggerEnableFlags;
+
+/* Read by the writers at DISPATCH_LEVEL, a NULL entry means no logger */
+static PWMIP_LOGGER_CONTEXT volatile WmipLoggers[WMIP_MAX_LOGGERS];
+
+/*
+ * Writers currently using a logger slot, per processor so that the context
+ * switch hook doesn't bounce a shared cache line. An EX_RUNDOWN_REF would
+ * have to signal the stopping thread from the releasing writer, which isn't
+ * possible from the context switch path.
+ */
+typedef struct DECLSPEC_CACHEALIGN _WMIP_LOGGER_REFERENCES
+{
+    volatile LONG Count[WMIP_MAX_LOGGERS];
+} WMIP_LOGGER_REFERENCES;
+
+static WMIP_LOGGER_REFERENCES WmipLoggerReferences[MAXIMUM_PROCESSORS];
+
+/* Serializes starting, stopping and controlling loggers */
+static FAST_MUTEX WmipLoggerMutex;
+
+static const UNICODE_STRING WmipKernelLoggerName = RTL_CONSTANT_STRING(KERNEL_LOGGER_NAMEW);
+
+/* PRIVATE FUNCTIONS ********************************************************/
+
+FORCEINLINE
+ULONG
+WmipLoggerHandleToId(
+    _In_ ULONG LoggerHandle)
+{
+    if (LoggerHandle == WMI_KERNEL_LOGGER_HANDLE)
+        return WMIP_KERNEL_LOGGER_ID;
+
+    if ((LoggerHandle > WMIP_KERNEL_LOGGER_ID) && (LoggerHandle < WMIP_MAX_LOGGERS))
+        return LoggerHandle;
+
+    return WMIP_MAX_LOGGERS;
+}
+
+FORCEINLINE
+ULONG
+WmipLoggerIdToHandle(
+    _In_ ULONG LoggerId)
+{
+    return (LoggerId == WMIP_KERNEL_LOGGER_ID) ? WMI_KERNEL_LOGGER_HANDLE : LoggerId;
+}
+
+static
+WMI_CLOCK_TYPE
+WmipGetClockType(
+    _In_ ULONG ClientContext)
+{
+    /* Same values as EVENT_TRACE_PROPERTIES::Wnode.ClientContext */
+    switch (ClientContext)
+    {
+        case 2:
+            return WMICT_SYSTEMTIME;
+
+        case 3:
+            return WMICT_CPUCYCLE;
+
+        default:
+            return WMICT_PERFCOUNTER;
+    }
+}
+
+static
+VOID
+WmipResetBuffer(
+    _In_ PWMIP_LOGGER_CONTEXT Logger,
+    _Inout_ PWMIP_BUFFER Buffer,
+    _In_ ULONG Processor)
+{
+    Buffer->CurrentOffset = sizeof(WMI_BUFFER_HEADER);
+    Buffer->Header->BufferSize = Logger->BufferSize;
+    Buffer->Header->SavedOffset = 0;
+    Buffer->Header->BufferNumber = 0;
+    Buffer->Header->ProcessorNumber = (USHORT)Processor;
+    Buffer->Header->LoggerId = (USHORT)Logger->LoggerId;
+    Buffer->Header->TimeStamp.QuadPart = WmiGetClock(Logger->ClockType, NULL);
+}
+
+static
+VOID
+WmipRetireBuffer(
+    _In_ PWMIP_LOGGER_CONTEXT Logger,
+    _Inout_ PWMIP_BUFFER Buffer)
+{
+    /* Hand it to the logger thread */
+    Buffer->Header->SavedOffset = Buffer->CurrentOffset;
+    InterlockedPushEntrySList(&Logger->FlushList, &Buffer->ListEntry);
+}
+
+static
+PVOID
+WmipReserveTraceBuffer(
+    _In_ PWMIP_LOGGER_CONTEXT Logger,
+    _In_ ULONG Size)
+{
+    PWMIP_BUFFER Buffer;
+    PSLIST_ENTRY ListEntry;
+    ULONG Processor;
+    PVOID Data;
+
+    /* At DISPATCH_LEVEL we are the only writer of this processor's buffer */
+    ASSERT(KeGetCurrentIrql() >= DISPATCH_LEVEL);
+    Processor = KeGetCurrentProcessorNumber();
+
+    Buffer = Logger->ProcessorBuffers[Processor];
+    if (!(Buffer) || (Buffer->CurrentOffset + Size > Logger->BufferSize))
+    {
+        /* Retire the full buffer and switch to a free one */
+        if (Buffer) WmipRetireBuffer(Logger, Buffer);
+
+        ListEntry = InterlockedPopEntrySList(&Logger->FreeList);
+        if (!ListEntry)
+        {
+            /* The logger thread is behind, drop the event */
+            Logger->ProcessorBuffers[Processor] = NULL;
+            InterlockedIncrement(&Logger->EventsLost);
+            return NULL;
+        }
+
+        Buffer = CONTAINING_RECORD(ListEntry, WMIP_BUFFER, ListEntry);
+        WmipResetBuffer(Logger, Buffer, Processor);
+        Logger->ProcessorBuffers[Processor] = Buffer;
+    }
+
+    Data = (PUCHAR)Buffer->Header + Buffer->CurrentOffset;
+    Buffer->CurrentOffset += Size;
+    return Data;
+}
+
+static
+NTSTATUS
+WmipLogEvent(
+    _In_ ULONG LoggerId,
+    _In_ PEVENT_TRACE_HEADER EventHeader,
+    _In_reads_bytes_opt_(EventDataLength) PVOID EventData,
+    _In_ ULONG EventDataLength)
+{
+    PWMIP_LOGGER_CONTEXT Logger;
+    PEVENT_TRACE_HEADER Header;
+    volatile LONG *References;
+    PKTHREAD Thread;
+    NTSTATUS Status;
+    KIRQL OldIrql;
+    ULONG Size;
+
+    ASSERT(LoggerId < WMIP_MAX_LOGGERS);
+
+    Size = sizeof(EVENT_TRACE_HEADER) + EventDataLength;
+    if (Size > MAXUSHORT) return STATUS_BUFFER_OVERFLOW;
+
+    /* Keep the current processor and its buffer to ourselves */
+    OldIrql = KeGetCurrentIrql();
+    if (OldIrql < DISPATCH_LEVEL) KeRaiseIrql(DISPATCH_LEVEL, &OldIrql);
+
+    /* Count ourselves in before looking at the slot, see WmipRundownLogger */
+    References = &WmipLoggerReferences[KeGetCurrentProcessorNumber()].Count[LoggerId];
+    InterlockedIncrement(References);
+
+    Logger = WmipLoggers[LoggerId];
+    if (!Logger)
+    {
+        Status = STATUS_INVALID_HANDLE;
+    }
+    else if (ALIGN_UP_BY(Size, WMIP_EVENT_ALIGNMENT) >
+             Logger->BufferSize - sizeof(WMI_BUFFER_HEADER))
+    {
+        Status = STATUS_BUFFER_OVERFLOW;
+    }
+    else
+    {
+        Header = WmipReserveTraceBuffer(Logger, ALIGN_UP_BY(Size, WMIP_EVENT_ALIGNMENT));
+        if (!Header)
+        {
+            Status = STATUS_NO_MEMORY;
+        }
+        else
+        {
+            Thread = KeGetCurrentThread();
+
+            *Header = *EventHeader;
+            Header->Size = (USHORT)Size;
+            Header->ThreadId = HandleToUlong(PsGetCurrentThreadId());
+            Header->ProcessId = HandleToUlong(PsGetCurrentProcessId());
+            if (!(EventHeader->Flags & WNODE_FLAG_USE_TIMESTAMP))
+            {
+                Header->TimeStamp.QuadPart = WmiGetClock(Logger->ClockType, NULL);
+            }
+            Header->KernelTime = Thread->KernelTime;
+            Header->UserTime = Thread->UserTime;
+
+            if (EventDataLength) RtlCopyMemory(Header + 1, EventData, EventDataLength);
+            Status = STATUS_SUCCESS;
+        }
+    }
+
+    InterlockedDecrement(References);
+    if (OldIrql < DISPATCH_LEVEL) KeLowerIrql(OldIrql);
+    return Status;
+}
+
+static
+VOID
+WmipLogKernelEvent(
+    _In_ ULONG LoggerId,
+    _In_ LPCGUID Guid,
+    _In_ UCHAR Type,
+    _In_reads_bytes_(EventDataLength) PVOID EventData,
+    _In_ ULONG EventDataLength)
+{
+    EVENT_TRACE_HEADER Header;
+
+    RtlZeroMemory(&Header, sizeof(Header));
+    Header.Guid = *Guid;
+    Header.Class.Type = Type;
+    Header.Class.Version = 1;
+
+    WmipLogEvent(LoggerId, &Header, EventData, EventDataLength);
+}
+
+static
+VOID
+WmipLogSessionInfo(
+    _In_ PWMIP_LOGGER_CONTEXT Logger)
+{
+    WMIP_SESSION_INFO_EVENT Info;
+
+    RtlZeroMemory(&Info, sizeof(Info));
+    Info.BufferSize = Logger->BufferSize;
+    Info.NumberOfProcessors = KeNumberProcessors;
+    Info.ClientContext = Logger->ClientContext;
+    Info.LogFileMode = Logger->LogFileMode;
+    Info.EnableFlags = Logger->EnableFlags;
+    KeQueryPerformanceCounter(&Info.PerfFreq);
+    KeQuerySystemTime(&Info.StartTime);
+
+    WmipLogKernelEvent(Logger->LoggerId,
+                       &EventTraceGuid,
+                       EVENT_TRACE_TYPE_INFO,
+                       &Info,
+                       sizeof(Info));
+}
+
+static
+VOID
+WmipWriteBuffer(
+    _In_ PWMIP_LOGGER_CONTEXT Logger,
+    _Inout_ PWMIP_BUFFER Buffer)
+{
+    PWMI_BUFFER_HEADER Header = Buffer->Header;
+    IO_STATUS_BLOCK IoStatusBlock;
+    ULONGLONG MaximumFileSize;
+    NTSTATUS Status;
+
+    /* Don't leak stale events to the file */
+    RtlZeroMemory((PUCHAR)Header + Header->SavedOffset,
+                  Logger->BufferSize - Header->SavedOffset);
+
+    /* The maximum file size is in MB */
+    MaximumFileSize = (ULONGLONG)Logger->MaximumFileSize * 1024 * 1024;
+    if ((MaximumFileSize) &&
+        ((ULONGLONG)Logger->FileOffset.QuadPart + Logger->BufferSize > MaximumFileSize))
+    {
+        if (!(Logger->LogFileMode & EVENT_TRACE_FILE_MODE_CIRCULAR))
+        {
+            /* The file is full */
+            Logger->LogBuffersLost++;
+            return;
+        }
+
+        /* Overwrite the oldest buffers, readers sort them by number */
+        Logger->FileOffset.QuadPart = 0;
+    }
+
+    Header->BufferNumber = Logger->SequenceNumber++;
+
+    Status = ZwWriteFile(Logger->FileHandle,
+                         NULL,
+                         NULL,
+                         NULL,
+                         &IoStatusBlock,
+                         Header,
+                         Logger->BufferSize,
+                         &Logger->FileOffset,
+                         NULL);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to write trace buffer: 0x%lx\n", Status);
+        Logger->LogBuffersLost++;
+        return;
+    }
+
+    Logger->FileOffset.QuadPart += Logger->BufferSize;
+    Logger->BuffersWritten++;
+}
+
+static
+VOID
+NTAPI
+WmipSwapBuffersDpc(
+    _In_ PKDPC Dpc,
+    _In_opt_ PVOID DeferredContext,
+    _In_opt_ PVOID SystemArgument1,
+    _In_opt_ PVOID SystemArgument2)
+{
+    PWMIP_LOGGER_CONTEXT Logger = DeferredContext;
+    PWMIP_BUFFER Buffer;
+    ULONG Processor;
+    UNREFERENCED_PARAMETER(Dpc);
+    UNREFERENCED_PARAMETER(SystemArgument1);
+    UNREFERENCED_PARAMETER(SystemArgument2);
+    ASSERT(KeGetCurrentIrql() == DISPATCH_LEVEL);
+
+    /* Nobody writes to this processor's buffer while we run, retire it */
+    Processor = KeGetCurrentProcessorNumber();
+    Buffer = Logger->ProcessorBuffers[Processor];
+    if (Buffer)
+    {
+        Logger->ProcessorBuffers[Processor] = NULL;
+        WmipRetireBuffer(Logger, Buffer);
+    }
+
+    if (InterlockedDecrement(&Logger->SwapDpcCount) == 0)
+        KeSetEvent(&Logger->SwapDoneEvent, IO_NO_INCREMENT, FALSE);
+}
+
+static
+VOID
+WmipSwapBuffers(
+    _In_ PWMIP_LOGGER_CONTEXT Logger)
+{
+    KAFFINITY ActiveProcessors = KeActiveProcessors;
+    ULONG Processor;
+    PAGED_CODE();
+
+    /* Called with the file mutex held, which serializes the use of the DPCs */
+    KeClearEvent(&Logger->SwapDoneEvent);
+    Logger->SwapDpcCount = 1;
+
+    for (Processor = 0; Processor < (ULONG)KeNumberProcessors; Processor++)
+    {
+        if (!(ActiveProcessors & AFFINITY_MASK(Processor))) continue;
+
+        /* Each processor retires its own buffer */
+        InterlockedIncrement(&Logger->SwapDpcCount);
+        KeInitializeDpc(&Logger->SwapDpc[Processor], WmipSwapBuffersDpc, Logger);
+        KeSetTargetProcessorDpc(&Logger->SwapDpc[Processor], (CCHAR)Processor);
+        KeSetImportanceDpc(&Logger->SwapDpc[Processor], HighImportance);
+        KeInsertQueueDpc(&Logger->SwapDpc[Processor], NULL, NULL);
+    }
+
+    /* Drop our own count, and wait for the last DPC */
+    if (InterlockedDecrement(&Logger->SwapDpcCount) != 0)
+    {
+        KeWaitForSingleObject(&Logger->SwapDoneEvent, Executive, KernelMode, FALSE, NULL);
+    }
+}
+
+static
+VOID
+WmipWriteBuffers(
+    _In_ PWMIP_LOGGER_CONTEXT Logger,
+    _In_ BOOLEAN SwapBuffers)
+{
+    PSLIST_ENTRY ListEntry, NextEntry, FirstEntry = NULL;
+    PWMIP_BUFFER Buffer;
+    PAGED_CODE();
+
+    /* The synchronous writes need special kernel APCs, so don't raise */
+    ExEnterCriticalRegionAndAcquireFastMutexUnsafe(&Logger->FileMutex);
+
+    /* Write partially filled buffers too */
+    if (SwapBuffers) WmipSwapBuffers(Logger);
+
+    /* Take the whole list, it is in reverse order of retirement */
+    ListEntry = InterlockedFlushSList(&Logger->FlushList);
+    while (ListEntry)
+    {
+        NextEntry = ListEntry->Next;
+        ListEntry->Next = FirstEntry;
+        FirstEntry = ListEntry;
+        ListEntry = NextEntry;
+    }
+
+    while (FirstEntry)
+    {
+        Buffer = CONTAINING_RECORD(FirstEntry, WMIP_BUFFER, ListEntry);
+        FirstEntry = FirstEntry->Next;
+
+        WmipWriteBuffer(Logger, Buffer);
+        InterlockedPushEntrySList(&Logger->FreeList, &Buffer->ListEntry);
+    }
+
+    ExReleaseFastMutexUnsafeAndLeaveCriticalRegion(&Logger->FileMutex);
+}
+
+static
+VOID
+NTAPI
+WmipLoggerThread(
+    _In_ PVOID Context)
+{
+    PWMIP_LOGGER_CONTEXT Logger = Context;
+    LARGE_INTEGER Timeout;
+    ULONG Seconds = 0;
+    BOOLEAN SwapBuffers;
+    NTSTATUS Status;
+
+    /* Wake up every second to write full buffers before the free list runs dry */
+    Timeout.QuadPart = -10 * 1000 * 1000;
+
+    do
+    {
+        Status = KeWaitForSingleObject(&Logger->StopEvent,
+                                       Executive,
+                                       KernelMode,
+                                       FALSE,
+                                       &Timeout);
+
+        /* Partially filled buffers are only written once per flush period */
+        SwapBuffers = FALSE;
+        if ((Status == STATUS_TIMEOUT) && (Logger->FlushTimer) &&
+            (++Seconds >= Logger->FlushTimer))
+        {
+            SwapBuffers = TRUE;
+            Seconds = 0;
+        }
+
+        WmipWriteBuffers(Logger, SwapBuffers);
+    } while (Status == STATUS_TIMEOUT);
+
+    PsTerminateSystemThread(STATUS_SUCCESS);
+}
+
+static
+VOID
+WmipDeleteLogger(
+    _In_ PWMIP_LOGGER_CONTEXT Logger)
+{
+    PSLIST_ENTRY ListEntry;
+    ULONG i;
+
+    /* Nobody uses the logger anymore, gather its buffers from everywhere */
+    for (i = 0; i < MAXIMUM_PROCESSORS; i++)
+    {
+        if (Logger->ProcessorBuffers[i])
+        {
+            ExFreePoolWithTag(Logger->ProcessorBuffers[i], TAG_WMI_BUFFER);
+        }
+    }
+    while ((ListEntry = InterlockedPopEntrySList(&Logger->FlushList)))
+    {
+        ExFreePoolWithTag(CONTAINING_RECORD(ListEntry, WMIP_BUFFER, ListEntry),
+                          TAG_WMI_BUFFER);
+    }
+    while ((ListEntry = InterlockedPopEntrySList(&Logger->FreeList)))
+    {
+        ExFreePoolWithTag(CONTAINING_RECORD(ListEntry, WMIP_BUFFER, ListEntry),
+                          TAG_WMI_BUFFER);
+    }
+
+    if (Logger->FileHandle) ZwClose(Logger->FileHandle);
+    if (Logger->LoggerName.Buffer)
+        ExFreePoolWithTag(Logger->LoggerName.Buffer, TAG_WMI_LOGGER);
+    ExFreePoolWithTag(Logger, TAG_WMI_LOGGER);
+}
+
+static
+NTSTATUS
+WmipCreateLogger(
+    _In_ PWMI_LOGGER_INFORMATION LoggerInfo,
+    _In_ ULONG LoggerId,
+    _Out_ PWMIP_LOGGER_CONTEXT *OutLogger)
+{
+    PWMIP_LOGGER_CONTEXT Logger;
+    ULONG BufferSize, NumberOfBuffers, MinimumBuffers, i;
+    PWMIP_BUFFER Buffer;
+
+    Logger = ExAllocatePoolWithTag(NonPagedPool, sizeof(*Logger), TAG_WMI_LOGGER);
+    if (!Logger) return STATUS_INSUFFICIENT_RESOURCES;
+
+    RtlZeroMemory(Logger, sizeof(*Logger));
+    InitializeSListHead(&Logger->FreeList);
+    InitializeSListHead(&Logger->FlushList);
+    ExInitializeFastMutex(&Logger->FileMutex);
+    KeInitializeEvent(&Logger->StopEvent, NotificationEvent, FALSE);
+    KeInitializeEvent(&Logger->SwapDoneEvent, NotificationEvent, FALSE);
+    Logger->LoggerId = LoggerId;
+    Logger->ClientContext = LoggerInfo->Wnode.ClientContext;
+    Logger->ClockType = WmipGetClockType(LoggerInfo->Wnode.ClientContext);
+    Logger->MaximumFileSize = LoggerInfo->MaximumFileSize;
+    Logger->LogFileMode = LoggerInfo->LogFileMode;
+    Logger->FlushTimer = LoggerInfo->FlushTimer;
+    Logger->EnableFlags = LoggerInfo->EnableFlags;
+
+    /* Keep our own copy of the name, it is what we are looked up by */
+    Logger->LoggerName.Buffer = ExAllocatePoolWithTag(PagedPool,
+                                                      LoggerInfo->LoggerName.Length,
+                                                      TAG_WMI_LOGGER);
+    if (!Logger->LoggerName.Buffer)
+    {
+        WmipDeleteLogger(Logger);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+    Logger->LoggerName.MaximumLength = LoggerInfo->LoggerName.Length;
+    RtlCopyUnicodeString(&Logger->LoggerName, &LoggerInfo->LoggerName);
+
+    BufferSize = LoggerInfo->BufferSize ? LoggerInfo->BufferSize : WMIP_DEFAULT_BUFFER_SIZE;
+    Logger->BufferSize = min(BufferSize, WMIP_MAX_BUFFER_SIZE) * 1024;
+
+    /* Every processor owns a buffer, and needs a spare one to switch to */
+    MinimumBuffers = max(LoggerInfo->MinimumBuffers, (ULONG)KeNumberProcessors + 2);
+    if (LoggerInfo->MaximumBuffers)
+        NumberOfBuffers = max(LoggerInfo->MaximumBuffers, MinimumBuffers);
+    else
+        NumberOfBuffers = MinimumBuffers + WMIP_EXTRA_BUFFERS;
+    NumberOfBuffers = min(NumberOfBuffers, WMIP_MAX_BUFFERS);
+    NumberOfBuffers = min(NumberOfBuffers,
+                          max(WMIP_MAX_LOGGER_MEMORY / Logger->BufferSize,
+                              (ULONG)KeNumberProcessors + 2));
+
+    for (i = 0; i < NumberOfBuffers; i++)
+    {
+        Buffer = ExAllocatePoolWithTag(NonPagedPool,
+                                       sizeof(WMIP_BUFFER) + Logger->BufferSize,
+                                       TAG_WMI_BUFFER);
+        if (!Buffer) break;
+
+        Buffer->Header = (PWMI_BUFFER_HEADER)(Buffer + 1);
+        InterlockedPushEntrySList(&Logger->FreeList, &Buffer->ListEntry);
+    }
+
+    /* Settle for less than asked for, but not for less than one per processor */
+    if (i < (ULONG)KeNumberProcessors + 2)
+    {
+        DPRINT1("Failed to allocate the trace buffers\n");
+        WmipDeleteLogger(Logger);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+    Logger->NumberOfBuffers = i;
+
+    *OutLogger = Logger;
+    return STATUS_SUCCESS;
+}
+
+static
+NTSTATUS
+WmipOpenLogFile(
+    _In_ PWMIP_LOGGER_CONTEXT Logger,
+    _In_ PUNICODE_STRING LogFileName,
+    _In_ KPROCESSOR_MODE PreviousMode)
+{
+    FILE_STANDARD_INFORMATION StandardInformation;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatusBlock;
+    BOOLEAN Append;
+    NTSTATUS Status;
+    PAGED_CODE();
+
+    Append = (Logger->LogFileMode & EVENT_TRACE_FILE_MODE_APPEND) != 0;
+
+    InitializeObjectAttributes(&ObjectAttributes,
+                               LogFileName,
+                               OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                               NULL,
+                               NULL);
+
+    /* The file is opened on behalf of the caller, check its access */
+    Status = IoCreateFile(&Logger->FileHandle,
+                          FILE_WRITE_DATA | FILE_READ_ATTRIBUTES | SYNCHRONIZE,
+                          &ObjectAttributes,
+                          &IoStatusBlock,
+                          NULL,
+                          FILE_ATTRIBUTE_NORMAL,
+                          FILE_SHARE_READ,
+                          Append ? FILE_OPEN_IF : FILE_OVERWRITE_IF,
+                          FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE |
+                          FILE_SEQUENTIAL_ONLY,
+                          NULL,
+                          0,
+                          CreateFileTypeNone,
+                          NULL,
+                          (PreviousMode != KernelMode) ? IO_FORCE_ACCESS_CHECK : 0);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to open log file '%wZ': 0x%lx\n", LogFileName, Status);
+        Logger->FileHandle = NULL;
+        return Status;
+    }
+
+    if (Append)
+    {
+        Status = ZwQueryInformationFile(Logger->FileHandle,
+                                        &IoStatusBlock,
+                                        &StandardInformation,
+                                        sizeof(StandardInformation),
+                                        FileStandardInformation);
+        if (!NT_SUCCESS(Status)) return Status;
+
+        Logger->FileOffset = StandardInformation.EndOfFile;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static
+NTSTATUS
+WmipStartLoggerThread(
+    _In_ PWMIP_LOGGER_CONTEXT Logger)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    HANDLE ThreadHandle;
+    CLIENT_ID ClientId;
+    NTSTATUS Status;
+
+    InitializeObjectAttributes(&ObjectAttributes, NULL, OBJ_KERNEL_HANDLE, NULL, NULL);
+    Status = PsCreateSystemThread(&ThreadHandle,
+                                  THREAD_ALL_ACCESS,
+                                  &ObjectAttributes,
+                                  NULL,
+                                  &ClientId,
+                                  WmipLoggerThread,
+                                  Logger);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to create the logger thread: 0x%lx\n", Status);
+        return Status;
+    }
+
+    Status = ObReferenceObjectByHandle(ThreadHandle,
+                                       SYNCHRONIZE,
+                                       PsThreadType,
+                                       KernelMode,
+                                       (PVOID*)&Logger->LoggerThread,
+                                       NULL);
+    if (!NT_SUCCESS(Status))
+    {
+        /* We can't keep track of it, so don't let it run */
+        DPRINT1("Failed to reference the logger thread: 0x%lx\n", Status);
+        KeSetEvent(&Logger->StopEvent, IO_NO_INCREMENT, FALSE);
+        ZwWaitForSingleObject(ThreadHandle, FALSE, NULL);
+        ZwClose(ThreadHandle);
+        Logger->LoggerThread = NULL;
+        return Status;
+    }
+    ZwClose(ThreadHandle);
+
+    Logger->LoggerThreadId = ClientId.UniqueThread;
+    return STATUS_SUCCESS;
+}
+
+static
+VOID
+WmipStopLoggerThread(
+    _In_ PWMIP_LOGGER_CONTEXT Logger)
+{
+    /* It writes the remaining buffers before leaving */
+    KeSetEvent(&Logger->StopEvent, IO_NO_INCREMENT, FALSE);
+    KeWaitForSingleObject(Logger->LoggerThread, Executive, KernelMode, FALSE, NULL);
+    ObDereferenceObject(Logger->LoggerThread);
+    Logger->LoggerThread = NULL;
+}
+
+static
+VOID
+WmipRundownLogger(
+    _In_ PWMIP_LOGGER_CONTEXT Logger)
+{
+    LARGE_INTEGER Interval;
+    ULONG Processor;
+    PAGED_CODE();
+
+    /* Hide the logger from new writers */
+    InterlockedExchangePointer((PVOID*)&WmipLoggers[Logger->LoggerId], NULL);
+
+    /*
+     * A writer counts itself in before reading the slot, and both are full
+     * barriers: it either sees the cleared slot, or we see its count. Writers
+     * don't block, so poll until the ones still inside have left.
+     */
+    Interval.QuadPart = -10 * 1000;
+    for (Processor = 0; Processor < MAXIMUM_PROCESSORS; Processor++)
+    {
+        while (WmipLoggerReferences[Processor].Count[Logger->LoggerId])
+        {
+            KeDelayExecutionThread(KernelMode, FALSE, &Interval);
+        }
+    }
+}
+
+static
+BOOLEAN
+WmipIsKernelLogger(
+    _In_ PWMI_LOGGER_INFORMATION LoggerInfo)
+{
+    return IsEqualGUID(&LoggerInfo->Wnode.Guid, &SystemTraceControlGuid) ||
+           RtlEqualUnicodeString(&LoggerInfo->LoggerName, &WmipKernelLoggerName, TRUE);
+}
+
+static
+PWMIP_LOGGER_CONTEXT
+WmipLookupLogger(
+    _In_ PWMI_LOGGER_INFORMATION LoggerInfo,
+    _In_ BOOLEAN UseHandle)
+{
+    PWMIP_LOGGER_CONTEXT Logger;
+    ULONG LoggerId;
+
+    /* Called with the logger mutex held */
+    if ((UseHandle) && (LoggerInfo->Wnode.HistoricalContext))
+    {
+        LoggerId = WmipLoggerHandleToId((ULONG)LoggerInfo->Wnode.HistoricalContext);
+        return (LoggerId < WMIP_MAX_LOGGERS) ? WmipLoggers[LoggerId] : NULL;
+    }
+
+    if (WmipIsKernelLogger(LoggerInfo))
+        return WmipLoggers[WMIP_KERNEL_LOGGER_ID];
+
+    for (LoggerId = WMIP_KERNEL_LOGGER_ID + 1; LoggerId < WMIP_MAX_LOGGERS; LoggerId++)
+    {
+        Logger = WmipLoggers[LoggerId];
+        if ((Logger) && (RtlEqualUnicodeString(&Logger->LoggerName, &LoggerInfo->LoggerName, TRUE)))
+            return Logger;
+    }
+
+    return NULL;
+}
+
+static
+VOID
+WmipQueryLogger(
+    _In_ PWMIP_LOGGER_CONTEXT Logger,
+    _Out_ PWMI_LOGGER_INFORMATION LoggerInfo)
+{
+    LoggerInfo->Wnode.HistoricalContext = WmipLoggerIdToHandle(Logger->LoggerId);
+    LoggerInfo->Wnode.ClientContext = Logger->ClientContext;
+    LoggerInfo->BufferSize = Logger->BufferSize / 1024;
+    LoggerInfo->MinimumBuffers = Logger->NumberOfBuffers;
+    LoggerInfo->MaximumBuffers = Logger->NumberOfBuffers;
+    LoggerInfo->MaximumFileSize = Logger->MaximumFileSize;
+    LoggerInfo->LogFileMode = Logger->LogFileMode;
+    LoggerInfo->FlushTimer = Logger->FlushTimer;
+    LoggerInfo->EnableFlags = Logger->EnableFlags;
+    LoggerInfo->LogFileHandle = NULL;
+    LoggerInfo->NumberOfBuffers = Logger->NumberOfBuffers;
+    LoggerInfo->FreeBuffers = ExQueryDepthSList(&Logger->FreeList);
+    LoggerInfo->EventsLost = Logger->EventsLost;
+    LoggerInfo->BuffersWritten = Logger->BuffersWritten;
+    LoggerInfo->LogBuffersLost = Logger->LogBuffersLost;
+    LoggerInfo->RealTimeBuffersLost = 0;
+    LoggerInfo->LoggerThreadId = Logger->LoggerThreadId;
+}
+
+static
+NTSTATUS
+WmipStartLogger(
+    _Inout_ PWMI_LOGGER_INFORMATION LoggerInfo,
+    _In_ KPROCESSOR_MODE PreviousMode)
+{
+    PWMIP_LOGGER_CONTEXT Logger;
+    ULONG LoggerId;
+    NTSTATUS Status;
+    PAGED_CODE();
+
+    /* We only know how to log to a file */
+    if (LoggerInfo->LogFileMode & EVENT_TRACE_REAL_TIME_MODE)
+    {
+        DPRINT1("Real time mode is not supported\n");
+        return STATUS_NOT_SUPPORTED;
+    }
+
+    if (!(LoggerInfo->LoggerName.Length) || !(LoggerInfo->LogFileName.Length))
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    ExEnterCriticalRegionAndAcquireFastMutexUnsafe(&WmipLoggerMutex);
+
+    if (WmipLookupLogger(LoggerInfo, FALSE))
+    {
+        Status = STATUS_OBJECT_NAME_COLLISION;
+        goto Quickie;
+    }
+
+    /* The kernel logger has its own slot, find a free one otherwise */
+    if (WmipIsKernelLogger(LoggerInfo))
+    {
+        LoggerId = WMIP_KERNEL_LOGGER_ID;
+    }
+    else
+    {
+        for (LoggerId = WMIP_KERNEL_LOGGER_ID + 1; LoggerId < WMIP_MAX_LOGGERS; LoggerId++)
+        {
+            if (!WmipLoggers[LoggerId]) break;
+        }
+
+        if (LoggerId == WMIP_MAX_LOGGERS)
+        {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            goto Quickie;
+        }
+    }
+
+    Status = WmipCreateLogger(LoggerInfo, LoggerId, &Logger);
+    if (!NT_SUCCESS(Status)) goto Quickie;
+
+    Status = WmipOpenLogFile(Logger, &LoggerInfo->LogFileName, PreviousMode);
+    if (NT_SUCCESS(Status)) Status = WmipStartLoggerThread(Logger);
+    if (!NT_SUCCESS(Status))
+    {
+        WmipDeleteLogger(Logger);
+        goto Quickie;
+    }
+
+    /* Go live, then turn the kernel hooks on */
+    InterlockedExchangePointer((PVOID*)&WmipLoggers[LoggerId], Logger);
+    WmipLogSessionInfo(Logger);
+    if (LoggerId == WMIP_KERNEL_LOGGER_ID)
+    {
+        InterlockedExchange((PLONG)&WmipKernelLoggerEnableFlags,
+                            Logger->EnableFlags & WMI_TRACE_FLAG_SUPPORTED);
+    }
+
+    WmipQueryLogger(Logger, LoggerInfo);
+
+Quickie:
+    ExReleaseFastMutexUnsafeAndLeaveCriticalRegion(&WmipLoggerMutex);
+    return Status;
+}
+
+static
+NTSTATUS
+WmipStopLogger(
+    _Inout_ PWMI_LOGGER_INFORMATION LoggerInfo)
+{
+    PWMIP_LOGGER_CONTEXT Logger;
+    PWMIP_BUFFER Buffer;
+    ULONG Processor;
+    NTSTATUS Status = STATUS_SUCCESS;
+    PAGED_CODE();
+
+    ExEnterCriticalRegionAndAcquireFastMutexUnsafe(&WmipLoggerMutex);
+
+    Logger = WmipLookupLogger(LoggerInfo, TRUE);
+    if (!Logger)
+    {
+        Status = STATUS_WMI_INSTANCE_NOT_FOUND;
+        goto Quickie;
+    }
+
+    /* Turn the hooks off, and wait for the writers to be gone */
+    if (Logger->LoggerId == WMIP_KERNEL_LOGGER_ID)
+    {
+        InterlockedExchange((PLONG)&WmipKernelLoggerEnableFlags, 0);
+    }
+    WmipRundownLogger(Logger);
+
+    /* Now that we are alone, write what is left in every processor's buffer */
+    WmipStopLoggerThread(Logger);
+    for (Processor = 0; Processor < MAXIMUM_PROCESSORS; Processor++)
+    {
+        Buffer = Logger->ProcessorBuffers[Processor];
+        if (Buffer)
+        {
+            Logger->ProcessorBuffers[Processor] = NULL;
+            WmipRetireBuffer(Logger, Buffer);
+        }
+    }
+    WmipWriteBuffers(Logger, FALSE);
+
+    WmipQueryLogger(Logger, LoggerInfo);
+    WmipDeleteLogger(Logger);
+
+Quickie:
+    ExReleaseFastMutexUnsafeAndLeaveCriticalRegion(&WmipLoggerMutex);
+    return Status;
+}
+
+static
+NTSTATUS
+WmipControlLogger(
+    _In_ ULONG IoControlCode,
+    _Inout_ PWMI_LOGGER_INFORMATION LoggerInfo)
+{
+    PWMIP_LOGGER_CONTEXT Logger;
+    NTSTATUS Status = STATUS_SUCCESS;
+    PAGED_CODE();
+
+    ExEnterCriticalRegionAndAcquireFastMutexUnsafe(&WmipLoggerMutex);
+
+    Logger = WmipLookupLogger(LoggerInfo, TRUE);
+    if (!Logger)
+    {
+        Status = STATUS_WMI_INSTANCE_NOT_FOUND;
+        goto Quickie;
+    }
+
+    switch (IoControlCode)
+    {
+        case IOCTL_WMI_UPDATE_LOGGER:
+        {
+            /* Only the flush period and the kernel flags can be changed */
+            Logger->FlushTimer = LoggerInfo->FlushTimer;
+            if (Logger->LoggerId == WMIP_KERNEL_LOGGER_ID)
+            {
+                Logger->EnableFlags = LoggerInfo->EnableFlags;
+                InterlockedExchange((PLONG)&WmipKernelLoggerEnableFlags,
+                                    Logger->EnableFlags & WMI_TRACE_FLAG_SUPPORTED);
+            }
+            break;
+        }
+
+        case IOCTL_WMI_FLUSH_LOGGER:
+        {
+            WmipWriteBuffers(Logger, TRUE);
+            break;
+        }
+
+        default:
+        {
+            ASSERT(IoControlCode == IOCTL_WMI_QUERY_LOGGER);
+            break;
+        }
+    }
+
+    WmipQueryLogger(Logger, LoggerInfo);
+
+Quickie:
+    ExReleaseFastMutexUnsafeAndLeaveCriticalRegion(&WmipLoggerMutex);
+    return Status;
+}
+
+static
+NTSTATUS
+WmipCaptureLoggerNames(
+    _Inout_ PWMI_LOGGER_INFORMATION LoggerInfo,
+    _In_ ULONG InputLength)
+{
+    PUCHAR Names = (PUCHAR)(LoggerInfo + 1);
+    ULONG NamesLength = InputLength - sizeof(WMI_LOGGER_INFORMATION);
+    USHORT LoggerNameLength = LoggerInfo->LoggerName.Length;
+    USHORT LogFileNameLength = LoggerInfo->LogFileName.Length;
+
+    /* The names follow the structure, and they are not terminated */
+    if ((LoggerNameLength & 1) || (LogFileNameLength & 1) ||
+        ((ULONG)LoggerNameLength + LogFileNameLength > NamesLength))
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    LoggerInfo->LoggerName.Buffer = LoggerNameLength ? (PWCHAR)Names : NULL;
+    LoggerInfo->LoggerName.MaximumLength = LoggerNameLength;
+    LoggerInfo->LogFileName.Buffer = LogFileNameLength ? (PWCHAR)(Names + LoggerNameLength) : NULL;
+    LoggerInfo->LogFileName.MaximumLength = LogFileNameLength;
+
+    return STATUS_SUCCESS;
+}
+
+/* PUBLIC FUNCTIONS *********************************************************/
+
+VOID
+NTAPI
+WmipInitializeTracing(
+    VOID)
+{
+    ExInitializeFastMutex(&WmipLoggerMutex);
+}
+
+NTSTATUS
+NTAPI
+WmipTraceControl(
+    _In_ ULONG IoControlCode,
+    _Inout_ PVOID Buffer,
+    _In_ ULONG InputLength,
+    _Inout_ PULONG OutputLength)
+{
+    PWMI_LOGGER_INFORMATION LoggerInfo = Buffer;
+    KPROCESSOR_MODE PreviousMode;
+    NTSTATUS Status;
+    PAGED_CODE();
+
+    if ((InputLength < sizeof(WMI_LOGGER_INFORMATION)) ||
+        (*OutputLength < sizeof(WMI_LOGGER_INFORMATION)))
+    {
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    /* Everything but queries needs the profiling privilege */
+    PreviousMode = ExGetPreviousMode();
+    if ((IoControlCode != IOCTL_WMI_QUERY_LOGGER) &&
+        !(SeSinglePrivilegeCheck(SeSystemProfilePrivilege, PreviousMode)))
+    {
+        return STATUS_ACCESS_DENIED;
+    }
+
+    Status = WmipCaptureLoggerNames(LoggerInfo, InputLength);
+    if (!NT_SUCCESS(Status)) return Status;
+
+    switch (IoControlCode)
+    {
+        case IOCTL_WMI_START_LOGGER:
+            Status = WmipStartLogger(LoggerInfo, PreviousMode);
+            break;
+
+        case IOCTL_WMI_STOP_LOGGER:
+            Status = WmipStopLogger(LoggerInfo);
+            break;
+
+        default:
+            Status = WmipControlLogger(IoControlCode, LoggerInfo);
+            break;
+    }
+
+    /* The names are not returned, don't hand out kernel pointers */
+    RtlZeroMemory(&LoggerInfo->LoggerName, sizeof(UNICODE_STRING));
+    RtlZeroMemory(&LoggerInfo->LogFileName, sizeof(UNICODE_STRING));
+    *OutputLength = sizeof(WMI_LOGGER_INFORMATION);
+
+    return Status;
+}
+
+NTSTATUS
+NTAPI
+WmipTraceEvent(
+    _In_ ULONG LoggerHandle,
+    _In_ PEVENT_TRACE_HEADER TraceHeader,
+    _In_ KPROCESSOR_MODE PreviousMode)
+{
+    UCHAR LocalBuffer[WMIP_SMALL_EVENT_SIZE];
+    MOF_FIELD MofFields[MAX_MOF_FIELDS];
+    EVENT_TRACE_HEADER Header;
+    ULONG DataLength = 0, MofCount, LoggerId, i;
+    PUCHAR Data = LocalBuffer;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    _SEH2_TRY
+    {
+        /* Capture the header */
+        if (PreviousMode != KernelMode)
+        {
+            ProbeForRead(TraceHeader, sizeof(EVENT_TRACE_HEADER), sizeof(ULONG));
+        }
+        Header = *TraceHeader;
+        if (Header.Size < sizeof(EVENT_TRACE_HEADER))
+        {
+            _SEH2_YIELD(return STATUS_INVALID_PARAMETER);
+        }
+
+        /* The fast I/O path passes the handle inside the header */
+        if (!LoggerHandle)
+        {
+            LoggerHandle = (ULONG)((PWNODE_HEADER)&Header)->HistoricalContext;
+        }
+
+        DataLength = Header.Size - sizeof(EVENT_TRACE_HEADER);
+        if (Header.Flags & WNODE_FLAG_USE_MOF_PTR)
+        {
+            /* The header is followed by the descriptions of the data */
+            MofCount = DataLength / sizeof(MOF_FIELD);
+            if (MofCount > MAX_MOF_FIELDS)
+            {
+                _SEH2_YIELD(return STATUS_ARRAY_BOUNDS_EXCEEDED);
+            }
+
+            if (PreviousMode != KernelMode)
+            {
+                ProbeForRead(TraceHeader + 1, MofCount * sizeof(MOF_FIELD), sizeof(ULONG));
+            }
+            RtlCopyMemory(MofFields, TraceHeader + 1, MofCount * sizeof(MOF_FIELD));
+
+            DataLength = 0;
+            for (i = 0; i < MofCount; i++)
+            {
+                if (MofFields[i].Length > MAXUSHORT - DataLength)
+                {
+                    _SEH2_YIELD(return STATUS_BUFFER_OVERFLOW);
+                }
+                DataLength += MofFields[i].Length;
+            }
+        }
+        else
+        {
+            MofCount = 0;
+        }
+
+        /* The data is copied at DISPATCH_LEVEL, capture it to nonpaged memory */
+        if (DataLength > sizeof(LocalBuffer))
+        {
+            Data = ExAllocatePoolWithTag(NonPagedPool, DataLength, TAG_WMI_EVENT);
+            if (!Data)
+            {
+                _SEH2_YIELD(return STATUS_NO_MEMORY);
+            }
+        }
+
+        if (Header.Flags & WNODE_FLAG_USE_MOF_PTR)
+        {
+            DataLength = 0;
+            for (i = 0; i < MofCount; i++)
+            {
+                if (PreviousMode != KernelMode)
+                {
+                    ProbeForRead((PVOID)(ULONG_PTR)MofFields[i].DataPtr,
+                                 MofFields[i].Length,
+                                 sizeof(UCHAR));
+                }
+                RtlCopyMemory(Data + DataLength,
+                              (PVOID)(ULONG_PTR)MofFields[i].DataPtr,
+                              MofFields[i].Length);
+                DataLength += MofFields[i].Length;
+            }
+        }
+        else if (DataLength)
+        {
+            if (PreviousMode != KernelMode)
+            {
+                ProbeForRead(TraceHeader + 1, DataLength, sizeof(UCHAR));
+            }
+            RtlCopyMemory(Data, TraceHeader + 1, DataLength);
+        }
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        Status = _SEH2_GetExceptionCode();
+    }
+    _SEH2_END;
+
+    if (NT_SUCCESS(Status))
+    {
+        LoggerId = WmipLoggerHandleToId(LoggerHandle);
+        if (LoggerId < WMIP_MAX_LOGGERS)
+            Status = WmipLogEvent(LoggerId, &Header, Data, DataLength);
+        else
+            Status = STATUS_INVALID_HANDLE;
+    }
+
+    if (Data != LocalBuffer) ExFreePoolWithTag(Data, TAG_WMI_EVENT);
+    return Status;
+}
+
+VOID
+NTAPI
+WmipTraceProcess(
+    IN PEPROCESS Process,
+    IN BOOLEAN Create)
+{
+    WMIP_PROCESS_EVENT Event;
+
+    Event.UniqueProcessKey = (ULONG_PTR)Process;
+    Event.ProcessId = HandleToUlong(Process->UniqueProcessId);
+    Event.ParentId = HandleToUlong(Process->InheritedFromUniqueProcessId);
+    Event.ExitStatus = Create ? STATUS_SUCCESS : Process->ExitStatus;
+    RtlCopyMemory(Event.ImageFileName, Process->ImageFileName, sizeof(Event.ImageFileName));
+
+    WmipLogKernelEvent(WMIP_KERNEL_LOGGER_ID,
+                       &ProcessGuid,
+                       Create ? EVENT_TRACE_TYPE_START : EVENT_TRACE_TYPE_END,
+                       &Event,
+                       sizeof(Event));
+}
+
+VOID
+NTAPI
+WmipTraceThread(
+    IN PETHREAD Thread,
+    IN BOOLEAN Create)
+{
+    WMIP_THREAD_EVENT Event;
+
+    Event.ProcessId = HandleToUlong(Thread->Cid.UniqueProcess);
+    Event.ThreadId = HandleToUlong(Thread->Cid.UniqueThread);
+    Event.StackBase = Thread->Tcb.StackBase;
+    Event.StackLimit = (PVOID)Thread->Tcb.StackLimit;
+    Event.StartAddress = (PVOID)Thread->StartAddress;
+    Event.Win32StartAddress = Thread->Win32StartAddress;
+    Event.TebBase = Thread->Tcb.Teb;
+
+    WmipLogKernelEvent(WMIP_KERNEL_LOGGER_ID,
+                       &ThreadGuid,
+                       Create ? EVENT_TRACE_TYPE_START : EVENT_TRACE_TYPE_END,
+                       &Event,
+                       sizeof(Event));
+}
+
+VOID
+FASTCALL
+WmipTraceContextSwitch(
+    IN PKTHREAD OldThread,
+    IN PKTHREAD NewThread)
+{
+    WMIP_CSWITCH_EVENT Event;
+
+    Event.NewThreadId = HandleToUlong(((PETHREAD)NewThread)->Cid.UniqueThread);
+    Event.OldThreadId = HandleToUlong(((PETHREAD)OldThread)->Cid.UniqueThread);
+    Event.NewThreadPriority = NewThread->Priority;
+    Event.OldThreadPriority = OldThread->Priority;
+    Event.OldThreadState = OldThread->State;
+    Event.OldThreadWaitReason = OldThread->WaitReason;
+    Event.OldThreadWaitMode = OldThread->WaitMode;
+    RtlZeroMemory(Event.Reserved, sizeof(Event.Reserved));
+
+    WmipLogKernelEvent(WMIP_KERNEL_LOGGER_ID,
+                       &ThreadGuid,
+                       WMIP_TYPE_CSWITCH,
+                       &Event,
+                       sizeof(Event));
+}
+
+VOID
+FASTCALL
+WmipTraceDiskIo(
+    IN PIRP Irp)
+{
+    PIO_STACK_LOCATION StackPtr;
+    WMIP_DISK_IO_EVENT Event;
+    PETHREAD Thread;
+    CCHAR Location;
+
+    /* Log the transfer once, at the lowest disk device that saw it */
+    StackPtr = IoGetCurrentIrpStackLocation(Irp);
+    for (Location = Irp->CurrentLocation;
+         Location <= Irp->StackCount;
+         Location++, StackPtr++)
+    {
+        if ((StackPtr->MajorFunction != IRP_MJ_READ) &&
+            (StackPtr->MajorFunction != IRP_MJ_WRITE))
+        {
+            continue;
+        }
+
+        if (!(StackPtr->DeviceObject) ||
+            (StackPtr->DeviceObject->DeviceType != FILE_DEVICE_DISK))
+        {
+            continue;
+        }
+
+        Thread = Irp->Tail.Overlay.Thread;
+
+        Event.DeviceObject = StackPtr->DeviceObject;
+        Event.FileObject = StackPtr->FileObject;
+        Event.Irp = Irp;
+        Event.ByteOffset = StackPtr->Parameters.Read.ByteOffset.QuadPart;
+        Event.TransferSize = (ULONG)Irp->IoStatus.Information;
+        Event.IrpFlags = Irp->Flags;
+        Event.Status = Irp->IoStatus.Status;
+        Event.IssuingThreadId = Thread ? HandleToUlong(Thread->Cid.UniqueThread) : 0;
+
+        WmipLogKernelEvent(WMIP_KERNEL_LOGGER_ID,
+                           &DiskIoGuid,
+                           (StackPtr->MajorFunction == IRP_MJ_READ) ?
+                           EVENT_TRACE_TYPE_IO_READ : EVENT_TRACE_TYPE_IO_WRITE,
+                           &Event,
+                           sizeof(Event));
+        break;
+    }
+}
+
+VOID
+FASTCALL
+WmipTracePageFault(
+    IN ULONG FaultCode,
+    IN PVOID Address,
+    IN KPROCESSOR_MODE Mode)
+{
+    WMIP_PAGE_FAULT_EVENT Event;
+
+    /* How the fault gets resolved isn't known yet, so there's no finer type */
+    Event.VirtualAddress = Address;
+    Event.FaultCode = FaultCode;
+    Event.Mode = Mode;
+
+    WmipLogKernelEvent(WMIP_KERNEL_LOGGER_ID,
+                       &PageFaultGuid,
+                       EVENT_TRACE_TYPE_INFO,
+                       &Event,
+                       sizeof(Event));
+}
+
+LONG64
+FASTCALL
+WmiGetClock(
+    IN WMI_CLOCK_TYPE ClockType,
+    IN PVOID Context)
+{
+    LARGE_INTEGER Time;
+
+    switch (ClockType)
+    {
+        case WMICT_SYSTEMTIME:
+            KeQuerySystemTime(&Time);
+            return Time.QuadPart;
+
+#if defined(_M_IX86) || defined(_M_AMD64)
+        case WMICT_CPUCYCLE:
+            return __rdtsc();
+#endif
+
+        default:
+            return KeQueryPerformanceCounter(NULL).QuadPart;
+    }
+}
+
+NTSTATUS
+NTAPI
+WmiStartTrace(
+    IN OUT PWMI_LOGGER_INFORMATION LoggerInfo)
+{
+    return WmipStartLogger(LoggerInfo, KernelMode);
+}
+
+NTSTATUS
+NTAPI
+WmiStopTrace(
+    IN PWMI_LOGGER_INFORMATION LoggerInfo)
+{
+    return WmipStopLogger(LoggerInfo);
+}
+
+NTSTATUS
+NTAPI
+WmiQueryTrace(
+    IN OUT PWMI_LOGGER_INFORMATION LoggerInfo)
+{
+    return WmipControlLogger(IOCTL_WMI_QUERY_LOGGER, LoggerInfo);
+}
+
+NTSTATUS
+NTAPI
+WmiUpdateTrace(
+    IN OUT PWMI_LOGGER_INFORMATION LoggerInfo)
+{
+    return WmipControlLogger(IOCTL_WMI_UPDATE_LOGGER, LoggerInfo);
+}
+
+NTSTATUS
+NTAPI
+WmiFlushTrace(
+    IN OUT PWMI_LOGGER_INFORMATION LoggerInfo)
+{
+    return WmipControlLogger(IOCTL_WMI_FLUSH_LOGGER, LoggerInfo);
+}
+
+NTSTATUS
+FASTCALL
+WmiTraceFastEvent(
+    IN PWNODE_HEADER Wnode)
+{
+    return WmipTraceEvent(0, (PEVENT_TRACE_HEADER)Wnode, KernelMode);
+}
+
+NTSTATUS
+NTAPI
+NtTraceEvent(
+    IN ULONG TraceHandle,
+    IN ULONG Flags,
+    IN ULONG TraceHeaderLength,
+    IN struct _EVENT_TRACE_HEADER* TraceHeader)
+{
+    PAGED_CODE();
+
+    return WmipTraceEvent(TraceHandle, TraceHeader, ExGetPreviousMode());
+}
+
+/* EOF */
@@ -19,18 +19,6 @@
 #define NDEBUG
 #include <debug.h>
 
-typedef PVOID PWMI_LOGGER_INFORMATION; // FIXME
-
-typedef enum _WMI_CLOCK_TYPE
-{
-    WMICT_DEFAULT,
-    WMICT_SYSTEMTIME,
-    WMICT_PERFCOUNTER,
-    WMICT_PROCESS,
-    WMICT_THREAD,
-    WMICT_CPUCYCLE
-} WMI_CLOCK_TYPE;
-
 /* FUNCTIONS *****************************************************************/
 
 BOOLEAN
@@ -49,6 +37,9 @@ WmiInitialize(
         return FALSE;
     }
 
+    /* Initialize the event trace loggers */
+    WmipInitializeTracing();
+
     /* Create the WMI driver */
     Status = IoCreateDriver(&DriverName, WmipDriverEntry);
     if (!NT_SUCCESS(Status))
@@ -361,75 +352,4 @@ WmiTraceMessageVa(IN TRACEHANDLE LoggerHandle,
     return STATUS_NOT_IMPLEMENTED;
 }
 
-NTSTATUS
-NTAPI
-WmiFlushTrace(IN OUT PWMI_LOGGER_INFORMATION LoggerInfo)
-{
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
-}
-
-LONG64
-FASTCALL
-WmiGetClock(IN WMI_CLOCK_TYPE ClockType,
-            IN PVOID Context)
-{
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
-}
-
-NTSTATUS
-NTAPI
-WmiQueryTrace(IN OUT PWMI_LOGGER_INFORMATION LoggerInfo)
-{
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
-}
-
-NTSTATUS
-NTAPI
-WmiStartTrace(IN OUT PWMI_LOGGER_INFORMATION LoggerInfo)
-{
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
-}
-    
-NTSTATUS
-NTAPI
-WmiStopTrace(IN PWMI_LOGGER_INFORMATION LoggerInfo)
-{
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
-}
-
-NTSTATUS
-FASTCALL
-WmiTraceFastEvent(IN PWNODE_HEADER Wnode)
-{
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
-}
-
-NTSTATUS
-NTAPI
-WmiUpdateTrace(IN OUT PWMI_LOGGER_INFORMATION LoggerInfo)
-{
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
-}
-
-/*
- * @unimplemented
- */
-NTSTATUS
-NTAPI
-NtTraceEvent(IN ULONG TraceHandle,
-             IN ULONG Flags,
-             IN ULONG TraceHeaderLength,
-             IN struct _EVENT_TRACE_HEADER* TraceHeader)
-{
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
-}
-
 /*Eof*/
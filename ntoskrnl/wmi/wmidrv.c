@@ -10,6 +10,7 @@
 
 #include <ntoskrnl.h>
 #include <wmistr.h>
+#include <evntrace.h>
 #include <wmiioctl.h>
 #include "wmip.h"
 
@@ -102,8 +103,8 @@ WmiTraceEvent(
     PVOID InputBuffer,
     KPROCESSOR_MODE PreviousMode)
 {
-    UNIMPLEMENTED_DBGBREAK();
-    return STATUS_SUCCESS;
+    /* The logger handle is in the WNODE_HEADER overlaying the event header */
+    return WmipTraceEvent(0, (PEVENT_TRACE_HEADER)InputBuffer, PreviousMode);
 }
 
 static
@@ -507,6 +508,19 @@ WmipIoControl(
             break;
         }
 
+        case IOCTL_WMI_START_LOGGER:
+        case IOCTL_WMI_STOP_LOGGER:
+        case IOCTL_WMI_QUERY_LOGGER:
+        case IOCTL_WMI_UPDATE_LOGGER:
+        case IOCTL_WMI_FLUSH_LOGGER:
+        {
+            Status = WmipTraceControl(IoControlCode,
+                                      Buffer,
+                                      InputLength,
+                                      &OutputLength);
+            break;
+        }
+
         case IOCTL_WMI_SET_MARK:
         {
             if (InputLength < FIELD_OFFSET(WMI_SET_MARK, Mark))
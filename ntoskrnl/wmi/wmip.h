@@ -17,6 +17,16 @@ typedef struct _WMIP_GUID_OBJECT
     LIST_ENTRY IrpLink;
 } WMIP_GUID_OBJECT, *PWMIP_GUID_OBJECT;
 
+typedef enum _WMI_CLOCK_TYPE
+{
+    WMICT_DEFAULT,
+    WMICT_SYSTEMTIME,
+    WMICT_PERFCOUNTER,
+    WMICT_PROCESS,
+    WMICT_THREAD,
+    WMICT_CPUCYCLE
+} WMI_CLOCK_TYPE;
+
 
 _Function_class_(DRIVER_INITIALIZE)
 _IRQL_requires_same_
@@ -55,3 +65,31 @@ WmipQueryRawSMBiosTables(
     _Inout_ ULONG *InOutBufferSize,
     _Out_opt_ PVOID OutBuffer);
 
+struct _EVENT_TRACE_HEADER;
+
+VOID
+NTAPI
+WmipInitializeTracing(
+    VOID);
+
+NTSTATUS
+NTAPI
+WmipTraceControl(
+    _In_ ULONG IoControlCode,
+    _Inout_ PVOID Buffer,
+    _In_ ULONG InputLength,
+    _Inout_ PULONG OutputLength);
+
+NTSTATUS
+NTAPI
+WmipTraceEvent(
+    _In_ ULONG LoggerHandle,
+    _In_ struct _EVENT_TRACE_HEADER *TraceHeader,
+    _In_ KPROCESSOR_MODE PreviousMode);
+
+LONG64
+FASTCALL
+WmiGetClock(
+    _In_ WMI_CLOCK_TYPE ClockType,
+    _In_opt_ PVOID Context);
+
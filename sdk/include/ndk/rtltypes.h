@@ -80,6 +80,7 @@ extern "C" {
 //
 #define RTL_RANGE_LIST_ADD_IF_CONFLICT                      0x00000001
 #define RTL_RANGE_LIST_ADD_SHARED                           0x00000002
+#define RTL_RANGE_LIST_MERGE_IF_CONFLICT                    RTL_RANGE_LIST_ADD_IF_CONFLICT
 
 #define RTL_RANGE_SHARED                                    0x01
 #define RTL_RANGE_CONFLICT                                  0x02
@@ -205,6 +205,10 @@ extern "C" {
 #define COPY_FILE_FAIL_IF_EXISTS 0x00000001
 #define COPY_FILE_RESTARTABLE 0x00000002
 #define COPY_FILE_OPEN_SOURCE_FOR_WRITE 0x00000004
+#if (_WIN32_WINNT >= 0x0600)
+#define COPY_FILE_COPY_SYMLINK 0x00000800
+#define COPY_FILE_NO_BUFFERING 0x00001000
+#endif
 #define FILE_FLAG_WRITE_THROUGH	0x80000000
 #define FILE_FLAG_OVERLAPPED	1073741824
 #define FILE_FLAG_NO_BUFFERING	536870912
@@ -3242,6 +3246,11 @@ DWORD WINAPI WaitForSingleObject(HANDLE,DWORD);
 DWORD WINAPI WaitForSingleObjectEx(HANDLE,DWORD,BOOL);
 BOOL WINAPI WaitNamedPipeA(_In_ LPCSTR, _In_ DWORD);
 BOOL WINAPI WaitNamedPipeW(_In_ LPCWSTR, _In_ DWORD);
+#if (_WIN32_WINNT >= 0x0602)
+BOOL WINAPI WaitOnAddress(_In_ volatile VOID*, _In_ PVOID, _In_ SIZE_T, _In_ DWORD);
+VOID WINAPI WakeByAddressAll(_In_ PVOID);
+VOID WINAPI WakeByAddressSingle(_In_ PVOID);
+#endif
 #if (_WIN32_WINNT >= 0x0600)
 VOID WINAPI WakeConditionVariable(PCONDITION_VARIABLE);
 VOID WINAPI WakeAllConditionVariable(PCONDITION_VARIABLE);
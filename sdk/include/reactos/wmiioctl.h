@@ -6,12 +6,12 @@
 #define IOCTL_WMI_SET_SINGLE_INSTANCE CTL_CODE(FILE_DEVICE_UNKNOWN, 0x02, METHOD_BUFFERED, FILE_WRITE_ACCESS) // 0x228008
 #define IOCTL_WMI_SET_SINGLE_ITEM CTL_CODE(FILE_DEVICE_UNKNOWN, 0x03, METHOD_BUFFERED, FILE_WRITE_ACCESS) // 0x22800C
 #define IOCTL_WMI_09 CTL_CODE(FILE_DEVICE_UNKNOWN, 0x09, METHOD_BUFFERED, FILE_WRITE_ACCESS) // 0x228024
-#define IOCTL_WMI_20 CTL_CODE(FILE_DEVICE_UNKNOWN, 0x20, METHOD_BUFFERED, FILE_ANY_ACCESS) // 0x220080
-#define IOCTL_WMI_21 CTL_CODE(FILE_DEVICE_UNKNOWN, 0x21, METHOD_BUFFERED, FILE_ANY_ACCESS) // 0x220084
-#define IOCTL_WMI_22 CTL_CODE(FILE_DEVICE_UNKNOWN, 0x22, METHOD_BUFFERED, FILE_ANY_ACCESS) // 0x220088
+#define IOCTL_WMI_START_LOGGER CTL_CODE(FILE_DEVICE_UNKNOWN, 0x20, METHOD_BUFFERED, FILE_ANY_ACCESS) // 0x220080
+#define IOCTL_WMI_STOP_LOGGER CTL_CODE(FILE_DEVICE_UNKNOWN, 0x21, METHOD_BUFFERED, FILE_ANY_ACCESS) // 0x220084
+#define IOCTL_WMI_QUERY_LOGGER CTL_CODE(FILE_DEVICE_UNKNOWN, 0x22, METHOD_BUFFERED, FILE_ANY_ACCESS) // 0x220088
 #define IOCTL_WMI_TRACE_EVENT CTL_CODE(FILE_DEVICE_UNKNOWN, 0x23, METHOD_NEITHER, FILE_WRITE_ACCESS) // 0x22808F
-#define IOCTL_WMI_24 CTL_CODE(FILE_DEVICE_UNKNOWN, 0x24, METHOD_BUFFERED, FILE_ANY_ACCESS) // 0x220090
-#define IOCTL_WMI_25 CTL_CODE(FILE_DEVICE_UNKNOWN, 0x25, METHOD_BUFFERED, FILE_ANY_ACCESS) // 0x220094
+#define IOCTL_WMI_UPDATE_LOGGER CTL_CODE(FILE_DEVICE_UNKNOWN, 0x24, METHOD_BUFFERED, FILE_ANY_ACCESS) // 0x220090
+#define IOCTL_WMI_FLUSH_LOGGER CTL_CODE(FILE_DEVICE_UNKNOWN, 0x25, METHOD_BUFFERED, FILE_ANY_ACCESS) // 0x220094
 #define IOCTL_WMI_TRACE_USER_MESSAGE CTL_CODE(FILE_DEVICE_UNKNOWN, 0x28, METHOD_NEITHER, FILE_WRITE_ACCESS) // 0x2280A3
 #define IOCTL_WMI_SET_MARK CTL_CODE(FILE_DEVICE_UNKNOWN, 0x29, METHOD_BUFFERED, FILE_ANY_ACCESS) // 0x2200A4
 #define IOCTL_WMI_2a CTL_CODE(FILE_DEVICE_UNKNOWN, 0x2a, METHOD_BUFFERED, FILE_ANY_ACCESS) // 0x2200A8
@@ -35,3 +35,55 @@
 #define IOCTL_WMI_58 CTL_CODE(FILE_DEVICE_UNKNOWN, 0x58, METHOD_BUFFERED, FILE_READ_ACCESS) // 0x224160
 #define IOCTL_WMI_59 CTL_CODE(FILE_DEVICE_UNKNOWN, 0x59, METHOD_BUFFERED, FILE_READ_ACCESS) // 0x224164
 #define IOCTL_WMI_5a CTL_CODE(FILE_DEVICE_UNKNOWN, 0x5a, METHOD_BUFFERED, FILE_WRITE_ACCESS) // 0x228168
+
+/* Logger handle of the "NT Kernel Logger" session */
+#define WMI_KERNEL_LOGGER_HANDLE 0xFFFF
+
+/*
+ * Input and output of the logger IOCTLs. The logger and log file names are
+ * packed right after the structure, in this order, the Buffer members are
+ * ignored on input. Wnode.HistoricalContext holds the logger handle and
+ * Wnode.ClientContext the clock type.
+ */
+typedef struct _WMI_LOGGER_INFORMATION
+{
+    WNODE_HEADER Wnode;
+    ULONG BufferSize;
+    ULONG MinimumBuffers;
+    ULONG MaximumBuffers;
+    ULONG MaximumFileSize;
+    ULONG LogFileMode;
+    ULONG FlushTimer;
+    ULONG EnableFlags;
+    LONG AgeLimit;
+    ULONG Wow;
+    HANDLE LogFileHandle;
+    ULONG NumberOfBuffers;
+    ULONG FreeBuffers;
+    ULONG EventsLost;
+    ULONG BuffersWritten;
+    ULONG LogBuffersLost;
+    ULONG RealTimeBuffersLost;
+    HANDLE LoggerThreadId;
+    UNICODE_STRING LogFileName;
+    UNICODE_STRING LoggerName;
+    PVOID Checksum;
+    PVOID LoggerExtension;
+} WMI_LOGGER_INFORMATION, *PWMI_LOGGER_INFORMATION;
+
+/*
+ * The log file is a sequence of BufferSize sized buffers, each starting with
+ * this header. It is followed by SavedOffset - sizeof(WMI_BUFFER_HEADER) bytes
+ * of events, every event is an EVENT_TRACE_HEADER and its data, padded to
+ * 8 bytes. The rest of the buffer is zeroed. Each processor fills its own
+ * buffers, so events are only in order within a buffer.
+ */
+typedef struct _WMI_BUFFER_HEADER
+{
+    ULONG BufferSize;
+    ULONG SavedOffset;
+    ULONG BufferNumber;
+    USHORT ProcessorNumber;
+    USHORT LoggerId;
+    LARGE_INTEGER TimeStamp;
+} WMI_BUFFER_HEADER, *PWMI_BUFFER_HEADER;
@@ -0,0 +1,29 @@
+/*
+ * PROJECT:     ReactOS CRT library
+ * LICENSE:     GPL - See COPYING in the top level directory
+ * PURPOSE:     Helpers for the word-at-a-time string and memory routines
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/* The routines work on naturally aligned machine words. An aligned word
+   never crosses a page boundary, so reading the whole word that holds the
+   terminator of a string can not fault even if the string ends mid word. */
+#define MEMWORD_SIZE            sizeof(size_t)
+#define MEMWORD_ALIGNED(p)      (((size_t)(p) & (MEMWORD_SIZE - 1)) == 0)
+
+/* Element mask, and a word holding 1 and 0x80 (0x8000) in each element,
+   for byte (n == 1) and wide character (n == 2) elements */
+#define MEMWORD_MASK(n)         ((n) == 1 ? 0xFF : 0xFFFF)
+#define MEMWORD_LOW(n)          ((size_t)-1 / MEMWORD_MASK(n))
+#define MEMWORD_HIGH(n)         (MEMWORD_LOW(n) << ((n) * 8 - 1))
+
+/* Replicates the element c into every element of a word */
+#define MEMWORD_SPLAT(c, n)     (((size_t)(c) & MEMWORD_MASK(n)) * MEMWORD_LOW(n))
+
+/* Nonzero if any element of the word w is zero */
+#define MEMWORD_HAS_ZERO(w, n)  ((((w) - MEMWORD_LOW(n)) & ~(w) & MEMWORD_HIGH(n)) != 0)
+
+/* EOF */
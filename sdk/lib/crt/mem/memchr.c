@@ -1,5 +1,6 @@
 
 #include <string.h>
+#include <internal/memword.h>
 
 #if defined(_MSC_VER) && defined(_M_ARM)
 #pragma function(memchr)
@@ -7,11 +8,34 @@
 
 void* __cdecl memchr(const void *s, int c, size_t n)
 {
+    const unsigned char *p = s;
+    unsigned char uc = (unsigned char)c;
+    size_t word_c;
+
+    if (n >= MEMWORD_SIZE)
+    {
+        /* Scan up to the first word boundary, then skip whole words
+           that do not contain the character */
+        while (!MEMWORD_ALIGNED(p))
+        {
+            if (*p == uc)
+                return (void *)p;
+            p++;
+            n--;
+        }
+        word_c = MEMWORD_SPLAT(uc, 1);
+        while (n >= MEMWORD_SIZE &&
+               !MEMWORD_HAS_ZERO(*(const size_t *)p ^ word_c, 1))
+        {
+            p += MEMWORD_SIZE;
+            n -= MEMWORD_SIZE;
+        }
+    }
+
     if (n)
     {
-        const char *p = s;
         do {
-            if (*p++ == c)
+            if (*p++ == uc)
                 return (void *)(p-1);
         } while (--n != 0);
     }
@@ -1,5 +1,6 @@
 
 #include <string.h>
+#include <internal/memword.h>
 
 #ifdef _MSC_VER
 #pragma warning(disable: 4164)
@@ -10,6 +11,28 @@ int __cdecl memcmp(const void *s1, const void *s2, size_t n)
 {
     if (n != 0) {
         const unsigned char *p1 = s1, *p2 = s2;
+
+        /* Skip the equal words, the bytes of the first differing word
+           are compared below */
+        if (n >= MEMWORD_SIZE &&
+            ((size_t)p1 & (MEMWORD_SIZE - 1)) == ((size_t)p2 & (MEMWORD_SIZE - 1))) {
+            while (!MEMWORD_ALIGNED(p1)) {
+                if (*p1 != *p2)
+                    return (*p1 - *p2);
+                p1++;
+                p2++;
+                n--;
+            }
+            while (n >= MEMWORD_SIZE &&
+                   *(const size_t *)p1 == *(const size_t *)p2) {
+                p1 += MEMWORD_SIZE;
+                p2 += MEMWORD_SIZE;
+                n -= MEMWORD_SIZE;
+            }
+            if (n == 0)
+                return 0;
+        }
+
         do {
             if (*p1++ != *p2++)
                 return (*--p1 - *--p2);
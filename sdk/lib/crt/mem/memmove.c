@@ -1,6 +1,8 @@
+
 #include <string.h>
+#include <internal/memword.h>
 
-/* NOTE: This code is duplicated in memcpy function */
+/* NOTE: This code is shared with the memcpy function */
 void * __cdecl memmove(void *dest,const void *src,size_t count)
 {
     char *char_dest = (char *)dest;
@@ -9,6 +11,24 @@ void * __cdecl memmove(void *dest,const void *src,size_t count)
     if ((char_dest <= char_src) || (char_dest >= (char_src+count)))
     {
         /*  non-overlapping buffers */
+        if (count >= MEMWORD_SIZE &&
+            ((size_t)char_dest & (MEMWORD_SIZE - 1)) == ((size_t)char_src & (MEMWORD_SIZE - 1)))
+        {
+            /* Copy up to the first word boundary, then whole words */
+            while (!MEMWORD_ALIGNED(char_dest))
+            {
+                *char_dest++ = *char_src++;
+                count--;
+            }
+            while (count >= MEMWORD_SIZE)
+            {
+                *(size_t *)char_dest = *(const size_t *)char_src;
+                char_dest += MEMWORD_SIZE;
+                char_src += MEMWORD_SIZE;
+                count -= MEMWORD_SIZE;
+            }
+        }
+
         while(count > 0)
 	{
             *char_dest = *char_src;
@@ -20,17 +40,36 @@ void * __cdecl memmove(void *dest,const void *src,size_t count)
     else
     {
         /* overlaping buffers */
-        char_dest = (char *)dest + count - 1;
-        char_src = (char *)src + count - 1;
+        char_dest = (char *)dest + count;
+        char_src = (char *)src + count;
+
+        if (count >= MEMWORD_SIZE &&
+            ((size_t)char_dest & (MEMWORD_SIZE - 1)) == ((size_t)char_src & (MEMWORD_SIZE - 1)))
+        {
+            /* Same as above, walking down from the end of the buffers */
+            while (!MEMWORD_ALIGNED(char_dest))
+            {
+                *--char_dest = *--char_src;
+                count--;
+            }
+            while (count >= MEMWORD_SIZE)
+            {
+                char_dest -= MEMWORD_SIZE;
+                char_src -= MEMWORD_SIZE;
+                *(size_t *)char_dest = *(const size_t *)char_src;
+                count -= MEMWORD_SIZE;
+            }
+        }
 
         while(count > 0)
 	{
-           *char_dest = *char_src;
            char_dest--;
            char_src--;
+           *char_dest = *char_src;
            count--;
 	}
     }
 
     return dest;
 }
+
@@ -1,5 +1,6 @@
 
 #include <string.h>
+#include <internal/memword.h>
 
 #ifdef _MSC_VER
 #pragma function(memset)
@@ -8,6 +9,23 @@
 void* __cdecl memset(void* src, int val, size_t count)
 {
     char *char_src = (char *)src;
+    size_t word_val;
+
+    if (count >= MEMWORD_SIZE)
+    {
+        /* Fill up to the first word boundary, then whole words */
+        while (!MEMWORD_ALIGNED(char_src)) {
+            *char_src = val;
+            char_src++;
+            count--;
+        }
+        word_val = MEMWORD_SPLAT(val, 1);
+        while (count >= MEMWORD_SIZE) {
+            *(size_t *)char_src = word_val;
+            char_src += MEMWORD_SIZE;
+            count -= MEMWORD_SIZE;
+        }
+    }
 
     while(count>0) {
         *char_src = val;
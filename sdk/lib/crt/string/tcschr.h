@@ -1,9 +1,29 @@
 
 #include <tchar.h>
+#include <internal/memword.h>
 
 _TCHAR * _tcschr(const _TCHAR * s, _XINT c)
 {
  _TCHAR cc = c;
+ const size_t * w;
+ size_t wc;
+
+ /* Skip whole words holding neither the character nor the terminator */
+ if(((size_t)s & (sizeof(_TCHAR) - 1)) == 0)
+ {
+  for(; !MEMWORD_ALIGNED(s); s++)
+  {
+   if(*s == cc) return (_TCHAR *)s;
+   if(*s == 0) return 0;
+  }
+
+  wc = MEMWORD_SPLAT(cc, sizeof(_TCHAR));
+  for(w = (const size_t *)s;
+      !MEMWORD_HAS_ZERO(*w, sizeof(_TCHAR)) && !MEMWORD_HAS_ZERO(*w ^ wc, sizeof(_TCHAR));
+      w++);
+
+  s = (const _TCHAR *)w;
+ }
 
  while(*s)
  {
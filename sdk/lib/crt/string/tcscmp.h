@@ -1,5 +1,6 @@
 
 #include <tchar.h>
+#include <internal/memword.h>
 
 #if defined(_MSC_VER)
 #pragma function(_tcscmp)
@@ -7,6 +8,24 @@
 
 int _tcscmp(const _TCHAR* s1, const _TCHAR* s2)
 {
+ /* With equal alignment, skip whole words that match and hold no terminator */
+ if(((size_t)s1 & (MEMWORD_SIZE - 1)) == ((size_t)s2 & (MEMWORD_SIZE - 1)) &&
+    ((size_t)s1 & (sizeof(_TCHAR) - 1)) == 0)
+ {
+  for(; !MEMWORD_ALIGNED(s1); s1 ++, s2 ++)
+  {
+   if(*s1 != *s2) return *s1 - *s2;
+   if(*s1 == 0) return 0;
+  }
+
+  while(*(const size_t *)s1 == *(const size_t *)s2 &&
+        !MEMWORD_HAS_ZERO(*(const size_t *)s1, sizeof(_TCHAR)))
+  {
+   s1 = (const _TCHAR *)((const size_t *)s1 + 1);
+   s2 = (const _TCHAR *)((const size_t *)s2 + 1);
+  }
+ }
+
  while(*s1 == *s2)
  {
   if(*s1 == 0) return 0;
@@ -1,6 +1,7 @@
 
 #include <stddef.h>
 #include <tchar.h>
+#include <internal/memword.h>
 
 #ifdef _MSC_VER
 #pragma function(_tcslen)
@@ -9,10 +10,24 @@
 size_t __cdecl _tcslen(const _TCHAR * str)
 {
  const _TCHAR * s;
+ const size_t * w;
 
  if(str == 0) return 0;
 
- for(s = str; *s; ++ s);
+ s = str;
+
+ /* Scan whole words once aligned, a misaligned wide string can't be */
+ if(((size_t)s & (sizeof(_TCHAR) - 1)) == 0)
+ {
+  for(; !MEMWORD_ALIGNED(s); ++ s)
+   if(*s == 0) return s - str;
+
+  for(w = (const size_t *)s; !MEMWORD_HAS_ZERO(*w, sizeof(_TCHAR)); ++ w);
+
+  s = (const _TCHAR *)w;
+ }
+
+ for(; *s; ++ s);
 
  return s - str;
 }
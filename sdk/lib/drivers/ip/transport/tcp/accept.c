@@ -78,7 +78,8 @@ NTSTATUS TCPListen(PCONNECTION_ENDPOINT Connection, UINT Backlog)
             if (NT_SUCCESS(Status))
             {
                 /* Allocate the port in the port bitmap */
-                Connection->AddressFile->Port = TCPAllocatePort(LocalAddress.Address[0].Address[0].sin_port);
+                AddrFileSetPort(Connection->AddressFile,
+                                TCPAllocatePort(LocalAddress.Address[0].Address[0].sin_port));
                 
                 /* This should never fail */
                 ASSERT(Connection->AddressFile->Port != 0xFFFF);
@@ -82,6 +82,22 @@ static const parser_state_func parser_funcs[NB_PARSER_STATES] =
 
 /* PRIVATE FUNCTIONS ********************************************************/
 
+static ULONG
+InfpHashString (PCWSTR String)
+{
+  ULONG Hash = 0;
+
+  /* Fold case the same way strcmpiW does */
+  while (*String != 0)
+    {
+      Hash = Hash * 31 + tolowerW (*String);
+      String++;
+    }
+
+  return Hash;
+}
+
+
 static PINFCACHELINE
 InfpFreeLine (PINFCACHELINE Line)
 {
@@ -133,6 +149,11 @@ InfpFreeSection (PINFCACHESECTION Section)
     }
   Section->LastLine = NULL;
 
+  if (Section->KeyHash != NULL)
+    {
+      FREE (Section->KeyHash);
+    }
+
   FREE (Section);
 
   return Next;
@@ -150,8 +171,8 @@ InfpFindSection(PINFCACHE Cache,
       return NULL;
     }
 
-  /* iterate through list of sections */
-  Section = Cache->FirstSection;
+  /* iterate through the sections in the hash bucket */
+  Section = Cache->SectionHash[InfpHashString(Name) & (INF_SECTION_HASH_SIZE - 1)];
   while (Section != NULL)
     {
       if (strcmpiW(Section->Name, Name) == 0)
@@ -160,7 +181,7 @@ InfpFindSection(PINFCACHE Cache,
         }
 
       /* get the next section*/
-      Section = Section->Next;
+      Section = Section->HashNext;
     }
 
   return NULL;
@@ -173,6 +194,7 @@ InfpAddSection(PINFCACHE Cache,
 {
   PINFCACHESECTION Section = NULL;
   ULONG Size;
+  ULONG Bucket;
 
   if (Cache == NULL || Name == NULL)
     {
@@ -208,6 +230,11 @@ InfpAddSection(PINFCACHE Cache,
       Cache->LastSection = Section;
     }
 
+  /* Index the section name. Callers only add sections that do not exist yet */
+  Bucket = InfpHashString(Name) & (INF_SECTION_HASH_SIZE - 1);
+  Section->HashNext = Cache->SectionHash[Bucket];
+  Cache->SectionHash[Bucket] = Section;
+
   return Section;
 }
 
@@ -316,12 +343,99 @@ InfpAddFieldToLine(PINFCACHELINE Line,
 }
 
 
+/*
+ * Brings the key index of a section up to date. Lines are only ever
+ * appended and get their key right after being added, so only the lines
+ * after the last indexed one need to be hashed. Only the first line with
+ * a given key is indexed, as that is the one a key lookup returns.
+ */
+static BOOLEAN
+InfpUpdateKeyHash(PINFCACHESECTION Section)
+{
+  PINFCACHELINE Line;
+  PINFCACHELINE *Bucket;
+  PINFCACHELINE Other;
+  ULONG Size;
+
+  if (Section->KeyHash == NULL ||
+      (ULONG)Section->LineCount > 2 * Section->KeyHashSize)
+    {
+      /* (Re)build the index with about one bucket per line */
+      for (Size = INF_KEY_HASH_MIN_LINES; Size < (ULONG)Section->LineCount; Size *= 2)
+        ;
+
+      Bucket = (PINFCACHELINE *)MALLOC(Size * sizeof(PINFCACHELINE));
+      if (Bucket == NULL)
+        {
+          DPRINT("MALLOC() failed\n");
+          return FALSE;
+        }
+      ZEROMEMORY(Bucket,
+                 Size * sizeof(PINFCACHELINE));
+
+      if (Section->KeyHash != NULL)
+        {
+          FREE(Section->KeyHash);
+        }
+      Section->KeyHash = Bucket;
+      Section->KeyHashSize = Size;
+      Section->LastHashedLine = NULL;
+    }
+
+  Line = (Section->LastHashedLine != NULL) ? Section->LastHashedLine->Next
+                                           : Section->FirstLine;
+  while (Line != NULL)
+    {
+      Section->LastHashedLine = Line;
+
+      if (Line->Key != NULL)
+        {
+          Bucket = &Section->KeyHash[InfpHashString(Line->Key) & (Section->KeyHashSize - 1)];
+
+          for (Other = *Bucket; Other != NULL; Other = Other->HashNext)
+            {
+              if (strcmpiW(Other->Key, Line->Key) == 0)
+                break;
+            }
+
+          if (Other == NULL)
+            {
+              Line->HashNext = *Bucket;
+              *Bucket = Line;
+            }
+        }
+
+      Line = Line->Next;
+    }
+
+  return TRUE;
+}
+
+
 PINFCACHELINE
 InfpFindKeyLine(PINFCACHESECTION Section,
                 PCWSTR Key)
 {
   PINFCACHELINE Line;
 
+  /* Use the key index for larger sections */
+  if (Section->LineCount >= INF_KEY_HASH_MIN_LINES &&
+      InfpUpdateKeyHash(Section))
+    {
+      Line = Section->KeyHash[InfpHashString(Key) & (Section->KeyHashSize - 1)];
+      while (Line != NULL)
+        {
+          if (strcmpiW(Line->Key, Key) == 0)
+            {
+              return Line;
+            }
+
+          Line = Line->HashNext;
+        }
+
+      return NULL;
+    }
+
   Line = Section->FirstLine;
   while (Line != NULL)
     {
@@ -18,6 +18,11 @@
 #define INF_STATUS_WRONG_INF_STYLE         ((INFSTATUS)0xC0700003)
 #define INF_STATUS_NOT_ENOUGH_MEMORY       ((INFSTATUS)0xC0700004)
 
+/* Number of buckets in the section name hash (power of two) */
+#define INF_SECTION_HASH_SIZE  128
+/* Sections with fewer lines are searched for keys without an index */
+#define INF_KEY_HASH_MIN_LINES 16
+
 typedef struct _INFCACHEFIELD
 {
   struct _INFCACHEFIELD *Next;
@@ -30,6 +35,7 @@ typedef struct _INFCACHELINE
 {
   struct _INFCACHELINE *Next;
   struct _INFCACHELINE *Prev;
+  struct _INFCACHELINE *HashNext;
 
   LONG FieldCount;
 
@@ -44,12 +50,18 @@ typedef struct _INFCACHESECTION
 {
   struct _INFCACHESECTION *Next;
   struct _INFCACHESECTION *Prev;
+  struct _INFCACHESECTION *HashNext;
 
   PINFCACHELINE FirstLine;
   PINFCACHELINE LastLine;
 
   LONG LineCount;
 
+  /* Key index, built on the first key lookup and extended as lines are added */
+  PINFCACHELINE *KeyHash;
+  ULONG KeyHashSize;
+  PINFCACHELINE LastHashedLine;
+
   WCHAR Name[1];
 } INFCACHESECTION, *PINFCACHESECTION;
 
@@ -60,6 +72,8 @@ typedef struct _INFCACHE
   PINFCACHESECTION LastSection;
 
   PINFCACHESECTION StringsSection;
+
+  PINFCACHESECTION SectionHash[INF_SECTION_HASH_SIZE];
 } INFCACHE, *PINFCACHE;
 
 typedef struct _INFCONTEXT
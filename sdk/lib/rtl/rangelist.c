@@ -15,12 +15,407 @@
 
 /* TYPES ********************************************************************/
 
+/*
+ * Besides being linked in start order on the list, which is what iterators
+ * walk, every entry is a node of an AVL tree keyed on the range start. Each
+ * node also records the highest end in its subtree, so that overlapping
+ * ranges can be found without visiting the ones that can't overlap. The
+ * RTL_RANGE_LIST structure has no room for the tree root; it is found by
+ * climbing from the first entry, which is the leftmost node.
+ */
 typedef struct _RTL_RANGE_ENTRY
 {
     LIST_ENTRY Entry;
     RTL_RANGE Range;
+    struct _RTL_RANGE_ENTRY *Parent;
+    struct _RTL_RANGE_ENTRY *Left;
+    struct _RTL_RANGE_ENTRY *Right;
+    ULONGLONG MaxEnd;
+    LONG Height;
 } RTL_RANGE_ENTRY, *PRTL_RANGE_ENTRY;
 
+/* PRIVATE FUNCTIONS *******************************************************/
+
+static
+PRTL_RANGE_ENTRY
+RtlpGetRangeRoot(IN PRTL_RANGE_LIST RangeList)
+{
+    PRTL_RANGE_ENTRY Node;
+
+    if (IsListEmpty(&RangeList->ListHead))
+        return NULL;
+
+    Node = CONTAINING_RECORD(RangeList->ListHead.Flink, RTL_RANGE_ENTRY, Entry);
+    while (Node->Parent != NULL)
+        Node = Node->Parent;
+
+    return Node;
+}
+
+static
+LONG
+RtlpGetRangeHeight(IN PRTL_RANGE_ENTRY Node)
+{
+    return (Node != NULL) ? Node->Height : 0;
+}
+
+static
+VOID
+RtlpUpdateRangeNode(IN PRTL_RANGE_ENTRY Node)
+{
+    LONG LeftHeight = RtlpGetRangeHeight(Node->Left);
+    LONG RightHeight = RtlpGetRangeHeight(Node->Right);
+
+    Node->Height = 1 + max(LeftHeight, RightHeight);
+
+    Node->MaxEnd = Node->Range.End;
+    if (Node->Left != NULL && Node->Left->MaxEnd > Node->MaxEnd)
+        Node->MaxEnd = Node->Left->MaxEnd;
+    if (Node->Right != NULL && Node->Right->MaxEnd > Node->MaxEnd)
+        Node->MaxEnd = Node->Right->MaxEnd;
+}
+
+static
+VOID
+RtlpReplaceRangeChild(IN PRTL_RANGE_ENTRY Parent,
+                      IN PRTL_RANGE_ENTRY OldChild,
+                      IN PRTL_RANGE_ENTRY NewChild)
+{
+    if (NewChild != NULL)
+        NewChild->Parent = Parent;
+
+    if (Parent != NULL)
+    {
+        if (Parent->Left == OldChild)
+            Parent->Left = NewChild;
+        else
+            Parent->Right = NewChild;
+    }
+}
+
+static
+PRTL_RANGE_ENTRY
+RtlpRotateRange(IN PRTL_RANGE_ENTRY Node,
+                IN BOOLEAN RotateLeft)
+{
+    PRTL_RANGE_ENTRY Pivot;
+
+    if (RotateLeft)
+    {
+        Pivot = Node->Right;
+        Node->Right = Pivot->Left;
+        if (Pivot->Left != NULL)
+            Pivot->Left->Parent = Node;
+        RtlpReplaceRangeChild(Node->Parent, Node, Pivot);
+        Pivot->Left = Node;
+    }
+    else
+    {
+        Pivot = Node->Left;
+        Node->Left = Pivot->Right;
+        if (Pivot->Right != NULL)
+            Pivot->Right->Parent = Node;
+        RtlpReplaceRangeChild(Node->Parent, Node, Pivot);
+        Pivot->Right = Node;
+    }
+
+    Node->Parent = Pivot;
+    RtlpUpdateRangeNode(Node);
+    RtlpUpdateRangeNode(Pivot);
+
+    return Pivot;
+}
+
+static
+VOID
+RtlpRebalanceRanges(IN PRTL_RANGE_ENTRY Node)
+{
+    LONG Balance;
+
+    /* Walk up to the root, the subtree maxima change all the way */
+    while (Node != NULL)
+    {
+        RtlpUpdateRangeNode(Node);
+        Balance = RtlpGetRangeHeight(Node->Left) - RtlpGetRangeHeight(Node->Right);
+
+        if (Balance > 1)
+        {
+            if (RtlpGetRangeHeight(Node->Left->Left) < RtlpGetRangeHeight(Node->Left->Right))
+                RtlpRotateRange(Node->Left, TRUE);
+            Node = RtlpRotateRange(Node, FALSE);
+        }
+        else if (Balance < -1)
+        {
+            if (RtlpGetRangeHeight(Node->Right->Right) < RtlpGetRangeHeight(Node->Right->Left))
+                RtlpRotateRange(Node->Right, FALSE);
+            Node = RtlpRotateRange(Node, TRUE);
+        }
+
+        Node = Node->Parent;
+    }
+}
+
+static
+VOID
+RtlpInsertRangeEntry(IN OUT PRTL_RANGE_LIST RangeList,
+                     IN PRTL_RANGE_ENTRY RangeEntry)
+{
+    PRTL_RANGE_ENTRY Parent, Current;
+
+    RangeEntry->Parent = NULL;
+    RangeEntry->Left = NULL;
+    RangeEntry->Right = NULL;
+    RangeEntry->MaxEnd = RangeEntry->Range.End;
+    RangeEntry->Height = 1;
+
+    Current = RtlpGetRangeRoot(RangeList);
+    if (Current == NULL)
+    {
+        InsertTailList(&RangeList->ListHead, &RangeEntry->Entry);
+        return;
+    }
+
+    /* Ranges with the same start stay in the order they were added */
+    do
+    {
+        Parent = Current;
+        if (RangeEntry->Range.Start < Current->Range.Start)
+            Current = Current->Left;
+        else
+            Current = Current->Right;
+    } while (Current != NULL);
+
+    RangeEntry->Parent = Parent;
+    if (RangeEntry->Range.Start < Parent->Range.Start)
+    {
+        /* The parent is the next entry */
+        Parent->Left = RangeEntry;
+        InsertTailList(&Parent->Entry, &RangeEntry->Entry);
+    }
+    else
+    {
+        /* The parent is the previous entry */
+        Parent->Right = RangeEntry;
+        InsertHeadList(&Parent->Entry, &RangeEntry->Entry);
+    }
+
+    RtlpRebalanceRanges(Parent);
+}
+
+static
+VOID
+RtlpRemoveRangeEntry(IN PRTL_RANGE_ENTRY RangeEntry)
+{
+    PRTL_RANGE_ENTRY Parent, Child, Successor;
+
+    RemoveEntryList(&RangeEntry->Entry);
+
+    if (RangeEntry->Left != NULL && RangeEntry->Right != NULL)
+    {
+        /* Move the next entry, which has no left child, into our place */
+        Successor = RangeEntry->Right;
+        while (Successor->Left != NULL)
+            Successor = Successor->Left;
+
+        if (Successor->Parent == RangeEntry)
+        {
+            Parent = Successor;
+        }
+        else
+        {
+            Parent = Successor->Parent;
+            Child = Successor->Right;
+            Parent->Left = Child;
+            if (Child != NULL)
+                Child->Parent = Parent;
+
+            Successor->Right = RangeEntry->Right;
+            Successor->Right->Parent = Successor;
+        }
+
+        Successor->Left = RangeEntry->Left;
+        Successor->Left->Parent = Successor;
+        RtlpReplaceRangeChild(RangeEntry->Parent, RangeEntry, Successor);
+    }
+    else
+    {
+        Child = (RangeEntry->Left != NULL) ? RangeEntry->Left : RangeEntry->Right;
+        Parent = RangeEntry->Parent;
+        RtlpReplaceRangeChild(Parent, RangeEntry, Child);
+    }
+
+    RtlpRebalanceRanges(Parent);
+}
+
+static
+PRTL_RANGE_ENTRY
+RtlpBuildRangeTree(IN OUT PLIST_ENTRY *Next,
+                   IN ULONG Count)
+{
+    PRTL_RANGE_ENTRY Node, Left;
+    ULONG LeftCount;
+
+    if (Count == 0)
+        return NULL;
+
+    /* The entries come in order, so the middle one becomes the root */
+    LeftCount = Count / 2;
+    Left = RtlpBuildRangeTree(Next, LeftCount);
+
+    Node = CONTAINING_RECORD(*Next, RTL_RANGE_ENTRY, Entry);
+    *Next = (*Next)->Flink;
+
+    Node->Parent = NULL;
+    Node->Left = Left;
+    if (Left != NULL)
+        Left->Parent = Node;
+
+    Node->Right = RtlpBuildRangeTree(Next, Count - LeftCount - 1);
+    if (Node->Right != NULL)
+        Node->Right->Parent = Node;
+
+    RtlpUpdateRangeNode(Node);
+
+    return Node;
+}
+
+static
+BOOLEAN
+RtlpIsRangeConflict(IN PRTL_RANGE Range,
+                    IN ULONG Flags,
+                    IN UCHAR AttributeAvailableMask,
+                    IN PVOID Context OPTIONAL,
+                    IN PRTL_CONFLICT_RANGE_CALLBACK Callback OPTIONAL)
+{
+    if (Range->Attributes & AttributeAvailableMask)
+        return FALSE;
+
+    /* Shared ranges only conflict with exclusive ones */
+    if ((Flags & RTL_RANGE_SHARED) && (Range->Flags & RTL_RANGE_SHARED))
+        return FALSE;
+
+    /* The callback tells whether the range may be used anyway */
+    if (Callback != NULL)
+        return !Callback(Context, Range);
+
+    return TRUE;
+}
+
+/* Returns the conflicting range with the lowest start */
+static
+PRTL_RANGE_ENTRY
+RtlpFindRangeConflict(IN PRTL_RANGE_ENTRY Node,
+                      IN ULONGLONG Start,
+                      IN ULONGLONG End,
+                      IN ULONG Flags,
+                      IN UCHAR AttributeAvailableMask,
+                      IN PVOID Context OPTIONAL,
+                      IN PRTL_CONFLICT_RANGE_CALLBACK Callback OPTIONAL)
+{
+    PRTL_RANGE_ENTRY Conflict;
+
+    while (Node != NULL && Node->MaxEnd >= Start)
+    {
+        Conflict = RtlpFindRangeConflict(Node->Left,
+                                         Start,
+                                         End,
+                                         Flags,
+                                         AttributeAvailableMask,
+                                         Context,
+                                         Callback);
+        if (Conflict != NULL)
+            return Conflict;
+
+        /* Everything from here on starts after the range */
+        if (Node->Range.Start > End)
+            return NULL;
+
+        if (Node->Range.End >= Start &&
+            RtlpIsRangeConflict(&Node->Range,
+                                Flags,
+                                AttributeAvailableMask,
+                                Context,
+                                Callback))
+        {
+            return Node;
+        }
+
+        Node = Node->Right;
+    }
+
+    return NULL;
+}
+
+static
+NTSTATUS
+RtlpCopyRanges(IN OUT PRTL_RANGE_LIST Destination,
+               IN PRTL_RANGE_LIST RangeList1,
+               IN PRTL_RANGE_LIST RangeList2 OPTIONAL)
+{
+    PLIST_ENTRY Entry1, Entry2, Next;
+    PRTL_RANGE_ENTRY Current1, Current2, Current, NewEntry;
+    BOOLEAN Append;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    /* An empty destination is filled in order and balanced in one go */
+    Append = (Destination->Count == 0);
+
+    Entry1 = RangeList1->ListHead.Flink;
+    Entry2 = (RangeList2 != NULL) ? RangeList2->ListHead.Flink : NULL;
+
+    while (TRUE)
+    {
+        Current1 = (Entry1 != &RangeList1->ListHead) ?
+            CONTAINING_RECORD(Entry1, RTL_RANGE_ENTRY, Entry) : NULL;
+        Current2 = (Entry2 != NULL && Entry2 != &RangeList2->ListHead) ?
+            CONTAINING_RECORD(Entry2, RTL_RANGE_ENTRY, Entry) : NULL;
+
+        if (Current1 != NULL &&
+            (Current2 == NULL || Current1->Range.Start <= Current2->Range.Start))
+        {
+            Current = Current1;
+            Entry1 = Entry1->Flink;
+        }
+        else if (Current2 != NULL)
+        {
+            Current = Current2;
+            Entry2 = Entry2->Flink;
+        }
+        else
+        {
+            break;
+        }
+
+        NewEntry = RtlpAllocateMemory(sizeof(RTL_RANGE_ENTRY), 'elRR');
+        if (NewEntry == NULL)
+        {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+            break;
+        }
+
+        RtlCopyMemory(&NewEntry->Range,
+                      &Current->Range,
+                      sizeof(RTL_RANGE));
+
+        if (Append)
+            InsertTailList(&Destination->ListHead, &NewEntry->Entry);
+        else
+            RtlpInsertRangeEntry(Destination, NewEntry);
+
+        Destination->Count++;
+    }
+
+    if (Append)
+    {
+        Next = Destination->ListHead.Flink;
+        RtlpBuildRangeTree(&Next, Destination->Count);
+    }
+
+    Destination->Stamp++;
+
+    return Status;
+}
+
 /* FUNCTIONS ***************************************************************/
 
 /**********************************************************************
@@ -58,13 +453,22 @@ RtlAddRange(IN OUT PRTL_RANGE_LIST RangeList,
             IN PVOID Owner OPTIONAL)
 {
     PRTL_RANGE_ENTRY RangeEntry;
-    //PRTL_RANGE_ENTRY Previous;
-    PRTL_RANGE_ENTRY Current;
-    PLIST_ENTRY Entry;
+    PRTL_RANGE_ENTRY Conflict;
 
     if (Start > End)
         return STATUS_INVALID_PARAMETER;
 
+    /* Overlapping ranges are only accepted when the caller allows it */
+    Conflict = RtlpFindRangeConflict(RtlpGetRangeRoot(RangeList),
+                                     Start,
+                                     End,
+                                     (Flags & RTL_RANGE_LIST_ADD_SHARED) ? RTL_RANGE_SHARED : 0,
+                                     0,
+                                     NULL,
+                                     NULL);
+    if (Conflict != NULL && !(Flags & RTL_RANGE_LIST_ADD_IF_CONFLICT))
+        return STATUS_RANGE_LIST_CONFLICT;
+
     /* Create new range entry */
     RangeEntry = RtlpAllocateMemory(sizeof(RTL_RANGE_ENTRY), 'elRR');
     if (RangeEntry == NULL)
@@ -80,50 +484,15 @@ RtlAddRange(IN OUT PRTL_RANGE_LIST RangeList,
     RangeEntry->Range.Flags = 0;
     if (Flags & RTL_RANGE_LIST_ADD_SHARED)
         RangeEntry->Range.Flags |= RTL_RANGE_SHARED;
+    if (Conflict != NULL)
+        RangeEntry->Range.Flags |= RTL_RANGE_CONFLICT;
 
     /* Insert range entry */
-    if (RangeList->Count == 0)
-    {
-        InsertTailList(&RangeList->ListHead,
-                       &RangeEntry->Entry);
-        RangeList->Count++;
-        RangeList->Stamp++;
-        return STATUS_SUCCESS;
-    }
-    else
-    {
-         //Previous = NULL;
-        Entry = RangeList->ListHead.Flink;
-        while (Entry != &RangeList->ListHead)
-        {
-            Current = CONTAINING_RECORD(Entry, RTL_RANGE_ENTRY, Entry);
-            if (Current->Range.Start > RangeEntry->Range.End)
-            {
-                /* Insert before current */
-                DPRINT("Insert before current\n");
-                InsertTailList(&Current->Entry,
-                               &RangeEntry->Entry);
-
-                RangeList->Count++;
-                RangeList->Stamp++;
-                return STATUS_SUCCESS;
-            }
+    RtlpInsertRangeEntry(RangeList, RangeEntry);
+    RangeList->Count++;
+    RangeList->Stamp++;
 
-            //Previous = Current;
-            Entry = Entry->Flink;
-        }
-
-        DPRINT("Insert tail\n");
-        InsertTailList(&RangeList->ListHead,
-                       &RangeEntry->Entry);
-        RangeList->Count++;
-        RangeList->Stamp++;
-        return STATUS_SUCCESS;
-    }
-
-    RtlpFreeMemory(RangeEntry, 0);
-
-    return STATUS_UNSUCCESSFUL;
+    return STATUS_SUCCESS;
 }
 
 
@@ -148,36 +517,9 @@ NTAPI
 RtlCopyRangeList(OUT PRTL_RANGE_LIST CopyRangeList,
                  IN PRTL_RANGE_LIST RangeList)
 {
-    PRTL_RANGE_ENTRY Current;
-    PRTL_RANGE_ENTRY NewEntry;
-    PLIST_ENTRY Entry;
-
     CopyRangeList->Flags = RangeList->Flags;
 
-    Entry = RangeList->ListHead.Flink;
-    while (Entry != &RangeList->ListHead)
-    {
-        Current = CONTAINING_RECORD(Entry, RTL_RANGE_ENTRY, Entry);
-
-        NewEntry = RtlpAllocateMemory(sizeof(RTL_RANGE_ENTRY), 'elRR');
-        if (NewEntry == NULL)
-            return STATUS_INSUFFICIENT_RESOURCES;
-
-        RtlCopyMemory(&NewEntry->Range,
-                      &Current->Range,
-                      sizeof(RTL_RANGE));
-
-        InsertTailList(&CopyRangeList->ListHead,
-                       &NewEntry->Entry);
-
-        CopyRangeList->Count++;
-
-        Entry = Entry->Flink;
-    }
-
-    CopyRangeList->Stamp++;
-
-    return STATUS_SUCCESS;
+    return RtlpCopyRanges(CopyRangeList, RangeList, NULL);
 }
 
 
@@ -210,16 +552,16 @@ RtlDeleteOwnersRanges(IN OUT PRTL_RANGE_LIST RangeList,
     while (Entry != &RangeList->ListHead)
     {
         Current = CONTAINING_RECORD(Entry, RTL_RANGE_ENTRY, Entry);
+        Entry = Entry->Flink;
+
         if (Current->Range.Owner == Owner)
         {
-            RemoveEntryList (Entry);
+            RtlpRemoveRangeEntry(Current);
             RtlpFreeMemory(Current, 0);
 
             RangeList->Count--;
             RangeList->Stamp++;
         }
-
-        Entry = Entry->Flink;
     }
 
     return STATUS_SUCCESS;
@@ -251,18 +593,40 @@ RtlDeleteRange(IN OUT PRTL_RANGE_LIST RangeList,
                IN ULONGLONG End,
                IN PVOID Owner)
 {
-    PRTL_RANGE_ENTRY Current;
+    PRTL_RANGE_ENTRY Current, First;
     PLIST_ENTRY Entry;
 
-    Entry = RangeList->ListHead.Flink;
+    /* Find the first range with this start */
+    First = NULL;
+    Current = RtlpGetRangeRoot(RangeList);
+    while (Current != NULL)
+    {
+        if (Current->Range.Start < Start)
+        {
+            Current = Current->Right;
+        }
+        else
+        {
+            if (Current->Range.Start == Start)
+                First = Current;
+            Current = Current->Left;
+        }
+    }
+
+    if (First == NULL)
+        return STATUS_RANGE_NOT_FOUND;
+
+    Entry = &First->Entry;
     while (Entry != &RangeList->ListHead)
     {
         Current = CONTAINING_RECORD(Entry, RTL_RANGE_ENTRY, Entry);
-        if (Current->Range.Start == Start &&
-            Current->Range.End == End &&
+        if (Current->Range.Start != Start)
+            break;
+
+        if (Current->Range.End == End &&
             Current->Range.Owner == Owner)
         {
-            RemoveEntryList(Entry);
+            RtlpRemoveRangeEntry(Current);
 
             RtlpFreeMemory(Current, 0);
 
@@ -300,9 +664,6 @@ RtlDeleteRange(IN OUT PRTL_RANGE_LIST RangeList,
  * RETURN VALUE
  *	Status
  *
- * TODO
- *	Support shared ranges and callback.
- *
  * @implemented
  */
 NTSTATUS
@@ -318,9 +679,8 @@ RtlFindRange(IN PRTL_RANGE_LIST RangeList,
              IN PRTL_CONFLICT_RANGE_CALLBACK Callback OPTIONAL,
              OUT PULONGLONG Start)
 {
-    PRTL_RANGE_ENTRY CurrentEntry;
-    PRTL_RANGE_ENTRY NextEntry;
-    PLIST_ENTRY Entry;
+    PRTL_RANGE_ENTRY Root;
+    PRTL_RANGE_ENTRY Conflict;
     ULONGLONG RangeMin;
     ULONGLONG RangeMax;
 
@@ -329,27 +689,21 @@ RtlFindRange(IN PRTL_RANGE_LIST RangeList,
         return STATUS_INVALID_PARAMETER;
     }
 
-    if (IsListEmpty(&RangeList->ListHead))
-    {
-        *Start = ROUND_DOWN(Maximum - (Length - 1), Alignment);
-        return STATUS_SUCCESS;
-    }
+    Root = RtlpGetRangeRoot(RangeList);
 
-    NextEntry = NULL;
-    Entry = RangeList->ListHead.Blink;
-    while (Entry != &RangeList->ListHead)
+    /* Try the highest fitting position below each conflict in turn */
+    RangeMax = Maximum;
+    while (TRUE)
     {
-        CurrentEntry = CONTAINING_RECORD(Entry, RTL_RANGE_ENTRY, Entry);
-
-        RangeMax = NextEntry ? (NextEntry->Range.Start - 1) : Maximum;
-        if (RangeMax + (Length - 1) < Minimum)
+        if (RangeMax < Minimum ||
+            (RangeMax - Minimum) < (Length - 1))
         {
             return STATUS_RANGE_NOT_FOUND;
         }
 
-        RangeMin = ROUND_DOWN(RangeMax - (Length - 1), Alignment);
-        if (RangeMin < Minimum ||
-            (RangeMax - RangeMin) < (Length - 1))
+        RangeMin = RangeMax - (Length - 1);
+        RangeMin -= RangeMin % Alignment;
+        if (RangeMin < Minimum)
         {
             return STATUS_RANGE_NOT_FOUND;
         }
@@ -357,35 +711,26 @@ RtlFindRange(IN PRTL_RANGE_LIST RangeList,
         DPRINT("RangeMax: %I64x\n", RangeMax);
         DPRINT("RangeMin: %I64x\n", RangeMin);
 
-        if (RangeMin > CurrentEntry->Range.End)
+        Conflict = RtlpFindRangeConflict(Root,
+                                         RangeMin,
+                                         RangeMin + (Length - 1),
+                                         Flags,
+                                         AttributeAvailableMask,
+                                         Context,
+                                         Callback);
+        if (Conflict == NULL)
         {
             *Start = RangeMin;
             return STATUS_SUCCESS;
         }
 
-        NextEntry = CurrentEntry;
-        Entry = Entry->Blink;
-    }
+        if (Conflict->Range.Start == 0)
+        {
+            return STATUS_RANGE_NOT_FOUND;
+        }
 
-    RangeMax = NextEntry ? (NextEntry->Range.Start - 1) : Maximum;
-    if (RangeMax + (Length - 1) < Minimum)
-    {
-        return STATUS_RANGE_NOT_FOUND;
+        RangeMax = Conflict->Range.Start - 1;
     }
-
-    RangeMin = ROUND_DOWN(RangeMax - (Length - 1), Alignment);
-    if (RangeMin < Minimum ||
-        (RangeMax - RangeMin) < (Length - 1))
-    {
-        return STATUS_RANGE_NOT_FOUND;
-    }
-
-    DPRINT("RangeMax: %I64x\n", RangeMax);
-    DPRINT("RangeMin: %I64x\n", RangeMin);
-
-    *Start = RangeMin;
-
-    return STATUS_SUCCESS;
 }
 
 
@@ -657,9 +1002,6 @@ RtlInvertRangeList(OUT PRTL_RANGE_LIST InvertedRangeList,
  * RETURN VALUE
  *	Status
  *
- * TODO:
- *   - honor Flags and AttributeAvailableMask.
- *
  * @implemented
  */
 NTSTATUS
@@ -673,34 +1015,13 @@ RtlIsRangeAvailable(IN PRTL_RANGE_LIST RangeList,
                     IN PRTL_CONFLICT_RANGE_CALLBACK Callback OPTIONAL,
                     OUT PBOOLEAN Available)
 {
-    PRTL_RANGE_ENTRY Current;
-    PLIST_ENTRY Entry;
-
-    *Available = TRUE;
-
-    Entry = RangeList->ListHead.Flink;
-    while (Entry != &RangeList->ListHead)
-    {
-        Current = CONTAINING_RECORD (Entry, RTL_RANGE_ENTRY, Entry);
-
-        if (!((Current->Range.Start >= End && Current->Range.End > End) ||
-              (Current->Range.Start <= Start && Current->Range.End < Start &&
-               (!(Flags & RTL_RANGE_SHARED) ||
-                !(Current->Range.Flags & RTL_RANGE_SHARED)))))
-        {
-            if (Callback != NULL)
-            {
-                *Available = Callback(Context,
-                                      &Current->Range);
-            }
-            else
-            {
-                *Available = FALSE;
-            }
-        }
-
-        Entry = Entry->Flink;
-    }
+    *Available = (RtlpFindRangeConflict(RtlpGetRangeRoot(RangeList),
+                                        Start,
+                                        End,
+                                        Flags,
+                                        AttributeAvailableMask,
+                                        Context,
+                                        Callback) == NULL);
 
     return STATUS_SUCCESS;
 }
@@ -731,43 +1052,37 @@ RtlMergeRangeLists(OUT PRTL_RANGE_LIST MergedRangeList,
                    IN PRTL_RANGE_LIST RangeList2,
                    IN ULONG Flags)
 {
-    RTL_RANGE_LIST_ITERATOR Iterator;
-    PRTL_RANGE Range;
-    NTSTATUS Status;
-
-    /* Copy range list 1 to the merged range list */
-    Status = RtlCopyRangeList(MergedRangeList,
-                              RangeList1);
-    if (!NT_SUCCESS(Status))
-        return Status;
-
-    /* Add range list 2 entries to the merged range list */
-    Status = RtlGetFirstRange(RangeList2,
-                              &Iterator,
-                              &Range);
-    if (!NT_SUCCESS(Status))
-        return (Status == STATUS_NO_MORE_ENTRIES) ? STATUS_SUCCESS : Status;
+    PLIST_ENTRY Entry;
+    PRTL_RANGE_ENTRY Current;
 
-    while (TRUE)
+    /* Fail before copying anything if the lists overlap */
+    if (!(Flags & RTL_RANGE_LIST_MERGE_IF_CONFLICT))
     {
-        Status = RtlAddRange(MergedRangeList,
-                             Range->Start,
-                             Range->End,
-                             Range->Attributes,
-                             Range->Flags | Flags,
-                             Range->UserData,
-                             Range->Owner);
-        if (!NT_SUCCESS(Status))
-            break;
+        Entry = RangeList2->ListHead.Flink;
+        while (Entry != &RangeList2->ListHead)
+        {
+            Current = CONTAINING_RECORD(Entry, RTL_RANGE_ENTRY, Entry);
+            if (RtlpFindRangeConflict(RtlpGetRangeRoot(RangeList1),
+                                      Current->Range.Start,
+                                      Current->Range.End,
+                                      Current->Range.Flags & RTL_RANGE_SHARED,
+                                      0,
+                                      NULL,
+                                      NULL) != NULL)
+            {
+                return STATUS_RANGE_LIST_CONFLICT;
+            }
 
-        Status = RtlGetNextRange(&Iterator,
-                                 &Range,
-                                 TRUE);
-        if (!NT_SUCCESS(Status))
-            break;
+            Entry = Entry->Flink;
+        }
     }
 
-    return (Status == STATUS_NO_MORE_ENTRIES) ? STATUS_SUCCESS : Status;
+    MergedRangeList->Flags = RangeList1->Flags;
+
+    /* Both lists are sorted, so merge them in one pass */
+    return RtlpCopyRanges(MergedRangeList,
+                          RangeList1,
+                          RangeList2);
 }
 
 /* EOF */
@@ -105,6 +105,12 @@ CCabinet::CCabinet()
     BytesLeftInBlock = 0;
     ReuseBlock       = false;
     CurrentDataNode  = NULL;
+
+#ifndef CAB_READ_ONLY
+    TotalUncompBytes = 0;
+    TotalCompBytes   = 0;
+    CompressTime     = 0;
+#endif /* CAB_READ_ONLY */
 }
 
 
@@ -1837,6 +1843,23 @@ void CCabinet::SetMaxDiskSize(ULONG Size)
     MaxDiskSize = Size;
 }
 
+
+void CCabinet::GetCompressionStatistics(ULONGLONG* UncompSize,
+                                        ULONGLONG* CompSize,
+                                        double* Seconds)
+/*
+ * FUNCTION: Returns the totals for the blocks compressed so far
+ * ARGUMENTS:
+ *     UncompSize = Address of buffer to place the number of bytes compressed
+ *     CompSize   = Address of buffer to place the number of bytes produced
+ *     Seconds    = Address of buffer to place the processor time spent compressing
+ */
+{
+    *UncompSize = TotalUncompBytes;
+    *CompSize   = TotalCompBytes;
+    *Seconds    = (double)CompressTime / CLOCKS_PER_SEC;
+}
+
 #endif /* CAB_READ_ONLY */
 
 
@@ -2986,11 +3009,17 @@ ULONG CCabinet::WriteDataBlock()
 
     if (!BlockIsSplit)
     {
+        clock_t Start = clock();
+
         Status = Codec->Compress(OutputBuffer,
             InputBuffer,
             CurrentIBufferSize,
             &TotalCompSize);
 
+        CompressTime     += clock() - Start;
+        TotalUncompBytes += CurrentIBufferSize;
+        TotalCompBytes   += TotalCompSize;
+
         DPRINT(MAX_TRACE, ("Block compressed. CurrentIBufferSize (%u)  TotalCompSize(%u).\n",
             (UINT)CurrentIBufferSize, (UINT)TotalCompSize));
 
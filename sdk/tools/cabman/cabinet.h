@@ -395,6 +395,8 @@ public:
     ULONG AddFile(char* FileName);
     /* Sets the maximum size of the current disk */
     void SetMaxDiskSize(ULONG Size);
+    /* Returns how much data was compressed, into how much, and how long it took */
+    void GetCompressionStatistics(ULONGLONG* UncompSize, ULONGLONG* CompSize, double* Seconds);
 #endif /* CAB_READ_ONLY */
 
     /* Default event handlers */
@@ -503,6 +505,9 @@ private:
     ULONG TotalBytesLeft;
     bool BlockIsSplit;                  // true if current data block is split
     ULONG NextFolderNumber;     // Zero based folder number
+    ULONGLONG TotalUncompBytes; // Bytes given to the codec
+    ULONGLONG TotalCompBytes;   // Bytes produced by the codec
+    clock_t CompressTime;       // Time spent in the codec
 #endif /* CAB_READ_ONLY */
 };
 
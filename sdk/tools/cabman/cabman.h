@@ -31,6 +31,7 @@ private:
     bool CreateCabinet();
     bool DisplayCabinet();
     bool ExtractFromCabinet();
+    void PrintCompressionStatistics();
     /* Event handlers */
     virtual bool OnOverwrite(PCFFILE File, char* FileName);
     virtual void OnExtract(PCFFILE File, char* FileName);
@@ -568,7 +568,11 @@ bool CCABManager::Run()
     switch (Mode)
     {
         case CM_MODE_CREATE:
-            return CreateCabinet();
+        {
+            bool Result = CreateCabinet();
+            PrintCompressionStatistics();
+            return Result;
+        }
 
         case CM_MODE_DISPLAY:
             return DisplayCabinet();
@@ -577,7 +581,11 @@ bool CCABManager::Run()
             return ExtractFromCabinet();
 
         case CM_MODE_CREATE_SIMPLE:
-            return CreateSimpleCabinet();
+        {
+            bool Result = CreateSimpleCabinet();
+            PrintCompressionStatistics();
+            return Result;
+        }
 
         default:
             break;
@@ -586,6 +594,31 @@ bool CCABManager::Run()
 }
 
 
+void CCABManager::PrintCompressionStatistics()
+/*
+ * FUNCTION: Prints the compression ratio and throughput in verbose mode
+ */
+{
+    ULONGLONG UncompSize, CompSize;
+    double Seconds;
+
+    if (!Verbose)
+        return;
+
+    GetCompressionStatistics(&UncompSize, &CompSize, &Seconds);
+    if (UncompSize == 0)
+        return;
+
+    printf("\nCompressed %llu bytes to %llu bytes (%.1f%%)",
+           (unsigned long long)UncompSize,
+           (unsigned long long)CompSize,
+           100.0 * CompSize / UncompSize);
+    if (Seconds > 0)
+        printf(" in %.2f s, %.1f MB/s", Seconds, UncompSize / Seconds / (1024 * 1024));
+    printf("\n");
+}
+
+
 /* Event handlers */
 
 bool CCABManager::OnOverwrite(PCFFILE File,
@@ -34,7 +34,11 @@ public:
                              PULONG OutputLength);
 private:
     int Status;
-    z_stream ZStream; /* Zlib stream */
+    /* Zlib streams, set up on first use and reset for each block */
+    z_stream DeflateStream;
+    z_stream InflateStream;
+    bool DeflateInitialized;
+    bool InflateInitialized;
 };
 
 /* EOF */
@@ -502,6 +502,166 @@ CreateSetSinglePixel(FILE *Out, unsigned Bpp, PROPINFO RopInfo, int Flags,
     Output(Out, "DestPtr = (PULONG)((char *) DestPtr + %u);\n", Bpp / 8);
 }
 
+static void
+CreateWideOperation(FILE *Out, unsigned Bpp, PROPINFO RopInfo, unsigned Bits,
+                    unsigned Index)
+{
+    const char *Cast;
+    const char *Ptr;
+    const char *Template;
+    char Dest[32];
+    char Source[32];
+
+    MARK(Out);
+    if (32 == Bits)
+    {
+        Cast = "";
+        Ptr = "";
+    }
+    else if (16 == Bpp)
+    {
+        Cast = "(USHORT) ";
+        Ptr = "(PUSHORT) ";
+    }
+    else
+    {
+        Cast = "(UCHAR) ";
+        Ptr = "(PUCHAR) ";
+    }
+    sprintf(Dest, "((%sDestPtr)[%u])", Ptr, Index);
+    sprintf(Source, "((%sSourcePtr)[%u])", Ptr, Index);
+    Output(Out, "%s = ", Dest);
+    Template = RopInfo->Operation;
+    while ('\0' != *Template)
+    {
+        switch(*Template)
+        {
+        case 'S':
+            Output(Out, "%s", Source);
+            break;
+        case 'P':
+            Output(Out, "%sPattern", Cast);
+            break;
+        case 'D':
+            Output(Out, "%s", Dest);
+            break;
+        default:
+            Output(Out, "%c", *Template);
+            break;
+        }
+        Template++;
+    }
+    Output(Out, ";\n");
+}
+
+/*
+ * When source and destination have the same format, no translation is needed
+ * and both start at the same offset within a 32 bit word, the source words can
+ * be combined with the destination words directly, instead of being assembled
+ * pixel by pixel using the shift tables. The center part is unrolled to
+ * process 4 words (16 bytes) per iteration.
+ */
+static int
+CanCreateWideBitCase(unsigned Bpp, PROPINFO RopInfo, int Flags,
+                     unsigned SourceBpp)
+{
+    return ROPCODE_GENERIC != RopInfo->RopCode &&
+           ROPCODE_SRCCOPY != RopInfo->RopCode &&
+           RopInfo->UsesSource &&
+           0 == (Flags & FLAG_FORCENOUSESSOURCE) &&
+           0 != (Flags & FLAG_TRIVIALXLATE) &&
+           0 == (Flags & FLAG_PATTERNSURFACE) &&
+           Bpp == SourceBpp && Bpp < 32;
+}
+
+static void
+CreateWideBitCase(FILE *Out, unsigned Bpp, PROPINFO RopInfo, int Flags)
+{
+    unsigned Unroll;
+
+    MARK(Out);
+    Output(Out, "SourceBase = (char *) BltInfo->SourceSurface->pvScan0 +\n");
+    if (0 == (Flags & FLAG_BOTTOMUP))
+    {
+        Output(Out, "             BltInfo->SourcePoint.y *\n");
+    }
+    else
+    {
+        Output(Out, "             (BltInfo->SourcePoint.y +\n");
+        Output(Out, "              BltInfo->DestRect.bottom -\n");
+        Output(Out, "              BltInfo->DestRect.top - 1) *\n");
+    }
+    Output(Out, "             BltInfo->SourceSurface->lDelta +\n");
+    if (8 < Bpp)
+    {
+        Output(Out, "             BltInfo->SourcePoint.x * %u;\n", Bpp / 8);
+    }
+    else
+    {
+        Output(Out, "             BltInfo->SourcePoint.x;\n");
+    }
+    CreateBase(Out, 0, Flags, Bpp);
+    Output(Out, "if (((ULONG_PTR) SourceBase & 0x3) == ((ULONG_PTR) DestBase & 0x3) &&\n");
+    Output(Out, "    0 == ((BltInfo->SourceSurface->lDelta |\n");
+    Output(Out, "           BltInfo->DestSurface->lDelta) & 0x3))\n");
+    Output(Out, "{\n");
+    Output(Out, "LeftCount = ((0 - (ULONG_PTR) DestBase) & 0x3)%s;\n",
+           8 < Bpp ? " >> 1" : "");
+    Output(Out, "if ((ULONG)(BltInfo->DestRect.right - BltInfo->DestRect.left) < "
+           "LeftCount)\n");
+    Output(Out, "{\n");
+    Output(Out, "LeftCount = BltInfo->DestRect.right - BltInfo->DestRect.left;\n");
+    Output(Out, "}\n");
+    Output(Out, "CenterCount = (BltInfo->DestRect.right - BltInfo->DestRect.left -\n");
+    Output(Out, "               LeftCount) / %u;\n", 32 / Bpp);
+    Output(Out, "RightCount = (BltInfo->DestRect.right - BltInfo->DestRect.left -\n");
+    Output(Out, "              LeftCount - %u * CenterCount);\n", 32 / Bpp);
+    MARK(Out);
+    Output(Out, "for (LineIndex = 0; LineIndex < LineCount; LineIndex++)\n");
+    Output(Out, "{\n");
+    Output(Out, "SourcePtr = (PULONG) SourceBase;\n");
+    Output(Out, "DestPtr = (PULONG) DestBase;\n");
+    Output(Out, "\n");
+    Output(Out, "for (i = 0; i < LeftCount; i++)\n");
+    Output(Out, "{\n");
+    CreateWideOperation(Out, Bpp, RopInfo, Bpp, 0);
+    Output(Out, "SourcePtr = (PULONG)((char *) SourcePtr + %u);\n", Bpp / 8);
+    Output(Out, "DestPtr = (PULONG)((char *) DestPtr + %u);\n", Bpp / 8);
+    Output(Out, "}\n");
+    Output(Out, "\n");
+    Output(Out, "for (i = 4; i <= CenterCount; i += 4)\n");
+    Output(Out, "{\n");
+    for (Unroll = 0; Unroll < 4; Unroll++)
+    {
+        CreateWideOperation(Out, Bpp, RopInfo, 32, Unroll);
+    }
+    Output(Out, "SourcePtr += 4;\n");
+    Output(Out, "DestPtr += 4;\n");
+    Output(Out, "}\n");
+    Output(Out, "for (i -= 4; i < CenterCount; i++)\n");
+    Output(Out, "{\n");
+    CreateWideOperation(Out, Bpp, RopInfo, 32, 0);
+    Output(Out, "SourcePtr++;\n");
+    Output(Out, "DestPtr++;\n");
+    Output(Out, "}\n");
+    Output(Out, "\n");
+    Output(Out, "for (i = 0; i < RightCount; i++)\n");
+    Output(Out, "{\n");
+    CreateWideOperation(Out, Bpp, RopInfo, Bpp, 0);
+    Output(Out, "SourcePtr = (PULONG)((char *) SourcePtr + %u);\n", Bpp / 8);
+    Output(Out, "DestPtr = (PULONG)((char *) DestPtr + %u);\n", Bpp / 8);
+    Output(Out, "}\n");
+    Output(Out, "\n");
+    Output(Out, "SourceBase %c= BltInfo->SourceSurface->lDelta;\n",
+           0 == (Flags & FLAG_BOTTOMUP) ? '+' : '-');
+    Output(Out, "DestBase %c= BltInfo->DestSurface->lDelta;\n",
+           0 == (Flags & FLAG_BOTTOMUP) ? '+' : '-');
+    Output(Out, "}\n");
+    Output(Out, "return;\n");
+    Output(Out, "}\n");
+    Output(Out, "\n");
+}
+
 static void
 CreateBitCase(FILE *Out, unsigned Bpp, PROPINFO RopInfo, int Flags,
               unsigned SourceBpp)
@@ -509,6 +669,10 @@ CreateBitCase(FILE *Out, unsigned Bpp, PROPINFO RopInfo, int Flags,
     unsigned Partial;
 
     MARK(Out);
+    if (CanCreateWideBitCase(Bpp, RopInfo, Flags, SourceBpp))
+    {
+        CreateWideBitCase(Out, Bpp, RopInfo, Flags);
+    }
     if (RopInfo->UsesSource)
     {
         if (0 == (Flags & FLAG_FORCENOUSESSOURCE))
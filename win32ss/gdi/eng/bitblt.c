@@ -558,6 +558,7 @@ EngBitBlt(
                 Direction = CD_ANY;
             }
             CLIPOBJ_cEnumStart(pco, FALSE, CT_RECTANGLES, Direction, 0);
+            IntEngClipEnumBounds(pco, &OutputRect);
             do
             {
                 EnumMore = CLIPOBJ_bEnum(pco, sizeof(RectEnum),
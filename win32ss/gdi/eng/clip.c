@@ -333,6 +333,7 @@ CLIPOBJ_bEnum(
 
     if(nCopy == 0)
     {
+        pERects->c = 0;
         return FALSE;
     }
 
@@ -344,7 +345,62 @@ CLIPOBJ_bEnum(
 
     Clip->EnumPos+=nCopy;
 
-    return Clip->EnumPos < Clip->RectCount;
+    return Clip->EnumPos < min(Clip->EnumMax, Clip->RectCount);
+}
+
+/*
+ * Restricts an enumeration started by CLIPOBJ_cEnumStart to the bands of the
+ * clip region which may intersect prclBounds. The rectangles are y-x banded,
+ * sorted either top-down (CD_ANY, CD_RIGHTDOWN, CD_LEFTDOWN) or bottom-up
+ * (CD_RIGHTUP, CD_LEFTUP), so the first and last band of interest can be
+ * found by binary search instead of enumerating the whole region.
+ */
+VOID
+FASTCALL
+IntEngClipEnumBounds(
+    _Inout_ CLIPOBJ *pco,
+    _In_ const RECTL *prclBounds)
+{
+    XCLIPOBJ* Clip = (XCLIPOBJ *)pco;
+    const RECTL* Rects = Clip->Rects;
+    ULONG Low, High, Mid, First;
+    BOOL TopDown;
+
+    if (Clip->RectCount <= 1 || Clip->EnumPos != 0)
+    {
+        return;
+    }
+
+    TopDown = (Clip->iDirection != CD_RIGHTUP && Clip->iDirection != CD_LEFTUP);
+
+    /* Find the first rectangle which is not entirely before the bounds */
+    Low = 0;
+    High = Clip->RectCount;
+    while (Low < High)
+    {
+        Mid = Low + (High - Low) / 2;
+        if (TopDown ? (Rects[Mid].bottom <= prclBounds->top) :
+                      (Rects[Mid].top >= prclBounds->bottom))
+            Low = Mid + 1;
+        else
+            High = Mid;
+    }
+    First = Low;
+
+    /* Find the first rectangle which is entirely after the bounds */
+    High = Clip->RectCount;
+    while (Low < High)
+    {
+        Mid = Low + (High - Low) / 2;
+        if (TopDown ? (Rects[Mid].top < prclBounds->bottom) :
+                      (Rects[Mid].bottom > prclBounds->top))
+            Low = Mid + 1;
+        else
+            High = Mid;
+    }
+
+    Clip->EnumMax = min(Clip->EnumMax, Low);
+    Clip->EnumPos = min(First, Clip->EnumMax);
 }
 
 /* EOF */
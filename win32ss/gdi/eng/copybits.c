@@ -132,6 +132,7 @@ EngCopyBits(
         case DC_COMPLEX:
 
             CLIPOBJ_cEnumStart(Clip, FALSE, CT_RECTANGLES, CD_ANY, 0);
+            IntEngClipEnumBounds(Clip, DestRect);
 
             do
             {
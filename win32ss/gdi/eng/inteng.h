@@ -127,6 +127,10 @@ IntEngInitClipObj(XCLIPOBJ *Clip);
 VOID FASTCALL
 IntEngFreeClipResources(XCLIPOBJ *Clip);
 
+VOID FASTCALL
+IntEngClipEnumBounds(CLIPOBJ *pco,
+                     const RECTL *prclBounds);
+
 
 BOOL FASTCALL
 IntEngTransparentBlt(SURFOBJ *Dest,
@@ -2556,6 +2556,98 @@ IntGdiGetRgnBox(
 }
 
 
+/*
+ * Band lookup helpers. Since the rectangles are y-x banded, the bottom
+ * coordinates are non-decreasing over the whole buffer and the left
+ * coordinates are increasing within a band, so the band containing a given
+ * scanline and the rectangle containing a given x coordinate within a band
+ * can be found by binary search.
+ */
+
+/* Returns the first rectangle of the first band with bottom > Y */
+static
+PRECTL
+REGION_pFindBand(
+    _In_ PRECTL pFirst,
+    _In_ PRECTL pEnd,
+    _In_ LONG Y)
+{
+    ULONG_PTR cRects = pEnd - pFirst;
+    ULONG_PTR cHalf;
+
+    while (cRects > 0)
+    {
+        cHalf = cRects / 2;
+        if (pFirst[cHalf].bottom <= Y)
+        {
+            pFirst += cHalf + 1;
+            cRects -= cHalf + 1;
+        }
+        else
+        {
+            cRects = cHalf;
+        }
+    }
+
+    return pFirst;
+}
+
+/* Returns the end of the band starting at pBand */
+static
+PRECTL
+REGION_pFindBandEnd(
+    _In_ PRECTL pBand,
+    _In_ PRECTL pEnd)
+{
+    ULONG_PTR cRects = pEnd - pBand;
+    ULONG_PTR cHalf;
+    LONG Top = pBand->top;
+
+    while (cRects > 0)
+    {
+        cHalf = cRects / 2;
+        if (pBand[cHalf].top == Top)
+        {
+            pBand += cHalf + 1;
+            cRects -= cHalf + 1;
+        }
+        else
+        {
+            cRects = cHalf;
+        }
+    }
+
+    return pBand;
+}
+
+/* Returns the first rectangle in the band with right > X */
+static
+PRECTL
+REGION_pFindInBand(
+    _In_ PRECTL pFirst,
+    _In_ PRECTL pBandEnd,
+    _In_ LONG X)
+{
+    ULONG_PTR cRects = pBandEnd - pFirst;
+    ULONG_PTR cHalf;
+
+    while (cRects > 0)
+    {
+        cHalf = cRects / 2;
+        if (pFirst[cHalf].right <= X)
+        {
+            pFirst += cHalf + 1;
+            cRects -= cHalf + 1;
+        }
+        else
+        {
+            cRects = cHalf;
+        }
+    }
+
+    return pFirst;
+}
+
 BOOL
 FASTCALL
 REGION_PtInRegion(
@@ -2563,17 +2655,19 @@ REGION_PtInRegion(
     INT X,
     INT Y)
 {
-    ULONG i;
-    PRECT r;
+    PRECTL pBand, pBandEnd, pRectEnd, pCurRect;
 
     if (prgn->rdh.nCount > 0 && INRECT(prgn->rdh.rcBound, X, Y))
     {
-        r =  prgn->Buffer;
-        for (i = 0; i < prgn->rdh.nCount; i++)
-        {
-            if (INRECT(r[i], X, Y))
-                return TRUE;
-        }
+        pRectEnd = prgn->Buffer + prgn->rdh.nCount;
+        pBand = REGION_pFindBand(prgn->Buffer, pRectEnd, Y);
+        if ((pBand == pRectEnd) || (pBand->top > Y))
+            return FALSE;
+
+        pBandEnd = REGION_pFindBandEnd(pBand, pRectEnd);
+        pCurRect = REGION_pFindInBand(pBand, pBandEnd, X);
+        if ((pCurRect < pBandEnd) && (pCurRect->left <= X))
+            return TRUE;
     }
 
     return FALSE;
@@ -2585,7 +2679,7 @@ REGION_RectInRegion(
     PREGION Rgn,
     const RECTL *rect)
 {
-    PRECTL pCurRect, pRectEnd;
+    PRECTL pBand, pBandEnd, pRectEnd, pCurRect;
     RECT rc;
 
     /* Swap the coordinates to make right >= left and bottom >= top */
@@ -2615,24 +2709,17 @@ REGION_RectInRegion(
     /* This is (just) a useful optimization */
     if ((Rgn->rdh.nCount > 0) && EXTENTCHECK(&Rgn->rdh.rcBound, &rc))
     {
-        for (pCurRect = Rgn->Buffer, pRectEnd = pCurRect +
-                                                Rgn->rdh.nCount; pCurRect < pRectEnd; pCurRect++)
-        {
-            if (pCurRect->bottom <= rc.top)
-                continue;             /* Not far enough down yet */
-
-            if (pCurRect->top >= rc.bottom)
-                break;                /* Too far down */
-
-            if (pCurRect->right <= rc.left)
-                continue;              /* Not far enough over yet */
+        pRectEnd = Rgn->Buffer + Rgn->rdh.nCount;
 
-            if (pCurRect->left >= rc.right)
-            {
-                continue;
-            }
-
-            return TRUE;
+        /* Skip the bands above the rectangle, then check each band it spans */
+        for (pBand = REGION_pFindBand(Rgn->Buffer, pRectEnd, rc.top);
+             (pBand < pRectEnd) && (pBand->top < rc.bottom);
+             pBand = pBandEnd)
+        {
+            pBandEnd = REGION_pFindBandEnd(pBand, pRectEnd);
+            pCurRect = REGION_pFindInBand(pBand, pBandEnd, rc.left);
+            if ((pCurRect < pBandEnd) && (pCurRect->left < rc.right))
+                return TRUE;
         }
     }
 
@@ -971,13 +971,26 @@ UpdateSelection(PGUI_CONSOLE_DATA GuiData,
 static VOID
 OnPaint(PGUI_CONSOLE_DATA GuiData)
 {
-    PCONSOLE_SCREEN_BUFFER ActiveBuffer = GuiData->ActiveBuffer;
+    PCONSRV_CONSOLE Console = GuiData->Console;
+    PCONSOLE_SCREEN_BUFFER ActiveBuffer;
     PAINTSTRUCT ps;
     RECT rcPaint;
+    BOOL Locked;
 
     /* Do nothing if the window is hidden */
     if (!GuiData->IsWindowVisible) return;
 
+    /*
+     * Apply the scrolling still pending from GuiWriteStream before painting,
+     * and keep the console locked until the buffer is painted: the pending
+     * scroll moves what is on screen, so it must never be applied after the
+     * current buffer contents have been painted.
+     */
+    Locked = ConDrvValidateConsoleUnsafe((PCONSOLE)Console, CONSOLE_RUNNING, TRUE);
+    if (Locked) FlushPendingUpdate(GuiData);
+
+    ActiveBuffer = GuiData->ActiveBuffer;
+
     BeginPaint(GuiData->hWindow, &ps);
     if (ps.hdc != NULL &&
         ps.rcPaint.left < ps.rcPaint.right &&
@@ -1018,6 +1031,8 @@ OnPaint(PGUI_CONSOLE_DATA GuiData)
     }
     EndPaint(GuiData->hWindow, &ps);
 
+    if (Locked) LeaveCriticalSection(&Console->Lock);
+
     return;
 }
 
@@ -1250,6 +1265,7 @@ OnTimer(PGUI_CONSOLE_DATA GuiData)
 
     if (GetType(Buff) == TEXTMODE_BUFFER)
     {
+        FlushPendingUpdate(GuiData);
         InvalidateCell(GuiData, Buff->CursorPosition.X, Buff->CursorPosition.Y);
         Buff->CursorBlinkOn = !Buff->CursorBlinkOn;
 
@@ -1400,6 +1416,9 @@ OnScroll(PGUI_CONSOLE_DATA GuiData, INT nBar, WORD sbCode)
 
     if (!ConDrvValidateConsoleUnsafe((PCONSOLE)Console, CONSOLE_RUNNING, TRUE)) return;
 
+    /* The view is scrolled below, so the window must show the buffer first */
+    FlushPendingUpdate(GuiData);
+
     Buff = GuiData->ActiveBuffer;
 
     if (nBar == SB_HORZ)
@@ -53,6 +53,14 @@ typedef struct _GUI_CONSOLE_DATA
 
     POINT OldCursor;
 
+    /*
+     * Screen updates accumulated by GuiWriteStream and flushed at once by the
+     * update timer. Protected by the console lock.
+     */
+    BOOL UpdatePending;
+    UINT PendingScroll;         /* Number of lines the window contents must be scrolled up */
+    SMALL_RECT PendingRegion;   /* Cells that must be repainted after scrolling */
+
     LONG_PTR WndStyle;
     LONG_PTR WndStyleEx;
     BOOL IsWndMax;
@@ -19,9 +19,9 @@
 #include "guiterm.h"
 #include "resource.h"
 
-// HACK!! Remove it when the hack in GuiWriteStream is fixed
-#define CONGUI_UPDATE_TIME    0
 #define CONGUI_UPDATE_TIMER   1
+/* Console output is painted at most once per frame (about 60 Hz) */
+#define CONGUI_FRAME_TIME     16
 
 #define PM_CREATE_CONSOLE     (WM_APP + 1)
 #define PM_DESTROY_CONSOLE    (WM_APP + 2)
@@ -71,12 +71,61 @@ GuiConsoleMoveWindow(PGUI_CONSOLE_DATA GuiData)
     }
 }
 
+/*
+ * Applies the scrolling and repainting accumulated by GuiWriteStream. Must be
+ * called before anything else invalidates or paints the window, since the
+ * pending scroll moves what is currently on screen.
+ */
+VOID
+FlushPendingUpdate(PGUI_CONSOLE_DATA GuiData)
+{
+    PCONSOLE_SCREEN_BUFFER Buff = GuiData->ActiveBuffer;
+    RECT RegionRect;
+
+    /* This function supposes that the console lock is held */
+
+    if (!GuiData->UpdatePending) return;
+    GuiData->UpdatePending = FALSE;
+
+    if (GuiData->PendingScroll != 0)
+    {
+        if (GuiData->PendingScroll >= (UINT)Buff->ViewSize.Y)
+        {
+            /* Everything visible has changed */
+            InvalidateRect(GuiData->hWindow, NULL, FALSE);
+        }
+        else
+        {
+            /* Move what is still valid on screen instead of repainting it */
+            ScrollWindowEx(GuiData->hWindow,
+                           0,
+                           -(int)(GuiData->PendingScroll * GuiData->CharHeight),
+                           NULL,
+                           NULL,
+                           NULL,
+                           NULL,
+                           SW_INVALIDATE);
+        }
+        GuiData->PendingScroll = 0;
+    }
+
+    if (!ConioIsRectEmpty(&GuiData->PendingRegion))
+    {
+        SmallRectToRect(GuiData, &RegionRect, &GuiData->PendingRegion);
+        /* Do not erase the background: it speeds up redrawing and reduce flickering */
+        InvalidateRect(GuiData->hWindow, &RegionRect, FALSE);
+        ConioInitRect(&GuiData->PendingRegion, 0, -1, 0, -1);
+    }
+}
+
 static VOID
 DrawRegion(PGUI_CONSOLE_DATA GuiData,
            SMALL_RECT* Region)
 {
     RECT RegionRect;
 
+    FlushPendingUpdate(GuiData);
+
     SmallRectToRect(GuiData, &RegionRect, Region);
     /* Do not erase the background: it speeds up redrawing and reduce flickering */
     InvalidateRect(GuiData->hWindow, &RegionRect, FALSE);
@@ -497,6 +546,7 @@ GuiInitFrontEnd(IN OUT PFRONTEND This,
     GuiData->ActiveBuffer = Console->ActiveBuffer;
     GuiData->hWindow = NULL;
     GuiData->IsWindowVisible = GuiInitInfo->IsWindowVisible;
+    ConioInitRect(&GuiData->PendingRegion, 0, -1, 0, -1);
 
     /* The console can be resized */
     Console->FixedSize = FALSE;
@@ -632,6 +682,14 @@ GuiDrawRegion(IN OUT PFRONTEND This,
     DrawRegion(GuiData, Region);
 }
 
+static VOID
+AddPendingCell(PGUI_CONSOLE_DATA GuiData,
+               SHORT x, SHORT y)
+{
+    SMALL_RECT CellRect = { x, y, x, y };
+    ConioGetUnion(&GuiData->PendingRegion, &GuiData->PendingRegion, &CellRect);
+}
+
 static VOID NTAPI
 GuiWriteStream(IN OUT PFRONTEND This,
                SMALL_RECT* Region,
@@ -643,8 +701,6 @@ GuiWriteStream(IN OUT PFRONTEND This,
 {
     PGUI_CONSOLE_DATA GuiData = This->Context;
     PCONSOLE_SCREEN_BUFFER Buff;
-    SHORT CursorEndX, CursorEndY;
-    RECT ScrollRect;
 
     if (NULL == GuiData || NULL == GuiData->hWindow) return;
 
@@ -654,45 +710,49 @@ GuiWriteStream(IN OUT PFRONTEND This,
     Buff = GuiData->ActiveBuffer;
     if (GetType(Buff) != TEXTMODE_BUFFER) return;
 
+    /*
+     * Do not paint anything now: accumulate the scrolling and the cells to
+     * redraw, so that a fast stream of writes only costs one window scroll
+     * and one repaint per frame (see OnTimer).
+     */
     if (0 != ScrolledLines)
     {
-        ScrollRect.left = 0;
-        ScrollRect.top = 0;
-        ScrollRect.right = Buff->ViewSize.X * GuiData->CharWidth;
-        ScrollRect.bottom = Region->Top * GuiData->CharHeight;
-
-        ScrollWindowEx(GuiData->hWindow,
-                       0,
-                       -(int)(ScrolledLines * GuiData->CharHeight),
-                       &ScrollRect,
-                       NULL,
-                       NULL,
-                       NULL,
-                       SW_INVALIDATE);
+        /* The cells already pending have moved up with the buffer contents */
+        if (!ConioIsRectEmpty(&GuiData->PendingRegion))
+        {
+            if (GuiData->PendingRegion.Bottom < (SHORT)ScrolledLines)
+            {
+                ConioInitRect(&GuiData->PendingRegion, 0, -1, 0, -1);
+            }
+            else
+            {
+                GuiData->PendingRegion.Top    = max(GuiData->PendingRegion.Top - (SHORT)ScrolledLines, 0);
+                GuiData->PendingRegion.Bottom -= (SHORT)ScrolledLines;
+            }
+        }
+        GuiData->PendingScroll += ScrolledLines;
+
+        /* So has the old cursor */
+        CursorStartY -= (SHORT)ScrolledLines;
     }
 
-    DrawRegion(GuiData, Region);
+    ConioGetUnion(&GuiData->PendingRegion, &GuiData->PendingRegion, Region);
 
-    if (CursorStartX < Region->Left || Region->Right < CursorStartX
-            || CursorStartY < Region->Top || Region->Bottom < CursorStartY)
-    {
-        InvalidateCell(GuiData, CursorStartX, CursorStartY);
-    }
+    if (CursorStartY >= 0)
+        AddPendingCell(GuiData, CursorStartX, CursorStartY);
+    AddPendingCell(GuiData, Buff->CursorPosition.X, Buff->CursorPosition.Y);
 
-    CursorEndX = Buff->CursorPosition.X;
-    CursorEndY = Buff->CursorPosition.Y;
-    if ((CursorEndX < Region->Left || Region->Right < CursorEndX
-            || CursorEndY < Region->Top || Region->Bottom < CursorEndY)
-            && (CursorEndX != CursorStartX || CursorEndY != CursorStartY))
+    Buff->CursorBlinkOn = TRUE;
+
+    /*
+     * Arm the update timer only for the first write of a frame: re-arming it
+     * on every write would postpone the repaint for as long as output flows.
+     */
+    if (!GuiData->UpdatePending)
     {
-        InvalidateCell(GuiData, CursorEndX, CursorEndY);
+        GuiData->UpdatePending = TRUE;
+        SetTimer(GuiData->hWindow, CONGUI_UPDATE_TIMER, CONGUI_FRAME_TIME, NULL);
     }
-
-    // HACK!!
-    // Set up the update timer (very short interval) - this is a "hack" for getting the OS to
-    // repaint the window without having it just freeze up and stay on the screen permanently.
-    Buff->CursorBlinkOn = TRUE;
-    SetTimer(GuiData->hWindow, CONGUI_UPDATE_TIMER, CONGUI_UPDATE_TIME, NULL);
 }
 
 /* static */ VOID NTAPI